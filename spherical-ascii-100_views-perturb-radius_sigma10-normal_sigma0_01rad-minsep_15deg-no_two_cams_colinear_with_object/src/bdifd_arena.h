@@ -0,0 +1,161 @@
+// This is bdifd_arena.h
+#ifndef bdifd_arena_h
+#define bdifd_arena_h
+//:
+//\file
+//\brief Bulk storage for the many small objects built from projected samples
+//\date Sun Oct 18 2026
+//
+// bdifd_arena<T> constructs objects in large chunks of raw storage and
+// destroys them all at once in release(): one allocation per chunk instead of
+// one per object, and objects of a view end up contiguous in memory.
+//
+// bdifd_ref_arena<T> is for reference-counted types (vsol, sdet edgemaps...)
+// handed out through vbl_smart_ptr. The arena holds one reference to each
+// object, so a smart pointer dropping to zero never calls delete on arena
+// storage. All outside references must be gone before release(); this is
+// checked in debug builds.
+//
+// bdifd_vsol_arena groups the vsol types used by bdifd_data, released in
+// dependency order (polylines and lines hold references to points).
+//
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+#include <vsol/vsol_point_2d.h>
+#include <vsol/vsol_line_2d.h>
+#include <vsol/vsol_polyline_2d.h>
+
+template <class T>
+class bdifd_arena {
+public:
+  explicit bdifd_arena(unsigned chunk=4096) : chunk_(chunk ? chunk : 1), size_(0) {}
+  bdifd_arena(bdifd_arena &&o) : chunk_(o.chunk_), size_(o.size_)
+  {
+    chunks_.swap(o.chunks_);
+    o.size_ = 0;
+  }
+  ~bdifd_arena() { release(); }
+
+  //: Makes room for \p n more objects in a single chunk.
+  void reserve(unsigned n)
+  {
+    if (chunks_.empty() || chunks_.back().size + n > chunks_.back().capacity)
+      add_chunk(n);
+  }
+
+  //: Constructs a T from \p args in arena storage.
+  template <class... A> T *
+  make(A&&... args)
+  {
+    if (chunks_.empty() || chunks_.back().size == chunks_.back().capacity)
+      add_chunk(chunk_);
+    chunk &c = chunks_.back();
+    T *p = new (c.data + c.size) T(std::forward<A>(args)...);
+    ++c.size;
+    ++size_;
+    return p;
+  }
+
+  //: Number of live objects.
+  unsigned size() const { return size_; }
+
+  //: Calls f(T &) on every live object, in construction order.
+  template <class F> void
+  for_each(const F &f)
+  {
+    for (unsigned i=0; i < chunks_.size(); ++i)
+      for (unsigned j=0; j < chunks_[i].size; ++j)
+        f(chunks_[i].data[j]);
+  }
+
+  //: Destroys all objects, last constructed first, and frees the storage.
+  void release()
+  {
+    for (unsigned i=chunks_.size(); i-- > 0; ) {
+      chunk &c = chunks_[i];
+      for (unsigned j=c.size; j-- > 0; )
+        c.data[j].~T();
+      ::operator delete(static_cast<void *>(c.data));
+    }
+    chunks_.clear();
+    size_ = 0;
+  }
+
+private:
+  struct chunk {
+    T *data;
+    unsigned size;
+    unsigned capacity;
+  };
+
+  void add_chunk(unsigned n)
+  {
+    chunk c;
+    c.data = static_cast<T *>(::operator new(sizeof(T)*std::size_t(n)));
+    c.size = 0;
+    c.capacity = n;
+    chunks_.push_back(c);
+  }
+
+  bdifd_arena(const bdifd_arena &);
+  bdifd_arena &operator=(const bdifd_arena &);
+
+  unsigned chunk_;
+  unsigned size_;
+  std::vector<chunk> chunks_;
+};
+
+//: Arena for types derived from vbl_ref_count.
+template <class T>
+class bdifd_ref_arena {
+public:
+  explicit bdifd_ref_arena(unsigned chunk=4096) : arena_(chunk) {}
+  bdifd_ref_arena(bdifd_ref_arena &&o) : arena_(std::move(o.arena_)) {}
+  ~bdifd_ref_arena() { release(); }
+
+  void reserve(unsigned n) { arena_.reserve(n); }
+  unsigned size() const { return arena_.size(); }
+
+  template <class... A> T *
+  make(A&&... args)
+  {
+    T *p = arena_.make(std::forward<A>(args)...);
+    p->ref();
+    return p;
+  }
+
+  void release()
+  {
+#ifndef NDEBUG
+    arena_.for_each([](T &o) { assert(o.get_references() == 1); });
+#endif
+    arena_.release();
+  }
+
+private:
+  bdifd_arena<T> arena_;
+};
+
+//: Points, lines and polylines of one view.
+struct bdifd_vsol_arena {
+  bdifd_ref_arena<vsol_polyline_2d> polylines;
+  bdifd_ref_arena<vsol_line_2d> lines;
+  bdifd_ref_arena<vsol_point_2d> points;
+
+  bdifd_vsol_arena() {}
+  bdifd_vsol_arena(bdifd_vsol_arena &&o) = default;
+  ~bdifd_vsol_arena() { release(); }
+
+  void release()
+  {
+    polylines.release();
+    lines.release();
+    points.release();
+  }
+};
+
+#endif // bdifd_arena_h
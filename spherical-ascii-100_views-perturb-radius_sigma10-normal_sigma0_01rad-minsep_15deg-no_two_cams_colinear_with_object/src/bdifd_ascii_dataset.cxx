@@ -0,0 +1,246 @@
+#include "bdifd_ascii_dataset.h"
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <vul/vul_file.h>
+#include "bdifd_channels.h"
+#include "bdifd_morton.h"
+
+bool bdifd_ascii_dataset::
+read_numbers(const std::string &fname, std::vector<double> *v)
+{
+  std::ifstream fp(fname.c_str(), std::ios::in | std::ios::binary);
+  if (!fp)
+    return false;
+  std::string buf((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+
+  v->clear();
+  v->reserve(buf.size()/20);
+  const char *p = buf.c_str();
+  const char *end = p + buf.size();
+  while (p < end) {
+    char *q;
+    double d = std::strtod(p, &q);
+    if (q == p) {
+      // only trailing whitespace may remain
+      while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        ++p;
+      if (p != end)
+        return false;
+      break;
+    }
+    v->push_back(d);
+    p = q;
+  }
+  return true;
+}
+
+std::string bdifd_ascii_dataset::
+view_name(unsigned v)
+{
+  std::ostringstream v_str;
+  v_str << "frame_" << std::setw(4) << std::setfill('0') << v;
+  return v_str.str();
+}
+
+static bool
+read_error(const std::string &fname)
+{
+  std::cerr << "bdifd_ascii_dataset: error, unable to read file name " << fname << std::endl;
+  return false;
+}
+
+//: Reads \p fname as rows of \p ncols numbers into the arrays of \p cols.
+static bool
+read_columns(const std::string &fname, unsigned ncols, std::vector<double> *cols[])
+{
+  std::vector<double> v;
+  if (!bdifd_ascii_dataset::read_numbers(fname, &v) || v.size() % ncols)
+    return read_error(fname);
+  unsigned n = v.size()/ncols;
+  for (unsigned c=0; c < ncols; ++c) {
+    cols[c]->resize(n);
+    for (unsigned i=0; i < n; ++i)
+      (*cols[c])[i] = v[i*ncols + c];
+  }
+  return true;
+}
+
+//: Puts \p v, in the line order \p ids, back in sample order.
+static void
+to_sample_order(const std::vector<unsigned> &ids, std::vector<double> *v)
+{
+  std::vector<double> s(v->size());
+  for (unsigned l=0; l < ids.size(); ++l)
+    s[ids[l]] = (*v)[l];
+  v->swap(s);
+}
+
+bool bdifd_ascii_dataset::
+read(const std::string &d, bool read_2d, bool keep_file_order)
+{
+  dir = d;
+  file_order = keep_file_order;
+  std::vector<double> v;
+
+  std::string fname = dir + "/calib.intrinsic";
+  if (!read_numbers(fname, &v) || v.size() != 9)
+    return read_error(fname);
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c)
+      K[r][c] = v[3*r + c];
+
+  distortion = bdifd_lens_distortion();
+  fname = dir + "/calib.distortion";
+  if (vul_file::exists(fname) && !distortion.read(fname))
+    return false;
+
+  R.clear();
+  C.clear();
+  for (unsigned k=0; ; ++k) {
+    fname = dir + "/" + view_name(k) + ".extrinsic";
+    if (!vul_file::exists(fname))
+      break;
+    if (!read_numbers(fname, &v) || v.size() != 12)
+      return read_error(fname);
+    vnl_double_3x3 Rk;
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned c=0; c < 3; ++c)
+        Rk[r][c] = v[3*r + c];
+    R.push_back(Rk);
+    C.push_back(vnl_double_3(v[9], v[10], v[11]));
+  }
+  if (R.empty())
+    return read_error(dir + "/" + view_name(0) + ".extrinsic");
+
+  std::vector<double> *pts3d[3] = {&X, &Y, &Z};
+  if (!read_columns(dir + "/crv-3D-pts.txt", 3, pts3d))
+    return false;
+  std::vector<double> *tgts3d[3] = {&TX, &TY, &TZ};
+  if (!read_columns(dir + "/crv-3D-tgts.txt", 3, tgts3d))
+    return false;
+  if (TX.size() != X.size())
+    return read_error(dir + "/crv-3D-tgts.txt");
+
+  fname = dir + "/crv-ids.txt";
+  if (!read_numbers(fname, &v) || v.size() != X.size())
+    return read_error(fname);
+  crv_id.resize(v.size());
+  for (unsigned i=0; i < v.size(); ++i)
+    crv_id[i] = static_cast<unsigned>(v[i]);
+
+  x.clear(); y.clear(); tx.clear(); ty.clear();
+  line_id.clear(); sample_line.clear();
+  if (!read_2d)
+    return true;
+
+  unsigned nv = R.size();
+  x.resize(nv); y.resize(nv); tx.resize(nv); ty.resize(nv);
+  line_id.resize(nv); sample_line.resize(nv);
+  for (unsigned k=0; k < nv; ++k) {
+    std::string base = dir + "/" + view_name(k);
+    std::vector<double> *pts[2] = {&x[k], &y[k]};
+    if (!read_columns(base + "-pts-2D.txt", 2, pts))
+      return false;
+    if (x[k].size() != X.size())
+      return read_error(base + "-pts-2D.txt");
+    std::vector<double> *tgts[2] = {&tx[k], &ty[k]};
+    if (!read_columns(base + "-tgts-2D.txt", 2, tgts))
+      return false;
+    if (tx[k].size() != X.size())
+      return read_error(base + "-tgts-2D.txt");
+
+    fname = bdifd_morton::ids_name(dir, k);
+    if (!vul_file::exists(fname))
+      continue;
+    if (!bdifd_morton::read_ids(fname, &line_id[k]))
+      return false;
+    if (line_id[k].size() != X.size())
+      return read_error(fname);
+    if (file_order)
+      bdifd_morton::inverse(line_id[k], &sample_line[k]);
+    else {
+      to_sample_order(line_id[k], &x[k]);  to_sample_order(line_id[k], &y[k]);
+      to_sample_order(line_id[k], &tx[k]); to_sample_order(line_id[k], &ty[k]);
+    }
+  }
+  return true;
+}
+
+void bdifd_ascii_dataset::
+undistorted(unsigned v, std::vector<double> *ux, std::vector<double> *uy,
+    std::vector<double> *utx, std::vector<double> *uty) const
+{
+  *ux = x[v];
+  *uy = y[v];
+  *utx = tx[v];
+  *uty = ty[v];
+  if (distortion.is_identity())
+    return;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  for (unsigned i=0; i < ux->size(); ++i)
+    if (!distortion.undistort_pixel(K, x[v][i], y[v][i], tx[v][i], ty[v][i],
+          &(*ux)[i], &(*uy)[i], &(*utx)[i], &(*uty)[i]))
+      (*ux)[i] = (*uy)[i] = (*utx)[i] = (*uty)[i] = nan;
+}
+
+bool bdifd_ascii_dataset::
+read_curvature(bool read_2d)
+{
+  std::vector<std::vector<double> > cols;
+  std::string base = bdifd_channels::space_base(dir);
+  if (!bdifd_channels::read(base, 3, &cols))
+    return false;
+  if (cols[0].size() != X.size())
+    return read_error(base);
+  KC.swap(cols[0]);
+  KCDOT.swap(cols[1]);
+  TAU.swap(cols[2]);
+
+  k.clear(); kdot.clear();
+  if (!read_2d)
+    return true;
+
+  unsigned nv = R.size();
+  k.resize(nv); kdot.resize(nv);
+  for (unsigned v=0; v < nv; ++v) {
+    base = bdifd_channels::view_base(dir, v);
+    if (!bdifd_channels::read(base, 2, &cols))
+      return false;
+    if (cols[0].size() != X.size())
+      return read_error(base);
+    k[v].swap(cols[0]);
+    kdot[v].swap(cols[1]);
+
+    // same order as x, y of the view; sample order if those were not read
+    std::vector<unsigned> ids;
+    if (v < line_id.size()) {
+      if (!file_order)
+        ids = line_id[v];
+    } else {
+      std::string fname = bdifd_morton::ids_name(dir, v);
+      if (vul_file::exists(fname) && !bdifd_morton::read_ids(fname, &ids))
+        return false;
+    }
+    if (!ids.empty()) {
+      if (ids.size() != X.size())
+        return read_error(bdifd_morton::ids_name(dir, v));
+      to_sample_order(ids, &k[v]);
+      to_sample_order(ids, &kdot[v]);
+    }
+  }
+  return true;
+}
+
+vpgl_perspective_camera<double> bdifd_ascii_dataset::
+camera(unsigned v) const
+{
+  return vpgl_perspective_camera<double>(
+      vpgl_calibration_matrix<double>(K),
+      vgl_point_3d<double>(C[v][0], C[v][1], C[v][2]),
+      vgl_rotation_3d<double>(R[v]));
+}
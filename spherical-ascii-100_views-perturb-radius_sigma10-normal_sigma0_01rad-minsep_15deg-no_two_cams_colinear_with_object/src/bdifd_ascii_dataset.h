@@ -0,0 +1,97 @@
+// This is bdifd_ascii_dataset.h
+#ifndef bdifd_ascii_dataset_h
+#define bdifd_ascii_dataset_h
+//:
+//\file
+//\brief Reader for the ASCII multiview curve datasets
+//\date Sun Oct 18 2026
+//
+// Loads a dataset directory in the format described in the README:
+// calib.intrinsic, frame_NNNN.extrinsic (R and camera center C),
+// frame_NNNN-pts-2D.txt, frame_NNNN-tgts-2D.txt, crv-3D-pts.txt,
+// crv-3D-tgts.txt and crv-ids.txt. Views are numbered from 0 until the first
+// missing extrinsic file.
+//
+// Each file is read in one go and parsed with strtod, which is what makes the
+// 100-view dataset load in well under a second. Samples are kept as one array
+// per coordinate, ready for the batched checkers.
+//
+// Views written in Z-order (bdifd_morton.h) are put back in sample order,
+// unless read with file_order, in which case the image arrays of such a view
+// stay in file order and line_id / sample_line map between the two.
+//
+// calib.distortion is read if present; otherwise distortion is the identity.
+// The image samples are kept as stored, i.e. distorted; undistorted() gives
+// those of a view as the pinhole cameras see them, which is what the
+// epipolar and trifocal checkers need.
+//
+// The optional curvature channels (bdifd_channels.h) are not read by read();
+// read_curvature() loads them for the consumers that want them.
+//
+
+#include <string>
+#include <vector>
+#include <vnl/vnl_double_3.h>
+#include <vnl/vnl_double_3x3.h>
+#include <vpgl/vpgl_perspective_camera.h>
+#include "bdifd_distortion.h"
+
+class bdifd_ascii_dataset {
+public:
+  //: Reads \p dir. With \p read_2d false only cameras and 3D curves are read.
+  // Prints the offending file name to std::cerr and returns false on error.
+  bool read(const std::string &dir, bool read_2d=true, bool file_order=false);
+
+  //: Reads the curvature channels of the dataset read last, the image ones
+  // too if \p read_2d. Same error handling as read().
+  bool read_curvature(bool read_2d=true);
+
+  unsigned nviews() const { return R.size(); }
+  unsigned npts() const { return X.size(); }
+
+  //: Image samples and unit tangents of view \p v with the lens distortion
+  // removed, in the order of x and y; a copy of them if there is none. NaN
+  // where the undistortion does not converge.
+  void undistorted(unsigned v, std::vector<double> *ux, std::vector<double> *uy,
+      std::vector<double> *utx, std::vector<double> *uty) const;
+
+  //: Camera of view \p v.
+  vpgl_perspective_camera<double> camera(unsigned v) const;
+
+  //: "frame_0014"-style prefix of view \p v.
+  static std::string view_name(unsigned v);
+
+  //: Reads a whitespace-separated text file of numbers into \p v.
+  // Returns false if the file cannot be read or holds anything else.
+  static bool read_numbers(const std::string &fname, std::vector<double> *v);
+
+  std::string dir;
+
+  vnl_double_3x3 K;
+  bdifd_lens_distortion distortion;
+  std::vector<vnl_double_3x3> R;    //:< world to camera rotation, per view
+  std::vector<vnl_double_3> C;      //:< camera center, per view
+
+  //: Image samples in pixels, [view][sample] (or [view][line], see above).
+  std::vector<std::vector<double> > x, y, tx, ty;
+
+  //: For Z-ordered views, the sample of each line, [view][line]; empty for
+  // views in sample order.
+  std::vector<std::vector<unsigned> > line_id;
+
+  //: With file_order, the line of each sample of Z-ordered views,
+  // [view][sample], the inverse of line_id.
+  std::vector<std::vector<unsigned> > sample_line;
+  bool file_order;
+
+  //: Space samples.
+  std::vector<double> X, Y, Z, TX, TY, TZ;
+  std::vector<unsigned> crv_id;
+
+  //: Curvature channels, empty until read_curvature(): image curvature and
+  // its derivative [view][sample], space curvature, derivative and torsion.
+  std::vector<std::vector<double> > k, kdot;
+  std::vector<double> KC, KCDOT, TAU;
+};
+
+#endif // bdifd_ascii_dataset_h
@@ -0,0 +1,116 @@
+#include "bdifd_bench.h"
+#include "bdifd_json.h"
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+bdifd_bench::
+bdifd_bench(unsigned repetitions, double min_time, const std::string &filter)
+  : repetitions_(repetitions ? repetitions : 1),
+    min_time_(min_time),
+    filter_(filter)
+{
+}
+
+std::string bdifd_bench::
+name(const std::string &stage, const params &p)
+{
+  std::ostringstream s;
+  s << stage;
+  for (unsigned i=0; i < p.size(); ++i)
+    s << '/' << p[i].first << ':' << p[i].second;
+  return s.str();
+}
+
+bool bdifd_bench::
+skip(const std::string &name) const
+{
+  return !filter_.empty() && name.find(filter_) == std::string::npos;
+}
+
+static double
+median(std::vector<double> v)
+{
+  std::sort(v.begin(), v.end());
+  unsigned n = v.size();
+  return n % 2 ? v[n/2] : (v[n/2 - 1] + v[n/2])/2;
+}
+
+void bdifd_bench::
+add(const std::string &name, const params &p, double items,
+    unsigned iterations, std::vector<double> &real, std::vector<double> &cpu)
+{
+  bdifd_bench_result r;
+  r.name = name;
+  r.params = p;
+  r.iterations = iterations;
+  r.repetitions = real.size();
+  r.real_time = median(real);
+  r.real_time_min = *std::min_element(real.begin(), real.end());
+  r.real_time_max = *std::max_element(real.begin(), real.end());
+  r.cpu_time = median(cpu);
+  r.items = items;
+  results_.push_back(r);
+
+  std::cerr << std::left << std::setw(56) << name << std::right
+    << std::setw(12) << r.real_time*1e3 << " ms" << std::endl;
+}
+
+void bdifd_bench::
+print(std::ostream &os) const
+{
+  os << std::left << std::setw(56) << "Benchmark" << std::right
+    << std::setw(14) << "Time (ms)" << std::setw(14) << "Min (ms)"
+    << std::setw(14) << "CPU (ms)" << std::setw(16) << "Items/s" << std::endl;
+  for (unsigned i=0; i < results_.size(); ++i) {
+    const bdifd_bench_result &r = results_[i];
+    os << std::left << std::setw(56) << r.name << std::right
+      << std::setw(14) << r.real_time*1e3 << std::setw(14) << r.real_time_min*1e3
+      << std::setw(14) << r.cpu_time*1e3 << std::setw(16)
+      << (r.items > 0 && r.real_time > 0 ? r.items/r.real_time : 0) << std::endl;
+  }
+}
+
+void bdifd_bench::
+write_json(std::ostream &os,
+    const std::vector<std::pair<std::string, std::string> > &context) const
+{
+  std::ios::fmtflags f = os.flags();
+  std::streamsize prec = os.precision(17);
+
+  os << "{\n  \"context\": {";
+  for (unsigned i=0; i < context.size(); ++i) {
+    os << (i ? ",\n    " : "\n    ");
+    bdifd_json_string(os, context[i].first);
+    os << ": ";
+    bdifd_json_string(os, context[i].second);
+  }
+  os << "\n  },\n  \"benchmarks\": [";
+
+  for (unsigned i=0; i < results_.size(); ++i) {
+    const bdifd_bench_result &r = results_[i];
+    os << (i ? ",\n    {" : "\n    {");
+    os << "\n      \"name\": ";
+    bdifd_json_string(os, r.name);
+    os << ",\n      \"run_type\": \"iteration\""
+      << ",\n      \"iterations\": " << r.iterations
+      << ",\n      \"repetitions\": " << r.repetitions
+      << ",\n      \"real_time\": " << r.real_time*1e9
+      << ",\n      \"real_time_min\": " << r.real_time_min*1e9
+      << ",\n      \"real_time_max\": " << r.real_time_max*1e9
+      << ",\n      \"cpu_time\": " << r.cpu_time*1e9
+      << ",\n      \"time_unit\": \"ns\"";
+    if (r.items > 0 && r.real_time > 0)
+      os << ",\n      \"items_per_second\": " << r.items/r.real_time;
+    for (unsigned k=0; k < r.params.size(); ++k) {
+      os << ",\n      ";
+      bdifd_json_string(os, r.params[k].first);
+      os << ": " << r.params[k].second;
+    }
+    os << "\n    }";
+  }
+  os << "\n  ]\n}\n";
+
+  os.precision(prec);
+  os.flags(f);
+}
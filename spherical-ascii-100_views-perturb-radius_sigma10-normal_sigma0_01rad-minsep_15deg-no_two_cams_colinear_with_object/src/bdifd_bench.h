@@ -0,0 +1,100 @@
+// This is bdifd_bench.h
+#ifndef bdifd_bench_h
+#define bdifd_bench_h
+//:
+//\file
+//\brief Minimal microbenchmark harness with JSON output
+//\date Sun Oct 18 2026
+//
+// Each case is a callable timed over a number of repetitions, after one
+// warm-up call; a repetition loops the callable until it has run for at least
+// min_time seconds so that fast stages are not lost in clock resolution.
+//
+// The JSON report follows the layout of Google Benchmark
+// ("context" + "benchmarks" with name, iterations, real_time, cpu_time,
+// time_unit), so that existing regression-tracking tools can read it.
+// Names are "stage/param:value/...".
+//
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct bdifd_bench_result {
+  std::string name;
+  std::vector<std::pair<std::string, double> > params;
+  unsigned iterations;      //:< calls per repetition
+  unsigned repetitions;
+  double real_time;         //:< median seconds per call over repetitions
+  double real_time_min;
+  double real_time_max;
+  double cpu_time;          //:< median process CPU seconds per call
+  double items;             //:< items processed per call (points, views...)
+};
+
+class bdifd_bench {
+public:
+  typedef std::vector<std::pair<std::string, double> > params;
+
+  //: Cases whose name does not contain \p filter are skipped.
+  explicit bdifd_bench(unsigned repetitions=5, double min_time=0.05,
+      const std::string &filter="");
+
+  //: Times f() as case \p stage; \p items per call gives the throughput.
+  template <class F> void
+  run(const std::string &stage, const params &p, double items, F f);
+
+  const std::vector<bdifd_bench_result> &results() const { return results_; }
+
+  //: Human-readable table.
+  void print(std::ostream &os) const;
+
+  //: Machine-readable report; \p context entries are added to "context".
+  void write_json(std::ostream &os,
+      const std::vector<std::pair<std::string, std::string> > &context) const;
+
+  static std::string name(const std::string &stage, const params &p);
+
+private:
+  bool skip(const std::string &name) const;
+  void add(const std::string &name, const params &p, double items,
+      unsigned iterations, std::vector<double> &real, std::vector<double> &cpu);
+
+  unsigned repetitions_;
+  double min_time_;
+  std::string filter_;
+  std::vector<bdifd_bench_result> results_;
+};
+
+template <class F> void bdifd_bench::
+run(const std::string &stage, const params &p, double items, F f)
+{
+  typedef std::chrono::steady_clock clock;
+  std::string nm = name(stage, p);
+  if (skip(nm))
+    return;
+
+  clock::time_point t0 = clock::now();
+  f();
+  double once = std::chrono::duration<double>(clock::now() - t0).count();
+  unsigned iterations = 1;
+  if (once < min_time_)
+    iterations = static_cast<unsigned>(min_time_/std::max(once, 1e-9)) + 1;
+
+  std::vector<double> real, cpu;
+  for (unsigned r=0; r < repetitions_; ++r) {
+    std::clock_t c0 = std::clock();
+    t0 = clock::now();
+    for (unsigned i=0; i < iterations; ++i)
+      f();
+    real.push_back(std::chrono::duration<double>(clock::now() - t0).count()/iterations);
+    cpu.push_back(double(std::clock() - c0)/CLOCKS_PER_SEC/iterations);
+  }
+  add(nm, p, items, iterations, real, cpu);
+}
+
+#endif // bdifd_bench_h
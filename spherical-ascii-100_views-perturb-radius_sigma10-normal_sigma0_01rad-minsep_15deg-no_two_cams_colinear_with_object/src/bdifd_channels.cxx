@@ -0,0 +1,187 @@
+#include "bdifd_channels.h"
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <vul/vul_file.h>
+#include "bdifd_ascii_dataset.h"
+
+namespace {
+
+const char magic[8] = {'b','d','i','f','d','c','h','1'};
+
+bool
+write_error(const std::string &fname)
+{
+  std::cerr << "bdifd_channels: error, unable to write file name " << fname << std::endl;
+  return false;
+}
+
+bool
+read_error(const std::string &fname)
+{
+  std::cerr << "bdifd_channels: error, unable to read file name " << fname << std::endl;
+  return false;
+}
+
+//: Opens \p fname and reads its header.
+bool
+open_binary(const std::string &fname, std::ifstream &fp, uint32_t *ncols, uint32_t *nrows)
+{
+  fp.open(fname.c_str(), std::ios::in | std::ios::binary);
+  char m[8];
+  if (!fp || !fp.read(m, 8) || std::memcmp(m, magic, 8)
+      || !fp.read(reinterpret_cast<char *>(ncols), 4) || !fp.read(reinterpret_cast<char *>(nrows), 4))
+    return false;
+  return true;
+}
+
+} // namespace
+
+bool bdifd_channels::
+parse_formats(const std::string &s, unsigned *formats)
+{
+  *formats = 0;
+  std::string f = s;
+  for (unsigned i=0; i < f.size(); ++i)
+    if (f[i] == ',')
+      f[i] = ' ';
+  std::istringstream is(f);
+  std::string w;
+  while (is >> w) {
+    if (w == "txt")
+      *formats |= text;
+    else if (w == "bin")
+      *formats |= binary;
+    else
+      return false;
+  }
+  return true;
+}
+
+bool bdifd_channels::
+write(const std::string &base, unsigned formats,
+    const std::vector<std::vector<double> > &cols, double *bytes)
+{
+  unsigned ncols = cols.size();
+  unsigned nrows = ncols ? cols[0].size() : 0;
+
+  if (formats & text) {
+    std::string fname = base + ".txt";
+    std::ofstream fp(fname.c_str());
+    if (!fp)
+      return write_error(fname);
+    fp << std::setprecision(20);
+    for (unsigned i=0; i < nrows; ++i) {
+      for (unsigned c=0; c < ncols; ++c)
+        fp << (c ? " " : "") << cols[c][i];
+      fp << std::endl;
+    }
+    if (!fp)
+      return write_error(fname);
+    if (bytes)
+      *bytes += double(fp.tellp());
+  }
+
+  if (formats & binary) {
+    std::string fname = base + ".bin";
+    std::ofstream fp(fname.c_str(), std::ios::out | std::ios::binary);
+    if (!fp)
+      return write_error(fname);
+    uint32_t n[2] = {ncols, nrows};
+    fp.write(magic, 8);
+    fp.write(reinterpret_cast<const char *>(n), sizeof(n));
+    for (unsigned c=0; c < ncols; ++c)
+      if (nrows)
+        fp.write(reinterpret_cast<const char *>(&cols[c][0]), nrows*sizeof(double));
+    if (!fp)
+      return write_error(fname);
+    if (bytes)
+      *bytes += double(fp.tellp());
+  }
+  return true;
+}
+
+bool bdifd_channels::
+read(const std::string &base, unsigned ncols, std::vector<std::vector<double> > *cols)
+{
+  cols->assign(ncols, std::vector<double>());
+
+  std::string fname = base + ".bin";
+  if (vul_file::exists(fname)) {
+    std::ifstream fp;
+    uint32_t nc, nr;
+    if (!open_binary(fname, fp, &nc, &nr) || nc != ncols)
+      return read_error(fname);
+    for (unsigned c=0; c < ncols; ++c) {
+      (*cols)[c].resize(nr);
+      if (nr && !fp.read(reinterpret_cast<char *>(&(*cols)[c][0]), nr*sizeof(double)))
+        return read_error(fname);
+    }
+    return true;
+  }
+
+  fname = base + ".txt";
+  std::vector<double> v;
+  if (!bdifd_ascii_dataset::read_numbers(fname, &v) || v.size() % ncols)
+    return read_error(fname);
+  unsigned nr = v.size()/ncols;
+  for (unsigned c=0; c < ncols; ++c) {
+    (*cols)[c].resize(nr);
+    for (unsigned i=0; i < nr; ++i)
+      (*cols)[c][i] = v[i*ncols + c];
+  }
+  return true;
+}
+
+bool bdifd_channels::
+read_column(const std::string &fname, unsigned c, std::vector<double> *col)
+{
+  std::ifstream fp;
+  uint32_t nc, nr;
+  if (!open_binary(fname, fp, &nc, &nr) || c >= nc)
+    return read_error(fname);
+  col->resize(nr);
+  fp.seekg(16 + std::streamoff(c)*nr*sizeof(double));
+  if (nr && !fp.read(reinterpret_cast<char *>(&(*col)[0]), nr*sizeof(double)))
+    return read_error(fname);
+  return true;
+}
+
+void bdifd_channels::
+curvature_2d(const std::vector<bdifd_3rd_order_point_2d> &pts,
+    std::vector<std::vector<double> > *cols)
+{
+  cols->assign(2, std::vector<double>(pts.size()));
+  for (unsigned i=0; i < pts.size(); ++i) {
+    (*cols)[0][i] = pts[i].k;
+    (*cols)[1][i] = pts[i].kdot;
+  }
+}
+
+void bdifd_channels::
+curvature_3d(const std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d,
+    std::vector<std::vector<double> > *cols)
+{
+  cols->assign(3, std::vector<double>());
+  for (unsigned c=0; c < crv3d.size(); ++c)
+    for (unsigned i=0; i < crv3d[c].size(); ++i) {
+      (*cols)[0].push_back(crv3d[c][i].K);
+      (*cols)[1].push_back(crv3d[c][i].Kdot);
+      (*cols)[2].push_back(crv3d[c][i].Tau);
+    }
+}
+
+std::string bdifd_channels::
+view_base(const std::string &dir, unsigned v)
+{
+  return dir + "/" + bdifd_ascii_dataset::view_name(v) + "-curv-2D";
+}
+
+std::string bdifd_channels::
+space_base(const std::string &dir)
+{
+  return dir + "/crv-3D-curv";
+}
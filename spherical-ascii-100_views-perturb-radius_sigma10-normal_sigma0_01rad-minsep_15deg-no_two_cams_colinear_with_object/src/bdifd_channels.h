@@ -0,0 +1,70 @@
+// This is bdifd_channels.h
+#ifndef bdifd_channels_h
+#define bdifd_channels_h
+//:
+//\file
+//\brief Optional per-sample channels stored next to a dataset
+//\date Sun Oct 18 2026
+//
+// The point and tangent files are all most consumers read, so differential
+// quantities of higher order go in files of their own, written only on
+// request:
+//
+//   frame_NNNN-curv-2D.{txt,bin}   k kdot      image curvature and its
+//                                              arclength derivative
+//   crv-3D-curv.{txt,bin}          K Kdot Tau  space curvature, its
+//                                              derivative and torsion
+//
+// one row per sample, in the order of the point files. The values are those
+// of the third-order projection (bdifd_camera::project_to_image) and of the
+// sampled space curves, so they cost nothing extra to compute; what is saved
+// by not asking for them is the formatting and the I/O.
+//
+// A .txt file has one row of columns per line. A .bin file is a 16-byte
+// header, the 8 bytes "bdifdch1" then the number of columns and of rows as
+// uint32, followed by each column in turn as native-endian doubles, so a
+// single column can be read with one seek (read_column).
+//
+
+#include <string>
+#include <vector>
+#include <bdifd/bdifd_frenet_point.h>
+
+class bdifd_channels {
+public:
+  enum format { text = 1, binary = 2 };
+
+  //: Parses a comma-separated list of "txt" and "bin" into a mask of
+  // formats; "" is none. False on anything else.
+  static bool parse_formats(const std::string &s, unsigned *formats);
+
+  //: Writes \p cols (all of the same length) to \p base + ".txt" and/or
+  // ".bin" as \p formats says, adding the bytes written to \p bytes if given.
+  // Prints the file name to std::cerr and returns false on error.
+  static bool write(const std::string &base, unsigned formats,
+      const std::vector<std::vector<double> > &cols, double *bytes=0);
+
+  //: Reads the \p ncols columns of \p base + ".bin" or, if there is none,
+  // + ".txt". Prints the file name to std::cerr and returns false on error.
+  static bool read(const std::string &base, unsigned ncols,
+      std::vector<std::vector<double> > *cols);
+
+  //: Reads column \p c of the binary file \p fname only.
+  static bool read_column(const std::string &fname, unsigned c, std::vector<double> *col);
+
+  //: k and kdot of \p pts, in that order.
+  static void curvature_2d(const std::vector<bdifd_3rd_order_point_2d> &pts,
+      std::vector<std::vector<double> > *cols);
+
+  //: K, Kdot and Tau of the samples of all curves of \p crv3d, in order.
+  static void curvature_3d(const std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d,
+      std::vector<std::vector<double> > *cols);
+
+  //: "frame_NNNN-curv-2D" style base name of view \p v in \p dir.
+  static std::string view_base(const std::string &dir, unsigned v);
+
+  //: Base name of the space curve channels in \p dir.
+  static std::string space_base(const std::string &dir);
+};
+
+#endif // bdifd_channels_h
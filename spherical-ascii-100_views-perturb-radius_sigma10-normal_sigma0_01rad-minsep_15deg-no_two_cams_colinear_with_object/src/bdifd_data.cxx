@@ -1,10 +1,17 @@
+#include <cmath>
 #include <ctime>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <bdifd/bdifd_util.h>
 #include <bdifd/bdifd_analytic.h>
 #include <bdifd/bdifd_rig.h>
 #include "bdifd_data.h"
+#include "bdifd_edgel_sampler.h"
+#include "bdifd_parallel.h"
+#include "bdifd_log.h"
+#include "bdifd_run_report.h"
+#include "bdifd_turntable_rig.h"
 #include <algorithm>
 #include <vsol/vsol_line_2d.h>
 #include <vul/vul_file.h>
@@ -29,30 +36,69 @@ max_err_reproj_perturb(
     unsigned &nvalid
     )
 {
-  std::vector<double> err_pos_sq_v;
-  std::vector<double> err_t_v;
-  std::vector<double> err_k_v;
-  std::vector<double> err_kdot_v;
-  std::vector<unsigned> valid_idx;
+  bdifd_err_stats s_pos, s_t, s_k, s_kdot;
 
-  err_reproj_perturb(crv2d_gt_, cam_, rig, err_pos_sq_v, err_t_v, err_k_v, err_kdot_v, valid_idx);
+  err_reproj_perturb(crv2d_gt_, cam_, rig, s_pos, s_t, s_k, s_kdot);
 
+  err_pos = s_pos.max();
+  i_pos   = s_pos.argmax();
 
-  unsigned idx;
+  err_t = s_t.max();
+  i_t = s_t.argmax();
 
-  err_pos = std::sqrt(bdifd_util::max(err_pos_sq_v,idx));
-  i_pos   = valid_idx[idx];
+  err_k = s_k.max();
+  i_k = s_k.argmax();
 
-  err_t = bdifd_util::max(err_t_v,idx);
-  i_t = valid_idx[idx];
+  err_kdot = s_kdot.max();
+  i_kdot = s_kdot.argmax();
 
-  err_k = bdifd_util::max(err_k_v,idx);
-  i_k = valid_idx[idx];
+  nvalid = s_pos.count();
+}
+
+//: Loop shared by the err_reproj_perturb variants. Calls
+// visit(i, err_pos_sq, err_t, err_k, err_kdot) for each valid point i.
+template <class F> static void
+err_reproj_perturb_visit(
+    const std::vector<std::vector<bdifd_3rd_order_point_2d> > &crv2d_gt_,
+    const std::vector<bdifd_camera> &cam_,
+    const bdifd_rig &rig,
+    const F &visit
+    )
+{
+  assert(crv2d_gt_.size() >= 3 && crv2d_gt_[0].size() == crv2d_gt_[1].size() && crv2d_gt_[0].size() == crv2d_gt_[2].size());
+
+  const double epipolar_angle_thresh = vnl_math::pi/6;
 
-  err_kdot = bdifd_util::max(err_kdot_v,idx);
-  i_kdot = valid_idx[idx];
+  for (unsigned i=0; i < crv2d_gt_[0].size(); ++i) {
+    // get hold of p1, theta1, k1, kdot1
+    const bdifd_3rd_order_point_2d &p1 = crv2d_gt_[0][i];
+
+    // get hold of p2, theta2, k2, kdot2
+    const bdifd_3rd_order_point_2d &p2 = crv2d_gt_[1][i];
+    bdifd_3rd_order_point_2d p1_w, p2_w;
+    bdifd_3rd_order_point_3d Prec;
+    rig.cam[0].img_to_world(&p1,&p1_w);
+    rig.cam[1].img_to_world(&p2,&p2_w);
 
-  nvalid = valid_idx.size();
+    rig.reconstruct_3rd_order(p1_w, p2_w, &Prec);
+
+    bool valid;
+    bdifd_3rd_order_point_2d p_rec_reproj = cam_[2].project_to_image(Prec,&valid);
+
+    double epipolar_angle = bdifd_rig::angle_with_epipolar_line(p1.t,p1.gama,rig.f12);
+      
+    if (valid && epipolar_angle > epipolar_angle_thresh) {
+      const bdifd_3rd_order_point_2d &p3 = crv2d_gt_[2][i];
+
+      double dx = p_rec_reproj.gama[0] - p3.gama[0];
+      double dy = p_rec_reproj.gama[1] - p3.gama[1];
+      double dtheta = std::acos(bdifd_util::clump_to_acos( p_rec_reproj.t[0]*p3.t[0] + p_rec_reproj.t[1]*p3.t[1] ));
+      double dk = std::fabs(p_rec_reproj.k - p3.k);
+      double dkdot = std::fabs(p_rec_reproj.kdot - p3.kdot);
+
+      visit(i, dx*dx + dy*dy, dtheta, dk, dkdot);
+    }
+  }
 }
 
 //: err_* : vector of reprojection errors of the measure ??? for the valid
@@ -74,52 +120,134 @@ err_reproj_perturb(
     std::vector<unsigned> &valid_idx
     )
 {
-  assert(crv2d_gt_.size() >= 3 && crv2d_gt_[0].size() == crv2d_gt_[1].size() && crv2d_gt_[0].size() == crv2d_gt_[2].size());
-
   err_pos_sq.reserve(crv2d_gt_[0].size());
   err_t.reserve(crv2d_gt_[0].size());
   err_k.reserve(crv2d_gt_[0].size());
   err_kdot.reserve(crv2d_gt_[0].size());
 
+  err_reproj_perturb_visit(crv2d_gt_, cam_, rig,
+      [&](unsigned i, double e_pos_sq, double e_t, double e_k, double e_kdot) {
+    valid_idx.push_back(i);
+    err_pos_sq.push_back(e_pos_sq);
+    err_t.push_back(e_t);
+    err_k.push_back(e_k);
+    err_kdot.push_back(e_kdot);
+  });
+}
+
+//: Streaming variant: the errors go straight into the accumulators, indexed
+// by point, so memory does not grow with the number of points. err_pos
+// receives the positional error itself, not its square.
+void bdifd_data::
+err_reproj_perturb(
+    const std::vector<std::vector<bdifd_3rd_order_point_2d> > &crv2d_gt_,
+    const std::vector<bdifd_camera> &cam_,
+    const bdifd_rig &rig,
+    bdifd_err_stats &err_pos,
+    bdifd_err_stats &err_t,
+    bdifd_err_stats &err_k,
+    bdifd_err_stats &err_kdot
+    )
+{
+  err_reproj_perturb_visit(crv2d_gt_, cam_, rig,
+      [&](unsigned i, double e_pos_sq, double e_t, double e_k, double e_kdot) {
+    err_pos.add(std::sqrt(e_pos_sq), i);
+    err_t.add(e_t, i);
+    err_k.add(e_k, i);
+    err_kdot.add(e_kdot, i);
+  });
+}
+
+//: The per-point bdifd calls (img_to_world, reconstruct_3rd_order,
+// project_to_image) fill small structure-of-arrays blocks; the error measures
+// then run as straight loops over each block before being streamed into the
+// accumulators. Triplets are
+// distributed over threads, each owning its rig and its entry of \p stats.
+void bdifd_data::
+err_reproj_perturb_triplets(
+    const std::vector<std::vector<bdifd_3rd_order_point_2d> > &crv2d_gt_,
+    const std::vector<bdifd_camera> &cam_,
+    const std::vector<vnl_vector_fixed<unsigned,3> > &triplets,
+    std::vector<bdifd_triplet_err_stats> &stats,
+    unsigned nthreads
+    )
+{
+  stats.resize(triplets.size());
+  if (triplets.empty())
+    return;
+
+  const unsigned npts = crv2d_gt_[0].size();
   const double epipolar_angle_thresh = vnl_math::pi/6;
 
-  for (unsigned i=0; i < crv2d_gt_[0].size(); ++i) {
-    // get hold of p1, theta1, k1, kdot1
-    const bdifd_3rd_order_point_2d &p1 = crv2d_gt_[0][i];
+  bdifd_parallel::for_each(triplets.size(), [&](unsigned l) {
+    const unsigned v1 = triplets[l][0], v2 = triplets[l][1], v3 = triplets[l][2];
+    assert(v1 < crv2d_gt_.size() && v2 < crv2d_gt_.size() && v3 < crv2d_gt_.size());
+    assert(crv2d_gt_[v1].size() == npts && crv2d_gt_[v2].size() == npts && crv2d_gt_[v3].size() == npts);
 
-    // get hold of p2, theta2, k2, kdot2
-    const bdifd_3rd_order_point_2d &p2 = crv2d_gt_[1][i];
-    bdifd_3rd_order_point_2d p1_w, p2_w;
-    bdifd_3rd_order_point_3d Prec;
-    rig.cam[0].img_to_world(&p1,&p1_w);
-    rig.cam[1].img_to_world(&p2,&p2_w);
+    const std::vector<bdifd_3rd_order_point_2d> &x1 = crv2d_gt_[v1];
+    const std::vector<bdifd_3rd_order_point_2d> &x2 = crv2d_gt_[v2];
+    const std::vector<bdifd_3rd_order_point_2d> &x3 = crv2d_gt_[v3];
 
-    rig.reconstruct_3rd_order(p1_w, p2_w, &Prec);
+    bdifd_rig rig(cam_[v1].Pr_, cam_[v2].Pr_);
 
-    bool valid;
-    bdifd_3rd_order_point_2d p_rec_reproj = cam_[2].project_to_image(Prec,&valid);
+    bdifd_triplet_err_stats &st = stats[l];
+    st.v[0] = v1; st.v[1] = v2; st.v[2] = v3;
+    st.pos.clear(); st.t.clear(); st.k.clear(); st.kdot.clear();
 
-    double epipolar_angle = bdifd_rig::angle_with_epipolar_line(p1.t,p1.gama,rig.f12);
-      
-    if (valid && epipolar_angle > epipolar_angle_thresh) {
-      valid_idx.push_back(i);
+    static const unsigned block = 256;
+    // reprojected (r*) and observed (o*) attributes of the valid points
+    double rx[block], ry[block], rtx[block], rty[block], rk[block], rkdot[block];
+    double ox[block], oy[block], otx[block], oty[block], ok[block], okdot[block];
+    double e_pos[block], e_t[block], e_k[block], e_kdot[block];
+    unsigned idx[block];
 
-      bdifd_3rd_order_point_2d p3 = crv2d_gt_[2][i];
+    for (unsigned b=0; b < npts; b += block) {
+      const unsigned bend = std::min(b + block, npts);
+      unsigned nb = 0;
 
-      double dx = p_rec_reproj.gama[0] - p3.gama[0];
-      double dy = p_rec_reproj.gama[1] - p3.gama[1];
-      err_pos_sq.push_back(dx*dx + dy*dy);
+      for (unsigned i=b; i < bend; ++i) {
+        const bdifd_3rd_order_point_2d &p1 = x1[i];
+        if (bdifd_rig::angle_with_epipolar_line(p1.t,p1.gama,rig.f12) <= epipolar_angle_thresh)
+          continue;
 
-      double dtheta = std::acos(bdifd_util::clump_to_acos( p_rec_reproj.t[0]*p3.t[0] + p_rec_reproj.t[1]*p3.t[1] ));
-      err_t.push_back(dtheta);
-      
-      double dk = std::fabs(p_rec_reproj.k - p3.k);
-      err_k.push_back(dk);
+        bdifd_3rd_order_point_2d p1_w, p2_w;
+        bdifd_3rd_order_point_3d Prec;
+        rig.cam[0].img_to_world(&p1,&p1_w);
+        rig.cam[1].img_to_world(&x2[i],&p2_w);
+        rig.reconstruct_3rd_order(p1_w, p2_w, &Prec);
 
-      double dkdot = std::fabs(p_rec_reproj.kdot - p3.kdot);
-      err_kdot.push_back(dkdot);
+        bool valid;
+        bdifd_3rd_order_point_2d p_rec_reproj = cam_[v3].project_to_image(Prec,&valid);
+        if (!valid)
+          continue;
+
+        const bdifd_3rd_order_point_2d &p3 = x3[i];
+        rx[nb] = p_rec_reproj.gama[0]; ry[nb] = p_rec_reproj.gama[1];
+        rtx[nb] = p_rec_reproj.t[0];   rty[nb] = p_rec_reproj.t[1];
+        rk[nb] = p_rec_reproj.k;       rkdot[nb] = p_rec_reproj.kdot;
+        ox[nb] = p3.gama[0]; oy[nb] = p3.gama[1];
+        otx[nb] = p3.t[0];   oty[nb] = p3.t[1];
+        ok[nb] = p3.k;       okdot[nb] = p3.kdot;
+        idx[nb++] = i;
+      }
+
+      for (unsigned m=0; m < nb; ++m) {
+        double dx = rx[m] - ox[m];
+        double dy = ry[m] - oy[m];
+        e_pos[m] = std::sqrt(dx*dx + dy*dy);
+        e_t[m] = std::acos(bdifd_util::clump_to_acos(rtx[m]*otx[m] + rty[m]*oty[m]));
+        e_k[m] = std::fabs(rk[m] - ok[m]);
+        e_kdot[m] = std::fabs(rkdot[m] - okdot[m]);
+      }
+
+      for (unsigned m=0; m < nb; ++m) {
+        st.pos.add(e_pos[m], idx[m]);
+        st.t.add(e_t[m], idx[m]);
+        st.k.add(e_k[m], idx[m]);
+        st.kdot.add(e_kdot[m], idx[m]);
+      }
     }
-  }
+  }, nthreads);
 }
 
 //: given a vector of 3rd order point 3d, it projects each point into the
@@ -128,15 +256,28 @@ void bdifd_data::
 project_into_cams(
     const std::vector<bdifd_3rd_order_point_3d> &crv3d, 
     const std::vector<bdifd_camera> &cam,
-    std::vector<std::vector<vsol_point_2d_sptr> > &xi //:< image coordinates
+    std::vector<std::vector<vsol_point_2d_sptr> > &xi, //:< image coordinates
+    std::vector<bdifd_vsol_arena> *arena
     ) 
 {
   unsigned nviews=cam.size();
   xi.resize(nviews);
+  if (arena)
+    arena->resize(nviews);
 
   for (unsigned k=0; k<nviews; ++k) {
     xi[k].resize(crv3d.size());
 
+    if (arena) {
+      bdifd_ref_arena<vsol_point_2d> &pts = (*arena)[k].points;
+      pts.reserve(crv3d.size());
+      for (unsigned i=0; i<crv3d.size(); ++i) {
+        bdifd_vector_2d p_aux = cam[k].project_to_image(crv3d[i].Gama);
+        xi[k][i] = pts.make(p_aux[0], p_aux[1]);
+      }
+      continue;
+    }
+
     for (unsigned i=0; i<crv3d.size(); ++i) {
       // - get image coordinates
       bdifd_vector_2d p_aux;
@@ -160,6 +301,7 @@ project_into_cams(
     npts += crv3d[k].size();
   }
 
+  unsigned nculled=0;
   crv2d_gt.resize(nviews);
   for (unsigned i=0; i < nviews; ++i) { // nviews
     crv2d_gt[i].resize(npts);
@@ -168,9 +310,12 @@ project_into_cams(
       for (unsigned  jj=0; jj < crv3d[k].size(); ++jj) {
         bool not_degenerate;
         crv2d_gt[i][nn++] = cam[i].project_to_image(crv3d[k][jj], &not_degenerate);
+        nculled += !not_degenerate;
       }
     }
   }
+  bdifd_run_report::count("samples_projected", double(nviews)*npts);
+  bdifd_run_report::count("samples_culled", nculled);
 }
 
 //: Project a set of space curves into different cameras
@@ -209,6 +354,7 @@ project_into_cams(
     ) 
 {
   unsigned nviews=cam.size();
+  unsigned nculled=0;
   xi.resize(nviews);
 
   for (unsigned k=0; k<nviews; ++k) {
@@ -218,8 +364,21 @@ project_into_cams(
       bool not_degenerate;
       // - get image coordinates
       xi[k][i] = cam[k].project_to_image(crv3d[i], &not_degenerate);
+      nculled += !not_degenerate;
     }
   }
+  bdifd_run_report::count("samples_projected", double(nviews)*crv3d.size());
+  bdifd_run_report::count("samples_culled", nculled);
+}
+
+//: Adds the number of samples in \p crv3d to the run report.
+static void
+count_samples_generated(const std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d)
+{
+  unsigned n=0;
+  for (unsigned i=0; i < crv3d.size(); ++i)
+    n += crv3d[i].size();
+  bdifd_run_report::count("samples_generated", n);
 }
 
 void bdifd_data::
@@ -537,13 +696,15 @@ space_curves_ctspheres(
   bdifd_analytic::rotate(crv_tmp,axis);
   crv3d.push_back(crv_tmp); crv_tmp.clear();
 
+  count_samples_generated(crv3d);
 }
 
 //: there are additions of small values to "translations"; these are to avoid
 //degenerate cases where we output two exactly equal 3D points. 
 void bdifd_data::
 space_curves_olympus_turntable(
-    std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d
+    std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d,
+    double density
     )
 {
   std::vector<double> theta;
@@ -556,7 +717,7 @@ space_curves_olympus_turntable(
   double l=80; //:< length of cube
   double un = l/20.; //(so cube goes from -10*un to 10*un)
 
-  double stepsize_lines =un/5.;
+  double stepsize_lines =un/5./density;
 
 //  double stepsize_circle_arclength=2;
 //  double stepsize_ellipse_arclength=2;
@@ -567,8 +728,8 @@ space_curves_olympus_turntable(
   double stepsize_ellipse=2;
   double stepsize_circle=10;
 
-  double stepsize_helix=5;
-  double stepsize_curve1=0.6;
+  double stepsize_helix=5/density;
+  double stepsize_curve1=0.6/density;
 
   { // Basic shapes to define volume where curves are to be drawn
     translation = bdifd_vector_3d (0,0,0);
@@ -870,6 +1031,7 @@ space_curves_olympus_turntable(
   axis = axis*angle;
   bdifd_analytic::rotate(crv_tmp,axis);
   crv3d.push_back(crv_tmp); crv_tmp.clear();
+  count_samples_generated(crv3d);
 }
 
 //: there are additions of small values to "translations"; these are to try to avoid
@@ -1228,6 +1390,7 @@ space_curves_digicam_turntable_sandbox(
   bdifd_analytic::rotate(crv_tmp,axis);
   crv3d.push_back(crv_tmp); crv_tmp.clear();
   */
+  count_samples_generated(crv3d);
 }
 
 //: there are additions of small values to "translations"; these are to avoid
@@ -1584,52 +1747,19 @@ space_curves_digicam_turntable_medium_sized(
   axis = axis*angle;
   bdifd_analytic::rotate(crv_tmp,axis);
   crv3d.push_back(crv_tmp); crv_tmp.clear();
+  count_samples_generated(crv3d);
 }
 
 
 
-// To see how the system is modeled, check out my notes "Rewriting Geometry jan
-// 11"
+//: Prefer bdifd_turntable_rig::ctspheres for sequences of frames.
 vpgl_perspective_camera<double> * bdifd_turntable::
 camera_ctspheres(
     unsigned frm_index,
     const vpgl_calibration_matrix<double> &K)
 {
-
-  //--- Determining R and t (extrinsic params)
-  //  double camera_to_object = camera_to_source - object_to_source;
-  double const object_to_source = 121.00;
-  double const r = object_to_source;
-  double rotation_step = 0.5; // (deg) artifact 2
-  //  double rotation_step = 0.440; // artifact 1
-
-  rotation_step *= (vnl_math::pi/180.0);
-
-  // -- Camera
-  double const theta = frm_index*rotation_step;
-
-  vnl_matrix_fixed< double, 3, 3 > R;
-  R[0][0] = std::cos(theta);
-  R[0][1] = 0;
-  R[0][2] = -std::sin(theta);
-
-  R[1][0] = 0;
-  R[1][1] = 1;
-  R[1][2] = 0;
-
-  R[2][0] = std::sin(theta);
-  R[2][1] = 0;
-  R[2][2] = std::cos(theta);
-  
-
-  vnl_vector_fixed<double,3> dummy0(0,0,0.0);
-  vgl_h_matrix_3d<double> Rhmg(R,dummy0);
-
-  // World origin is at center of rotation or fixation point.
-  vgl_homg_point_3d<double> transl(-r*std::sin(theta), 0, -r*std::cos(theta));
-
-
-  return new vpgl_perspective_camera<double> (K, transl, vgl_rotation_3d<double>(Rhmg));
+  return new vpgl_perspective_camera<double>(
+      bdifd_turntable_rig::ctspheres(K).camera(frm_index*bdifd_turntable_rig::ctspheres_step()));
 }
 
 
@@ -1679,6 +1809,21 @@ internal_calib_ctspheres(vnl_double_3x3 &m, double x_max_scaled)
 }
 
 
+// Same constants as internal_calib_ctspheres (artifact 2).
+void bdifd_turntable::
+ctspheres_detector(double x_max_scaled, double *source_to_detector, double *width, double *height)
+{
+  double const camera_to_source = 161.00;
+  double const nx = 4000.0; /* number of cols (artifact 2)*/
+  double const ny = 2096.0; /* number of rows (artifact 2)*/
+  double const scale = (x_max_scaled-1)/(nx-1);
+
+  *source_to_detector = camera_to_source;
+  *width = x_max_scaled;
+  *height = 1 + scale*(ny-1);
+}
+
+
 //: From david statue dataset 02-26-2006; Calib_Results.mat + base_extrinsics_rect.mat
 void bdifd_turntable::
 internal_calib_olympus(vnl_double_3x3 &m, double x_max_scaled, unsigned  crop_x, unsigned  crop_y)
@@ -1729,122 +1874,60 @@ internal_calib_olympus(vnl_double_3x3 &m, double x_max_scaled, unsigned  crop_x,
 }
 
 //: \param[in] theta : rotation angle in degrees
+// Prefer bdifd_turntable_rig::olympus for sequences of frames.
 vpgl_perspective_camera<double> * bdifd_turntable::
 camera_olympus(
     double theta,
     const vpgl_calibration_matrix<double> &K)
 {
+  return new vpgl_perspective_camera<double>(bdifd_turntable_rig::olympus(K).camera(theta));
+}
 
-  double camera_to_object = 1.128036301860739e+03;
-  bdifd_vector_3d Tckk = camera_to_object * bdifd_vector_3d(0, 0.12722239600987, 0.99187421680045);
-
-  double roll = -3.961405930732378e-15;
-  double pitch = -3.02282467212289;
-  double yaw = -1.15081788134986;
-
-  vnl_double_3x3 Rx, Ry, Rz;
-
-  Rx[0][0] = 1          ;
-  Rx[0][1] = 0          ;
-  Rx[0][2] = 0          ;
-               
-  Rx[1][0] = 0          ;
-  Rx[1][1] = std::cos(pitch) ;
-  Rx[1][2] = -std::sin(pitch);
-               
-  Rx[2][0] = 0          ;
-  Rx[2][1] = std::sin(pitch) ;
-  Rx[2][2] = std::cos(pitch) ;
-
-  Ry[0][0] = std::cos(yaw) ;
-  Ry[0][1] = 0        ;
-  Ry[0][2] = std::sin(yaw) ;
-                        
-  Ry[1][0] = 0        ;
-  Ry[1][1] = 1        ;
-  Ry[1][2] = 0        ;
-                        
-  Ry[2][0] = -std::sin(yaw); 
-  Ry[2][1] = 0        ;
-  Ry[2][2] = std::cos(yaw) ;
-
-  Rz[0][0] =std::cos(roll) ;
-  Rz[0][1] =-std::sin(roll);
-  Rz[0][2] =0         ;
-                       
-  Rz[1][0] =std::sin(roll) ;
-  Rz[1][1] =std::cos(roll) ;
-  Rz[1][2] =0         ;
-                       
-  Rz[2][0] =0         ;
-  Rz[2][1] =0         ;
-  Rz[2][2] =1         ;
-
-
-  //: Got the following from david-02-26-2006-crop2 Rckk normalized as in
-  // Mundy's notes.
-  vnl_double_3x3 Rckk;
-  Rckk = Rx*Ry*Rz;
-//  Rckk[0][0] =   4.077407717391018371E-01  ;
-//  Rckk[0][1] =   2.058618136737014769E-15  ;
-//  Rckk[0][2] =   - 9.130977291952939723E-01;
-//                                           
-//  Rckk[1][0] =   1.081919985807717616E-01  ;
-//  Rckk[1][1] =   - 9.929553699976120251E-01;
-//  Rckk[1][2] =   4.831277922046327278E-02  ;
-//                                           
-//  Rckk[2][0] = - 9.066652935370919097E-01  ;
-//  Rckk[2][1] = - 1.184889581054157787E-01  ;
-//  Rckk[2][2] = - 4.048683888653117346E-01  ;
-
-  theta *= -vnl_math::pi / 180.0;
-
-  // R_cam1_to_cam2 = dR^(i);
-
-  vnl_double_3x3 Rot_theta;
-
-  Rot_theta[0][0] = std::cos(theta);
-  Rot_theta[0][1] = 0;
-  Rot_theta[0][2] = -std::sin(theta);
-
-  Rot_theta[1][0] = 0;
-  Rot_theta[1][1] = 1;
-  Rot_theta[1][2] = 0;
-
-  Rot_theta[2][0] = std::sin(theta);
-  Rot_theta[2][1] = 0;
-  Rot_theta[2][2] = std::cos(theta);
-
-  vnl_double_3x3 R_W0_to_Wtheta = Rot_theta.transpose();
-
-  vnl_double_3x3 R_world_to_cam2 =  Rckk * R_W0_to_Wtheta;
-
-
-  bdifd_vector_3d C2_in_world = - Rot_theta * Rckk.transpose() * Tckk;
-
-  vgl_point_3d<double> C2_in_world_vgl(C2_in_world[0], C2_in_world[1], C2_in_world[2]);
-
-  vgl_h_matrix_3d<double> Rhmg(R_world_to_cam2,bdifd_vector_3d(0,0,0));
-
-  return new vpgl_perspective_camera<double>(K, C2_in_world_vgl, vgl_rotation_3d<double>(Rhmg));
+void bdifd_turntable::
+cameras_olympus_spherical(
+  std::vector<vpgl_perspective_camera<double> > *pcams,
+  const vpgl_calibration_matrix<double> &K,
+  bool enforce_minimum_separation,
+  bool perturb,
+  unsigned seed)
+{
+  cameras_olympus_spherical(pcams, K, bdifd_spherical_params(),
+      enforce_minimum_separation, perturb, seed);
+}
+
+unsigned bdifd_spherical_params::
+max_separated_views() const
+{
+  double cap = 1 - std::cos(minsep_deg/2*vnl_math::pi/180.);
+  if (!(cap > 1./std::numeric_limits<unsigned>::max()))
+    return std::numeric_limits<unsigned>::max();
+  return static_cast<unsigned>(1/cap);
 }
 
 void bdifd_turntable::
 cameras_olympus_spherical(
   std::vector<vpgl_perspective_camera<double> > *pcams,
   const vpgl_calibration_matrix<double> &K,
+  const bdifd_spherical_params &p,
   bool enforce_minimum_separation,
-  bool perturb)
+  bool perturb,
+  unsigned seed)
 {
   typedef boost::random::mt19937 gen_type;
   std::vector<vpgl_perspective_camera<double> > &cams = *pcams;
-  unsigned nviews=100;
-  double minsep = (15./180.)*vnl_math::pi;
+  unsigned nviews=p.nviews;
+  double minsep = (p.minsep_deg/180.)*vnl_math::pi;
   assert(nviews != 0);
+  // beyond the bound every further camera would spend its 100000 trials
+  if (enforce_minimum_separation && nviews > p.max_separated_views()) {
+    bdifd_log_msg(warn) << nviews << " cameras cannot all be " << p.minsep_deg
+      << " degrees apart (at most " << p.max_separated_views() << "); not separating them\n";
+    enforce_minimum_separation = false;
+  }
 
   // You can seed this your way as well, but this is my quick and dirty way.
   gen_type rand_gen;
-  rand_gen.seed(static_cast<unsigned int>(std::time(0)));
+  rand_gen.seed(seed ? seed : static_cast<unsigned int>(std::time(0)));
 
   // Create the distribution object.
   boost::uniform_on_sphere<double> unif_sphere(3);
@@ -1871,16 +1954,17 @@ cameras_olympus_spherical(
   
   unsigned i=0;
   unsigned ntrials=0;
+  unsigned nrejected=0;
   do {
       // Now you can draw a vector of drawn coordinates as such:
       std::vector<double> r = random_on_sphere();
       bdifd_vector_3d z(-r[0],-r[1],-r[2]);
       
       if (perturb) {
-        std::cout << "z before " << z << std::endl;
-        z += bdifd_vector_3d(0.01*random01(),0.01*random01(),0.01*random01());
+        bdifd_log_msg(trace) << "z before " << z << std::endl;
+        z += bdifd_vector_3d(p.normal_sigma*random01(),p.normal_sigma*random01(),p.normal_sigma*random01());
         z.normalize(); 
-        std::cout << "z after " << z << std::endl;
+        bdifd_log_msg(trace) << "z after " << z << std::endl;
       }
       
       if (enforce_minimum_separation) {
@@ -1896,7 +1980,7 @@ cameras_olympus_spherical(
           assert(angle_distance_along_unit_sphere < vnl_math::pi);
           if (angle_distance_along_unit_sphere < minsep || vnl_math::pi - angle_distance_along_unit_sphere < minsep ) {
             if (ntrials > 100000) {
-              std::cerr << "PROBLEM: Unable to reduce separation\n";
+              bdifd_log_msg(warn) << "PROBLEM: Unable to reduce separation\n";
               break;
             } else {
 //              std::cerr << "Trying again" << std::endl;
@@ -1904,18 +1988,20 @@ cameras_olympus_spherical(
             }
           }
         }
-        if (need_resample)
+        if (need_resample) {
+          ++nrejected;
           continue;
+        }
       }
       
 //      std::cerr << "YES!" << std::endl;
       ntrials = 0;
       
-      double camera_to_object = 1.128036301860739e+03;
+      double camera_to_object = p.camera_to_object;
       if (perturb)
-        camera_to_object += random01()*10;
+        camera_to_object += random01()*p.radius_sigma;
 
-      std::cout << "Cam to object: " << camera_to_object << std::endl;
+      bdifd_log_msg(debug) << "Cam to object: " << camera_to_object << std::endl;
       
       vgl_point_3d<double> C(camera_to_object*r[0],camera_to_object*r[1],camera_to_object*r[2]);
 
@@ -1951,6 +2037,41 @@ cameras_olympus_spherical(
       cams.push_back(vpgl_perspective_camera<double>(K, C, vgl_rotation_3d<double>(Rhmg)));
       ++i;
   } while (i < nviews);
+
+  bdifd_run_report::count("cameras_generated", nviews);
+  bdifd_run_report::count("camera_trials_rejected", nrejected);
+}
+
+//: get_lines with the endpoints and lines made in \p arena. The endpoints are
+// those vsol_line_2d(tan, middle) computes, middle -/+ tan/2, without its
+// temporary points.
+static void
+get_lines_in_arena(
+    std::vector<vsol_line_2d_sptr> &lines,
+    const std::vector<bdifd_3rd_order_point_2d> &C_subpixel,
+    bool do_perturb,
+    double pert_pos,
+    double pert_tan,
+    bdifd_vsol_arena &arena
+    )
+{
+  arena.points.reserve(2*C_subpixel.size());
+  arena.lines.reserve(C_subpixel.size());
+  for (unsigned i=0; i<C_subpixel.size(); i++) {
+    vgl_vector_2d<double> tan(C_subpixel[i].t[0], C_subpixel[i].t[1]);
+    double x = C_subpixel[i].gama[0];
+    double y = C_subpixel[i].gama[1];
+
+    if (do_perturb) {
+      x = bdifd_analytic::perturb(x,pert_pos);
+      y = bdifd_analytic::perturb(y,pert_pos);
+      bdifd_analytic::perturb(tan, pert_tan);
+    }
+    double hx = tan.x()/2, hy = tan.y()/2;
+    vsol_point_2d_sptr p0 = arena.points.make(x - hx, y - hy);
+    vsol_point_2d_sptr p1 = arena.points.make(x + hx, y + hy);
+    lines[i] = arena.lines.make(p0, p1);
+  }
 }
 
 //: convert from std::vector<bdifd_3rd_order_point_2d> 
@@ -1961,10 +2082,15 @@ get_lines(
     const std::vector<bdifd_3rd_order_point_2d> &C_subpixel,
     bool do_perturb,
     double pert_pos,
-    double pert_tan
+    double pert_tan,
+    bdifd_vsol_arena *arena
     )
 {
   lines.resize(C_subpixel.size());
+  if (arena) {
+    get_lines_in_arena(lines, C_subpixel, do_perturb, pert_pos, pert_tan, *arena);
+    return;
+  }
   for (unsigned i=0; i<C_subpixel.size(); i++) {
     vgl_vector_2d<double> tan(C_subpixel[i].t[0], C_subpixel[i].t[1]);
     vsol_point_2d_sptr middle = new vsol_point_2d(C_subpixel[i].gama[0], C_subpixel[i].gama[1]);
@@ -1988,27 +2114,33 @@ get_circle_edgels(
     std::vector<bdifd_3rd_order_point_2d> &C_subpixel,
     bool do_perturb,
     double pert_pos,
-    double pert_tan
+    double pert_tan,
+    bdifd_vsol_arena *arena,
+    double spacing
     )
 {
   // transl. big enough so all coordinates are positive
   bdifd_vector_2d translation(radius,radius);
 
-  double dtheta = (std::asin(std::sqrt(2.)/(2.*radius)) );
-
-  dtheta *= (180.0/vnl_math::pi);
-
   if (do_perturb) {
     pert_tan *= (vnl_math::pi/180.0);
   }
 
-  std::vector<double> theta;
-  std::vector<bdifd_3rd_order_point_2d> C;
-  bdifd_analytic::circle_curve( radius, translation, C, theta, 0, dtheta, 360);
+  if (spacing > 0)
+    bdifd_edgel_sampler(spacing).sample(bdifd_conic_arc(radius, radius, radius, radius), &C_subpixel);
+  else {
+    double dtheta = (std::asin(std::sqrt(2.)/(2.*radius)) );
+
+    dtheta *= (180.0/vnl_math::pi);
 
-  bdifd_analytic::limit_distance(C, C_subpixel);
+    std::vector<double> theta;
+    std::vector<bdifd_3rd_order_point_2d> C;
+    bdifd_analytic::circle_curve( radius, translation, C, theta, 0, dtheta, 360);
 
-  bdifd_data::get_lines(lines, C_subpixel, do_perturb, pert_pos, pert_tan);
+    bdifd_analytic::limit_distance(C, C_subpixel);
+  }
+
+  bdifd_data::get_lines(lines, C_subpixel, do_perturb, pert_pos, pert_tan, arena);
 }
 
 
@@ -2022,30 +2154,36 @@ get_ellipse_edgels(
     std::vector<bdifd_3rd_order_point_2d> &C_subpixel,
     bool do_perturb,
     double pert_pos,
-    double pert_tan
+    double pert_tan,
+    bdifd_vsol_arena *arena,
+    double spacing
     )
 {
   // transl. big enough so all coordinates are positive
   bdifd_vector_2d translation(ra,rb);
 
-  double dtheta = (std::asin(std::sqrt(2.)/(2.*std::max(ra,rb))) );
-  dtheta /= 10.0; // XXX
-
-  dtheta *= (180.0/vnl_math::pi);
-
   if (do_perturb) {
     pert_tan *= (vnl_math::pi/180.0);
   }
 
-  std::vector<double> theta;
-  std::vector<bdifd_3rd_order_point_2d> C;
-  bdifd_analytic::ellipse(ra, rb, translation, C, theta, 0, dtheta, 360);
+  if (spacing > 0)
+    bdifd_edgel_sampler(spacing).sample(bdifd_conic_arc(ra, rb, ra, rb), &C_subpixel);
+  else {
+    double dtheta = (std::asin(std::sqrt(2.)/(2.*std::max(ra,rb))) );
+    dtheta /= 10.0; // XXX
 
-  std::cout << "Before limit distance: " << C.size() << std::endl;
-  bdifd_analytic::limit_distance(C, C_subpixel);
-  std::cout << "After limit distance: " << C_subpixel.size() << std::endl;
+    dtheta *= (180.0/vnl_math::pi);
 
-  bdifd_data::get_lines(lines, C_subpixel, do_perturb, pert_pos, pert_tan);
+    std::vector<double> theta;
+    std::vector<bdifd_3rd_order_point_2d> C;
+    bdifd_analytic::ellipse(ra, rb, translation, C, theta, 0, dtheta, 360);
+
+    bdifd_log_msg(debug) << "Before limit distance: " << C.size() << std::endl;
+    bdifd_analytic::limit_distance(C, C_subpixel);
+    bdifd_log_msg(debug) << "After limit distance: " << C_subpixel.size() << std::endl;
+  }
+
+  bdifd_data::get_lines(lines, C_subpixel, do_perturb, pert_pos, pert_tan, arena);
 }
 
 vgl_point_3d<double> bdifd_data::
@@ -2098,12 +2236,9 @@ get_digital_camera_point_dataset(
   bdifd_turntable::internal_calib_olympus(Kmatrix, x_max_scaled, crop_origin_x, crop_origin_y);
   vpgl_calibration_matrix<double> K(Kmatrix);
 
-  for (unsigned v=0; v < view_angles.size(); ++v) {
-    vpgl_perspective_camera<double> *P;
-    P = bdifd_turntable::camera_olympus(view_angles[v], K);
-    cams.push_back(*P);
-    delete P;
-  }
+  bdifd_turntable_rig rig = bdifd_turntable_rig::olympus(K);
+  for (unsigned v=0; v < view_angles.size(); ++v)
+    cams.push_back(rig.camera(view_angles[v]));
 
   // Extracts list of 3D point positions
   {
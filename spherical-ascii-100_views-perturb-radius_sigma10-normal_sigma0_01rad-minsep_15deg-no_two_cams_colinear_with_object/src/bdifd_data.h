@@ -10,9 +10,24 @@
 
 #include <bdifd/bdifd_camera.h>
 #include <vsol/vsol_line_2d_sptr.h>
+#include "bdifd_err_stats.h"
+#include "bdifd_arena.h"
 
 class bdifd_rig;
 
+//: Summary of the reprojection errors of one view triplet, as computed by
+// bdifd_data::err_reproj_perturb_triplets. Points are reconstructed from views
+// v[0], v[1] and reprojected into view v[2]. Only the non-degenerate points
+// enter the statistics; argmax() of each accumulator is a sample index.
+struct bdifd_triplet_err_stats {
+  unsigned v[3];
+
+  bdifd_err_stats pos;   //:< positional error, pixels
+  bdifd_err_stats t;     //:< tangent angle error, radians
+  bdifd_err_stats k;
+  bdifd_err_stats kdot;
+};
+
 //: Defines some multiview differential-geometric synthetic data and utilities
 class bdifd_data {
   public:
@@ -28,7 +43,8 @@ class bdifd_data {
   project_into_cams(
       const std::vector<bdifd_3rd_order_point_3d> &crv3d, 
       const std::vector<bdifd_camera> &cam,
-      std::vector<std::vector<vsol_point_2d_sptr> > &xi //:< image coordinates
+      std::vector<std::vector<vsol_point_2d_sptr> > &xi, //:< image coordinates
+      std::vector<bdifd_vsol_arena> *arena=0 //:< if given, points of view k are made in (*arena)[k]
       );
 
   static void 
@@ -41,8 +57,11 @@ class bdifd_data {
   static void
   space_curves_ctspheres( std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d );
 
+  //: \p density divides every step size; 1 gives the published dataset.
+  // bdifd_lod uses powers of two for nested levels of detail.
   static void
-  space_curves_olympus_turntable( std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d);
+  space_curves_olympus_turntable( std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d,
+      double density=1);
 
   static void 
   space_curves_digicam_turntable_sandbox( std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d);
@@ -88,15 +107,44 @@ class bdifd_data {
       std::vector<unsigned> &valid_idx
       );
 
+  static void 
+  err_reproj_perturb(
+      const std::vector<std::vector<bdifd_3rd_order_point_2d> > &crv2d_gt_,
+      const std::vector<bdifd_camera> &cam_,
+      const bdifd_rig &rig,
+      bdifd_err_stats &err_pos,
+      bdifd_err_stats &err_t,
+      bdifd_err_stats &err_k,
+      bdifd_err_stats &err_kdot
+      );
+
+  //: Same error measures as err_reproj_perturb, for many view triplets at
+  // once. triplets[l] = (i,j,k) reconstructs from views i,j and reprojects
+  // into k. Only summary statistics are kept per triplet.
+  static void 
+  err_reproj_perturb_triplets(
+      const std::vector<std::vector<bdifd_3rd_order_point_2d> > &crv2d_gt_,
+      const std::vector<bdifd_camera> &cam_,
+      const std::vector<vnl_vector_fixed<unsigned,3> > &triplets,
+      std::vector<bdifd_triplet_err_stats> &stats,
+      unsigned nthreads=0
+      );
+
   //---------------------------------------------------------------------------
+  //: If \p arena is given, the lines and their endpoints are made there;
+  // \p lines must be cleared before the arena is released.
   static void get_lines(
       std::vector<vsol_line_2d_sptr> &lines,
       const std::vector<bdifd_3rd_order_point_2d> &C_subpixel,
       bool do_perturb=false,
       double pert_pos=0.0,
-      double pert_tan=0.0
+      double pert_tan=0.0,
+      bdifd_vsol_arena *arena=0
       );
 
+  //: With \p spacing <= 0 (the default) the curve is oversampled and thinned
+  // with bdifd_analytic::limit_distance. With \p spacing > 0 the edgels are
+  // that many pixels apart, placed directly by bdifd_edgel_sampler.
   static void 
   get_circle_edgels(
       double radius, 
@@ -104,9 +152,12 @@ class bdifd_data {
       std::vector<bdifd_3rd_order_point_2d> &C_subpixel,
       bool do_perturb=false,
       double pert_pos=0.1,
-      double pert_tan=10
+      double pert_tan=10,
+      bdifd_vsol_arena *arena=0,
+      double spacing=0
       );
 
+  //: As get_circle_edgels.
   static void get_ellipse_edgels(
       double ra, 
       double rb, 
@@ -114,7 +165,9 @@ class bdifd_data {
       std::vector<bdifd_3rd_order_point_2d> &C_subpixel,
       bool do_perturb,
       double pert_pos,
-      double pert_tan
+      double pert_tan,
+      bdifd_vsol_arena *arena=0,
+      double spacing=0
       );
 
   static vgl_point_3d<double> 
@@ -131,7 +184,30 @@ class bdifd_data {
       const std::vector<double> &view_angles);
 };
 
+//: Parameters of the spherical camera configuration; the defaults are those
+// of the published spherical-ascii-100_views-... dataset.
+struct bdifd_spherical_params {
+  unsigned nviews;
+  double radius_sigma;        //:< camera distance noise, mm (perturb)
+  double normal_sigma;        //:< viewing direction noise, rad (perturb)
+  double minsep_deg;          //:< minimum angle between camera centers
+  double camera_to_object;    //:< mean camera distance, mm
+
+  bdifd_spherical_params()
+    : nviews(100), radius_sigma(10), normal_sigma(0.01), minsep_deg(15),
+    camera_to_object(1.128036301860739e+03) {}
+
+  //: Most cameras that can all be minsep_deg apart, from each other and from
+  // each other's antipode: caps of minsep/2 around every camera and its
+  // antipode cannot overlap, so at most 1/(1 - cos(minsep/2)) of them fit,
+  // 116 at 15 degrees. Random placement saturates well before that; the
+  // published 100 views have 91 pairs closer than 15 degrees.
+  unsigned max_separated_views() const;
+};
+
 //: Class dealing with a turntable camera configuration.
+// The camera_* functions build one camera per call; bdifd_turntable_rig
+// generates whole sequences from the same rigs without allocating.
 class bdifd_turntable {
 public:
   //- function to set the turntable params
@@ -149,6 +225,12 @@ public:
   static void 
   internal_calib_ctspheres(vnl_double_3x3 &m, double x_max_scaled=4000.0);
 
+  //: Source to detector distance (mm) and detector size (pixels) of the CT
+  // setup, for images scaled to \p x_max_scaled columns as above. The object
+  // lies between the source (optical center) and the detector (image plane).
+  static void
+  ctspheres_detector(double x_max_scaled, double *source_to_detector, double *width, double *height);
+
   static void 
   internal_calib_olympus(vnl_double_3x3 &m, double x_max_scaled=0, unsigned  crop_x=0, unsigned  crop_y=0);
 
@@ -158,12 +240,29 @@ public:
       const vpgl_calibration_matrix<double> &K);
 
   // samples turtable center but on a spherical configurations of cameras
-  // with cameras poiting to center
+  // with cameras poiting to center. A \p seed of 0 seeds from the clock, as
+  // for the published dataset; any other value gives reproducible cameras.
   static void cameras_olympus_spherical(
       std::vector<vpgl_perspective_camera<double> > *pcams,
       const vpgl_calibration_matrix<double> &K,
       bool enforce_minimum_separation=false,
-      bool perturb=false);
+      bool perturb=false,
+      unsigned seed=0);
+
+  //: Same with the number of views, noise and separation of \p p. Cameras
+  // are drawn one after another, so with the same \p seed and the other
+  // parameters equal the first n cameras are the same for any p.nviews >= n;
+  // another sigma or separation changes which draws are rejected, and with
+  // them the cameras that follow. A camera that stays too close to the
+  // others after 100000 draws is kept as is, with a warning, and more than
+  // p.max_separated_views() cameras are generated without the separation.
+  static void cameras_olympus_spherical(
+      std::vector<vpgl_perspective_camera<double> > *pcams,
+      const vpgl_calibration_matrix<double> &K,
+      const bdifd_spherical_params &p,
+      bool enforce_minimum_separation,
+      bool perturb,
+      unsigned seed);
 };
 
 
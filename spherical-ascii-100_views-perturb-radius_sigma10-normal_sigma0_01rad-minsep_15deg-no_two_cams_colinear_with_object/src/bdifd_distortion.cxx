@@ -0,0 +1,338 @@
+#include "bdifd_distortion.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include "bdifd_ascii_dataset.h"
+#include "bdifd_parallel.h"
+
+namespace {
+
+//: Truncated Taylor polynomial c[0] + c[1] s + ... + c[N-1] s^(N-1).
+template <unsigned N>
+struct jet {
+  double c[N];
+};
+
+template <unsigned N> jet<N>
+operator+(const jet<N> &a, const jet<N> &b)
+{
+  jet<N> r;
+  for (unsigned i=0; i < N; ++i)
+    r.c[i] = a.c[i] + b.c[i];
+  return r;
+}
+
+template <unsigned N> jet<N>
+operator+(double a, const jet<N> &b)
+{
+  jet<N> r = b;
+  r.c[0] += a;
+  return r;
+}
+
+template <unsigned N> jet<N>
+operator*(double a, const jet<N> &b)
+{
+  jet<N> r;
+  for (unsigned i=0; i < N; ++i)
+    r.c[i] = a*b.c[i];
+  return r;
+}
+
+template <unsigned N> jet<N>
+operator*(const jet<N> &a, const jet<N> &b)
+{
+  jet<N> r;
+  for (unsigned k=0; k < N; ++k) {
+    r.c[k] = 0;
+    for (unsigned i=0; i <= k; ++i)
+      r.c[k] += a.c[i]*b.c[k-i];
+  }
+  return r;
+}
+
+//: The Brown-Conrady map, on numbers or on jets.
+template <class T> void
+brown(const bdifd_lens_distortion &d, const T &u, const T &v, T *ud, T *vd)
+{
+  T uu = u*u, vv = v*v, uv = u*v;
+  T r2 = uu + vv;
+  T c = 1 + r2*(d.k1 + r2*(d.k2 + d.k3*r2));
+  *ud = c*u + (2*d.p1)*uv + d.p2*(r2 + 2*uu);
+  *vd = c*v + d.p1*(r2 + 2*vv) + (2*d.p2)*uv;
+}
+
+inline double
+cross(const double a[2], const double b[2])
+{
+  return a[0]*b[1] - a[1]*b[0];
+}
+
+} // namespace
+
+void bdifd_lens_distortion::
+distort(double u, double v, double *ud, double *vd) const
+{
+  brown(*this, u, v, ud, vd);
+}
+
+void bdifd_lens_distortion::
+distort(double u, double v, double du, double dv,
+    double *ud, double *vd, double *dud, double *dvd) const
+{
+  jet<2> ju = {{u, du}}, jv = {{v, dv}}, ou, ov;
+  brown(*this, ju, jv, &ou, &ov);
+  *ud = ou.c[0];
+  *vd = ov.c[0];
+  *dud = ou.c[1];
+  *dvd = ov.c[1];
+}
+
+bool bdifd_lens_distortion::
+distort(const vnl_double_3x3 &K, bdifd_3rd_order_point_2d *p) const
+{
+  double fx = K[0][0], s = K[0][1], cx = K[0][2], fy = K[1][1], cy = K[1][2];
+
+  // derivatives of the image curve in its arclength: t, k n, kdot n - k^2 t
+  double d[3][2];
+  for (unsigned i=0; i < 2; ++i) {
+    d[0][i] = p->t[i];
+    d[1][i] = p->k*p->n[i];
+    d[2][i] = p->kdot*p->n[i] - p->k*p->k*p->t[i];
+  }
+
+  // to normalized coordinates, as Taylor coefficients
+  jet<4> u, v;
+  v.c[0] = (p->gama[1] - cy)/fy;
+  u.c[0] = (p->gama[0] - cx - s*v.c[0])/fx;
+  const double fact[3] = {1, 2, 6};
+  for (unsigned j=0; j < 3; ++j) {
+    v.c[j+1] = d[j][1]/fy/fact[j];
+    u.c[j+1] = (d[j][0] - s*d[j][1]/fy)/fx/fact[j];
+  }
+
+  jet<4> ud, vd;
+  brown(*this, u, v, &ud, &vd);
+
+  // back to pixels, as derivatives in the old arclength
+  double q[3][2];
+  for (unsigned j=0; j < 3; ++j) {
+    q[j][0] = (fx*ud.c[j+1] + s*vd.c[j+1])*fact[j];
+    q[j][1] = fy*vd.c[j+1]*fact[j];
+  }
+  p->gama[0] = fx*ud.c[0] + s*vd.c[0] + cx;
+  p->gama[1] = fy*vd.c[0] + cy;
+
+  double g = std::sqrt(q[0][0]*q[0][0] + q[0][1]*q[0][1]);
+  if (!(g > 0)) {
+    p->valid = false;
+    return false;
+  }
+  double side = p->t[0]*p->n[1] - p->t[1]*p->n[0] < 0 ? -1 : 1;
+  p->t[0] = q[0][0]/g;
+  p->t[1] = q[0][1]/g;
+  p->n[0] = -side*p->t[1];
+  p->n[1] = side*p->t[0];
+
+  // k = q1 x q2 / g^3, and its derivative in the new arclength
+  double c12 = cross(q[0], q[1]), c13 = cross(q[0], q[2]);
+  double d12 = q[0][0]*q[1][0] + q[0][1]*q[1][1];
+  double g3 = g*g*g;
+  p->k = side*c12/g3;
+  p->kdot = side*(c13/g3 - 3*c12*d12/(g3*g*g))/g;
+  return true;
+}
+
+void bdifd_lens_distortion::
+distort_pixel(const vnl_double_3x3 &K, double x, double y, double *xd, double *yd) const
+{
+  double v = (y - K[1][2])/K[1][1];
+  double u = (x - K[0][2] - K[0][1]*v)/K[0][0];
+  double ud, vd;
+  brown(*this, u, v, &ud, &vd);
+  *xd = K[0][0]*ud + K[0][1]*vd + K[0][2];
+  *yd = K[1][1]*vd + K[1][2];
+}
+
+bool bdifd_lens_distortion::
+undistort(double ud, double vd, double *u, double *v, unsigned max_iter) const
+{
+  double x = ud, y = vd;
+  for (unsigned it=0; it <= max_iter; ++it) {
+    jet<2> jx = {{x, 1}}, jy = {{y, 0}}, fu, fv;
+    brown(*this, jx, jy, &fu, &fv);
+    double a = fu.c[1], c = fv.c[1];    // d/du
+    jy.c[1] = 1;
+    jx.c[1] = 0;
+    brown(*this, jx, jy, &fu, &fv);
+    double b = fu.c[1], e = fv.c[1];    // d/dv
+
+    double ru = fu.c[0] - ud, rv = fv.c[0] - vd;
+    if (std::fabs(ru) + std::fabs(rv) <= 1e-14*(1 + std::fabs(ud) + std::fabs(vd))) {
+      *u = x;
+      *v = y;
+      return true;
+    }
+    double det = a*e - b*c;
+    if (it == max_iter || !(std::fabs(det) > 1e-300))
+      break;
+    x -= (e*ru - b*rv)/det;
+    y -= (a*rv - c*ru)/det;
+  }
+  *u = x;
+  *v = y;
+  return false;
+}
+
+bool bdifd_lens_distortion::
+undistort_pixel(const vnl_double_3x3 &K, double xd, double yd, double *x, double *y,
+    unsigned max_iter) const
+{
+  double vd = (yd - K[1][2])/K[1][1];
+  double ud = (xd - K[0][2] - K[0][1]*vd)/K[0][0];
+  double u, v;
+  bool ok = undistort(ud, vd, &u, &v, max_iter);
+  *x = K[0][0]*u + K[0][1]*v + K[0][2];
+  *y = K[1][1]*v + K[1][2];
+  return ok;
+}
+
+bool bdifd_lens_distortion::
+undistort_pixel(const vnl_double_3x3 &K, double xd, double yd, double txd, double tyd,
+    double *x, double *y, double *tx, double *ty, unsigned max_iter) const
+{
+  double fx = K[0][0], s = K[0][1], cx = K[0][2], fy = K[1][1], cy = K[1][2];
+  double vd = (yd - cy)/fy;
+  double ud = (xd - cx - s*vd)/fx;
+  double u, v;
+  bool ok = undistort(ud, vd, &u, &v, max_iter);
+  *x = fx*u + s*v + cx;
+  *y = fy*v + cy;
+
+  // solve J (du, dv) = (dud, dvd), J the Jacobian of the map at (u, v)
+  double dvd = tyd/fy;
+  double dud = (txd - s*dvd)/fx;
+  double a, b, c, e, pu, pv;
+  distort(u, v, 1, 0, &pu, &pv, &a, &c);
+  distort(u, v, 0, 1, &pu, &pv, &b, &e);
+  double det = a*e - b*c;
+  double du = (e*dud - b*dvd)/det, dv = (a*dvd - c*dud)/det;
+  double qx = fx*du + s*dv, qy = fy*dv;
+  double g = std::sqrt(qx*qx + qy*qy);
+  *tx = qx/g;
+  *ty = qy/g;
+  return ok && g > 0;
+}
+
+bool bdifd_lens_distortion::
+parse(const std::string &s)
+{
+  double c[5] = {0, 0, 0, 0, 0};
+  const char *p = s.c_str();
+  for (unsigned i=0; i < 5 && *p; ++i) {
+    char *q;
+    c[i] = std::strtod(p, &q);
+    if (q == p)
+      return false;
+    p = q;
+    if (*p == ',')
+      ++p;
+    else if (*p)
+      return false;
+  }
+  if (*p)
+    return false;
+  *this = bdifd_lens_distortion(c[0], c[1], c[2], c[3], c[4]);
+  return true;
+}
+
+bool bdifd_lens_distortion::
+write(const std::string &fname) const
+{
+  std::ofstream fp(fname.c_str());
+  if (fp) {
+    fp << std::setprecision(20);
+    fp << k1 << " " << k2 << " " << k3 << " " << p1 << " " << p2 << std::endl;
+  }
+  if (!fp) {
+    std::cerr << "bdifd_lens_distortion: error, unable to write file name " << fname << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool bdifd_lens_distortion::
+read(const std::string &fname)
+{
+  std::vector<double> v;
+  if (!bdifd_ascii_dataset::read_numbers(fname, &v) || v.size() != 5) {
+    std::cerr << "bdifd_lens_distortion: error, unable to read file name " << fname << std::endl;
+    return false;
+  }
+  *this = bdifd_lens_distortion(v[0], v[1], v[2], v[3], v[4]);
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+void bdifd_undistort_lut::
+build(const vnl_double_3x3 &K, const bdifd_lens_distortion &d,
+    double width, double height, double step, unsigned nthreads)
+{
+  K_ = K;
+  d_ = d;
+  w_ = width;
+  h_ = height;
+  step_ = step > 0 ? step : 1;
+  nx_ = static_cast<unsigned>(std::ceil(w_/step_)) + 1;
+  ny_ = static_cast<unsigned>(std::ceil(h_/step_)) + 1;
+  dxy_.resize(2ul*nx_*ny_);
+
+  bdifd_parallel::for_each(ny_, [&](unsigned j) {
+    float *row = &dxy_[2ul*nx_*j];
+    double yd = j*step_;
+    for (unsigned i=0; i < nx_; ++i) {
+      double xd = i*step_, x, y;
+      if (d_.undistort_pixel(K_, xd, yd, &x, &y)) {
+        row[2*i] = static_cast<float>(x - xd);
+        row[2*i+1] = static_cast<float>(y - yd);
+      } else {
+        row[2*i] = row[2*i+1] = std::numeric_limits<float>::quiet_NaN();
+      }
+    }
+  }, nthreads);
+}
+
+void bdifd_undistort_lut::
+undistort(double xd, double yd, double *x, double *y) const
+{
+  double fx = xd/step_, fy = yd/step_;
+  if (!(fx >= 0 && fy >= 0 && fx <= nx_ - 1 && fy <= ny_ - 1)) {
+    d_.undistort_pixel(K_, xd, yd, x, y);
+    return;
+  }
+  unsigned i = std::min(static_cast<unsigned>(fx), nx_ - 2);
+  unsigned j = std::min(static_cast<unsigned>(fy), ny_ - 2);
+  double a = fx - i, b = fy - j;
+  const float *p = &dxy_[2ul*(nx_*j + i)], *q = p + 2ul*nx_;
+  double w00 = (1-a)*(1-b), w10 = a*(1-b), w01 = (1-a)*b, w11 = a*b;
+  double dx = w00*p[0] + w10*p[2] + w01*q[0] + w11*q[2];
+  double dy = w00*p[1] + w10*p[3] + w01*q[1] + w11*q[3];
+  if (dx != dx || dy != dy) {
+    d_.undistort_pixel(K_, xd, yd, x, y);
+    return;
+  }
+  *x = xd + dx;
+  *y = yd + dy;
+}
+
+void bdifd_undistort_lut::
+undistort(unsigned n, const double *xd, const double *yd, double *x, double *y) const
+{
+  for (unsigned i=0; i < n; ++i)
+    undistort(xd[i], yd[i], x + i, y + i);
+}
@@ -0,0 +1,223 @@
+#include "bdifd_edgel_sampler.h"
+#include <algorithm>
+#include <cmath>
+#include <vnl/vnl_math.h>
+#include "bdifd_parallel.h"
+
+bdifd_3rd_order_point_2d bdifd_edgel_sampler::
+point(const bdifd_conic_arc &a, double theta)
+{
+  double c = std::cos(theta), s = std::sin(theta);
+  double dx = -a.ra*s, dy = a.rb*c;
+  double v2 = dx*dx + dy*dy, v = std::sqrt(v2);
+
+  bdifd_3rd_order_point_2d p;
+  p.gama[0] = a.cx + a.ra*c;
+  p.gama[1] = a.cy + a.rb*s;
+  p.gama[2] = 0;
+  p.t[0] = dx/v;
+  p.t[1] = dy/v;
+  p.t[2] = 0;
+  p.n[0] = -p.t[1];
+  p.n[1] = p.t[0];
+  p.n[2] = 0;
+  p.k = a.ra*a.rb/(v2*v);
+  p.kdot = -3*a.ra*a.rb*(a.ra*a.ra - a.rb*a.rb)*s*c/(v2*v2*v2);
+  p.valid = true;
+  return p;
+}
+
+namespace {
+
+//: Carlson's symmetric elliptic integral R_F(x, y, z), by duplication; the
+// truncation error goes as the 6th power of the stopping tolerance, and each
+// duplication divides the spread of x, y, z by about 4.
+double
+carlson_rf(double x, double y, double z)
+{
+  double mu, dx, dy, dz;
+  for (unsigned it=0; it < 60; ++it) {
+    double sx = std::sqrt(x), sy = std::sqrt(y), sz = std::sqrt(z);
+    double lambda = sx*(sy + sz) + sy*sz;
+    x = (x + lambda)/4;
+    y = (y + lambda)/4;
+    z = (z + lambda)/4;
+    mu = (x + y + z)/3;
+    dx = (mu - x)/mu;
+    dy = (mu - y)/mu;
+    dz = (mu - z)/mu;
+    if (std::max(std::fabs(dx), std::max(std::fabs(dy), std::fabs(dz))) < 0.0025)
+      break;
+  }
+  double e2 = dx*dy - dz*dz, e3 = dx*dy*dz;
+  return (1 + (e2/24 - 0.1 - 3*e3/44)*e2 + e3/14)/std::sqrt(mu);
+}
+
+//: Carlson's symmetric elliptic integral R_D(x, y, z), by duplication.
+double
+carlson_rd(double x, double y, double z)
+{
+  double sum = 0, fac = 1, mu, dx, dy, dz;
+  for (unsigned it=0; it < 60; ++it) {
+    double sx = std::sqrt(x), sy = std::sqrt(y), sz = std::sqrt(z);
+    double lambda = sx*(sy + sz) + sy*sz;
+    sum += fac/(sz*(z + lambda));
+    fac /= 4;
+    x = (x + lambda)/4;
+    y = (y + lambda)/4;
+    z = (z + lambda)/4;
+    mu = (x + y + 3*z)/5;
+    dx = (mu - x)/mu;
+    dy = (mu - y)/mu;
+    dz = (mu - z)/mu;
+    if (std::max(std::fabs(dx), std::max(std::fabs(dy), std::fabs(dz))) < 0.0015)
+      break;
+  }
+  double ea = dx*dy, eb = dz*dz, ec = ea - eb, ed = ea - 6*eb, ee = ed + 2*ec;
+  return 3*sum + fac*(1 + ed*(-3.0/14 + 9.0/88*ed - 9.0/52*dz*ee)
+      + dz*(ee/6 + dz*(-9.0/22*ec + 3.0/26*dz*ea)))/(mu*std::sqrt(mu));
+}
+
+//: Arclength of an arc of an ellipse from a fixed origin, as a function of
+// theta. Its speed^2 ra^2 sin^2 + rb^2 cos^2 is written around the larger
+// radius r as r^2 (1 - m sin^2(theta - phase)), so that the arclength is r
+// times the incomplete elliptic integral of the second kind E(theta - phase
+// | m), with 0 <= m < 1, reduced to [-pi/2, pi/2] by E(phi + pi) = E(phi) +
+// 2 E(pi/2).
+struct ellipse_arclength {
+  double r, m, phase, half_turn;
+
+  explicit ellipse_arclength(const bdifd_conic_arc &a)
+  {
+    bool tall = a.rb >= a.ra;
+    r = tall ? a.rb : a.ra;
+    double q = tall ? a.ra/a.rb : a.rb/a.ra;
+    m = 1 - q*q;
+    phase = tall ? 0 : vnl_math::pi/2;
+    half_turn = 2*r*(carlson_rf(0, 1 - m, 1) - m/3*carlson_rd(0, 1 - m, 1));
+  }
+
+  double operator()(double theta) const
+  {
+    double phi = theta - phase;
+    double k = std::floor(phi/vnl_math::pi + 0.5), x = phi - k*vnl_math::pi;
+    double s = std::sin(x), c = std::cos(x), q = 1 - m*s*s;
+    return r*(s*carlson_rf(c*c, q, 1) - m*s*s*s/3*carlson_rd(c*c, q, 1)) + k*half_turn;
+  }
+
+  //: Derivative in theta.
+  double speed(double theta) const
+  {
+    double s = std::sin(theta - phase);
+    return r*std::sqrt(1 - m*s*s);
+  }
+
+  //: Parameter step from \p theta for an arclength step \p ds, to second
+  // order: the root of v dtheta + v'/2 dtheta^2 = ds, with the speed v and
+  // its derivative v'.
+  double predict(double theta, double ds) const
+  {
+    double s = std::sin(theta - phase), c = std::cos(theta - phase);
+    double v = r*std::sqrt(1 - m*s*s), dv = -r*r*m*s*c/v;
+    double disc = v*v + 2*dv*ds;
+    return disc > 0 ? 2*ds/(v + std::sqrt(disc)) : ds/v;
+  }
+};
+
+//: Parameter in [\p lo, \p hi] at which the arclength \p len is \p s, with
+// len(lo) <= s <= len(hi), starting from \p theta. Newton steps that leave
+// the bracket are replaced by bisection; the arclength is monotone, so the
+// bracket always holds the root.
+double
+param(const ellipse_arclength &len, double s, double lo, double hi, double theta, double tol)
+{
+  for (unsigned it=0; it < 100; ++it) {
+    if (!(theta > lo && theta < hi))
+      theta = (lo + hi)/2;
+    double f = len(theta) - s;
+    if (std::fabs(f) <= tol)
+      break;
+    if (f < 0)
+      lo = theta;
+    else
+      hi = theta;
+    if (!(hi > lo))
+      break;
+    theta -= f/len.speed(theta);
+  }
+  return theta;
+}
+
+}
+
+void bdifd_edgel_sampler::
+sample(const bdifd_conic_arc &a, std::vector<bdifd_3rd_order_point_2d> *C) const
+{
+  C->clear();
+  const double deg = vnl_math::pi/180.0;
+  double t0 = a.theta0*deg, t1 = a.theta1*deg;
+  if (!(t1 > t0) || !(a.ra > 0) || !(a.rb > 0)) {
+    C->push_back(point(a, t0));
+    return;
+  }
+  bool closed = t1 - t0 >= 2*vnl_math::pi*(1 - 1e-12);
+  if (closed)
+    t1 = t0 + 2*vnl_math::pi;
+
+  // a whole number of equal arclength steps, the nearest to h
+  ellipse_arclength len(a);
+  double s0 = len(t0), L = len(t1) - s0;
+  unsigned N = std::max(1u, static_cast<unsigned>(L/h_ + 0.5));
+  if (closed)
+    N = std::max(N, 3u);
+  double ds = L/N, tol = 1e-9*ds;
+
+  C->reserve(N + 1);
+  C->push_back(point(a, t0));
+  double t = t0;
+  for (unsigned i=1; i < N; ++i) {
+    t = param(len, s0 + i*ds, t, t1, t + len.predict(t, ds), tol);
+    C->push_back(point(a, t));
+  }
+  if (!closed)
+    C->push_back(point(a, t1));
+}
+
+void bdifd_edgel_sampler::
+sample_segment(double x0, double y0, double x1, double y1,
+    std::vector<bdifd_3rd_order_point_2d> *C) const
+{
+  C->clear();
+  double dx = x1 - x0, dy = y1 - y0;
+  double len = std::sqrt(dx*dx + dy*dy);
+  unsigned N = std::max(1u, static_cast<unsigned>(len/h_ + 0.5));
+
+  bdifd_3rd_order_point_2d p;
+  p.gama[2] = 0;
+  p.t[0] = len > 0 ? dx/len : 1;
+  p.t[1] = len > 0 ? dy/len : 0;
+  p.t[2] = 0;
+  p.n[0] = -p.t[1];
+  p.n[1] = p.t[0];
+  p.n[2] = 0;
+  p.k = 0;
+  p.kdot = 0;
+  p.valid = true;
+  C->reserve(N + 1);
+  for (unsigned i=0; i <= N; ++i) {
+    double u = double(i)/N;
+    p.gama[0] = x0 + u*dx;
+    p.gama[1] = y0 + u*dy;
+    C->push_back(p);
+  }
+}
+
+void bdifd_edgel_sampler::
+sample(const std::vector<bdifd_conic_arc> &arcs,
+    std::vector<std::vector<bdifd_3rd_order_point_2d> > *C, unsigned nthreads) const
+{
+  C->resize(arcs.size());
+  bdifd_parallel::for_each(arcs.size(), [&](unsigned i) {
+    sample(arcs[i], &(*C)[i]);
+  }, nthreads);
+}
@@ -0,0 +1,80 @@
+// This is bdifd_edgel_sampler.h
+#ifndef bdifd_edgel_sampler_h
+#define bdifd_edgel_sampler_h
+//:
+//\file
+//\brief Image curves sampled directly at a target pixel spacing
+//\date Sun Oct 18 2026
+//
+// By default get_circle_edgels and get_ellipse_edgels sample at a fixed
+// angular step small enough for the largest radius (a tenth of it for
+// ellipses) and then drop most samples with bdifd_analytic::limit_distance.
+// Given a spacing > 0 they use this sampler instead, which places each
+// sample from the local geometry and so only generates the samples that are
+// kept.
+//
+// Samples are equally spaced in arclength: the arc, of length L, is cut into
+// N = round(L/h) steps of L/N, so the count is the nearest to L/h and a
+// closed curve has no short or long gap where it closes up. The arclength of
+// the ellipse is r E(theta - phase | m), an incomplete elliptic integral of
+// the second kind evaluated with Carlson's R_F and R_D, and each sample is
+// placed by Newton on it (the derivative is the speed) from a second order
+// prediction, inside the bracket of the previous sample and the end of the
+// arc and falling back to bisection; it is monotone, so every sample is
+// found to 1e-9 of the step whatever the aspect ratio.
+//
+// A chord is never longer than its arc, so no chord exceeds L/N. Where the
+// curvature stays below k over a step, the chord is at least 2 sin(k L/2N)/k
+// (at most k^2 (L/N)^3/24 short of it): with h = 1, within 0.002% of L/N on a
+// circle of radius 50, 0.2% at radius 5 and 1% at radius 2. At the ends of an
+// ellipse whose radius of curvature there, rb^2/ra, is below about h/2 (e.g.
+// 200x5, or 3x0.5) the curve folds back within a step and the chord across
+// the fold is shorter, down to the width of the ellipse there.
+//
+// Points carry position, unit tangent, normal (the tangent turned by +90
+// degrees), curvature and its arclength derivative, with gama[2] = t[2] = 0.
+// Lines are the trivial case and are sampled uniformly.
+//
+
+#include <vector>
+#include <bdifd/bdifd_frenet_point.h>
+
+//: Arc of the ellipse (ra cos theta, rb sin theta) + (cx, cy), theta from
+// theta0 to theta1 degrees, counterclockwise; a circle if ra == rb. An arc of
+// 360 degrees or more is the closed curve.
+struct bdifd_conic_arc {
+  double ra, rb;
+  double cx, cy;
+  double theta0, theta1;
+
+  bdifd_conic_arc(double a, double b, double x, double y, double t0=0, double t1=360)
+    : ra(a), rb(b), cx(x), cy(y), theta0(t0), theta1(t1) {}
+};
+
+class bdifd_edgel_sampler {
+public:
+  //: Samples \p spacing pixels apart.
+  explicit bdifd_edgel_sampler(double spacing=1) : h_(spacing > 0 ? spacing : 1) {}
+
+  double spacing() const { return h_; }
+
+  //: Samples of \p a, in increasing theta. Open arcs include both ends.
+  void sample(const bdifd_conic_arc &a, std::vector<bdifd_3rd_order_point_2d> *C) const;
+
+  //: Samples of the segment from (x0,y0) to (x1,y1), both ends included.
+  void sample_segment(double x0, double y0, double x1, double y1,
+      std::vector<bdifd_3rd_order_point_2d> *C) const;
+
+  //: Samples of every arc, (*C)[i] for arcs[i], spread over \p nthreads
+  // threads (0 = one per core).
+  void sample(const std::vector<bdifd_conic_arc> &arcs,
+      std::vector<std::vector<bdifd_3rd_order_point_2d> > *C, unsigned nthreads=0) const;
+
+  //: Point of \p a at \p theta radians.
+  static bdifd_3rd_order_point_2d point(const bdifd_conic_arc &a, double theta);
+
+private:
+  double h_;
+};
+
+#endif // bdifd_edgel_sampler_h
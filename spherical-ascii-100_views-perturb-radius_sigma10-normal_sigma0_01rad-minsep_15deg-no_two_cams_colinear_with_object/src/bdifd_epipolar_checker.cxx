@@ -0,0 +1,206 @@
+#include "bdifd_epipolar_checker.h"
+#include "bdifd_ascii_dataset.h"
+#include "bdifd_parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <vnl/vnl_inverse.h>
+
+namespace {
+
+const unsigned block_size = 256;
+
+}
+
+const char *bdifd_epipolar_residuals::
+name(unsigned k)
+{
+  static const char *names[nkinds] = { "point", "tangent" };
+  return k < nkinds ? names[k] : "unknown";
+}
+
+double bdifd_epipolar_residuals::
+bin_lower(unsigned b)
+{
+  return b ? std::pow(10.0, int(b) - 17) : 0;
+}
+
+unsigned bdifd_epipolar_residuals::
+bin(double r)
+{
+  if (!std::isfinite(r))
+    return nbins - 1;
+  int b = int(std::floor(std::log10(std::max(r, 1e-17)))) + 17;
+  return std::min(std::max(b, 0), int(nbins) - 1);
+}
+
+bdifd_epipolar_checker::
+bdifd_epipolar_checker(const bdifd_ascii_dataset &ds, double degenerate_sin)
+  : view_(ds.nviews()),
+    degenerate_sin_(degenerate_sin),
+    npts_(ds.npts())
+{
+  vnl_double_3x3 Kinv = vnl_inverse(ds.K);
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c)
+      Kinv_[r][c] = Kinv[r][c];
+
+  for (unsigned c=0; c < 3; ++c)
+    T_[c].resize(npts_);
+  for (unsigned i=0; i < npts_; ++i) {
+    double nt = std::sqrt(ds.TX[i]*ds.TX[i] + ds.TY[i]*ds.TY[i] + ds.TZ[i]*ds.TZ[i]);
+    T_[0][i] = ds.TX[i]/nt;
+    T_[1][i] = ds.TY[i]/nt;
+    T_[2][i] = ds.TZ[i]/nt;
+  }
+
+  const vnl_double_3x3 &K = ds.K;
+  for (unsigned v=0; v < view_.size(); ++v) {
+    view &w = view_[v];
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned c=0; c < 3; ++c)
+        w.R[r][c] = ds.R[v][r][c];
+    for (unsigned r=0; r < 3; ++r)
+      w.t[r] = -(w.R[r][0]*ds.C[v][0] + w.R[r][1]*ds.C[v][1] + w.R[r][2]*ds.C[v][2]);
+    std::vector<double> utx, uty;
+    ds.undistorted(v, &w.x, &w.y, &utx, &uty);
+
+    // Tangent line l = [x;y;1] x [tx;ty;0] back-projects to the plane of
+    // normal K^T l in the camera, R^T K^T l in the world.
+    for (unsigned c=0; c < 3; ++c)
+      w.n[c].resize(npts_);
+    const double *tx = &utx[0], *ty = &uty[0];
+    for (unsigned i=0; i < npts_; ++i) {
+      double l[3] = { -ty[i], tx[i], w.x[i]*ty[i] - w.y[i]*tx[i] };
+      double m[3];
+      for (unsigned r=0; r < 3; ++r)
+        m[r] = K[0][r]*l[0] + K[1][r]*l[1] + K[2][r]*l[2];
+      double nw[3];
+      for (unsigned r=0; r < 3; ++r)
+        nw[r] = w.R[0][r]*m[0] + w.R[1][r]*m[1] + w.R[2][r]*m[2];
+      double nn = std::sqrt(nw[0]*nw[0] + nw[1]*nw[1] + nw[2]*nw[2]);
+      for (unsigned r=0; r < 3; ++r)
+        w.n[r][i] = nw[r]/nn;
+    }
+  }
+}
+
+void bdifd_epipolar_checker::
+check(unsigned vi, unsigned vj, bdifd_epipolar_residuals *res) const
+{
+  typedef bdifd_epipolar_residuals K;
+  res->v[0] = vi;
+  res->v[1] = vj;
+  res->degenerate = 0;
+  for (unsigned k=0; k < K::nkinds; ++k) {
+    res->max[k] = 0;
+    res->argmax[k] = 0;
+    res->mean[k] = 0;
+    res->count[k] = 0;
+    res->nonfinite[k] = 0;
+    std::fill(res->hist[k], res->hist[k] + K::nbins, 0u);
+  }
+
+  const view &wi = view_[vi], &wj = view_[vj];
+
+  // F = K^{-T} [t]_x R K^{-1}
+  vnl_double_3x3 R, tx(0.0), Kinv;
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c) {
+      R[r][c] = wj.R[r][0]*wi.R[c][0] + wj.R[r][1]*wi.R[c][1] + wj.R[r][2]*wi.R[c][2];
+      Kinv[r][c] = Kinv_[r][c];
+    }
+  double t[3];
+  for (unsigned r=0; r < 3; ++r)
+    t[r] = wj.t[r] - (R[r][0]*wi.t[0] + R[r][1]*wi.t[1] + R[r][2]*wi.t[2]);
+  tx[0][1] = -t[2]; tx[0][2] =  t[1];
+  tx[1][0] =  t[2]; tx[1][2] = -t[0];
+  tx[2][0] = -t[1]; tx[2][1] =  t[0];
+  vnl_double_3x3 Fm = Kinv.transpose()*tx*R*Kinv;
+  double F[3][3];
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c)
+      F[r][c] = Fm[r][c];
+
+  const double *xi = &wi.x[0], *yi = &wi.y[0], *xj = &wj.x[0], *yj = &wj.y[0];
+  const double *ni0 = &wi.n[0][0], *ni1 = &wi.n[1][0], *ni2 = &wi.n[2][0];
+  const double *nj0 = &wj.n[0][0], *nj1 = &wj.n[1][0], *nj2 = &wj.n[2][0];
+  const double *T0 = &T_[0][0], *T1 = &T_[1][0], *T2 = &T_[2][0];
+  const double dsin = degenerate_sin_;
+
+  double r_pt[block_size], r_tgt[block_size], s_planes[block_size];
+  double sum[K::nkinds] = {0, 0};
+
+  for (unsigned base=0; base < npts_; base += block_size) {
+    unsigned nb = std::min(block_size, npts_ - base);
+    for (unsigned b=0; b < nb; ++b) {
+      unsigned i = base + b;
+      double l0 = F[0][0]*xi[i] + F[0][1]*yi[i] + F[0][2];
+      double l1 = F[1][0]*xi[i] + F[1][1]*yi[i] + F[1][2];
+      double l2 = F[2][0]*xi[i] + F[2][1]*yi[i] + F[2][2];
+      r_pt[b] = std::fabs(xj[i]*l0 + yj[i]*l1 + l2)/std::sqrt(l0*l0 + l1*l1);
+
+      // c = ni x nj is the direction of the reconstructed tangent
+      double c0 = ni1[i]*nj2[i] - ni2[i]*nj1[i];
+      double c1 = ni2[i]*nj0[i] - ni0[i]*nj2[i];
+      double c2 = ni0[i]*nj1[i] - ni1[i]*nj0[i];
+      double cn = std::sqrt(c0*c0 + c1*c1 + c2*c2);
+      double s0 = c1*T2[i] - c2*T1[i];
+      double s1 = c2*T0[i] - c0*T2[i];
+      double s2 = c0*T1[i] - c1*T0[i];
+      s_planes[b] = cn;
+      r_tgt[b] = std::sqrt(s0*s0 + s1*s1 + s2*s2)/std::max(cn, dsin);
+    }
+
+    for (unsigned b=0; b < nb; ++b) {
+      double r = r_pt[b];
+      if (!std::isfinite(r)) {
+        res->nonfinite[K::point]++;
+        continue;
+      }
+      sum[K::point] += r;
+      res->count[K::point]++;
+      res->hist[K::point][K::bin(r)]++;
+      if (r > res->max[K::point]) {
+        res->max[K::point] = r;
+        res->argmax[K::point] = base + b;
+      }
+    }
+    for (unsigned b=0; b < nb; ++b) {
+      if (s_planes[b] < dsin) {
+        res->degenerate++;
+        continue;
+      }
+      double r = r_tgt[b];
+      if (!std::isfinite(r)) {
+        res->nonfinite[K::tangent]++;
+        continue;
+      }
+      sum[K::tangent] += r;
+      res->count[K::tangent]++;
+      res->hist[K::tangent][K::bin(r)]++;
+      if (r > res->max[K::tangent]) {
+        res->max[K::tangent] = r;
+        res->argmax[K::tangent] = base + b;
+      }
+    }
+  }
+  for (unsigned k=0; k < K::nkinds; ++k)
+    res->mean[k] = res->count[k] ? sum[k]/res->count[k] : 0;
+}
+
+void bdifd_epipolar_checker::
+check_all(std::vector<bdifd_epipolar_residuals> *res, unsigned nthreads) const
+{
+  unsigned nv = view_.size();
+  std::vector<unsigned> pi, pj;
+  for (unsigned i=0; i < nv; ++i)
+    for (unsigned j=i+1; j < nv; ++j) {
+      pi.push_back(i);
+      pj.push_back(j);
+    }
+
+  res->resize(pi.size());
+  bdifd_parallel::for_each(pi.size(), [&](unsigned p) {
+    check(pi[p], pj[p], &(*res)[p]);
+  }, nthreads);
+}
@@ -0,0 +1,98 @@
+// This is bdifd_epipolar_checker.h
+#ifndef bdifd_epipolar_checker_h
+#define bdifd_epipolar_checker_h
+//:
+//\file
+//\brief Epipolar point and tangent residuals over all view pairs of a dataset
+//\date Sun Oct 18 2026
+//
+// Native, exhaustive counterpart of synthdata_bifocal.sce. For each pair of
+// views i < j the fundamental matrix is built from calib.intrinsic and the
+// .extrinsic files,
+//
+//   F_ij = K^{-T} [t]_x R K^{-1},   R = Rj Ri^T,  t = tj - R ti,  t = -R C,
+//
+// and every sample gets two residuals:
+//
+//   point    x_j^T F_ij x_i divided by |(F_ij x_i)_{1,2}|, i.e. the distance
+//            in pixels from x_j to the epipolar line of x_i
+//   tangent  sine of the angle between the space tangent in crv-3D-tgts.txt
+//            and the intersection of the planes back-projected from the two
+//            image tangent lines
+//
+// With a calib.distortion the image samples and tangents are undistorted
+// first (bdifd_ascii_dataset::undistorted), since F relates pinhole views.
+//
+// Near epipolar tangency the two planes coincide and the tangent is not
+// determined by the pair; those samples (sine of the angle between the planes
+// below degenerate_sin) are counted apart and left out of the tangent
+// statistics.
+//
+// Residuals of each pair go into a histogram of decades, bin b >= 1 holding
+// [10^(b-17), 10^(b-16)) and bin 0 anything below 1e-16. NaN and infinite
+// residuals, e.g. from a sample on the baseline or a degenerate pair, are
+// counted apart (nonfinite) and left out of the histogram and statistics;
+// check_epipolar fails on any. Pairs are spread
+// over threads; within a pair samples are processed in blocks, with the
+// arithmetic in branch-free loops over one array per coordinate.
+//
+
+#include <vector>
+
+class bdifd_ascii_dataset;
+
+struct bdifd_epipolar_residuals {
+  enum kind {
+    point=0,
+    tangent,
+    nkinds
+  };
+  static const unsigned nbins = 20;
+
+  static const char *name(unsigned k);
+
+  //: Lower end of histogram bin \p b.
+  static double bin_lower(unsigned b);
+
+  //: Histogram bin of residual \p r; the last one if it is not finite.
+  static unsigned bin(double r);
+
+  unsigned v[2];
+  double max[nkinds];
+  unsigned argmax[nkinds];
+  double mean[nkinds];
+  unsigned count[nkinds];     //:< finite residuals
+  unsigned nonfinite[nkinds];
+  unsigned hist[nkinds][nbins];
+  unsigned degenerate;  //:< tangent samples near epipolar tangency
+};
+
+class bdifd_epipolar_checker {
+public:
+  //: \p d must have its 2D samples read.
+  explicit bdifd_epipolar_checker(const bdifd_ascii_dataset &d, double degenerate_sin=1e-3);
+
+  unsigned nviews() const { return view_.size(); }
+  unsigned npts() const { return npts_; }
+
+  //: Checks all pairs i < j, in that order, over \p nthreads threads
+  // (0 = one per core).
+  void check_all(std::vector<bdifd_epipolar_residuals> *res, unsigned nthreads=0) const;
+
+  void check(unsigned i, unsigned j, bdifd_epipolar_residuals *r) const;
+
+private:
+  struct view {
+    double R[3][3], t[3];
+    std::vector<double> x, y;   //:< pixels
+    std::vector<double> n[3];   //:< unit back-projected tangent plane normal, world
+  };
+
+  std::vector<view> view_;
+  double Kinv_[3][3];
+  std::vector<double> T_[3];    //:< unit space tangents
+  double degenerate_sin_;
+  unsigned npts_;
+};
+
+#endif // bdifd_epipolar_checker_h
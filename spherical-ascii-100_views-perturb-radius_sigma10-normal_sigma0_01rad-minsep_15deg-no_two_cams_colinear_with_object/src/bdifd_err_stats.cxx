@@ -0,0 +1,177 @@
+#include "bdifd_err_stats.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+//: Each level below the top has 2/3 the capacity of the one above it.
+static const double kll_capacity_decay = 2./3.;
+
+bdifd_quantile_sketch::
+bdifd_quantile_sketch(unsigned k)
+  : k_(k < 8 ? 8 : k)
+{
+  clear();
+}
+
+void bdifd_quantile_sketch::
+clear()
+{
+  n_ = 0;
+  size_ = 0;
+  rand_state_ = 0x9e3779b9u;
+  compactors_.assign(1, std::vector<double>());
+  max_size_ = capacity(0);
+}
+
+unsigned bdifd_quantile_sketch::
+capacity(unsigned h) const
+{
+  unsigned depth = compactors_.size() - h - 1;
+  unsigned c = static_cast<unsigned>(std::ceil(k_*std::pow(kll_capacity_decay, static_cast<double>(depth))));
+  return c < 2 ? 2 : c;
+}
+
+//: xorshift32; fixed seed so that runs are reproducible.
+bool bdifd_quantile_sketch::
+coin()
+{
+  rand_state_ ^= rand_state_ << 13;
+  rand_state_ ^= rand_state_ >> 17;
+  rand_state_ ^= rand_state_ << 5;
+  return rand_state_ & 1u;
+}
+
+void bdifd_quantile_sketch::
+add(double x)
+{
+  compactors_[0].push_back(x);
+  ++n_;
+  ++size_;
+  if (size_ >= max_size_)
+    compress();
+}
+
+void bdifd_quantile_sketch::
+compress()
+{
+  while (size_ >= max_size_) {
+    for (unsigned h=0; h < compactors_.size(); ++h) {
+      if (compactors_[h].size() < capacity(h))
+        continue;
+
+      if (h + 1 == compactors_.size())
+        compactors_.push_back(std::vector<double>());
+
+      std::vector<double> &level = compactors_[h];
+      std::vector<double> &up = compactors_[h+1];
+      std::sort(level.begin(), level.end());
+
+      // an odd item out stays at this level
+      double leftover = 0;
+      bool has_leftover = level.size() % 2;
+      if (has_leftover) {
+        leftover = level.back();
+        level.pop_back();
+      }
+
+      for (unsigned i = coin(); i < level.size(); i += 2)
+        up.push_back(level[i]);
+
+      size_ -= level.size()/2;
+      level.clear();
+      if (has_leftover)
+        level.push_back(leftover);
+      break;
+    }
+
+    max_size_ = 0;
+    for (unsigned h=0; h < compactors_.size(); ++h)
+      max_size_ += capacity(h);
+  }
+}
+
+void bdifd_quantile_sketch::
+merge(const bdifd_quantile_sketch &o)
+{
+  assert(k_ == o.k_);
+  while (compactors_.size() < o.compactors_.size())
+    compactors_.push_back(std::vector<double>());
+
+  for (unsigned h=0; h < o.compactors_.size(); ++h)
+    compactors_[h].insert(compactors_[h].end(), o.compactors_[h].begin(), o.compactors_[h].end());
+
+  n_ += o.n_;
+  size_ += o.size_;
+  max_size_ = 0;
+  for (unsigned h=0; h < compactors_.size(); ++h)
+    max_size_ += capacity(h);
+  compress();
+}
+
+double bdifd_quantile_sketch::
+quantile(double q) const
+{
+  if (!size_)
+    return 0;
+
+  std::vector<std::pair<double, unsigned long> > items;
+  items.reserve(size_);
+  unsigned long total = 0;
+  for (unsigned h=0; h < compactors_.size(); ++h) {
+    unsigned long w = 1ul << h;
+    for (unsigned i=0; i < compactors_[h].size(); ++i)
+      items.push_back(std::make_pair(compactors_[h][i], w));
+    total += w*compactors_[h].size();
+  }
+  std::sort(items.begin(), items.end());
+
+  q = std::min(std::max(q, 0.), 1.);
+  double target = q*total;
+  unsigned long cum = 0;
+  for (unsigned i=0; i < items.size(); ++i) {
+    cum += items[i].second;
+    if (cum >= target)
+      return items[i].first;
+  }
+  return items.back().first;
+}
+
+//---------------------------------------------------------------------------
+
+bdifd_err_stats::
+bdifd_err_stats(unsigned k)
+  : sketch_(k)
+{
+  clear();
+}
+
+void bdifd_err_stats::
+clear()
+{
+  n_ = 0;
+  sum_ = 0;
+  max_ = 0;
+  argmax_ = 0;
+  sketch_.clear();
+}
+
+void bdifd_err_stats::
+merge(const bdifd_err_stats &o)
+{
+  if (!o.n_)
+    return;
+  if (!n_ || o.max_ > max_) {
+    max_ = o.max_;
+    argmax_ = o.argmax_;
+  }
+  n_ += o.n_;
+  sum_ += o.sum_;
+  sketch_.merge(o.sketch_);
+}
+
+void bdifd_err_stats::
+print_summary(std::ostream &os, const char *label) const
+{
+  os << label << " average, max, med error: " << mean() << ", " << max() << ", " << median() << std::endl;
+}
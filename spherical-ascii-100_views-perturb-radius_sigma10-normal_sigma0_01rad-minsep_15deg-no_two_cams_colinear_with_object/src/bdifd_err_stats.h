@@ -0,0 +1,97 @@
+// This is bdifd_err_stats.h
+#ifndef bdifd_err_stats_h
+#define bdifd_err_stats_h
+//:
+//\file
+//\brief Streaming error statistics with a mergeable quantile sketch
+//\date Sun Oct 18 2026
+//
+// The error loops of bdifd_data feed these accumulators one value at a time,
+// so evaluating any number of points takes a bounded amount of memory.
+// Accumulators filled by different threads are combined with merge().
+//
+
+#include <ostream>
+#include <vector>
+
+//: KLL quantile sketch (Karnin, Lang, Liberty, FOCS 2016).
+//
+// Keeps a hierarchy of compactors; level h holds items of weight 2^h. When
+// the sketch is full, the lowest overfull level is sorted and every other item
+// is promoted, starting at a random offset. The rank error of quantile() is
+// about 1.7/k with high probability, independent of the number of items.
+class bdifd_quantile_sketch {
+public:
+  explicit bdifd_quantile_sketch(unsigned k=200);
+
+  void add(double x);
+
+  //: Folds \p o into this sketch; both must have been built with the same k.
+  void merge(const bdifd_quantile_sketch &o);
+
+  //: Approximate q-quantile, q in [0,1]. Returns 0 for an empty sketch.
+  double quantile(double q) const;
+
+  //: Number of items added, including those merged in.
+  unsigned long count() const { return n_; }
+
+  //: Number of items currently retained (the memory footprint).
+  unsigned retained() const { return size_; }
+
+  void clear();
+
+private:
+  unsigned capacity(unsigned h) const;
+  void compress();
+  bool coin();
+
+  unsigned k_;
+  unsigned long n_;
+  unsigned size_;
+  unsigned max_size_;
+  unsigned rand_state_;
+  std::vector<std::vector<double> > compactors_;
+};
+
+//: Count, mean, maximum with the index where it occurred, and quantiles of a
+// stream of non-negative error values.
+class bdifd_err_stats {
+public:
+  explicit bdifd_err_stats(unsigned k=200);
+
+  //: Adds error \p x observed at point (or sample) index \p id.
+  void add(double x, unsigned id)
+  {
+    ++n_;
+    sum_ += x;
+    if (n_ == 1 || x > max_) {
+      max_ = x;
+      argmax_ = id;
+    }
+    sketch_.add(x);
+  }
+
+  void merge(const bdifd_err_stats &o);
+
+  unsigned long count() const { return n_; }
+  double mean() const { return n_ ? sum_/n_ : 0; }
+  double max() const { return max_; }
+  unsigned argmax() const { return argmax_; }
+  double median() const { return sketch_.quantile(0.5); }
+  double quantile(double q) const { return sketch_.quantile(q); }
+
+  void clear();
+
+  //: Prints "<label> average, max, med error: a, b, c", the summary line
+  // format of the pose estimation runs in misc/old.
+  void print_summary(std::ostream &os, const char *label) const;
+
+private:
+  unsigned long n_;
+  double sum_;
+  double max_;
+  unsigned argmax_;
+  bdifd_quantile_sketch sketch_;
+};
+
+#endif // bdifd_err_stats_h
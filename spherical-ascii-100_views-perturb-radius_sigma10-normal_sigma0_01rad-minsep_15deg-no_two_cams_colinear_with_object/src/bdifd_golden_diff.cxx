@@ -0,0 +1,324 @@
+#include "bdifd_golden_diff.h"
+#include "bdifd_ascii_dataset.h"
+#include "bdifd_parallel.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vul/vul_file.h>
+
+namespace {
+
+//: Read-only view of a whole file.
+class mapped_file {
+public:
+  mapped_file() : data_(0), size_(0), mapped_(false) {}
+  ~mapped_file()
+  {
+    if (mapped_)
+      munmap(const_cast<char *>(data_), size_);
+  }
+
+  bool open(const std::string &fname)
+  {
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      return false;
+    }
+    size_ = st.st_size;
+    if (!size_) {
+      ::close(fd);
+      data_ = "";
+      return true;
+    }
+    void *p = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+      return false;
+    madvise(p, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char *>(p);
+    mapped_ = true;
+    return true;
+  }
+
+  const char *begin() const { return data_; }
+  const char *end() const { return data_ + size_; }
+
+private:
+  mapped_file(const mapped_file &);
+  mapped_file &operator=(const mapped_file &);
+
+  const char *data_;
+  size_t size_;
+  bool mapped_;
+};
+
+struct token {
+  const char *p;
+  unsigned n;
+};
+
+inline bool
+is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+//: Splits [p, end) at whitespace.
+void
+tokenize(const char *p, const char *end, std::vector<token> *t)
+{
+  t->clear();
+  while (p < end) {
+    while (p < end && is_space(*p))
+      ++p;
+    const char *q = p;
+    while (q < end && !is_space(*q))
+      ++q;
+    if (q > p) {
+      token k = { p, unsigned(q - p) };
+      t->push_back(k);
+    }
+    p = q;
+  }
+}
+
+//: Parses the whole token as a double. The mapped file is not terminated, so
+// the token is copied out first.
+bool
+parse_number(const token &k, double *d)
+{
+  char buf[64];
+  if (k.n >= sizeof(buf))
+    return false;
+  std::memcpy(buf, k.p, k.n);
+  buf[k.n] = 0;
+  char *q;
+  *d = std::strtod(buf, &q);
+  return q == buf + k.n;
+}
+
+//: End of the line starting at \p p, without the newline.
+inline const char *
+line_end(const char *p, const char *end)
+{
+  const void *nl = std::memchr(p, '\n', end - p);
+  return nl ? static_cast<const char *>(nl) : end;
+}
+
+inline std::string
+str(const char *p, const char *q)
+{
+  while (q > p && q[-1] == '\r')
+    --q;
+  return std::string(p, q);
+}
+
+}
+
+double bdifd_golden_diff::
+ulps(double a, double b)
+{
+  if (a != a || b != b)
+    return (a != a && b != b) ? 0 : std::numeric_limits<double>::infinity();
+
+  // map doubles to integers in the same order, -0 and +0 together
+  long long ia, ib;
+  std::memcpy(&ia, &a, sizeof(a));
+  std::memcpy(&ib, &b, sizeof(b));
+  const long long sign = std::numeric_limits<long long>::min();
+  if (ia < 0)
+    ia = sign - ia;
+  if (ib < 0)
+    ib = sign - ib;
+  return ia > ib ? double(ia) - double(ib) : double(ib) - double(ia);
+}
+
+void bdifd_golden_diff::
+dataset_files(const std::string &dir, bool camera_free, std::vector<std::string> *names)
+{
+  names->clear();
+  names->push_back("calib.intrinsic");
+  names->push_back("crv-3D-pts.txt");
+  names->push_back("crv-3D-tgts.txt");
+  names->push_back("crv-ids.txt");
+  if (camera_free)
+    return;
+  for (unsigned v=0; ; ++v) {
+    std::string base = bdifd_ascii_dataset::view_name(v);
+    if (!vul_file::exists(dir + "/" + base + ".extrinsic"))
+      break;
+    names->push_back(base + ".extrinsic");
+    names->push_back(base + "-pts-2D.txt");
+    names->push_back(base + "-tgts-2D.txt");
+  }
+}
+
+bool bdifd_golden_diff::
+compare_files(const std::string &golden, const std::string &generated,
+    const std::string &name,
+    bdifd_golden_file *f,
+    std::vector<bdifd_golden_offense> *offenses) const
+{
+  f->file = name;
+  f->missing = false;
+  f->lines = 0;
+  f->offending_lines = 0;
+  f->max_abs_diff = 0;
+  f->max_ulps = 0;
+
+  bdifd_golden_offense o;
+  o.file = name;
+  o.line = 0;
+  o.field = 0;
+  o.abs_diff = 0;
+  o.ulps = 0;
+
+  mapped_file a, b;
+  if (!a.open(golden)) {
+    std::cerr << "bdifd_golden_diff: error, unable to open file name " << golden << std::endl;
+    f->missing = true;
+    f->offending_lines = 1;
+    o.what = "golden file unreadable";
+    offenses->push_back(o);
+    return false;
+  }
+  if (!b.open(generated)) {
+    f->missing = true;
+    f->offending_lines = 1;
+    o.what = "file missing";
+    offenses->push_back(o);
+    return false;
+  }
+
+  std::vector<token> ta, tb;
+  const char *pa = a.begin(), *pb = b.begin();
+  while (pa < a.end() || pb < b.end()) {
+    ++f->lines;
+    if (pa >= a.end() || pb >= b.end()) {
+      f->offending_lines++;
+      if (offenses->size() < max_offenses_) {
+        o.line = f->lines;
+        o.field = 0;
+        o.what = pa >= a.end() ? "extra lines" : "missing lines";
+        o.expected = pa < a.end() ? str(pa, line_end(pa, a.end())) : "";
+        o.actual = pb < b.end() ? str(pb, line_end(pb, b.end())) : "";
+        offenses->push_back(o);
+      }
+      break;
+    }
+    const char *ea = line_end(pa, a.end()), *eb = line_end(pb, b.end());
+    bool same = (ea - pa) == (eb - pb) && std::memcmp(pa, pb, ea - pa) == 0;
+
+    if (!same) {
+      tokenize(pa, ea, &ta);
+      tokenize(pb, eb, &tb);
+      unsigned bad_field = 0;
+      const char *what = 0;
+      double line_diff = 0, line_ulps = 0;
+      if (ta.size() != tb.size()) {
+        what = "field count";
+      } else {
+        for (unsigned k=0; k < ta.size(); ++k) {
+          double x, y;
+          if (parse_number(ta[k], &x) && parse_number(tb[k], &y)) {
+            double d = std::fabs(x - y), u = ulps(x, y);
+            if (d > f->max_abs_diff)
+              f->max_abs_diff = d;
+            if (u > f->max_ulps)
+              f->max_ulps = u;
+            if (!(d <= abs_tol_ || u <= max_ulps_) && !bad_field) {
+              bad_field = k + 1;
+              what = "value";
+              line_diff = d;
+              line_ulps = u;
+            }
+          } else if ((ta[k].n != tb[k].n || std::memcmp(ta[k].p, tb[k].p, ta[k].n)) && !bad_field) {
+            bad_field = k + 1;
+            what = "text";
+          }
+        }
+      }
+      if (what) {
+        f->offending_lines++;
+        if (offenses->size() < max_offenses_) {
+          o.line = f->lines;
+          o.field = bad_field;
+          o.what = what;
+          if (bad_field) {
+            o.expected = std::string(ta[bad_field-1].p, ta[bad_field-1].n);
+            o.actual = std::string(tb[bad_field-1].p, tb[bad_field-1].n);
+          } else {
+            o.expected = str(pa, ea);
+            o.actual = str(pb, eb);
+          }
+          o.abs_diff = line_diff;
+          o.ulps = line_ulps;
+          offenses->push_back(o);
+        }
+      }
+    }
+    pa = ea < a.end() ? ea + 1 : ea;
+    pb = eb < b.end() ? eb + 1 : eb;
+  }
+  return f->offending_lines == 0;
+}
+
+bool bdifd_golden_diff::
+compare_dirs(const std::string &golden, const std::string &generated,
+    std::vector<bdifd_golden_file> *files,
+    std::vector<bdifd_golden_offense> *offenses,
+    unsigned nthreads) const
+{
+  std::vector<std::string> names;
+  dataset_files(golden, camera_free_, &names);
+
+  files->resize(names.size());
+  std::vector<std::vector<bdifd_golden_offense> > per_file(names.size());
+  bdifd_parallel::for_each(names.size(), [&](unsigned i) {
+    compare_files(golden + "/" + names[i], generated + "/" + names[i], names[i],
+        &(*files)[i], &per_file[i]);
+  }, nthreads);
+
+  bool ok = true;
+  offenses->clear();
+  for (unsigned i=0; i < names.size(); ++i) {
+    ok = ok && (*files)[i].offending_lines == 0;
+    for (unsigned k=0; k < per_file[i].size() && offenses->size() < max_offenses_; ++k)
+      offenses->push_back(per_file[i][k]);
+  }
+
+  if (!camera_free_) {
+    // views beyond the last golden one
+    unsigned nviews = (names.size() - 4)/3;
+    std::string extra = bdifd_ascii_dataset::view_name(nviews) + ".extrinsic";
+    if (vul_file::exists(generated + "/" + extra)) {
+      ok = false;
+      bdifd_golden_file f;
+      f.file = extra;
+      f.missing = false;
+      f.lines = 0;
+      f.offending_lines = 1;
+      f.max_abs_diff = f.max_ulps = 0;
+      files->push_back(f);
+      if (offenses->size() < max_offenses_) {
+        bdifd_golden_offense o;
+        o.file = extra;
+        o.line = o.field = 0;
+        o.what = "extra view";
+        o.abs_diff = o.ulps = 0;
+        offenses->push_back(o);
+      }
+    }
+  }
+  return ok;
+}
@@ -0,0 +1,81 @@
+// This is bdifd_golden_diff.h
+#ifndef bdifd_golden_diff_h
+#define bdifd_golden_diff_h
+//:
+//\file
+//\brief Numeric diff of a generated dataset against the committed one
+//\date Sun Oct 18 2026
+//
+// Compares the files of two dataset directories line by line and field by
+// field. Fields that parse as numbers match if they are within abs_tol or
+// within max_ulps units in the last place of each other, so reformatting or
+// last-bit differences from a compiler change can be told apart from real
+// changes to the data. Other fields must match exactly.
+//
+// Files are mapped read-only with mmap and compared in parallel, one file per
+// work item; identical lines are skipped with a byte comparison before any
+// parsing. The first max_offenses offending lines are kept, in file and line
+// order.
+//
+// With camera_free, only calib.intrinsic and the crv-*.txt files are
+// compared: they do not depend on the camera draw, so they can be checked
+// against a dataset whose cameras were seeded from the clock.
+//
+
+#include <string>
+#include <vector>
+
+struct bdifd_golden_offense {
+  std::string file;
+  unsigned line;      //:< from 1
+  unsigned field;     //:< from 1; 0 if the line as a whole differs
+  std::string what;
+  std::string expected, actual;
+  double abs_diff;
+  double ulps;
+};
+
+struct bdifd_golden_file {
+  std::string file;
+  bool missing;             //:< absent or unreadable in the generated set
+  unsigned lines;
+  unsigned offending_lines;
+  double max_abs_diff;
+  double max_ulps;
+};
+
+class bdifd_golden_diff {
+public:
+  bdifd_golden_diff(double abs_tol=0, double max_ulps=4, unsigned max_offenses=20)
+    : abs_tol_(abs_tol), max_ulps_(max_ulps), max_offenses_(max_offenses), camera_free_(false) {}
+
+  void set_camera_free(bool b) { camera_free_ = b; }
+
+  //: Compares all dataset files of \p golden with those in \p generated,
+  // over \p nthreads threads (0 = one per core). Returns true if they match.
+  bool compare_dirs(const std::string &golden, const std::string &generated,
+      std::vector<bdifd_golden_file> *files,
+      std::vector<bdifd_golden_offense> *offenses,
+      unsigned nthreads=0) const;
+
+  //: Compares two files; \p name is what offenses are reported under.
+  bool compare_files(const std::string &golden, const std::string &generated,
+      const std::string &name,
+      bdifd_golden_file *file,
+      std::vector<bdifd_golden_offense> *offenses) const;
+
+  //: Dataset files of \p dir, in the order they are reported.
+  static void dataset_files(const std::string &dir, bool camera_free,
+      std::vector<std::string> *names);
+
+  //: Number of representable doubles between \p a and \p b.
+  static double ulps(double a, double b);
+
+private:
+  double abs_tol_;
+  double max_ulps_;
+  unsigned max_offenses_;
+  bool camera_free_;
+};
+
+#endif // bdifd_golden_diff_h
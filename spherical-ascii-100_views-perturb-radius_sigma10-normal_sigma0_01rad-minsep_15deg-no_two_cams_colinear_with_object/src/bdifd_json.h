@@ -0,0 +1,34 @@
+// This is bdifd_json.h
+#ifndef bdifd_json_h
+#define bdifd_json_h
+//:
+//\file
+//\brief Helpers shared by the JSON reports (benchmarks, run reports)
+//\date Sun Oct 18 2026
+//
+
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+//: Writes \p s as a quoted JSON string.
+inline void
+bdifd_json_string(std::ostream &os, const std::string &s)
+{
+  os << '"';
+  for (unsigned i=0; i < s.size(); ++i) {
+    char c = s[i];
+    if (c == '"' || c == '\\')
+      os << '\\' << c;
+    else if (c == '\n')
+      os << "\\n";
+    else if (static_cast<unsigned char>(c) < 0x20)
+      os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c)
+        << std::dec << std::setfill(' ');
+    else
+      os << c;
+  }
+  os << '"';
+}
+
+#endif // bdifd_json_h
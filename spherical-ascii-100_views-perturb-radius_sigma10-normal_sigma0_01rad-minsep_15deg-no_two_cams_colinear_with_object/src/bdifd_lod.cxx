@@ -0,0 +1,121 @@
+#include "bdifd_lod.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+bdifd_lod::
+bdifd_lod(const std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d, unsigned nlevels)
+{
+  std::vector<unsigned> sizes(crv3d.size());
+  for (unsigned i=0; i < crv3d.size(); ++i)
+    sizes[i] = crv3d[i].size();
+  build(sizes, nlevels);
+}
+
+double bdifd_lod::
+density(unsigned nlevels, unsigned base)
+{
+  return nlevels > base ? std::ldexp(1.0, nlevels - 1 - base) : 1.0;
+}
+
+void bdifd_lod::
+build(const std::vector<unsigned> &curve_sizes, unsigned nlevels)
+{
+  nlevels_ = nlevels ? std::min(nlevels, 32u) : 1;
+  unsigned finest = nlevels_ - 1;
+  sample_level_.clear();
+  for (unsigned c=0; c < curve_sizes.size(); ++c) {
+    unsigned n = curve_sizes[c];
+    for (unsigned j=0; j < n; ++j) {
+      // the level of j is set by its factors of two
+      unsigned l = finest;
+      if (j == 0 || j == n - 1)
+        l = 0;
+      else
+        for (unsigned m = j; l > 0 && m % 2 == 0; m /= 2)
+          --l;
+      sample_level_.push_back(l);
+    }
+  }
+  index_levels();
+}
+
+void bdifd_lod::
+index_levels()
+{
+  levels_.assign(nlevels_, std::vector<unsigned>());
+  for (unsigned i=0; i < sample_level_.size(); ++i)
+    for (unsigned l=sample_level_[i]; l < nlevels_; ++l)
+      levels_[l].push_back(i);
+}
+
+bool bdifd_lod::
+write(const std::string &fname) const
+{
+  std::ofstream fp(fname.c_str());
+  if (!fp) {
+    std::cerr << "bdifd_lod: error, unable to open file name " << fname << std::endl;
+    return false;
+  }
+  for (unsigned i=0; i < sample_level_.size(); ++i)
+    fp << unsigned(sample_level_[i]) << "\n";
+  return bool(fp);
+}
+
+bool bdifd_lod::
+read(const std::string &fname)
+{
+  std::vector<double> v;
+  if (!bdifd_ascii_dataset::read_numbers(fname, &v)) {
+    std::cerr << "bdifd_lod: error, unable to read file name " << fname << std::endl;
+    return false;
+  }
+  unsigned maxl = 0;
+  sample_level_.resize(v.size());
+  for (unsigned i=0; i < v.size(); ++i) {
+    if (!(v[i] >= 0 && v[i] < 32) || v[i] != std::floor(v[i])) {
+      std::cerr << "bdifd_lod: error, bad level in file name " << fname << std::endl;
+      return false;
+    }
+    sample_level_[i] = static_cast<unsigned char>(v[i]);
+    maxl = std::max(maxl, unsigned(sample_level_[i]));
+  }
+  nlevels_ = maxl + 1;
+  index_levels();
+  return true;
+}
+
+namespace {
+
+template <class T> void
+keep(const std::vector<unsigned> &idx, std::vector<T> *v)
+{
+  if (v->empty())
+    return;
+  for (unsigned k=0; k < idx.size(); ++k)
+    (*v)[k] = (*v)[idx[k]];
+  v->resize(idx.size());
+}
+
+} // namespace
+
+void bdifd_lod::
+select(unsigned l, bdifd_ascii_dataset *ds) const
+{
+  // indices increase, so compacting in place never overwrites one still needed
+  const std::vector<unsigned> &idx = levels_[std::min(l, nlevels_ - 1)];
+  keep(idx, &ds->X);  keep(idx, &ds->Y);  keep(idx, &ds->Z);
+  keep(idx, &ds->TX); keep(idx, &ds->TY); keep(idx, &ds->TZ);
+  keep(idx, &ds->crv_id);
+  for (unsigned v=0; v < ds->x.size(); ++v) {
+    keep(idx, &ds->x[v]);  keep(idx, &ds->y[v]);
+    keep(idx, &ds->tx[v]); keep(idx, &ds->ty[v]);
+  }
+  if (!ds->KC.empty()) {
+    keep(idx, &ds->KC); keep(idx, &ds->KCDOT); keep(idx, &ds->TAU);
+  }
+  for (unsigned v=0; v < ds->k.size(); ++v) {
+    keep(idx, &ds->k[v]); keep(idx, &ds->kdot[v]);
+  }
+}
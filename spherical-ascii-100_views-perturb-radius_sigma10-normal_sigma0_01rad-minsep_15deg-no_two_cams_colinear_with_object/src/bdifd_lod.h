@@ -0,0 +1,75 @@
+// This is bdifd_lod.h
+#ifndef bdifd_lod_h
+#define bdifd_lod_h
+//:
+//\file
+//\brief Dyadic levels of detail over the samples of a curve dataset
+//\date Sun Oct 18 2026
+//
+// The curves are sampled once, at the finest density, and every coarser
+// level is an index subset of the next finer one. In a curve of samples
+// j = 0, 1, ..., level l of L levels keeps the j that are multiples of
+// 2^(L-1-l), plus the last sample so that every level spans the whole curve.
+// Level L-1 is everything; each level has about twice the samples of the
+// previous one.
+//
+// Samples and their projections are stored once, as usual. Next to them
+// crv-lod.txt gives, for each sample in crv-3D-pts.txt order, the coarsest
+// level that contains it; level l is the samples whose entry is <= l. A
+// consumer picks a density at load time with select().
+//
+// With bdifd_data::space_curves_olympus_turntable(crv3d, density(L, b)),
+// level b has the step sizes of the published dataset. It samples the same
+// curves at the same spacing, but may differ from a run at density 1 in the
+// last bits or by a sample at a curve end, depending on how bdifd_analytic
+// steps its parameter.
+//
+
+#include <string>
+#include <vector>
+#include <bdifd/bdifd_camera.h>
+#include "bdifd_ascii_dataset.h"
+
+class bdifd_lod {
+public:
+  bdifd_lod() : nlevels_(1) {}
+
+  //: Levels of \p nlevels over the samples of \p crv3d, in order.
+  bdifd_lod(const std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d, unsigned nlevels);
+
+  //: Same, from the number of samples of each curve.
+  void build(const std::vector<unsigned> &curve_sizes, unsigned nlevels);
+
+  //: Density to sample at so that level \p base of \p nlevels has unit
+  // density.
+  static double density(unsigned nlevels, unsigned base);
+
+  unsigned nlevels() const { return nlevels_; }
+  unsigned npts() const { return sample_level_.size(); }
+
+  //: Coarsest level containing sample \p i.
+  unsigned sample_level(unsigned i) const { return sample_level_[i]; }
+
+  //: Samples of level \p l, increasing.
+  const std::vector<unsigned> &level(unsigned l) const { return levels_[l]; }
+
+  //: Writes the level of each sample, one per line.
+  bool write(const std::string &fname) const;
+
+  //: Reads a file written by write(). Prints the file name to std::cerr and
+  // returns false on error.
+  bool read(const std::string &fname);
+
+  //: Reduces \p ds (3D samples, curve ids, image samples of every view and
+  // any curvature channels read) to level \p l. \p ds must hold npts() samples.
+  void select(unsigned l, bdifd_ascii_dataset *ds) const;
+
+private:
+  void index_levels();
+
+  unsigned nlevels_;
+  std::vector<unsigned char> sample_level_;
+  std::vector<std::vector<unsigned> > levels_;
+};
+
+#endif // bdifd_lod_h
@@ -0,0 +1,45 @@
+#include "bdifd_log.h"
+#include <cstdlib>
+#include <iostream>
+
+static int
+initial_threshold()
+{
+  bdifd_log::level l = bdifd_log::warn;
+  const char *env = std::getenv("BDIFD_LOG");
+  if (env)
+    bdifd_log::parse(env, &l);
+  return l;
+}
+
+std::atomic<int> bdifd_log::threshold_(initial_threshold());
+
+bool bdifd_log::
+parse(const std::string &name, level *l)
+{
+  for (int i=error; i <= trace; ++i)
+    if (name == bdifd_log::name(static_cast<level>(i))) {
+      *l = static_cast<level>(i);
+      return true;
+    }
+  return false;
+}
+
+const char *bdifd_log::
+name(level l)
+{
+  switch (l) {
+    case error: return "error";
+    case warn:  return "warn";
+    case info:  return "info";
+    case debug: return "debug";
+    case trace: return "trace";
+  }
+  return "";
+}
+
+std::ostream &bdifd_log::
+stream(level l)
+{
+  return std::clog << '[' << name(l) << "] ";
+}
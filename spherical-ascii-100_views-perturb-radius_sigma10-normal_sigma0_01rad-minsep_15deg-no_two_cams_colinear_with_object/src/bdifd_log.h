@@ -0,0 +1,51 @@
+// This is bdifd_log.h
+#ifndef bdifd_log_h
+#define bdifd_log_h
+//:
+//\file
+//\brief Leveled diagnostic output
+//\date Sun Oct 18 2026
+//
+// Messages go to std::clog with a level prefix. A disabled message costs a
+// single relaxed atomic load: the stream expression after bdifd_log_msg() is
+// not evaluated at all.
+//
+//   bdifd_log_msg(debug) << "Cam to object: " << d << std::endl;
+//
+// The threshold defaults to warn and can be set with the BDIFD_LOG
+// environment variable (error, warn, info, debug, trace) or set_threshold().
+//
+
+#include <atomic>
+#include <iosfwd>
+#include <string>
+
+class bdifd_log {
+public:
+  enum level { error=0, warn, info, debug, trace };
+
+  static bool
+  enabled(level l) { return l <= threshold_.load(std::memory_order_relaxed); }
+
+  static level
+  threshold() { return static_cast<level>(threshold_.load(std::memory_order_relaxed)); }
+
+  static void
+  set_threshold(level l) { threshold_.store(l, std::memory_order_relaxed); }
+
+  //: Parses a level name; returns false and leaves \p l alone if unknown.
+  static bool parse(const std::string &name, level *l);
+
+  static const char *name(level l);
+
+  //: std::clog, after writing the prefix for \p l.
+  static std::ostream &stream(level l);
+
+private:
+  static std::atomic<int> threshold_;
+};
+
+#define bdifd_log_msg(lvl) \
+  if (!bdifd_log::enabled(bdifd_log::lvl)) ; else bdifd_log::stream(bdifd_log::lvl)
+
+#endif // bdifd_log_h
@@ -0,0 +1,443 @@
+#include "bdifd_minimal_bench.h"
+#include "bdifd_ascii_dataset.h"
+#include "bdifd_parallel.h"
+#include "bdifd_resection.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <utility>
+#include <vnl/vnl_inverse.h>
+#include <vnl/vnl_math.h>
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_random.h>
+#include <vnl/algo/vnl_svd.h>
+#include <vnl/algo/vnl_symmetric_eigensystem.h>
+
+namespace {
+
+inline void
+cross(const double a[3], const double b[3], double c[3])
+{
+  c[0] = a[1]*b[2] - a[2]*b[1];
+  c[1] = a[2]*b[0] - a[0]*b[2];
+  c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+inline double
+dot(const double a[3], const double b[3])
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+// Angles go through atan2, as acos loses all precision near 0.
+
+//: Angle of Ra Rb^T, degrees; bdifd_resection::rotation_error.
+double
+rotation_error(const double Ra[3][3], const double Rb[3][3])
+{
+  return bdifd_resection::rotation_error(vnl_double_3x3(&Ra[0][0]), vnl_double_3x3(&Rb[0][0]))
+    *180/vnl_math::pi;
+}
+
+//: Angle between the directions of \p a and \p b, degrees; 180 if either is 0.
+double
+direction_error(const double a[3], const double b[3])
+{
+  double c[3];
+  cross(a, b, c);
+  double sn = std::sqrt(dot(c, c)), cs = dot(a, b);
+  if (!(sn > 0) && !(cs > 0))
+    return 180;
+  return std::atan2(sn, cs)*180/vnl_math::pi;
+}
+
+//: Returns the ground truth; measures the cost of sampling and scoring.
+class oracle : public bdifd_minimal_solver {
+public:
+  explicit oracle(unsigned nviews) : nviews_(nviews) {}
+
+  std::string name() const { return nviews_ == 2 ? "oracle2" : "oracle3"; }
+  unsigned nviews() const { return nviews_; }
+  unsigned npoints() const { return nviews_ == 2 ? 5 : 3; }
+  bool uses_tangents() const { return nviews_ == 3; }
+
+  void solve(const bdifd_minimal_sample &s, std::vector<bdifd_relative_pose> *sols) const
+  {
+    sols->resize(1);
+    bdifd_relative_pose &p = (*sols)[0];
+    for (unsigned v=0; v+1 < nviews_; ++v)
+      for (unsigned r=0; r < 3; ++r) {
+        p.t[v][r] = s.T[v][r];
+        for (unsigned c=0; c < 3; ++c)
+          p.R[v][r][c] = s.R[v][r][c];
+      }
+  }
+
+private:
+  unsigned nviews_;
+};
+
+//: Linear eight-point algorithm on normalized coordinates.
+// The essential matrix is the null vector of the 8x9 system x2^T E x1 = 0
+// (Hartley-normalized),
+// projected onto diag(1,1,0); of its four decompositions the one placing the
+// most points in front of both cameras is returned.
+class eight_point : public bdifd_minimal_solver {
+public:
+  std::string name() const { return "8pt"; }
+  unsigned nviews() const { return 2; }
+  unsigned npoints() const { return 8; }
+
+  void solve(const bdifd_minimal_sample &s, std::vector<bdifd_relative_pose> *sols) const
+  {
+    sols->clear();
+    unsigned n = s.npoints;
+
+    // Hartley normalization, x' = s (x - m): the field of view is narrow, so
+    // the raw system is badly conditioned even in normalized coordinates
+    double m[2][2], sc[2];
+    for (unsigned j=0; j < 2; ++j) {
+      m[j][0] = m[j][1] = 0;
+      for (unsigned i=0; i < n; ++i) {
+        m[j][0] += s.x[j][i][0];
+        m[j][1] += s.x[j][i][1];
+      }
+      m[j][0] /= n;
+      m[j][1] /= n;
+      double d = 0;
+      for (unsigned i=0; i < n; ++i)
+        d += std::sqrt((s.x[j][i][0] - m[j][0])*(s.x[j][i][0] - m[j][0])
+            + (s.x[j][i][1] - m[j][1])*(s.x[j][i][1] - m[j][1]));
+      if (!(d > 0))
+        return;
+      sc[j] = std::sqrt(2.0)*n/d;
+    }
+
+    vnl_matrix<double> A(9, 9, 0.0);
+    for (unsigned i=0; i < n; ++i) {
+      double a[3] = { sc[0]*(s.x[0][i][0] - m[0][0]), sc[0]*(s.x[0][i][1] - m[0][1]), 1 };
+      double b[3] = { sc[1]*(s.x[1][i][0] - m[1][0]), sc[1]*(s.x[1][i][1] - m[1][1]), 1 };
+      double row[9];
+      for (unsigned r=0; r < 3; ++r)
+        for (unsigned c=0; c < 3; ++c)
+          row[3*r+c] = b[r]*a[c];
+      for (unsigned r=0; r < 9; ++r)
+        for (unsigned c=0; c < 9; ++c)
+          A[r][c] += row[r]*row[c];
+    }
+    vnl_symmetric_eigensystem<double> eig(A);
+    vnl_vector<double> e = eig.get_eigenvector(0);
+
+    // E = T2^T En T1, T = [s 0 -s mx; 0 s -s my; 0 0 1]
+    double T[2][3][3];
+    for (unsigned j=0; j < 2; ++j) {
+      double Tj[3][3] = { {sc[j], 0, -sc[j]*m[j][0]}, {0, sc[j], -sc[j]*m[j][1]}, {0, 0, 1} };
+      for (unsigned r=0; r < 3; ++r)
+        for (unsigned c=0; c < 3; ++c)
+          T[j][r][c] = Tj[r][c];
+    }
+    double ET1[3][3];
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned c=0; c < 3; ++c)
+        ET1[r][c] = e[3*r]*T[0][0][c] + e[3*r+1]*T[0][1][c] + e[3*r+2]*T[0][2][c];
+    vnl_matrix<double> E(3, 3);
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned c=0; c < 3; ++c)
+        E[r][c] = T[1][0][r]*ET1[0][c] + T[1][1][r]*ET1[1][c] + T[1][2][r]*ET1[2][c];
+    vnl_svd<double> svd(E);
+    vnl_matrix<double> Um = svd.U(), Vm = svd.V();
+
+    // third singular vectors from the first two, so U and V are rotations
+    double U[3][3], V[3][3];
+    double u0[3], u1[3], u2[3], v0[3], v1[3], v2[3];
+    for (unsigned r=0; r < 3; ++r) {
+      u0[r] = Um[r][0]; u1[r] = Um[r][1];
+      v0[r] = Vm[r][0]; v1[r] = Vm[r][1];
+    }
+    cross(u0, u1, u2);
+    cross(v0, v1, v2);
+    for (unsigned r=0; r < 3; ++r) {
+      U[r][0] = u0[r]; U[r][1] = u1[r]; U[r][2] = u2[r];
+      V[r][0] = v0[r]; V[r][1] = v1[r]; V[r][2] = v2[r];
+    }
+
+    // R = U W V^T or U W^T V^T, W = [0 -1 0; 1 0 0; 0 0 1]; t = +-u2
+    double Ra[3][3], Rb[3][3];
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned c=0; c < 3; ++c) {
+        Ra[r][c] = U[r][1]*V[c][0] - U[r][0]*V[c][1] + U[r][2]*V[c][2];
+        Rb[r][c] = -U[r][1]*V[c][0] + U[r][0]*V[c][1] + U[r][2]*V[c][2];
+      }
+
+    int best = -1, best_front = -1;
+    for (unsigned k=0; k < 4; ++k) {
+      const double (*R)[3] = k < 2 ? Ra : Rb;
+      double sg = k % 2 ? -1 : 1;
+      double t[3] = { sg*u2[0], sg*u2[1], sg*u2[2] };
+      int front = 0;
+      for (unsigned i=0; i < n; ++i) {
+        // l2 x2 = l1 R x1 + t
+        const double *x1 = s.x[0][i], *x2 = s.x[1][i];
+        double Rx[3] = { dot(R[0], x1), dot(R[1], x1), dot(R[2], x1) };
+        double a[3], b[3];
+        cross(x2, Rx, a);
+        cross(x2, t, b);
+        double aa = dot(a, a);
+        if (!(aa > 0))
+          continue;
+        double l1 = -dot(a, b)/aa;
+        double X2[3] = { l1*Rx[0] + t[0], l1*Rx[1] + t[1], l1*Rx[2] + t[2] };
+        if (l1 > 0 && dot(X2, x2) > 0)
+          ++front;
+      }
+      if (front > best_front) {
+        best_front = front;
+        best = k;
+      }
+    }
+
+    sols->resize(1);
+    bdifd_relative_pose &p = (*sols)[0];
+    const double (*R)[3] = best < 2 ? Ra : Rb;
+    double sg = best % 2 ? -1 : 1;
+    for (unsigned r=0; r < 3; ++r) {
+      p.t[0][r] = sg*u2[r];
+      for (unsigned c=0; c < 3; ++c)
+        p.R[0][r][c] = R[r][c];
+    }
+  }
+};
+
+bdifd_minimal_solver *make_oracle2() { return new oracle(2); }
+bdifd_minimal_solver *make_oracle3() { return new oracle(3); }
+bdifd_minimal_solver *make_eight_point() { return new eight_point; }
+
+typedef std::vector<std::pair<std::string, bdifd_minimal_solver::factory> > registry_t;
+
+std::mutex registry_mutex;
+
+registry_t &
+registry()
+{
+  static registry_t r;
+  if (r.empty()) {
+    r.push_back(std::make_pair(std::string("8pt"), &make_eight_point));
+    r.push_back(std::make_pair(std::string("oracle2"), &make_oracle2));
+    r.push_back(std::make_pair(std::string("oracle3"), &make_oracle3));
+  }
+  return r;
+}
+
+}
+
+//---------------------------------------------------------------------------
+
+void bdifd_minimal_solver::
+add(const std::string &name, factory f)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry_t &r = registry();
+  for (unsigned i=0; i < r.size(); ++i)
+    if (r[i].first == name) {
+      r[i].second = f;
+      return;
+    }
+  r.push_back(std::make_pair(name, f));
+}
+
+bdifd_minimal_solver *bdifd_minimal_solver::
+create(const std::string &name)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry_t &r = registry();
+  for (unsigned i=0; i < r.size(); ++i)
+    if (r[i].first == name)
+      return r[i].second();
+  return 0;
+}
+
+std::vector<std::string> bdifd_minimal_solver::
+names()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry_t &r = registry();
+  std::vector<std::string> n;
+  for (unsigned i=0; i < r.size(); ++i)
+    n.push_back(r[i].first);
+  return n;
+}
+
+//---------------------------------------------------------------------------
+
+bdifd_minimal_bench::
+bdifd_minimal_bench(const bdifd_ascii_dataset &d)
+  : d_(d), view_(d.nviews()), tol_deg_(1), batch_(4096)
+{
+  vnl_double_3x3 Kinv = vnl_inverse(d.K);
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c)
+      Kinv_[r][c] = Kinv[r][c];
+
+  // t = -R C
+  for (unsigned v=0; v < d.nviews(); ++v)
+    for (unsigned r=0; r < 3; ++r) {
+      view_[v].t[r] = 0;
+      for (unsigned c=0; c < 3; ++c) {
+        view_[v].R[r][c] = d.R[v][r][c];
+        view_[v].t[r] -= d.R[v][r][c]*d.C[v][c];
+      }
+    }
+}
+
+void bdifd_minimal_bench::
+relative(unsigned v1, unsigned v, double R[3][3], double t[3]) const
+{
+  const view &a = view_[v1], &b = view_[v];
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c)
+      R[r][c] = b.R[r][0]*a.R[c][0] + b.R[r][1]*a.R[c][1] + b.R[r][2]*a.R[c][2];
+  for (unsigned r=0; r < 3; ++r)
+    t[r] = b.t[r] - dot(R[r], a.t);
+}
+
+void bdifd_minimal_bench::
+run(const bdifd_minimal_solver &solver, double dpos, double dtheta,
+    unsigned long ntrials, unsigned seed, bdifd_minimal_result *res,
+    unsigned nthreads) const
+{
+  typedef std::chrono::steady_clock clock;
+
+  res->dpos = dpos;
+  res->dtheta = dtheta;
+  res->trials = res->solved = res->success = res->solutions = 0;
+  res->solve_seconds = res->wall_seconds = 0;
+  res->rot_err.clear();
+  res->t_err.clear();
+
+  unsigned nv = solver.nviews(), np = solver.npoints();
+  if (nv < 2 || nv > 3 || !np || np > bdifd_minimal_sample::max_points
+      || d_.nviews() < nv || d_.npts() < np)
+    return;
+
+  unsigned batch = batch_;
+  unsigned nbatches = static_cast<unsigned>((ntrials + batch - 1)/batch);
+  double th_noise = dtheta*vnl_math::pi/180;
+  std::mutex mutex;
+  clock::time_point wall0 = clock::now();
+
+  bdifd_parallel::for_each(nbatches, [&](unsigned b) {
+    vnl_random rng(seed + 1000003ul*b);
+    unsigned n = static_cast<unsigned>(std::min<unsigned long>(batch, ntrials - (unsigned long)b*batch));
+
+    std::vector<bdifd_minimal_sample> smp(n);
+    for (unsigned k=0; k < n; ++k) {
+      bdifd_minimal_sample &s = smp[k];
+      s.nviews = nv;
+      s.npoints = np;
+
+      if (!views_.empty()) {
+        const vnl_vector_fixed<unsigned,3> &w = views_[rng.lrand32(views_.size() - 1)];
+        for (unsigned j=0; j < nv; ++j)
+          s.v[j] = w[j];
+      } else
+        for (unsigned j=0; j < nv; ++j) {
+          bool dup;
+          do {
+            s.v[j] = rng.lrand32(d_.nviews() - 1);
+            dup = false;
+            for (unsigned l=0; l < j; ++l)
+              dup = dup || s.v[l] == s.v[j];
+          } while (dup);
+        }
+
+      for (unsigned i=0; i < np; ++i) {
+        bool dup;
+        do {
+          s.id[i] = rng.lrand32(d_.npts() - 1);
+          dup = false;
+          for (unsigned l=0; l < i; ++l)
+            dup = dup || s.id[l] == s.id[i];
+        } while (dup);
+      }
+
+      for (unsigned j=0; j < nv; ++j) {
+        unsigned v = s.v[j];
+        for (unsigned i=0; i < np; ++i) {
+          unsigned id = s.id[i];
+          double px = d_.x[v][id], py = d_.y[v][id];
+          double th = std::atan2(d_.ty[v][id], d_.tx[v][id]);
+          if (dpos > 0) {
+            px += rng.drand64(-dpos, dpos);
+            py += rng.drand64(-dpos, dpos);
+          }
+          if (th_noise > 0)
+            th += rng.drand64(-th_noise, th_noise);
+          double tx = std::cos(th), ty = std::sin(th);
+
+          double *x = s.x[j][i], *t = s.t[j][i];
+          for (unsigned r=0; r < 3; ++r) {
+            x[r] = Kinv_[r][0]*px + Kinv_[r][1]*py + Kinv_[r][2];
+            t[r] = Kinv_[r][0]*tx + Kinv_[r][1]*ty;
+          }
+          x[0] /= x[2];
+          x[1] /= x[2];
+          x[2] = 1;
+          double tn = std::sqrt(dot(t, t));
+          for (unsigned r=0; r < 3; ++r)
+            t[r] /= tn;
+        }
+      }
+
+      for (unsigned j=1; j < nv; ++j)
+        relative(s.v[0], s.v[j], s.R[j-1], s.T[j-1]);
+    }
+
+    // only the solver is timed
+    std::vector<std::vector<bdifd_relative_pose> > sols(n);
+    clock::time_point t0 = clock::now();
+    for (unsigned k=0; k < n; ++k)
+      solver.solve(smp[k], &sols[k]);
+    double secs = std::chrono::duration<double>(clock::now() - t0).count();
+
+    unsigned long solved = 0, success = 0, nsols = 0;
+    bdifd_err_stats rot_err, t_err;
+    for (unsigned k=0; k < n; ++k) {
+      const bdifd_minimal_sample &s = smp[k];
+      nsols += sols[k].size();
+      if (sols[k].empty())
+        continue;
+      ++solved;
+      double best = -1, best_r = 0, best_t = 0;
+      for (unsigned m=0; m < sols[k].size(); ++m) {
+        const bdifd_relative_pose &p = sols[k][m];
+        double er = 0, et = 0;
+        for (unsigned j=0; j+1 < nv; ++j) {
+          er = std::max(er, rotation_error(p.R[j], s.R[j]));
+          et = std::max(et, direction_error(p.t[j], s.T[j]));
+        }
+        if (best < 0 || std::max(er, et) < best) {
+          best = std::max(er, et);
+          best_r = er;
+          best_t = et;
+        }
+      }
+      unsigned id = b*batch + k;
+      rot_err.add(best_r, id);
+      t_err.add(best_t, id);
+      if (best_r <= tol_deg_ && best_t <= tol_deg_)
+        ++success;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    res->trials += n;
+    res->solved += solved;
+    res->success += success;
+    res->solutions += nsols;
+    res->solve_seconds += secs;
+    res->rot_err.merge(rot_err);
+    res->t_err.merge(t_err);
+  }, nthreads);
+
+  res->wall_seconds = std::chrono::duration<double>(clock::now() - wall0).count();
+}
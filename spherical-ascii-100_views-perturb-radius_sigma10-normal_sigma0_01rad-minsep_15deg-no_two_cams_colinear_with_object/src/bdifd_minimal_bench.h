@@ -0,0 +1,130 @@
+// This is bdifd_minimal_bench.h
+#ifndef bdifd_minimal_bench_h
+#define bdifd_minimal_bench_h
+//:
+//\file
+//\brief Harness for minimal relative pose solvers on dataset correspondences
+//\date Sun Oct 18 2026
+//
+// Draws minimal sets from a dataset -- npoints() samples seen in a view pair
+// or, for solvers that use tangents, a view triplet -- perturbs them as in
+// the published noise ladder (uniform position noise in (-dpos, dpos) pixels,
+// uniform tangent noise in (-dtheta, dtheta) degrees), hands them to a solver
+// and scores the returned poses against the .extrinsic files.
+//
+// Samples are given to solvers in normalized camera coordinates: x = K^{-1}
+// [x;1] and t the unit K^{-1} [t;0]. Solutions are the poses of views 2 (and
+// 3) relative to view 1, R_v = R_vw R_1w^T and t_v = t_vw - R_v t_1w, with t
+// compared in direction only. Among several solutions the one closest to the
+// ground truth is scored, as is usual for minimal solvers.
+//
+// Solvers derive from bdifd_minimal_solver and are registered by name with
+// add(), so a solver built elsewhere is benchmarked by linking it in. The
+// tree itself provides "8pt" (linear eight-point essential matrix, a
+// non-minimal reference) and "oracle2"/"oracle3", which return the ground
+// truth and so measure the harness overhead.
+//
+// Trials are split into batches; each batch is sampled, solved and scored by
+// one thread with its own random generator, seeded from the batch number so
+// results do not depend on the thread count. Only the solve loop of each
+// batch is timed for solves/s.
+//
+
+#include <string>
+#include <vector>
+#include <vnl/vnl_vector_fixed.h>
+#include "bdifd_err_stats.h"
+
+class bdifd_ascii_dataset;
+
+struct bdifd_minimal_sample {
+  static const unsigned max_points = 8;
+
+  unsigned nviews;
+  unsigned npoints;
+  unsigned v[3];                      //:< views
+  unsigned id[max_points];            //:< sample ids
+  double x[3][max_points][3];         //:< K^{-1} [x;1]
+  double t[3][max_points][3];         //:< unit K^{-1} [t;0]
+
+  // ground truth, views 2 and 3 relative to view 1
+  double R[2][3][3];
+  double T[2][3];
+};
+
+//: Poses of views 2 and 3 relative to view 1.
+struct bdifd_relative_pose {
+  double R[2][3][3];
+  double t[2][3];
+};
+
+class bdifd_minimal_solver {
+public:
+  typedef bdifd_minimal_solver *(*factory)();
+
+  virtual ~bdifd_minimal_solver() {}
+
+  virtual std::string name() const = 0;
+  virtual unsigned nviews() const = 0;
+  virtual unsigned npoints() const = 0;
+  virtual bool uses_tangents() const { return false; }
+
+  //: Appends the solutions for \p s to \p sols (cleared first).
+  virtual void solve(const bdifd_minimal_sample &s, std::vector<bdifd_relative_pose> *sols) const = 0;
+
+  //: Makes solver \p name available to create().
+  static void add(const std::string &name, factory f);
+
+  //: Solver called \p name, or 0; the caller owns it.
+  static bdifd_minimal_solver *create(const std::string &name);
+
+  static std::vector<std::string> names();
+};
+
+//: Results of one noise level.
+struct bdifd_minimal_result {
+  double dpos, dtheta;
+  unsigned long trials;
+  unsigned long solved;       //:< at least one solution returned
+  unsigned long success;      //:< best solution within tolerance
+  unsigned long solutions;    //:< total returned
+  double solve_seconds;       //:< summed over threads
+  double wall_seconds;
+  bdifd_err_stats rot_err;    //:< degrees, best solution
+  bdifd_err_stats t_err;      //:< degrees between directions, best solution
+};
+
+class bdifd_minimal_bench {
+public:
+  //: \p d must have its 2D samples read.
+  explicit bdifd_minimal_bench(const bdifd_ascii_dataset &d);
+
+  //: View tuples to draw from; by default all pairs or triplets.
+  void set_views(const std::vector<vnl_vector_fixed<unsigned,3> > &v) { views_ = v; }
+
+  //: Success tolerance on both rotation and translation errors, degrees.
+  void set_tolerance(double deg) { tol_deg_ = deg; }
+
+  void set_batch(unsigned b) { batch_ = b ? b : 1; }
+
+  //: Runs \p ntrials trials of \p solver at noise level (\p dpos, \p dtheta).
+  void run(const bdifd_minimal_solver &solver, double dpos, double dtheta,
+      unsigned long ntrials, unsigned seed, bdifd_minimal_result *r,
+      unsigned nthreads=0) const;
+
+private:
+  struct view {
+    double R[3][3], t[3];
+  };
+
+  void relative(unsigned v1, unsigned v, double R[3][3], double t[3]) const;
+
+  const bdifd_ascii_dataset &d_;
+  double Kinv_[3][3];
+  std::vector<view> view_;
+  std::vector<vnl_vector_fixed<unsigned,3> > views_;
+  double tol_deg_;
+  unsigned batch_;
+};
+
+#endif // bdifd_minimal_bench_h
@@ -0,0 +1,130 @@
+#include "bdifd_morton.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include "bdifd_ascii_dataset.h"
+
+namespace {
+
+const char magic[8] = {'b','d','i','f','d','i','d','1'};
+
+//: Spreads the bits of \p v to the even bits of the result.
+inline uint64_t
+spread(uint32_t v)
+{
+  uint64_t x = v;
+  x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+  x = (x | (x << 8))  & 0x00FF00FF00FF00FFull;
+  x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0Full;
+  x = (x | (x << 2))  & 0x3333333333333333ull;
+  x = (x | (x << 1))  & 0x5555555555555555ull;
+  return x;
+}
+
+//: Cell index of \p v from \p lo, clamped to 32 bits.
+inline uint32_t
+cell_index(double v, double lo, double cell)
+{
+  double c = std::floor((v - lo)/cell);
+  if (!(c > 0))
+    return 0;
+  return c < 4294967295.0 ? static_cast<uint32_t>(c) : 0xFFFFFFFFu;
+}
+
+} // namespace
+
+uint64_t bdifd_morton::
+code(uint32_t x, uint32_t y)
+{
+  return spread(x) | (spread(y) << 1);
+}
+
+void bdifd_morton::
+order(const std::vector<double> &x, const std::vector<double> &y,
+    std::vector<unsigned> *ids, double cell)
+{
+  unsigned n = x.size();
+  ids->resize(n);
+  if (!n)
+    return;
+  if (!(cell > 0))
+    cell = 1;
+
+  double xmin = x[0], ymin = y[0];
+  for (unsigned i=1; i < n; ++i) {
+    xmin = std::min(xmin, x[i]);
+    ymin = std::min(ymin, y[i]);
+  }
+  // from the image origin, so that aligned image tiles are Z-order blocks,
+  // unless samples fall left of or above it
+  xmin = std::min(0.0, std::floor(xmin/cell)*cell);
+  ymin = std::min(0.0, std::floor(ymin/cell)*cell);
+
+  std::vector<std::pair<uint64_t, unsigned> > keys(n);
+  for (unsigned i=0; i < n; ++i)
+    keys[i] = std::make_pair(code(cell_index(x[i], xmin, cell), cell_index(y[i], ymin, cell)), i);
+  std::sort(keys.begin(), keys.end());
+  for (unsigned l=0; l < n; ++l)
+    (*ids)[l] = keys[l].second;
+}
+
+void bdifd_morton::
+inverse(const std::vector<unsigned> &ids, std::vector<unsigned> *pos)
+{
+  pos->resize(ids.size());
+  for (unsigned l=0; l < ids.size(); ++l)
+    (*pos)[ids[l]] = l;
+}
+
+std::string bdifd_morton::
+ids_name(const std::string &dir, unsigned v)
+{
+  return dir + "/" + bdifd_ascii_dataset::view_name(v) + "-ids.bin";
+}
+
+bool bdifd_morton::
+write_ids(const std::string &fname, const std::vector<unsigned> &ids)
+{
+  std::ofstream fp(fname.c_str(), std::ios::out | std::ios::binary);
+  uint32_t n = ids.size();
+  std::vector<uint32_t> v(ids.begin(), ids.end());
+  fp.write(magic, 8);
+  fp.write(reinterpret_cast<const char *>(&n), 4);
+  if (n)
+    fp.write(reinterpret_cast<const char *>(&v[0]), n*sizeof(uint32_t));
+  if (!fp) {
+    std::cerr << "bdifd_morton: error, unable to write file name " << fname << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool bdifd_morton::
+read_ids(const std::string &fname, std::vector<unsigned> *ids)
+{
+  std::ifstream fp(fname.c_str(), std::ios::in | std::ios::binary);
+  char m[8];
+  uint32_t n = 0;
+  bool ok = fp && fp.read(m, 8) && !std::memcmp(m, magic, 8)
+    && fp.read(reinterpret_cast<char *>(&n), 4);
+  std::vector<uint32_t> v(ok ? n : 0);
+  if (ok && n)
+    ok = static_cast<bool>(fp.read(reinterpret_cast<char *>(&v[0]), n*sizeof(uint32_t)));
+
+  // must be a permutation of 0..n-1
+  std::vector<char> seen(v.size(), 0);
+  for (unsigned l=0; ok && l < v.size(); ++l) {
+    ok = v[l] < n && !seen[v[l]];
+    if (ok)
+      seen[v[l]] = 1;
+  }
+  if (!ok) {
+    std::cerr << "bdifd_morton: error, unable to read file name " << fname << std::endl;
+    return false;
+  }
+  ids->assign(v.begin(), v.end());
+  return true;
+}
@@ -0,0 +1,54 @@
+// This is bdifd_morton.h
+#ifndef bdifd_morton_h
+#define bdifd_morton_h
+//:
+//\file
+//\brief Z-order (Morton) layout of the samples of a view
+//\date Sun Oct 18 2026
+//
+// In sample order consecutive lines of frame_NNNN-pts-2D.txt follow the
+// curves, which cross and revisit image regions, so the samples of one image
+// tile are spread over several runs of lines far apart in the file (about
+// three per 32-pixel tile on the published datasets). In Z-order the samples
+// of any aligned 2^j x 2^j block of cells are contiguous: the cell of each
+// sample, counted from the image origin (or from the lowest cell, if samples
+// fall left of or above it), is mapped to the interleaving of the bits of its
+// column and row, and samples are sorted by that code (ties in sample
+// order). With one-pixel cells every aligned 2^j-pixel image tile is one run.
+//
+// A view written in Z-order (generate_synth_sequence_3 -zorder) comes with
+// frame_NNNN-ids.bin, the sample id of every line: the 8 bytes "bdifdid1",
+// the count as uint32, then one native-endian uint32 per line. Line l of
+// every file of the view is sample ids[l], i.e. line ids[l] of crv-3D-pts.txt
+// and of the other views in sample order, so the README's line-number
+// correspondence still holds through one lookup; the inverse (inverse())
+// gives the line of a sample in O(1) as well.
+//
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class bdifd_morton {
+public:
+  //: Interleaves the bits of \p x (even) and \p y (odd).
+  static uint64_t code(uint32_t x, uint32_t y);
+
+  //: Sample ids of points (\p x[i], \p y[i]) in Z-order of their \p cell
+  // pixel cells.
+  static void order(const std::vector<double> &x, const std::vector<double> &y,
+      std::vector<unsigned> *ids, double cell=1);
+
+  //: pos[ids[l]] = l.
+  static void inverse(const std::vector<unsigned> &ids, std::vector<unsigned> *pos);
+
+  //: frame_NNNN-ids.bin of view \p v in \p dir.
+  static std::string ids_name(const std::string &dir, unsigned v);
+
+  //: Write / read an ids file. Print the file name to std::cerr and return
+  // false on error; read_ids also fails if \p ids is not a permutation.
+  static bool write_ids(const std::string &fname, const std::vector<unsigned> &ids);
+  static bool read_ids(const std::string &fname, std::vector<unsigned> *ids);
+};
+
+#endif // bdifd_morton_h
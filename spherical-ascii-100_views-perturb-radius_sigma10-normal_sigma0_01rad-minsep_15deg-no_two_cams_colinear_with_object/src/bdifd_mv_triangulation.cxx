@@ -0,0 +1,276 @@
+#include "bdifd_mv_triangulation.h"
+#include "bdifd_parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include <vnl/vnl_inverse.h>
+
+bdifd_mv_triangulation::
+bdifd_mv_triangulation(const std::vector<bdifd_camera> &cam)
+{
+  std::vector<vpgl_perspective_camera<double> > P(cam.size());
+  for (unsigned v=0; v < cam.size(); ++v)
+    P[v] = cam[v].Pr_;
+  set(P);
+}
+
+bdifd_mv_triangulation::
+bdifd_mv_triangulation(const std::vector<vpgl_perspective_camera<double> > &cam)
+{
+  set(cam);
+}
+
+void bdifd_mv_triangulation::
+set(const std::vector<vpgl_perspective_camera<double> > &cam)
+{
+  view_.resize(cam.size());
+  for (unsigned v=0; v < cam.size(); ++v) {
+    view &w = view_[v];
+    vgl_point_3d<double> c = cam[v].get_camera_center();
+    w.c[0] = c.x(); w.c[1] = c.y(); w.c[2] = c.z();
+
+    vnl_double_3x3 M = cam[v].get_rotation().as_matrix().transpose()
+      * vnl_inverse(cam[v].get_calibration().get_matrix());
+    const vnl_double_3x4 &P = cam[v].get_matrix();
+    for (unsigned r=0; r < 3; ++r) {
+      for (unsigned s=0; s < 3; ++s)
+        w.M[r][s] = M[r][s];
+      for (unsigned s=0; s < 4; ++s)
+        w.P[r][s] = P[r][s];
+    }
+  }
+}
+
+static inline double dot3(const double *a, const double *b)
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static inline void cross3(const double *a, const double *b, double *c)
+{
+  c[0] = a[1]*b[2] - a[2]*b[1];
+  c[1] = a[2]*b[0] - a[0]*b[2];
+  c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static inline void normalize3(double *a)
+{
+  double n = std::sqrt(dot3(a,a));
+  if (n > 0) {
+    a[0] /= n; a[1] /= n; a[2] /= n;
+  }
+}
+
+//: Eigenvalues e[0] >= e[1] >= e[2] of the symmetric 3x3 matrix \p A, in
+// closed form (Smith, CACM 1961).
+static void
+sym3_eigenvalues(const double A[3][3], double e[3])
+{
+  double p1 = A[0][1]*A[0][1] + A[0][2]*A[0][2] + A[1][2]*A[1][2];
+  double q = (A[0][0] + A[1][1] + A[2][2])/3;
+  double d0 = A[0][0] - q, d1 = A[1][1] - q, d2 = A[2][2] - q;
+  double p = std::sqrt((d0*d0 + d1*d1 + d2*d2 + 2*p1)/6);
+  if (p == 0) {
+    e[0] = e[1] = e[2] = q;
+    return;
+  }
+  double B[3][3] = {
+    {d0/p, A[0][1]/p, A[0][2]/p},
+    {A[1][0]/p, d1/p, A[1][2]/p},
+    {A[2][0]/p, A[2][1]/p, d2/p}};
+  double r = (B[0][0]*(B[1][1]*B[2][2] - B[1][2]*B[2][1])
+            - B[0][1]*(B[1][0]*B[2][2] - B[1][2]*B[2][0])
+            + B[0][2]*(B[1][0]*B[2][1] - B[1][1]*B[2][0]))/2;
+  r = std::max(-1.0, std::min(1.0, r));
+  double phi = std::acos(r)/3;
+  e[0] = q + 2*p*std::cos(phi);
+  e[2] = q + 2*p*std::cos(phi + 2*vnl_math::pi/3);
+  e[1] = 3*q - e[0] - e[2];
+}
+
+//: Unit eigenvector of \p A for the simple eigenvalue \p e: the largest cross
+// product of two rows of A - e I. Returns false if e is not simple.
+static bool
+sym3_eigenvector(const double A[3][3], double e, double u[3])
+{
+  double R[3][3];
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned s=0; s < 3; ++s)
+      R[r][s] = A[r][s] - (r == s ? e : 0);
+
+  double c[3][3];
+  cross3(R[0], R[1], c[0]);
+  cross3(R[0], R[2], c[1]);
+  cross3(R[1], R[2], c[2]);
+
+  unsigned best = 0;
+  double nbest = dot3(c[0],c[0]);
+  for (unsigned k=1; k < 3; ++k) {
+    double n = dot3(c[k],c[k]);
+    if (n > nbest) {
+      nbest = n;
+      best = k;
+    }
+  }
+  if (nbest == 0)
+    return false;
+  double inv = 1/std::sqrt(nbest);
+  for (unsigned r=0; r < 3; ++r)
+    u[r] = c[best][r]*inv;
+  return true;
+}
+
+void bdifd_mv_triangulation::
+solve(
+    const std::vector<std::vector<bdifd_3rd_order_point_2d> > &x,
+    const unsigned *views,
+    unsigned nv,
+    unsigned i,
+    bdifd_mv_point *P) const
+{
+  static const double eps = 1e-12;
+
+  P->nviews = nv;
+  P->valid = P->valid_t = false;
+  P->reproj_rms = P->reproj_max = P->t_residual = 0;
+  P->pos_cond = P->t_cond = 0;
+  P->Gama.fill(0);
+  P->T.fill(0);
+  if (nv < 2)
+    return;
+
+  // Normal equations: A Gama = b for position, S T = 0 for the tangent.
+  double A[3][3] = {{0,0,0},{0,0,0},{0,0,0}}, b[3] = {0,0,0};
+  double S[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
+  double t_ref[3] = {0,0,0}, g_ref[3] = {0,0,0};
+
+  for (unsigned l=0; l < nv; ++l) {
+    const view &w = view_[views[l]];
+    const bdifd_3rd_order_point_2d &p = x[views[l]][i];
+
+    double g[3], t[3];
+    for (unsigned r=0; r < 3; ++r) {
+      g[r] = w.M[r][0]*p.gama[0] + w.M[r][1]*p.gama[1] + w.M[r][2];
+      t[r] = w.M[r][0]*p.t[0] + w.M[r][1]*p.t[1];
+    }
+    if (l == 0)
+      for (unsigned r=0; r < 3; ++r) {
+        g_ref[r] = g[r];
+        t_ref[r] = t[r];
+      }
+
+    double d[3] = {g[0], g[1], g[2]};
+    normalize3(d);
+    double dc = dot3(d, w.c);
+    for (unsigned r=0; r < 3; ++r) {
+      for (unsigned s=0; s < 3; ++s)
+        A[r][s] -= d[r]*d[s];
+      A[r][r] += 1;
+      b[r] += w.c[r] - d[r]*dc;
+    }
+
+    double m[3];
+    cross3(g, t, m);
+    normalize3(m);
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned s=0; s < 3; ++s)
+        S[r][s] += m[r]*m[s];
+  }
+
+  double e[3];
+  sym3_eigenvalues(A, e);
+  P->pos_cond = e[2] > 0 ? e[0]/e[2] : HUGE_VAL;
+  if (e[2] > eps*e[0]) {
+    vnl_double_3x3 Am;
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned s=0; s < 3; ++s)
+        Am[r][s] = A[r][s];
+    P->Gama = vnl_inverse(Am)*bdifd_vector_3d(b[0], b[1], b[2]);
+    P->valid = true;
+
+    double ss = 0, emax = 0;
+    for (unsigned l=0; l < nv; ++l) {
+      const view &w = view_[views[l]];
+      const bdifd_3rd_order_point_2d &p = x[views[l]][i];
+      double h[3];
+      for (unsigned r=0; r < 3; ++r)
+        h[r] = w.P[r][0]*P->Gama[0] + w.P[r][1]*P->Gama[1] + w.P[r][2]*P->Gama[2] + w.P[r][3];
+      double dx = h[0]/h[2] - p.gama[0], dy = h[1]/h[2] - p.gama[1];
+      double e2 = dx*dx + dy*dy;
+      ss += e2;
+      emax = std::max(emax, e2);
+    }
+    P->reproj_rms = std::sqrt(ss/nv);
+    P->reproj_max = std::sqrt(emax);
+  }
+
+  sym3_eigenvalues(S, e);
+  P->t_cond = e[1] > 0 ? e[0]/e[1] : HUGE_VAL;
+  double T[3];
+  if (e[1] > eps*e[0] && sym3_eigenvector(S, e[2], T)) {
+    // Orient T along the first view's image tangent, comparing within the
+    // tangent plane of that view, away from the ray: (g x T) x g.
+    double u[3];
+    cross3(g_ref, T, u);
+    double v[3];
+    cross3(u, g_ref, v);
+    if (dot3(v, t_ref) < 0)
+      for (unsigned r=0; r < 3; ++r)
+        T[r] = -T[r];
+    P->T = bdifd_vector_3d(T[0], T[1], T[2]);
+    P->t_residual = std::sqrt(std::max(0.0, e[2])/nv);
+    P->valid_t = true;
+  }
+}
+
+void bdifd_mv_triangulation::
+triangulate(
+    const std::vector<std::vector<bdifd_3rd_order_point_2d> > &x,
+    const std::vector<unsigned> &views,
+    unsigned i,
+    bdifd_mv_point *P) const
+{
+  for (unsigned l=0; l < views.size(); ++l)
+    assert(views[l] < view_.size() && i < x[views[l]].size());
+  solve(x, views.empty() ? 0 : &views[0], views.size(), i, P);
+}
+
+void bdifd_mv_triangulation::
+triangulate(
+    const std::vector<std::vector<bdifd_3rd_order_point_2d> > &x,
+    unsigned i,
+    bdifd_mv_point *P) const
+{
+  assert(x.size() == view_.size());
+  std::vector<unsigned> views;
+  views.reserve(x.size());
+  for (unsigned v=0; v < x.size(); ++v)
+    if (x[v][i].valid)
+      views.push_back(v);
+  solve(x, views.empty() ? 0 : &views[0], views.size(), i, P);
+}
+
+void bdifd_mv_triangulation::
+triangulate(
+    const std::vector<std::vector<bdifd_3rd_order_point_2d> > &x,
+    std::vector<bdifd_mv_point> *X,
+    unsigned nthreads) const
+{
+  assert(x.size() == view_.size());
+  const unsigned npts = x.empty() ? 0 : x[0].size();
+  for (unsigned v=0; v < x.size(); ++v)
+    assert(x[v].size() == npts);
+  X->resize(npts);
+
+  bdifd_parallel::for_blocks(npts, 512, [&](unsigned begin, unsigned end) {
+    std::vector<unsigned> views;
+    views.reserve(x.size());
+    for (unsigned i=begin; i < end; ++i) {
+      views.clear();
+      for (unsigned v=0; v < x.size(); ++v)
+        if (x[v][i].valid)
+          views.push_back(v);
+      solve(x, views.empty() ? 0 : &views[0], views.size(), i, &(*X)[i]);
+    }
+  }, nthreads);
+}
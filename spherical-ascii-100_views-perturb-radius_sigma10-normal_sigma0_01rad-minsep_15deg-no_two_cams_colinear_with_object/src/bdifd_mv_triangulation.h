@@ -0,0 +1,89 @@
+// This is bdifd_mv_triangulation.h
+#ifndef bdifd_mv_triangulation_h
+#define bdifd_mv_triangulation_h
+//:
+//\file
+//\brief Least-squares triangulation of points and tangents from N views
+//\date Sun Oct 18 2026
+//
+// Generalizes the two-view bdifd_rig::reconstruct_1st_order to every view in
+// which a sample is visible:
+//
+//   Gama   minimizes the sum of squared distances to the viewing rays,
+//          i.e. solves sum_v (I - d_v d_v^T) (Gama - c_v) = 0
+//   T      unit vector closest to all the planes spanned by each viewing
+//          ray and its image tangent: the eigenvector of the smallest
+//          eigenvalue of sum_v m_v m_v^T, with m_v the unit plane normals
+//
+// Both normal matrices are 3x3 and symmetric, so their eigenvalues also give
+// the conditioning of each estimate at no extra cost. The cameras are
+// reduced once to centers and R^T K^{-1} (pixel to world direction), shared
+// by all points.
+//
+
+#include <vector>
+#include <bdifd/bdifd_camera.h>
+
+//: Triangulated sample with its quality measures.
+struct bdifd_mv_point {
+  bdifd_vector_3d Gama;
+  bdifd_vector_3d T;
+
+  unsigned nviews;      //:< number of views used
+  double reproj_rms;    //:< RMS reprojection error of Gama, pixels
+  double reproj_max;    //:< worst reprojection error of Gama, pixels
+  double t_residual;    //:< RMS sine of the angle between T and the tangent planes
+  double pos_cond;      //:< condition number of the position normal equations
+  double t_cond;        //:< largest over second smallest eigenvalue for T
+  bool valid;           //:< Gama is determined (>= 2 views, non-parallel rays)
+  bool valid_t;         //:< T is determined (tangent planes not all coaxial)
+};
+
+class bdifd_mv_triangulation {
+public:
+  explicit bdifd_mv_triangulation(const std::vector<bdifd_camera> &cam);
+  explicit bdifd_mv_triangulation(const std::vector<vpgl_perspective_camera<double> > &cam);
+
+  unsigned nviews() const { return view_.size(); }
+
+  //: Triangulates sample \p i of \p x, where x[v][i] is its image in view v,
+  // from the views in which it is valid.
+  void triangulate(
+      const std::vector<std::vector<bdifd_3rd_order_point_2d> > &x,
+      unsigned i,
+      bdifd_mv_point *P) const;
+
+  //: Triangulates sample \p i from a given subset of views.
+  void triangulate(
+      const std::vector<std::vector<bdifd_3rd_order_point_2d> > &x,
+      const std::vector<unsigned> &views,
+      unsigned i,
+      bdifd_mv_point *P) const;
+
+  //: Triangulates every sample of \p x, spreading points over \p nthreads
+  // threads (0 = one per core).
+  void triangulate(
+      const std::vector<std::vector<bdifd_3rd_order_point_2d> > &x,
+      std::vector<bdifd_mv_point> *X,
+      unsigned nthreads=0) const;
+
+private:
+  //: Normalized camera: center, R^T K^{-1} and the projection matrix.
+  struct view {
+    double c[3];
+    double M[3][3];
+    double P[3][4];
+  };
+
+  void set(const std::vector<vpgl_perspective_camera<double> > &cam);
+  void solve(
+      const std::vector<std::vector<bdifd_3rd_order_point_2d> > &x,
+      const unsigned *views,
+      unsigned nv,
+      unsigned i,
+      bdifd_mv_point *P) const;
+
+  std::vector<view> view_;
+};
+
+#endif // bdifd_mv_triangulation_h
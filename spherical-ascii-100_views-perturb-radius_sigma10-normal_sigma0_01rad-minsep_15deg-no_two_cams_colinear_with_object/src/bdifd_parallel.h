@@ -0,0 +1,70 @@
+// This is bdifd_parallel.h
+#ifndef bdifd_parallel_h
+#define bdifd_parallel_h
+//:
+//\file
+//\brief Small thread helpers used to spread dataset work over cores
+//\date Sun Oct 18 2026
+//
+// Work items are handed out through an atomic counter, so items of uneven
+// cost (e.g. view triplets with different numbers of valid points) balance
+// out without any tuning. The callable is invoked concurrently and must only
+// write to storage owned by the item it was given.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class bdifd_parallel {
+public:
+  //: Number of threads to use; \p requested == 0 means one per core.
+  static unsigned
+  num_threads(unsigned requested=0)
+  {
+    if (requested)
+      return requested;
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+  }
+
+  //: Calls f(i) for every i in [0,n), from up to \p nthreads threads.
+  template <class F> static void
+  for_each(unsigned n, const F &f, unsigned nthreads=0)
+  {
+    nthreads = std::min(num_threads(nthreads), n);
+    if (nthreads <= 1) {
+      for (unsigned i=0; i < n; ++i)
+        f(i);
+      return;
+    }
+
+    std::atomic<unsigned> next(0);
+    std::vector<std::thread> pool;
+    pool.reserve(nthreads);
+    for (unsigned t=0; t < nthreads; ++t)
+      pool.push_back(std::thread([&]() {
+        for (unsigned i = next++; i < n; i = next++)
+          f(i);
+      }));
+    for (unsigned t=0; t < nthreads; ++t)
+      pool[t].join();
+  }
+
+  //: Splits [0,n) into contiguous blocks of at most \p block items and calls
+  // f(begin, end) on each block, from up to \p nthreads threads.
+  template <class F> static void
+  for_blocks(unsigned n, unsigned block, const F &f, unsigned nthreads=0)
+  {
+    if (!block)
+      block = 1;
+    unsigned nblocks = (n + block - 1)/block;
+    for_each(nblocks, [&](unsigned b) {
+      unsigned begin = b*block;
+      f(begin, std::min(begin + block, n));
+    }, nthreads);
+  }
+};
+
+#endif // bdifd_parallel_h
@@ -0,0 +1,108 @@
+#include "bdifd_query_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// keeps the grid of a view with a few far-off samples small
+const unsigned max_cells_per_axis = 1024;
+
+unsigned
+clamp_cell(double c, unsigned n)
+{
+  if (!(c > 0))
+    return 0;
+  return c >= n ? n - 1 : static_cast<unsigned>(c);
+}
+
+} // namespace
+
+bdifd_query_index::
+bdifd_query_index(const bdifd_ascii_dataset &ds, double cell)
+  : nviews_(ds.x.size()), npts_(ds.npts()), cell_(cell > 0 ? cell : 32),
+  xmin_(std::numeric_limits<double>::max()), ymin_(std::numeric_limits<double>::max()),
+  xmax_(-std::numeric_limits<double>::max()), ymax_(-std::numeric_limits<double>::max())
+{
+  grids_.resize(nviews_);
+  tracks_.resize(std::size_t(npts_)*nviews_);
+  for (unsigned v=0; v < nviews_; ++v) {
+    const std::vector<double> &x = ds.x[v], &y = ds.y[v];
+    grid &g = grids_[v];
+    double gx0 = std::numeric_limits<double>::max(), gy0 = gx0;
+    double gx1 = -gx0, gy1 = -gx0;
+    for (unsigned i=0; i < npts_; ++i) {
+      gx0 = std::min(gx0, x[i]); gx1 = std::max(gx1, x[i]);
+      gy0 = std::min(gy0, y[i]); gy1 = std::max(gy1, y[i]);
+    }
+    if (!npts_)
+      gx0 = gy0 = gx1 = gy1 = 0;
+    xmin_ = std::min(xmin_, gx0); xmax_ = std::max(xmax_, gx1);
+    ymin_ = std::min(ymin_, gy0); ymax_ = std::max(ymax_, gy1);
+
+    g.x0 = gx0;
+    g.y0 = gy0;
+    g.nx = std::min(max_cells_per_axis, static_cast<unsigned>((gx1 - gx0)/cell_) + 1);
+    g.ny = std::min(max_cells_per_axis, static_cast<unsigned>((gy1 - gy0)/cell_) + 1);
+
+    // counting sort of the samples by cell
+    std::vector<unsigned> cell_of(npts_);
+    g.start.assign(g.nx*g.ny + 1, 0);
+    for (unsigned i=0; i < npts_; ++i) {
+      unsigned c = clamp_cell((y[i] - g.y0)/cell_, g.ny)*g.nx + clamp_cell((x[i] - g.x0)/cell_, g.nx);
+      cell_of[i] = c;
+      ++g.start[c + 1];
+    }
+    for (unsigned c=0; c < g.nx*g.ny; ++c)
+      g.start[c + 1] += g.start[c];
+    std::vector<unsigned> fill(g.start.begin(), g.start.end() - 1);
+    g.rec.resize(npts_);
+    for (unsigned i=0; i < npts_; ++i) {
+      bdifd_query_record r;
+      r.point = i;
+      r.view = v;
+      r.x = x[i];
+      r.y = y[i];
+      r.tx = ds.tx[v][i];
+      r.ty = ds.ty[v][i];
+      g.rec[fill[cell_of[i]]++] = r;
+      tracks_[std::size_t(i)*nviews_ + v] = r;
+    }
+  }
+  if (!nviews_)
+    xmin_ = ymin_ = xmax_ = ymax_ = 0;
+}
+
+bool bdifd_query_index::
+box(unsigned v, double xmin, double ymin, double xmax, double ymax,
+    std::vector<bdifd_query_record> *out) const
+{
+  if (v >= nviews_)
+    return false;
+  const grid &g = grids_[v];
+  if (g.rec.empty() || !(xmin <= xmax && ymin <= ymax))
+    return true;
+  unsigned cx0 = clamp_cell((xmin - g.x0)/cell_, g.nx), cx1 = clamp_cell((xmax - g.x0)/cell_, g.nx);
+  unsigned cy0 = clamp_cell((ymin - g.y0)/cell_, g.ny), cy1 = clamp_cell((ymax - g.y0)/cell_, g.ny);
+  for (unsigned cy=cy0; cy <= cy1; ++cy) {
+    // cells of the row are contiguous: one run from cx0 to cx1
+    const bdifd_query_record *r = &g.rec[0] + g.start[cy*g.nx + cx0];
+    const bdifd_query_record *end = &g.rec[0] + g.start[cy*g.nx + cx1 + 1];
+    for (; r != end; ++r)
+      if (r->x >= xmin && r->x <= xmax && r->y >= ymin && r->y <= ymax)
+        out->push_back(*r);
+  }
+  return true;
+}
+
+bool bdifd_query_index::
+observations(unsigned i, std::vector<bdifd_query_record> *out) const
+{
+  if (i >= npts_)
+    return false;
+  if (!nviews_)
+    return true;
+  const bdifd_query_record *r = &tracks_[0] + std::size_t(i)*nviews_;
+  out->insert(out->end(), r, r + nviews_);
+  return true;
+}
@@ -0,0 +1,76 @@
+// This is bdifd_query_index.h
+#ifndef bdifd_query_index_h
+#define bdifd_query_index_h
+//:
+//\file
+//\brief In-memory index answering view-box and point-track lookups
+//\date Sun Oct 18 2026
+//
+// Built once from a dataset with its image samples. Two queries:
+//
+//  - box(): the samples of view v inside an axis-aligned box. Each view is
+//    bucketed on a uniform grid of cell x cell pixels spanning its samples,
+//    and its records are stored in cell order, so a query scans contiguous
+//    memory for the cells it overlaps, one run per row of cells, and tests
+//    every record of the run against the box. Interior cells are not taken
+//    whole: the outermost cells also hold the samples beyond the grid (past
+//    max_cells_per_axis, or NaN), which only the exact test keeps out.
+//  - observations(): sample i in every view. Records are stored point-major,
+//    nviews consecutive records per point.
+//
+// Both append bdifd_query_record, the unit of the query protocol
+// (bdifd_query_server.h). The index is read-only after construction, so any
+// number of threads may query it.
+//
+
+#include <stdint.h>
+#include <vector>
+#include "bdifd_ascii_dataset.h"
+
+//: One observation: image point and unit tangent of sample \p point in
+// \p view.
+struct bdifd_query_record {
+  uint32_t point;
+  uint32_t view;
+  double x, y, tx, ty;
+};
+
+class bdifd_query_index {
+public:
+  //: Indexes the image samples of \p ds, which must have been read with them.
+  explicit bdifd_query_index(const bdifd_ascii_dataset &ds, double cell=32);
+
+  unsigned nviews() const { return nviews_; }
+  unsigned npts() const { return npts_; }
+
+  //: Bounds of all image samples.
+  double xmin() const { return xmin_; }
+  double ymin() const { return ymin_; }
+  double xmax() const { return xmax_; }
+  double ymax() const { return ymax_; }
+
+  //: Appends the samples of view \p v with xmin <= x <= xmax and
+  // ymin <= y <= ymax, in no particular order. False if \p v is out of range.
+  bool box(unsigned v, double xmin, double ymin, double xmax, double ymax,
+      std::vector<bdifd_query_record> *out) const;
+
+  //: Appends sample \p i in every view, in view order. False if \p i is out
+  // of range.
+  bool observations(unsigned i, std::vector<bdifd_query_record> *out) const;
+
+private:
+  struct grid {
+    double x0, y0;
+    unsigned nx, ny;
+    std::vector<unsigned> start;    //:< nx*ny + 1 offsets into rec
+    std::vector<bdifd_query_record> rec;
+  };
+
+  unsigned nviews_, npts_;
+  double cell_;
+  double xmin_, ymin_, xmax_, ymax_;
+  std::vector<grid> grids_;
+  std::vector<bdifd_query_record> tracks_;
+};
+
+#endif // bdifd_query_index_h
@@ -0,0 +1,443 @@
+#include "bdifd_query_server.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "bdifd_parallel.h"
+
+namespace {
+
+bool
+socket_error(const std::string &what, const std::string &address)
+{
+  std::cerr << "bdifd_query: error, unable to " << what << " " << address
+    << ": " << std::strerror(errno) << std::endl;
+  return false;
+}
+
+//: Socket address of "unix:/path" or "tcp:port".
+bool
+parse_address(const std::string &address, sockaddr_storage *sa, socklen_t *len, bool *is_unix)
+{
+  std::memset(sa, 0, sizeof(*sa));
+  if (address.compare(0, 5, "unix:") == 0) {
+    std::string path = address.substr(5);
+    sockaddr_un *un = reinterpret_cast<sockaddr_un *>(sa);
+    if (path.empty() || path.size() >= sizeof(un->sun_path))
+      return false;
+    un->sun_family = AF_UNIX;
+    std::strcpy(un->sun_path, path.c_str());
+    *len = sizeof(sockaddr_un);
+    *is_unix = true;
+    return true;
+  }
+  if (address.compare(0, 4, "tcp:") == 0) {
+    char *end;
+    long port = std::strtol(address.c_str() + 4, &end, 10);
+    if (*end || port <= 0 || port > 65535)
+      return false;
+    sockaddr_in *in = reinterpret_cast<sockaddr_in *>(sa);
+    in->sin_family = AF_INET;
+    in->sin_port = htons(static_cast<uint16_t>(port));
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    *len = sizeof(sockaddr_in);
+    *is_unix = false;
+    return true;
+  }
+  return false;
+}
+
+void
+set_nodelay(int fd)
+{
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+//: Per-connection buffers of an event loop.
+struct connection {
+  std::string in;
+  std::string out;
+  std::size_t out_sent;
+  uint32_t events;    //:< registered with epoll
+
+  connection() : out_sent(0), events(EPOLLIN) {}
+};
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+// bdifd_query_server
+
+bdifd_query_server::
+bdifd_query_server(const bdifd_query_index &index)
+  : index_(index), listen_fd_(-1), stop_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+  requests_(0), connections_(0)
+{
+}
+
+bdifd_query_server::
+~bdifd_query_server()
+{
+  if (listen_fd_ >= 0)
+    close(listen_fd_);
+  if (stop_fd_ >= 0)
+    close(stop_fd_);
+  if (!unix_path_.empty())
+    unlink(unix_path_.c_str());
+}
+
+bool bdifd_query_server::
+listen(const std::string &address)
+{
+  sockaddr_storage sa;
+  socklen_t len;
+  bool is_unix;
+  if (!parse_address(address, &sa, &len, &is_unix)) {
+    std::cerr << "bdifd_query: error, bad address " << address
+      << " (expected unix:/path or tcp:port)" << std::endl;
+    return false;
+  }
+  int fd = socket(sa.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return socket_error("create a socket for", address);
+  if (is_unix)
+    unlink(reinterpret_cast<sockaddr_un *>(&sa)->sun_path);
+  else {
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  }
+  if (bind(fd, reinterpret_cast<sockaddr *>(&sa), len) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+    socket_error("listen on", address);
+    close(fd);
+    return false;
+  }
+  if (is_unix)
+    unix_path_ = reinterpret_cast<sockaddr_un *>(&sa)->sun_path;
+  listen_fd_ = fd;
+  return true;
+}
+
+void bdifd_query_server::
+stop()
+{
+  uint64_t one = 1;
+  ssize_t r = write(stop_fd_, &one, sizeof(one));
+  (void)r;
+}
+
+void bdifd_query_server::
+run(unsigned nthreads)
+{
+  if (listen_fd_ < 0 || stop_fd_ < 0)
+    return;
+  nthreads = bdifd_parallel::num_threads(nthreads);
+  std::vector<std::thread> pool;
+  for (unsigned t=1; t < nthreads; ++t)
+    pool.push_back(std::thread([this]() { loop(); }));
+  loop();
+  for (unsigned t=0; t < pool.size(); ++t)
+    pool[t].join();
+}
+
+void bdifd_query_server::
+answer(const bdifd_query_request &q, std::vector<bdifd_query_record> *scratch, std::string *out) const
+{
+  scratch->clear();
+  bool ok = true;
+  switch (q.op) {
+    case bdifd_query_request::op_info: {
+      bdifd_query_record r;
+      r.point = index_.npts();
+      r.view = index_.nviews();
+      r.x = index_.xmin();
+      r.y = index_.ymin();
+      r.tx = index_.xmax();
+      r.ty = index_.ymax();
+      scratch->push_back(r);
+      break;
+    }
+    case bdifd_query_request::op_box:
+      ok = index_.box(q.view, q.xmin, q.ymin, q.xmax, q.ymax, scratch);
+      break;
+    case bdifd_query_request::op_point:
+      ok = index_.observations(q.point, scratch);
+      break;
+    default:
+      ok = false;
+  }
+  if (!ok)
+    scratch->clear();
+
+  bdifd_query_response r;
+  r.id = q.id;
+  r.status = ok ? bdifd_query_response::ok : bdifd_query_response::bad_request;
+  r.count = scratch->size();
+  r.reserved = 0;
+  out->append(reinterpret_cast<const char *>(&r), sizeof(r));
+  if (!scratch->empty())
+    out->append(reinterpret_cast<const char *>(&(*scratch)[0]), scratch->size()*sizeof(bdifd_query_record));
+}
+
+void bdifd_query_server::
+loop()
+{
+  int ep = epoll_create1(EPOLL_CLOEXEC);
+  if (ep < 0) {
+    socket_error("create an event loop for", "the server");
+    return;
+  }
+  epoll_event ev;
+  ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+  ev.data.fd = listen_fd_;
+  epoll_ctl(ep, EPOLL_CTL_ADD, listen_fd_, &ev);
+  // never read, so it wakes every loop
+  ev.events = EPOLLIN;
+  ev.data.fd = stop_fd_;
+  epoll_ctl(ep, EPOLL_CTL_ADD, stop_fd_, &ev);
+
+  std::unordered_map<int, connection> conns;
+  std::vector<bdifd_query_record> scratch;
+  std::vector<char> buf(1 << 16);
+  const unsigned max_events = 64;
+  epoll_event events[max_events];
+  bool done = false;
+
+  while (!done) {
+    int n = epoll_wait(ep, events, max_events, -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    for (int e=0; e < n; ++e) {
+      int fd = events[e].data.fd;
+      if (fd == stop_fd_) {
+        done = true;
+        continue;
+      }
+      if (fd == listen_fd_) {
+        for (;;) {
+          int c = accept4(listen_fd_, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+          if (c < 0)
+            break;
+          if (unix_path_.empty())
+            set_nodelay(c);
+          ev.events = EPOLLIN;
+          ev.data.fd = c;
+          epoll_ctl(ep, EPOLL_CTL_ADD, c, &ev);
+          conns[c];
+          connections_.fetch_add(1, std::memory_order_relaxed);
+        }
+        continue;
+      }
+
+      std::unordered_map<int, connection>::iterator it = conns.find(fd);
+      if (it == conns.end())
+        continue;
+      connection &cn = it->second;
+      bool closed = false;
+
+      if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        ssize_t r = recv(fd, &buf[0], buf.size(), 0);
+        if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR))
+          closed = true;
+        else if (r > 0) {
+          cn.in.append(&buf[0], r);
+          // every complete request of the read, answered in one batch
+          std::size_t pos = 0;
+          unsigned long nreq = 0;
+          for (; cn.in.size() - pos >= sizeof(bdifd_query_request); pos += sizeof(bdifd_query_request)) {
+            bdifd_query_request q;
+            std::memcpy(&q, cn.in.data() + pos, sizeof(q));
+            answer(q, &scratch, &cn.out);
+            ++nreq;
+          }
+          cn.in.erase(0, pos);
+          requests_.fetch_add(nreq, std::memory_order_relaxed);
+        }
+      }
+
+      if (!closed && cn.out.size() > cn.out_sent) {
+        ssize_t w = send(fd, cn.out.data() + cn.out_sent, cn.out.size() - cn.out_sent, MSG_NOSIGNAL);
+        if (w < 0 && errno != EAGAIN && errno != EINTR)
+          closed = true;
+        else if (w > 0)
+          cn.out_sent += w;
+      }
+      if (closed) {
+        epoll_ctl(ep, EPOLL_CTL_DEL, fd, 0);
+        close(fd);
+        conns.erase(it);
+        continue;
+      }
+
+      // Keep reading while responses are pending, so that a client writing a
+      // large batch before reading is not stalled; past max_pending its
+      // requests wait in the socket instead of piling up here.
+      std::size_t pending = cn.out.size() - cn.out_sent;
+      if (!pending) {
+        cn.out.clear();
+        cn.out_sent = 0;
+      } else if (cn.out_sent >= max_pending) {
+        cn.out.erase(0, cn.out_sent);
+        cn.out_sent = 0;
+      }
+      uint32_t want = (pending < max_pending ? uint32_t(EPOLLIN) : 0) | (pending ? uint32_t(EPOLLOUT) : 0);
+      if (want != cn.events) {
+        cn.events = want;
+        ev.events = want;
+        ev.data.fd = fd;
+        epoll_ctl(ep, EPOLL_CTL_MOD, fd, &ev);
+      }
+    }
+  }
+
+  for (std::unordered_map<int, connection>::iterator it = conns.begin(); it != conns.end(); ++it)
+    close(it->first);
+  close(ep);
+}
+
+//-----------------------------------------------------------------------------
+// bdifd_query_client
+
+bdifd_query_client::
+~bdifd_query_client()
+{
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool bdifd_query_client::
+connect(const std::string &address)
+{
+  sockaddr_storage sa;
+  socklen_t len;
+  bool is_unix;
+  if (!parse_address(address, &sa, &len, &is_unix)) {
+    std::cerr << "bdifd_query: error, bad address " << address
+      << " (expected unix:/path or tcp:port)" << std::endl;
+    return false;
+  }
+  if (fd_ >= 0)
+    close(fd_);
+  in_.clear();
+  in_pos_ = 0;
+  fd_ = socket(sa.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd_ < 0)
+    return socket_error("create a socket for", address);
+  if (::connect(fd_, reinterpret_cast<sockaddr *>(&sa), len) != 0) {
+    socket_error("connect to", address);
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  if (!is_unix)
+    set_nodelay(fd_);
+  return true;
+}
+
+bool bdifd_query_client::
+send(const bdifd_query_request *q, unsigned n)
+{
+  const char *p = reinterpret_cast<const char *>(q);
+  std::size_t left = std::size_t(n)*sizeof(bdifd_query_request);
+  while (left) {
+    ssize_t w = ::send(fd_, p, left, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (w > 0) {
+      p += w;
+      left -= w;
+      continue;
+    }
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+      return false;
+
+    // The socket is full, and the server may be waiting for us to read:
+    // take in whatever has arrived until we can write again.
+    pollfd pfd;
+    pfd.fd = fd_;
+    pfd.events = POLLIN | POLLOUT;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) && !recv_some(false))
+      return false;
+  }
+  return true;
+}
+
+//: Appends what one recv() returns to in_. Without \p wait, returns true
+// having read nothing if nothing has arrived. False on error or end of stream.
+bool bdifd_query_client::
+recv_some(bool wait)
+{
+  if (in_pos_ == in_.size()) {
+    in_.clear();
+    in_pos_ = 0;
+  } else if (in_pos_ >= (1u << 16)) {
+    in_.erase(0, in_pos_);
+    in_pos_ = 0;
+  }
+  std::size_t old = in_.size();
+  in_.resize(old + (1 << 16));
+  for (;;) {
+    ssize_t r = recv(fd_, &in_[old], 1 << 16, wait ? 0 : MSG_DONTWAIT);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r > 0) {
+      in_.resize(old + r);
+      return true;
+    }
+    in_.resize(old);
+    return r < 0 && !wait && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+}
+
+bool bdifd_query_client::
+read_fully(void *p, std::size_t n)
+{
+  char *dst = static_cast<char *>(p);
+  while (n) {
+    if (in_pos_ == in_.size() && !recv_some(true))
+      return false;
+    std::size_t k = std::min(n, in_.size() - in_pos_);
+    std::memcpy(dst, in_.data() + in_pos_, k);
+    in_pos_ += k;
+    dst += k;
+    n -= k;
+  }
+  return true;
+}
+
+bool bdifd_query_client::
+receive(bdifd_query_response *r, std::vector<bdifd_query_record> *records)
+{
+  if (!read_fully(r, sizeof(*r)))
+    return false;
+  records->resize(r->count);
+  return !r->count || read_fully(&(*records)[0], r->count*sizeof(bdifd_query_record));
+}
+
+bool bdifd_query_client::
+query(const bdifd_query_request &q, bdifd_query_response *r, std::vector<bdifd_query_record> *records)
+{
+  return send(&q, 1) && receive(r, records);
+}
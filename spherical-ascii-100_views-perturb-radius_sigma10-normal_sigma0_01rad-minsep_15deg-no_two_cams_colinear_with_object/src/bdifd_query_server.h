@@ -0,0 +1,134 @@
+// This is bdifd_query_server.h
+#ifndef bdifd_query_server_h
+#define bdifd_query_server_h
+//:
+//\file
+//\brief Binary query protocol over a local socket, its server and a client
+//\date Sun Oct 18 2026
+//
+// Serves a bdifd_query_index to other processes of the node, over a Unix
+// domain socket ("unix:/path") or loopback TCP ("tcp:port", bound to
+// 127.0.0.1).
+//
+// The protocol is fixed-size native-endian structs, so both ends must run on
+// the same kind of machine. A client writes any number of
+// bdifd_query_request back to back; the server answers each, in order, with a
+// bdifd_query_response followed by response.count bdifd_query_record. Clients
+// are expected to pipeline: all complete requests found in a read are
+// answered, and their responses sent, in a single write. The server keeps
+// reading while responses wait to be sent, up to max_pending bytes of them
+// per connection; past that it reads again once the client has taken some.
+// bdifd_query_client::send() takes in responses while its own writes would
+// block, so a batch of any size goes through.
+//
+//  - op_info: one record with point = npts, view = nviews and the bounds of
+//    the image samples as x = xmin, y = ymin, tx = xmax, ty = ymax.
+//  - op_box: the samples of request.view inside [xmin,xmax] x [ymin,ymax].
+//  - op_point: request.point in every view.
+//
+// The server runs one event loop (epoll) per thread. The listening socket is
+// in every loop with EPOLLEXCLUSIVE, so each connection is accepted by and
+// stays on one thread; with one thread per core and a connection per client
+// thread, requests never wait on a lock.
+//
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "bdifd_query_index.h"
+
+struct bdifd_query_request {
+  enum { op_info = 0, op_box = 1, op_point = 2 };
+
+  uint32_t op;
+  uint32_t id;        //:< echoed in the response
+  uint32_t view;
+  uint32_t point;
+  double xmin, ymin, xmax, ymax;
+};
+
+struct bdifd_query_response {
+  enum { ok = 0, bad_request = 1 };
+
+  uint32_t id;
+  uint32_t status;
+  uint32_t count;     //:< records that follow
+  uint32_t reserved;
+};
+
+class bdifd_query_server {
+public:
+  //: Unsent response bytes per connection above which requests are not read.
+  static const std::size_t max_pending = 4u << 20;
+
+  //: Serves \p index, which must outlive the server.
+  explicit bdifd_query_server(const bdifd_query_index &index);
+  ~bdifd_query_server();
+
+  //: Binds and listens on \p address ("unix:/path" or "tcp:port"). A stale
+  // Unix socket file is replaced. Prints the reason to std::cerr and returns
+  // false on error.
+  bool listen(const std::string &address);
+
+  //: Serves with \p nthreads event loops (0 = one per core) until stop().
+  void run(unsigned nthreads=0);
+
+  //: Makes run() return. Async-signal-safe.
+  void stop();
+
+  //: Requests answered so far.
+  unsigned long requests() const { return requests_.load(std::memory_order_relaxed); }
+  unsigned long connections() const { return connections_.load(std::memory_order_relaxed); }
+
+  //: Answers request \p q, appending the response to \p out.
+  void answer(const bdifd_query_request &q, std::vector<bdifd_query_record> *scratch,
+      std::string *out) const;
+
+private:
+  bdifd_query_server(const bdifd_query_server &);
+  bdifd_query_server &operator=(const bdifd_query_server &);
+
+  void loop();
+
+  const bdifd_query_index &index_;
+  int listen_fd_;
+  int stop_fd_;
+  std::string unix_path_;
+  std::atomic<unsigned long> requests_, connections_;
+};
+
+//: Blocking client for bdifd_query_server.
+class bdifd_query_client {
+public:
+  bdifd_query_client() : fd_(-1), in_pos_(0) {}
+  ~bdifd_query_client();
+
+  //: Connects to \p address as for bdifd_query_server::listen().
+  bool connect(const std::string &address);
+
+  //: Sends \p n requests in as few writes as the socket takes. Whenever it
+  // is full, responses that have arrived are buffered for receive(), so the
+  // server is never left waiting on its own writes.
+  bool send(const bdifd_query_request *q, unsigned n);
+
+  //: Reads the next response and its records into \p records (replaced).
+  bool receive(bdifd_query_response *r, std::vector<bdifd_query_record> *records);
+
+  //: Sends \p q and waits for its response.
+  bool query(const bdifd_query_request &q, bdifd_query_response *r,
+      std::vector<bdifd_query_record> *records);
+
+private:
+  bdifd_query_client(const bdifd_query_client &);
+  bdifd_query_client &operator=(const bdifd_query_client &);
+
+  bool read_fully(void *p, std::size_t n);
+  bool recv_some(bool wait);
+
+  int fd_;
+  std::string in_;          //:< received, not yet consumed from in_pos_
+  std::size_t in_pos_;
+};
+
+#endif // bdifd_query_server_h
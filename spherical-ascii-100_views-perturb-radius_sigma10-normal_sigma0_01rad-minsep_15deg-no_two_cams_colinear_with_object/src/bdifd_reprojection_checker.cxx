@@ -0,0 +1,128 @@
+#include "bdifd_reprojection_checker.h"
+#include "bdifd_ascii_dataset.h"
+#include "bdifd_parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+
+const unsigned block_size = 256;
+
+}
+
+void bdifd_reprojection_checker::
+check(unsigned v, bdifd_view_reprojection *res) const
+{
+  res->v = v;
+  res->checked = true;
+  res->max_pt = res->mean_pt = 0;
+  res->max_tgt = res->mean_tgt = 0;
+  res->argmax_pt = res->argmax_tgt = 0;
+
+  // M = K R, p = M (X - C)
+  double M[3][3], C[3];
+  for (unsigned r=0; r < 3; ++r) {
+    for (unsigned c=0; c < 3; ++c)
+      M[r][c] = d_.K[r][0]*d_.R[v][0][c] + d_.K[r][1]*d_.R[v][1][c] + d_.K[r][2]*d_.R[v][2][c];
+    C[r] = d_.C[v][r];
+  }
+
+  const unsigned n = d_.npts();
+  const double *X = &d_.X[0], *Y = &d_.Y[0], *Z = &d_.Z[0];
+  const double *TX = &d_.TX[0], *TY = &d_.TY[0], *TZ = &d_.TZ[0];
+  const double *x = &d_.x[v][0], *y = &d_.y[v][0];
+  const double *tx = &d_.tx[v][0], *ty = &d_.ty[v][0];
+
+  const bdifd_lens_distortion &dist = d_.distortion;
+  const bool distorted = !dist.is_identity();
+  const double fx = d_.K[0][0], s = d_.K[0][1], cx = d_.K[0][2], fy = d_.K[1][1], cy = d_.K[1][2];
+
+  double px[block_size], py[block_size], qx[block_size], qy[block_size];
+  double e_pt[block_size], e_tgt[block_size];
+  double sum_pt = 0, sum_tgt = 0;
+
+  for (unsigned base=0; base < n; base += block_size) {
+    unsigned nb = std::min(block_size, n - base);
+    for (unsigned b=0; b < nb; ++b) {
+      unsigned i = base + b;
+      double X0 = X[i] - C[0], X1 = Y[i] - C[1], X2 = Z[i] - C[2];
+      double h0 = M[0][0]*X0 + M[0][1]*X1 + M[0][2]*X2;
+      double h1 = M[1][0]*X0 + M[1][1]*X1 + M[1][2]*X2;
+      double h2 = M[2][0]*X0 + M[2][1]*X1 + M[2][2]*X2;
+      px[b] = h0/h2;
+      py[b] = h1/h2;
+
+      // derivative of the projection along T
+      double g0 = M[0][0]*TX[i] + M[0][1]*TY[i] + M[0][2]*TZ[i];
+      double g1 = M[1][0]*TX[i] + M[1][1]*TY[i] + M[1][2]*TZ[i];
+      double g2 = M[2][0]*TX[i] + M[2][1]*TY[i] + M[2][2]*TZ[i];
+      qx[b] = g0 - px[b]*g2;
+      qy[b] = g1 - py[b]*g2;
+    }
+
+    // through the lens, in normalized coordinates, tangent by the Jacobian
+    if (distorted)
+      for (unsigned b=0; b < nb; ++b) {
+        double v = (py[b] - cy)/fy, u = (px[b] - cx - s*v)/fx;
+        double dv = qy[b]/fy, du = (qx[b] - s*dv)/fx;
+        double ud, vd, dud, dvd;
+        dist.distort(u, v, du, dv, &ud, &vd, &dud, &dvd);
+        px[b] = fx*ud + s*vd + cx;
+        py[b] = fy*vd + cy;
+        qx[b] = fx*dud + s*dvd;
+        qy[b] = fy*dvd;
+      }
+
+    for (unsigned b=0; b < nb; ++b) {
+      unsigned i = base + b;
+      double dx = px[b] - x[i], dy = py[b] - y[i];
+      e_pt[b] = std::sqrt(dx*dx + dy*dy);
+      e_tgt[b] = std::atan2(std::fabs(qx[b]*ty[i] - qy[b]*tx[i]), qx[b]*tx[i] + qy[b]*ty[i]);
+    }
+    for (unsigned b=0; b < nb; ++b) {
+      sum_pt += e_pt[b];
+      sum_tgt += e_tgt[b];
+      if (e_pt[b] > res->max_pt) {
+        res->max_pt = e_pt[b];
+        res->argmax_pt = base + b;
+      }
+      if (e_tgt[b] > res->max_tgt) {
+        res->max_tgt = e_tgt[b];
+        res->argmax_tgt = base + b;
+      }
+    }
+  }
+  if (n) {
+    res->mean_pt = sum_pt/n;
+    res->mean_tgt = sum_tgt/n;
+  }
+  // also catches NaN from samples on the principal plane
+  res->ok = res->max_pt <= tol_pt_ && res->max_tgt <= tol_tgt_
+    && sum_pt == sum_pt && sum_tgt == sum_tgt;
+}
+
+unsigned bdifd_reprojection_checker::
+check_all(std::vector<bdifd_view_reprojection> *res, unsigned nthreads) const
+{
+  unsigned nv = d_.nviews();
+  res->resize(nv);
+  for (unsigned v=0; v < nv; ++v) {
+    (*res)[v].v = v;
+    (*res)[v].checked = false;
+    (*res)[v].ok = false;
+  }
+
+  std::atomic<unsigned> first_bad(nv);
+  bdifd_parallel::for_each(nv, [&](unsigned v) {
+    if (v > first_bad)
+      return;
+    check(v, &(*res)[v]);
+    if (!(*res)[v].ok) {
+      unsigned cur = first_bad;
+      while (v < cur && !first_bad.compare_exchange_weak(cur, v))
+        ;
+    }
+  }, nthreads);
+  return first_bad;
+}
@@ -0,0 +1,56 @@
+// This is bdifd_reprojection_checker.h
+#ifndef bdifd_reprojection_checker_h
+#define bdifd_reprojection_checker_h
+//:
+//\file
+//\brief Checks stored 2D samples against the reprojection of the 3D curves
+//\date Sun Oct 18 2026
+//
+// For each view, reprojects crv-3D-pts.txt as K R (X - C), with R and C read
+// from the .extrinsic file (rows of R, then C), and compares with
+// frame_NNNN-pts-2D.txt. The space tangents in crv-3D-tgts.txt are carried
+// through the derivative of the projection and compared by angle with
+// frame_NNNN-tgts-2D.txt. With a calib.distortion the projections, tangents
+// included, are passed through it first, as generate_synth_sequence_3
+// -distortion does.
+//
+// The kernel works on one array per coordinate with no branches, so the
+// compiler vectorizes it; views are spread over threads. check_all() stops
+// handing out views past the first one that fails, so a bad dataset is
+// reported without reprojecting everything.
+//
+
+#include <vector>
+
+class bdifd_ascii_dataset;
+
+struct bdifd_view_reprojection {
+  unsigned v;
+  bool checked;           //:< false if skipped after an earlier failure
+  bool ok;
+  double max_pt, mean_pt; //:< pixels
+  unsigned argmax_pt;
+  double max_tgt, mean_tgt; //:< radians
+  unsigned argmax_tgt;
+};
+
+class bdifd_reprojection_checker {
+public:
+  //: \p d must have its 2D samples read.
+  bdifd_reprojection_checker(const bdifd_ascii_dataset &d, double tol_pt, double tol_tgt)
+    : d_(d), tol_pt_(tol_pt), tol_tgt_(tol_tgt) {}
+
+  //: Checks view \p v.
+  void check(unsigned v, bdifd_view_reprojection *r) const;
+
+  //: Checks all views over \p nthreads threads (0 = one per core). Returns the
+  // first failing view, or nviews if all pass; views after it may be left
+  // unchecked.
+  unsigned check_all(std::vector<bdifd_view_reprojection> *r, unsigned nthreads=0) const;
+
+private:
+  const bdifd_ascii_dataset &d_;
+  double tol_pt_, tol_tgt_;
+};
+
+#endif // bdifd_reprojection_checker_h
@@ -0,0 +1,438 @@
+#include "bdifd_resection.h"
+#include <algorithm>
+#include <cmath>
+#include <vnl/vnl_inverse.h>
+#include <vnl/vnl_matrix.h>
+#include <vnl/algo/vnl_svd.h>
+#include <vnl/algo/vnl_symmetric_eigensystem.h>
+
+namespace {
+
+//: Pose and the quantities shared by all residuals.
+struct pose {
+  double R[3][3], t[3];
+  double KR[3][3], Kt[3];
+
+  void set(const vnl_double_3x3 &K, const double Rm[3][3], const double tv[3])
+  {
+    for (unsigned r=0; r < 3; ++r) {
+      t[r] = tv[r];
+      for (unsigned c=0; c < 3; ++c)
+        R[r][c] = Rm[r][c];
+    }
+    for (unsigned r=0; r < 3; ++r) {
+      Kt[r] = K[r][0]*t[0] + K[r][1]*t[1] + K[r][2]*t[2];
+      for (unsigned c=0; c < 3; ++c)
+        KR[r][c] = K[r][0]*R[0][c] + K[r][1]*R[1][c] + K[r][2]*R[2][c];
+    }
+  }
+};
+
+//: Rotation by angle-axis \p w (Rodrigues) applied on the left of \p R.
+void
+rotate(const double w[3], const double R[3][3], double Rn[3][3])
+{
+  double th = std::sqrt(w[0]*w[0] + w[1]*w[1] + w[2]*w[2]);
+  double A[3][3];
+  if (th < 1e-300) {
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned c=0; c < 3; ++c)
+        A[r][c] = r == c;
+  } else {
+    double k[3] = { w[0]/th, w[1]/th, w[2]/th };
+    double s = std::sin(th), c1 = 1 - std::cos(th);
+    double Kx[3][3] = { {0, -k[2], k[1]}, {k[2], 0, -k[0]}, {-k[1], k[0], 0} };
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned c=0; c < 3; ++c) {
+        double K2 = Kx[r][0]*Kx[0][c] + Kx[r][1]*Kx[1][c] + Kx[r][2]*Kx[2][c];
+        A[r][c] = (r == c) + s*Kx[r][c] + c1*K2;
+      }
+  }
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c)
+      Rn[r][c] = A[r][0]*R[0][c] + A[r][1]*R[1][c] + A[r][2]*R[2][c];
+}
+
+//: Residuals of sample \p i under \p P: 2 for the point, 1 for the tangent.
+inline void
+residuals(const bdifd_resection_problem &p, unsigned i, const pose &P,
+    double wt, double r[3])
+{
+  double h0 = P.KR[0][0]*p.X[i] + P.KR[0][1]*p.Y[i] + P.KR[0][2]*p.Z[i] + P.Kt[0];
+  double h1 = P.KR[1][0]*p.X[i] + P.KR[1][1]*p.Y[i] + P.KR[1][2]*p.Z[i] + P.Kt[1];
+  double h2 = P.KR[2][0]*p.X[i] + P.KR[2][1]*p.Y[i] + P.KR[2][2]*p.Z[i] + P.Kt[2];
+  double u = h0/h2, v = h1/h2;
+  r[0] = u - p.x[i];
+  r[1] = v - p.y[i];
+
+  double g0 = P.KR[0][0]*p.TX[i] + P.KR[0][1]*p.TY[i] + P.KR[0][2]*p.TZ[i];
+  double g1 = P.KR[1][0]*p.TX[i] + P.KR[1][1]*p.TY[i] + P.KR[1][2]*p.TZ[i];
+  double g2 = P.KR[2][0]*p.TX[i] + P.KR[2][1]*p.TY[i] + P.KR[2][2]*p.TZ[i];
+  double q0 = g0 - u*g2, q1 = g1 - v*g2;
+  double qn = std::sqrt(q0*q0 + q1*q1);
+  r[2] = qn > 0 ? wt*(p.tx[i]*q1 - p.ty[i]*q0)/qn : 0;
+}
+
+//: Adds row^T row to the upper triangle of \p A.
+inline void
+add_outer(double A[12][12], const double row[12])
+{
+  for (unsigned r=0; r < 12; ++r)
+    if (row[r] != 0)
+      for (unsigned c=r; c < 12; ++c)
+        A[r][c] += row[r]*row[c];
+}
+
+//: Solves the 6x6 system A x = b by Cholesky; false if not positive definite.
+bool
+solve6(double A[6][6], const double b[6], double x[6])
+{
+  double L[6][6] = {{0}};
+  for (unsigned i=0; i < 6; ++i)
+    for (unsigned j=0; j <= i; ++j) {
+      double s = A[i][j];
+      for (unsigned k=0; k < j; ++k)
+        s -= L[i][k]*L[j][k];
+      if (i == j) {
+        if (s <= 0)
+          return false;
+        L[i][i] = std::sqrt(s);
+      } else
+        L[i][j] = s/L[j][j];
+    }
+  double y[6];
+  for (unsigned i=0; i < 6; ++i) {
+    double s = b[i];
+    for (unsigned k=0; k < i; ++k)
+      s -= L[i][k]*y[k];
+    y[i] = s/L[i][i];
+  }
+  for (unsigned i=6; i-- > 0; ) {
+    double s = y[i];
+    for (unsigned k=i+1; k < 6; ++k)
+      s -= L[k][i]*x[k];
+    x[i] = s/L[i][i];
+  }
+  return true;
+}
+
+}
+
+//---------------------------------------------------------------------------
+
+bdifd_resection_solver *bdifd_resection_solver::
+create(const std::string &name)
+{
+  if (name == "dlt")
+    return new bdifd_resection_dlt(true);
+  if (name == "dlt_points")
+    return new bdifd_resection_dlt(false);
+  return 0;
+}
+
+std::vector<std::string> bdifd_resection_solver::
+names()
+{
+  std::vector<std::string> n;
+  n.push_back("dlt");
+  n.push_back("dlt_points");
+  return n;
+}
+
+bool bdifd_resection_dlt::
+solve(const bdifd_resection_problem &p, vnl_double_3x3 *Rp, vnl_double_3 *tp) const
+{
+  unsigned n = p.size();
+  if (n < 6)
+    return false;
+
+  // center and scale the space points
+  double m[3] = {0, 0, 0};
+  for (unsigned i=0; i < n; ++i) {
+    m[0] += p.X[i];
+    m[1] += p.Y[i];
+    m[2] += p.Z[i];
+  }
+  for (unsigned r=0; r < 3; ++r)
+    m[r] /= n;
+  double ss = 0;
+  for (unsigned i=0; i < n; ++i) {
+    double d0 = p.X[i] - m[0], d1 = p.Y[i] - m[1], d2 = p.Z[i] - m[2];
+    ss += d0*d0 + d1*d1 + d2*d2;
+  }
+  double sigma = std::sqrt(ss/(3*n));
+  if (!(sigma > 0))
+    return false;
+
+  vnl_double_3x3 Kinv = vnl_inverse(p.K);
+  double A[12][12] = {{0}};
+  double row[12];
+
+  for (unsigned i=0; i < n; ++i) {
+    double xn[3], tn[3];
+    for (unsigned r=0; r < 3; ++r) {
+      xn[r] = Kinv[r][0]*p.x[i] + Kinv[r][1]*p.y[i] + Kinv[r][2];
+      tn[r] = Kinv[r][0]*p.tx[i] + Kinv[r][1]*p.ty[i];
+    }
+    xn[0] /= xn[2];
+    xn[1] /= xn[2];
+    double Xs[4] = { (p.X[i] - m[0])/sigma, (p.Y[i] - m[1])/sigma, (p.Z[i] - m[2])/sigma, 1 };
+
+    // x x P X = 0: [0, -X, y X] and [X, 0, -x X]
+    for (unsigned c=0; c < 4; ++c) {
+      row[c] = 0;
+      row[4+c] = -Xs[c];
+      row[8+c] = xn[1]*Xs[c];
+    }
+    add_outer(A, row);
+    for (unsigned c=0; c < 4; ++c) {
+      row[c] = Xs[c];
+      row[4+c] = 0;
+      row[8+c] = -xn[0]*Xs[c];
+    }
+    add_outer(A, row);
+
+    if (use_tangents_) {
+      // l^T P [T;0] = 0, l = x x t
+      double x3[3] = { xn[0], xn[1], 1 };
+      double l[3] = { x3[1]*tn[2] - x3[2]*tn[1], x3[2]*tn[0] - x3[0]*tn[2], x3[0]*tn[1] - x3[1]*tn[0] };
+      double ln = std::sqrt(l[0]*l[0] + l[1]*l[1] + l[2]*l[2]);
+      double T[3] = { p.TX[i], p.TY[i], p.TZ[i] };
+      double Tn = std::sqrt(T[0]*T[0] + T[1]*T[1] + T[2]*T[2]);
+      if (ln > 0 && Tn > 0) {
+        for (unsigned r=0; r < 3; ++r) {
+          for (unsigned c=0; c < 3; ++c)
+            row[4*r + c] = l[r]*T[c]/(ln*Tn);
+          row[4*r + 3] = 0;
+        }
+        add_outer(A, row);
+      }
+    }
+  }
+
+  vnl_matrix<double> Am(12, 12, 0.0);
+  for (unsigned r=0; r < 12; ++r)
+    for (unsigned c=r; c < 12; ++c)
+      Am[r][c] = Am[c][r] = A[r][c];
+  vnl_symmetric_eigensystem<double> eig(Am);
+  vnl_vector<double> pv = eig.get_eigenvector(0);
+
+  // undo the normalization: M = M'/sigma, p4 = p4' - M m
+  vnl_matrix<double> M(3, 3, 0.0);
+  double p4[3];
+  for (unsigned r=0; r < 3; ++r) {
+    for (unsigned c=0; c < 3; ++c)
+      M[r][c] = pv[4*r + c]/sigma;
+    p4[r] = pv[4*r + 3] - (M[r][0]*m[0] + M[r][1]*m[1] + M[r][2]*m[2]);
+  }
+  double det = M[0][0]*(M[1][1]*M[2][2] - M[1][2]*M[2][1])
+             - M[0][1]*(M[1][0]*M[2][2] - M[1][2]*M[2][0])
+             + M[0][2]*(M[1][0]*M[2][1] - M[1][1]*M[2][0]);
+  if (det == 0 || det != det)
+    return false;
+  if (det < 0) {
+    for (unsigned r=0; r < 3; ++r) {
+      for (unsigned c=0; c < 3; ++c)
+        M[r][c] = -M[r][c];
+      p4[r] = -p4[r];
+    }
+  }
+
+  vnl_svd<double> svd(M);
+  vnl_matrix<double> U = svd.U(), V = svd.V();
+  double s = (svd.W(0) + svd.W(1) + svd.W(2))/3;
+  for (unsigned r=0; r < 3; ++r) {
+    for (unsigned c=0; c < 3; ++c)
+      (*Rp)[r][c] = U[r][0]*V[c][0] + U[r][1]*V[c][1] + U[r][2]*V[c][2];
+    (*tp)[r] = p4[r]/s;
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+unsigned bdifd_resection::
+refine(const bdifd_resection_problem &p, vnl_double_3x3 *Rp, vnl_double_3 *tp,
+    double tangent_weight, unsigned max_iterations)
+{
+  const unsigned n = p.size();
+  const double wt = tangent_weight*p.K[0][0];
+  const unsigned nres = tangent_weight > 0 ? 3 : 2;
+
+  double R[3][3], t[3];
+  for (unsigned r=0; r < 3; ++r) {
+    t[r] = (*tp)[r];
+    for (unsigned c=0; c < 3; ++c)
+      R[r][c] = (*Rp)[r][c];
+  }
+
+  pose P;
+  P.set(p.K, R, t);
+  double cost = 0;
+  for (unsigned i=0; i < n; ++i) {
+    double r[3];
+    residuals(p, i, P, wt, r);
+    for (unsigned k=0; k < nres; ++k)
+      cost += r[k]*r[k];
+  }
+
+  double lambda = -1;
+  bool converged = false;
+  unsigned it;
+  for (it=0; it < max_iterations && !converged; ++it) {
+    // forward differences for the 6 parameters
+    pose Pd[6];
+    double h[6];
+    double tn = std::sqrt(t[0]*t[0] + t[1]*t[1] + t[2]*t[2]);
+    for (unsigned k=0; k < 6; ++k) {
+      double w[3] = {0, 0, 0}, Rk[3][3], tk[3] = { t[0], t[1], t[2] };
+      if (k < 3) {
+        h[k] = 1e-7;
+        w[k] = h[k];
+        rotate(w, R, Rk);
+      } else {
+        h[k] = 1e-7*(tn + 1);
+        tk[k-3] += h[k];
+        for (unsigned r=0; r < 3; ++r)
+          for (unsigned c=0; c < 3; ++c)
+            Rk[r][c] = R[r][c];
+      }
+      Pd[k].set(p.K, Rk, tk);
+    }
+
+    double JtJ[6][6] = {{0}}, Jtr[6] = {0};
+    for (unsigned i=0; i < n; ++i) {
+      double r[3], rd[3], J[6][3];
+      residuals(p, i, P, wt, r);
+      for (unsigned k=0; k < 6; ++k) {
+        residuals(p, i, Pd[k], wt, rd);
+        for (unsigned j=0; j < nres; ++j)
+          J[k][j] = (rd[j] - r[j])/h[k];
+      }
+      for (unsigned a=0; a < 6; ++a) {
+        for (unsigned j=0; j < nres; ++j)
+          Jtr[a] += J[a][j]*r[j];
+        for (unsigned b=a; b < 6; ++b)
+          for (unsigned j=0; j < nres; ++j)
+            JtJ[a][b] += J[a][j]*J[b][j];
+      }
+    }
+    for (unsigned a=0; a < 6; ++a)
+      for (unsigned b=0; b < a; ++b)
+        JtJ[a][b] = JtJ[b][a];
+
+    if (lambda < 0) {
+      double dmax = 0;
+      for (unsigned a=0; a < 6; ++a)
+        dmax = std::max(dmax, JtJ[a][a]);
+      lambda = 1e-3*dmax;
+    }
+
+    // damped steps until one lowers the cost
+    bool improved = false;
+    double step_norm = 0;
+    for (unsigned tries=0; tries < 10 && !improved; ++tries) {
+      double A[6][6], b[6], d[6];
+      for (unsigned a=0; a < 6; ++a) {
+        for (unsigned c=0; c < 6; ++c)
+          A[a][c] = JtJ[a][c];
+        A[a][a] += lambda;
+        b[a] = -Jtr[a];
+      }
+      if (!solve6(A, b, d)) {
+        lambda *= 10;
+        continue;
+      }
+      double Rn[3][3], tn2[3];
+      rotate(d, R, Rn);
+      for (unsigned r=0; r < 3; ++r)
+        tn2[r] = t[r] + d[3+r];
+      pose Pn;
+      Pn.set(p.K, Rn, tn2);
+      double cost_n = 0;
+      for (unsigned i=0; i < n; ++i) {
+        double r[3];
+        residuals(p, i, Pn, wt, r);
+        for (unsigned k=0; k < nres; ++k)
+          cost_n += r[k]*r[k];
+      }
+      if (cost_n < cost) {
+        improved = true;
+        step_norm = 0;
+        for (unsigned a=0; a < 6; ++a)
+          step_norm += d[a]*d[a];
+        double rel = (cost - cost_n)/cost;
+        cost = cost_n;
+        for (unsigned r=0; r < 3; ++r) {
+          t[r] = tn2[r];
+          for (unsigned c=0; c < 3; ++c)
+            R[r][c] = Rn[r][c];
+        }
+        P = Pn;
+        lambda /= 10;
+        converged = rel < 1e-12;
+      } else
+        lambda *= 10;
+    }
+    if (!improved || step_norm < 1e-24) {
+      ++it;
+      break;
+    }
+  }
+  for (unsigned r=0; r < 3; ++r) {
+    (*tp)[r] = t[r];
+    for (unsigned c=0; c < 3; ++c)
+      (*Rp)[r][c] = R[r][c];
+  }
+  return it;
+}
+
+void bdifd_resection::
+reprojection_errors(const bdifd_resection_problem &p,
+    const vnl_double_3x3 &R, const vnl_double_3 &t, std::vector<double> *err)
+{
+  double Rm[3][3], tv[3];
+  for (unsigned r=0; r < 3; ++r) {
+    tv[r] = t[r];
+    for (unsigned c=0; c < 3; ++c)
+      Rm[r][c] = R[r][c];
+  }
+  pose P;
+  P.set(p.K, Rm, tv);
+  err->resize(p.size());
+  for (unsigned i=0; i < p.size(); ++i) {
+    double r[3];
+    residuals(p, i, P, 0, r);
+    (*err)[i] = std::sqrt(r[0]*r[0] + r[1]*r[1]);
+  }
+}
+
+void bdifd_resection::
+summary(const std::vector<double> &err, double *avg, double *max, double *med)
+{
+  *avg = *max = *med = 0;
+  if (err.empty())
+    return;
+  std::vector<double> e(err);
+  double s = 0;
+  for (unsigned i=0; i < e.size(); ++i) {
+    s += e[i];
+    *max = std::max(*max, e[i]);
+  }
+  *avg = s/e.size();
+  std::nth_element(e.begin(), e.begin() + e.size()/2, e.end());
+  *med = e[e.size()/2];
+}
+
+double bdifd_resection::
+rotation_error(const vnl_double_3x3 &Ra, const vnl_double_3x3 &Rb)
+{
+  // D = Ra Rb^T; 2 cos = trace D - 1 and 2 sin = |axial part of D - D^T|.
+  // Through atan2, as acos loses all precision near 0.
+  double D[3][3];
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c)
+      D[r][c] = Ra[r][0]*Rb[c][0] + Ra[r][1]*Rb[c][1] + Ra[r][2]*Rb[c][2];
+  double s0 = D[2][1] - D[1][2], s1 = D[0][2] - D[2][0], s2 = D[1][0] - D[0][1];
+  return std::atan2(std::sqrt(s0*s0 + s1*s1 + s2*s2), D[0][0] + D[1][1] + D[2][2] - 1);
+}
@@ -0,0 +1,90 @@
+// This is bdifd_resection.h
+#ifndef bdifd_resection_h
+#define bdifd_resection_h
+//:
+//\file
+//\brief Camera pose from 2D-3D point and tangent correspondences
+//\date Sun Oct 18 2026
+//
+// A solver turns a bdifd_resection_problem (known K, image samples with unit
+// tangents, the matching space points and tangents) into R and t, with
+// x ~ K (R X + t). Solvers implement bdifd_resection_solver and are picked by
+// name through bdifd_resection_solver::create(), so new ones can be compared
+// against the baseline with the same driver.
+//
+// The baseline, "dlt", is a first-order DLT: each point gives the two rows of
+// x x P[X;1] = 0 and each tangent the row l^T P [T;0] = 0, with l = x x t the
+// image tangent line, i.e. the space tangent must project onto the image
+// tangent. Space points are centered and scaled first; P is the eigenvector
+// of the smallest eigenvalue of the 12x12 normal matrix, and its left 3x3
+// block is projected onto the rotations with an SVD.
+//
+// bdifd_resection::refine() then runs Levenberg-Marquardt on the 6 pose
+// parameters, minimizing the reprojection error in pixels plus, weighted, the
+// sine of the angle between each image tangent and the projected space
+// tangent, times the focal length to bring it to pixels.
+//
+
+#include <string>
+#include <vector>
+#include <vnl/vnl_double_3.h>
+#include <vnl/vnl_double_3x3.h>
+
+struct bdifd_resection_problem {
+  vnl_double_3x3 K;
+  std::vector<double> x, y;       //:< image points, pixels
+  std::vector<double> tx, ty;     //:< unit image tangents
+  std::vector<double> X, Y, Z;    //:< space points
+  std::vector<double> TX, TY, TZ; //:< space tangents
+
+  unsigned size() const { return x.size(); }
+};
+
+class bdifd_resection_solver {
+public:
+  virtual ~bdifd_resection_solver() {}
+
+  virtual std::string name() const = 0;
+
+  //: Estimates R, t. Returns false if the problem is degenerate.
+  virtual bool solve(const bdifd_resection_problem &p, vnl_double_3x3 *R, vnl_double_3 *t) const = 0;
+
+  //: Solver called \p name, or 0 if there is none; the caller owns it.
+  static bdifd_resection_solver *create(const std::string &name);
+
+  //: Names accepted by create().
+  static std::vector<std::string> names();
+};
+
+//: First-order DLT on points and tangents.
+class bdifd_resection_dlt : public bdifd_resection_solver {
+public:
+  explicit bdifd_resection_dlt(bool use_tangents=true) : use_tangents_(use_tangents) {}
+
+  std::string name() const { return use_tangents_ ? "dlt" : "dlt_points"; }
+  bool solve(const bdifd_resection_problem &p, vnl_double_3x3 *R, vnl_double_3 *t) const;
+
+private:
+  bool use_tangents_;
+};
+
+class bdifd_resection {
+public:
+  //: Levenberg-Marquardt on R, t; \p tangent_weight 0 uses points only.
+  // Returns the number of iterations taken.
+  static unsigned refine(const bdifd_resection_problem &p,
+      vnl_double_3x3 *R, vnl_double_3 *t,
+      double tangent_weight=1, unsigned max_iterations=20);
+
+  //: Reprojection error of each point, pixels.
+  static void reprojection_errors(const bdifd_resection_problem &p,
+      const vnl_double_3x3 &R, const vnl_double_3 &t, std::vector<double> *err);
+
+  //: Average, max and median of \p err.
+  static void summary(const std::vector<double> &err, double *avg, double *max, double *med);
+
+  //: Angle of Ra Rb^T, radians, accurate down to 0.
+  static double rotation_error(const vnl_double_3x3 &Ra, const vnl_double_3x3 &Rb);
+};
+
+#endif // bdifd_resection_h
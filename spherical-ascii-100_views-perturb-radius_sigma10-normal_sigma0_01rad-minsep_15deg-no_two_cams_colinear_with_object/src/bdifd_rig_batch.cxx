@@ -0,0 +1,282 @@
+#include "bdifd_rig_batch.h"
+#include "bdifd_parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include <vnl/vnl_inverse.h>
+#include <bdifd/bdifd_rig.h>
+
+void bdifd_2d_soa::
+resize(unsigned n)
+{
+  x.resize(n); y.resize(n);
+  tx.resize(n); ty.resize(n);
+  nx.resize(n); ny.resize(n);
+  k.resize(n); kdot.resize(n);
+}
+
+void bdifd_2d_soa::
+set(unsigned i, const bdifd_3rd_order_point_2d &p)
+{
+  x[i] = p.gama[0]; y[i] = p.gama[1];
+  tx[i] = p.t[0];   ty[i] = p.t[1];
+  nx[i] = p.n[0];   ny[i] = p.n[1];
+  k[i] = p.k;       kdot[i] = p.kdot;
+}
+
+void bdifd_2d_soa::
+from_points(const std::vector<bdifd_3rd_order_point_2d> &pts, bdifd_2d_soa &soa)
+{
+  soa.resize(pts.size());
+  for (unsigned i=0; i < pts.size(); ++i)
+    soa.set(i, pts[i]);
+}
+
+void bdifd_3d_soa::
+resize(unsigned n)
+{
+  X.resize(n);  Y.resize(n);  Z.resize(n);
+  Tx.resize(n); Ty.resize(n); Tz.resize(n);
+  Nx.resize(n); Ny.resize(n); Nz.resize(n);
+  Bx.resize(n); By.resize(n); Bz.resize(n);
+  K.resize(n);  Kdot.resize(n); Tau.resize(n);
+  valid.resize(n);
+}
+
+void bdifd_3d_soa::
+get(unsigned i, bdifd_3rd_order_point_3d *P) const
+{
+  P->Gama = bdifd_vector_3d(X[i], Y[i], Z[i]);
+  P->T = bdifd_vector_3d(Tx[i], Ty[i], Tz[i]);
+  P->N = bdifd_vector_3d(Nx[i], Ny[i], Nz[i]);
+  P->B = bdifd_vector_3d(Bx[i], By[i], Bz[i]);
+  P->K = K[i];
+  P->Kdot = Kdot[i];
+  P->Tau = Tau[i];
+}
+
+//---------------------------------------------------------------------------
+
+bdifd_rig_batch::
+bdifd_rig_batch(
+    const vpgl_perspective_camera<double> &P1,
+    const vpgl_perspective_camera<double> &P2)
+{
+  set(P1, P2);
+}
+
+bdifd_rig_batch::
+bdifd_rig_batch(const bdifd_rig &rig)
+{
+  set(rig.cam[0].Pr_, rig.cam[1].Pr_);
+}
+
+void bdifd_rig_batch::
+set(
+    const vpgl_perspective_camera<double> &P1,
+    const vpgl_perspective_camera<double> &P2)
+{
+  const vpgl_perspective_camera<double> *P[2] = {&P1, &P2};
+
+  for (unsigned v=0; v < 2; ++v) {
+    vgl_point_3d<double> c = P[v]->get_camera_center();
+    c_[v][0] = c.x(); c_[v][1] = c.y(); c_[v][2] = c.z();
+
+    vnl_double_3x3 Rt = P[v]->get_rotation().as_matrix().transpose();
+    vnl_double_3x3 Kinv = vnl_inverse(P[v]->get_calibration().get_matrix());
+    vnl_double_3x3 M = Rt*Kinv;
+
+    for (unsigned r=0; r < 3; ++r) {
+      for (unsigned s=0; s < 3; ++s)
+        M_[v][r][s] = M[r][s];
+      F_[v][r] = Rt[r][2];
+    }
+    detA_[v] = std::fabs(Kinv[0][0]*Kinv[1][1] - Kinv[0][1]*Kinv[1][0]);
+  }
+}
+
+//: Image attributes of one view, mapped to world coordinates.
+struct bdifd_rig_batch_view {
+  double g[3];        //:< viewing direction at unit depth
+  double t[3], n[3];  //:< unit tangent and normal on the image plane
+  double k, kdot;     //:< curvature and its derivative, unit-depth metric
+};
+
+static inline double dot3(const double *a, const double *b)
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static inline void cross3(const double *a, const double *b, double *c)
+{
+  c[0] = a[1]*b[2] - a[2]*b[1];
+  c[1] = a[2]*b[0] - a[0]*b[2];
+  c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+//: img_to_world for one sample. The curvature of the image of a plane curve
+// under a linear map A is k |det A| / |A t|^3, differentiated for kdot.
+static inline void
+to_world(const double M[3][3], double detA,
+    double x, double y, double tx, double ty, double nx, double ny, double k, double kdot,
+    bdifd_rig_batch_view &w)
+{
+  for (unsigned r=0; r < 3; ++r) {
+    w.g[r] = M[r][0]*x + M[r][1]*y + M[r][2];
+    w.t[r] = M[r][0]*tx + M[r][1]*ty;
+    w.n[r] = M[r][0]*nx + M[r][1]*ny;
+  }
+  double a2 = dot3(w.t,w.t);
+  double a = std::sqrt(a2);
+  double tn = dot3(w.t,w.n);
+
+  double k_w = k*detA/(a2*a);
+  w.kdot = detA*(kdot/(a2*a) - 3*k*k*tn/(a2*a2*a))/a;
+  w.k = k_w;
+
+  double inv_a = 1/a;
+  for (unsigned r=0; r < 3; ++r)
+    w.t[r] *= inv_a;
+  tn *= inv_a;
+  for (unsigned r=0; r < 3; ++r)
+    w.n[r] -= tn*w.t[r];
+  double inv_n = 1/std::sqrt(dot3(w.n,w.n));
+  for (unsigned r=0; r < 3; ++r)
+    w.n[r] *= inv_n;
+}
+
+void bdifd_rig_batch::
+reconstruct_3rd_order(
+    const bdifd_2d_soa &x1,
+    const bdifd_2d_soa &x2,
+    bdifd_3d_soa *X,
+    unsigned begin,
+    unsigned end) const
+{
+  assert(x1.size() == x2.size() && X->size() >= x1.size() && end <= x1.size());
+  if (begin >= end)
+    return;
+
+  const double *x1x = &x1.x[0], *x1y = &x1.y[0], *x1tx = &x1.tx[0], *x1ty = &x1.ty[0];
+  const double *x1nx = &x1.nx[0], *x1ny = &x1.ny[0], *x1k = &x1.k[0], *x1kdot = &x1.kdot[0];
+  const double *x2x = &x2.x[0], *x2y = &x2.y[0], *x2tx = &x2.tx[0], *x2ty = &x2.ty[0];
+  const double *x2nx = &x2.nx[0], *x2ny = &x2.ny[0], *x2k = &x2.k[0], *x2kdot = &x2.kdot[0];
+
+  double *oX = &X->X[0], *oY = &X->Y[0], *oZ = &X->Z[0];
+  double *oTx = &X->Tx[0], *oTy = &X->Ty[0], *oTz = &X->Tz[0];
+  double *oNx = &X->Nx[0], *oNy = &X->Ny[0], *oNz = &X->Nz[0];
+  double *oBx = &X->Bx[0], *oBy = &X->By[0], *oBz = &X->Bz[0];
+  double *oK = &X->K[0], *oKdot = &X->Kdot[0], *oTau = &X->Tau[0];
+  unsigned char *ovalid = &X->valid[0];
+
+  const double base[3] = {c_[1][0] - c_[0][0], c_[1][1] - c_[0][1], c_[1][2] - c_[0][2]};
+  static const double eps = 1e-12;
+
+  for (unsigned i=begin; i < end; ++i) {
+    bdifd_rig_batch_view w[2];
+    to_world(M_[0], detA_[0], x1x[i], x1y[i], x1tx[i], x1ty[i], x1nx[i], x1ny[i], x1k[i], x1kdot[i], w[0]);
+    to_world(M_[1], detA_[1], x2x[i], x2y[i], x2tx[i], x2ty[i], x2nx[i], x2ny[i], x2k[i], x2kdot[i], w[1]);
+
+    // -- Position: midpoint of the closest points of the two rays
+    double a11 = dot3(w[0].g,w[0].g), a12 = dot3(w[0].g,w[1].g), a22 = dot3(w[1].g,w[1].g);
+    double e1 = dot3(w[0].g,base), e2 = dot3(w[1].g,base);
+    double det = a11*a22 - a12*a12;
+    double inv_det = 1/det;
+    double l1 = (a22*e1 - a12*e2)*inv_det;
+    double l2 = (a12*e1 - a11*e2)*inv_det;
+
+    double G[3];
+    for (unsigned r=0; r < 3; ++r)
+      G[r] = 0.5*(c_[0][r] + l1*w[0].g[r] + c_[1][r] + l2*w[1].g[r]);
+
+    double rho[2];
+    for (unsigned v=0; v < 2; ++v)
+      rho[v] = F_[v][0]*(G[0]-c_[v][0]) + F_[v][1]*(G[1]-c_[v][1]) + F_[v][2]*(G[2]-c_[v][2]);
+
+    // -- Tangent: intersection of the planes through each ray and tangent
+    double m[2][3], T[3];
+    cross3(w[0].g, w[0].t, m[0]);
+    cross3(w[1].g, w[1].t, m[1]);
+    cross3(m[0], m[1], T);
+    double m12 = std::sqrt(dot3(T,T));
+    double m1m2 = std::sqrt(dot3(m[0],m[0])*dot3(m[1],m[1]));
+
+    double gxT[3];
+    cross3(w[0].g, T, gxT);
+    double sgn = std::copysign(1.0, dot3(gxT, m[0]));
+    double inv_T = sgn/m12;
+    for (unsigned r=0; r < 3; ++r)
+      T[r] *= inv_T;
+
+    // speeds g_v = d(image arclength)/ds; view 2 may run the other way
+    double g[2];
+    for (unsigned v=0; v < 2; ++v) {
+      cross3(w[v].g, T, gxT);
+      g[v] = dot3(gxT, m[v])/(rho[v]*dot3(m[v],m[v]));
+    }
+    double s2 = std::copysign(1.0, g[1]);
+    g[1] *= s2;
+    w[1].kdot *= s2;
+    for (unsigned r=0; r < 3; ++r) {
+      w[1].t[r] *= s2;
+      m[1][r] *= s2;
+    }
+
+    // -- Curvature vector: m_v . KN = rho_v g_v^2 k_v (m_v . n_v), T . KN = 0
+    double r1 = rho[0]*g[0]*g[0]*w[0].k*dot3(m[0],w[0].n);
+    double r2 = rho[1]*g[1]*g[1]*w[1].k*dot3(m[1],w[1].n);
+    double c2T[3], Tc1[3], KN[3];
+    cross3(m[1], T, c2T);
+    cross3(T, m[0], Tc1);
+    double D3 = dot3(m[0], c2T);
+    for (unsigned r=0; r < 3; ++r)
+      KN[r] = (r1*c2T[r] + r2*Tc1[r])/D3;
+
+    double Kc = std::sqrt(dot3(KN,KN));
+    // zero curvature (lines): N, B and the third-order terms are set to zero
+    double curved = Kc > eps;
+    double inv_K = curved/std::max(Kc, eps);
+    double N[3], B[3];
+    for (unsigned r=0; r < 3; ++r)
+      N[r] = KN[r]*inv_K;
+    cross3(T, N, B);
+
+    // -- Third order: m_v . (Kdot N + K Tau B) = q_v  (m_v . T = 0 by construction)
+    double q[2], mN[2], mB[2];
+    for (unsigned v=0; v < 2; ++v) {
+      double drho = dot3(F_[v], T);
+      double ddrho = dot3(F_[v], KN);
+      double dg = (dot3(KN, w[v].t) - ddrho*dot3(w[v].g, w[v].t) - 2*drho*g[v])/rho[v];
+      double gk = g[v]*g[v]*w[v].k;
+      q[v] = dot3(m[v],w[v].n)*(3*drho*gk + rho[v]*(3*g[v]*dg*w[v].k + g[v]*g[v]*g[v]*w[v].kdot));
+      mN[v] = dot3(m[v], N);
+      mB[v] = dot3(m[v], B);
+    }
+    double D2 = mN[0]*mB[1] - mB[0]*mN[1];
+    double inv_D2 = curved/D2;
+    double Kdot = (q[0]*mB[1] - q[1]*mB[0])*inv_D2;
+    double KTau = (mN[0]*q[1] - mN[1]*q[0])*inv_D2;
+
+    oX[i] = G[0];  oY[i] = G[1];  oZ[i] = G[2];
+    oTx[i] = T[0]; oTy[i] = T[1]; oTz[i] = T[2];
+    oNx[i] = N[0]; oNy[i] = N[1]; oNz[i] = N[2];
+    oBx[i] = B[0]; oBy[i] = B[1]; oBz[i] = B[2];
+    oK[i] = Kc;
+    oKdot[i] = Kdot;
+    oTau[i] = KTau*inv_K;
+    ovalid[i] = (std::fabs(det) > eps*a11*a22) & (m12 > eps*m1m2);
+  }
+}
+
+void bdifd_rig_batch::
+reconstruct_3rd_order(
+    const bdifd_2d_soa &x1,
+    const bdifd_2d_soa &x2,
+    bdifd_3d_soa *X,
+    unsigned nthreads) const
+{
+  X->resize(x1.size());
+  bdifd_parallel::for_blocks(x1.size(), 4096, [&](unsigned b, unsigned e) {
+    reconstruct_3rd_order(x1, x2, X, b, e);
+  }, nthreads);
+}
@@ -0,0 +1,105 @@
+// This is bdifd_rig_batch.h
+#ifndef bdifd_rig_batch_h
+#define bdifd_rig_batch_h
+//:
+//\file
+//\brief Batched two-view reconstruction of points, tangents and curvatures
+//\date Sun Oct 18 2026
+//
+// Structure-of-arrays counterpart of bdifd_rig::reconstruct_3rd_order for a
+// fixed pair of cameras. Everything that depends only on the rig is computed
+// once in the constructor; the per-point kernel is a branch-free loop over
+// contiguous arrays so that the compiler can run it in SIMD lanes.
+//
+// Unlike bdifd_rig, the inputs are in image (pixel) coordinates: the
+// img_to_world step is folded into the kernel.
+//
+// Closed form used, per view v with center c_v and viewing direction
+// gh_v = R_v^T K_v^{-1} x_v (unit depth), m_v = gh_v x t_v:
+//
+//   Gama       midpoint of the two rays
+//   T          (gh_1 x t_1) x (gh_2 x t_2), oriented along view 1
+//   K N        m_v . K N = rho_v g_v^2 k_v (m_v . n_v),  T . K N = 0
+//   Kdot, Tau  m_v . (Kdot N + K Tau B) = (m_v . n_v)(3 rho'_v g_v^2 k_v
+//              + rho_v (3 g_v g'_v k_v + g_v^3 kdot_v))
+//
+// The third-order relation in general also has a K^2 (m_v . T) term; it is
+// zero here since T is along m_1 x m_2.
+// where rho_v is depth and g_v = d(image arclength)/d(space arclength), see
+// Fabbri and Kimia, "Multiview Differential Geometry of Curves", IJCV 2016.
+//
+
+#include <vector>
+#include <bdifd/bdifd_camera.h>
+
+class bdifd_rig;
+
+//: Image samples with differential geometry, one array per attribute.
+// Coordinates are in pixels; (tx,ty) is the unit tangent, (nx,ny) the unit
+// normal, k the curvature along n and kdot its arclength derivative.
+struct bdifd_2d_soa {
+  std::vector<double> x, y, tx, ty, nx, ny, k, kdot;
+
+  unsigned size() const { return x.size(); }
+  void resize(unsigned n);
+  void set(unsigned i, const bdifd_3rd_order_point_2d &p);
+
+  //: Fills \p soa from an array of points.
+  static void from_points(const std::vector<bdifd_3rd_order_point_2d> &pts, bdifd_2d_soa &soa);
+};
+
+//: Reconstructed space samples, one array per attribute. valid[i] is zero for
+// degenerate configurations (parallel rays, tangent along the epipolar plane,
+// zero curvature for the third-order terms).
+struct bdifd_3d_soa {
+  std::vector<double> X, Y, Z;
+  std::vector<double> Tx, Ty, Tz;
+  std::vector<double> Nx, Ny, Nz;
+  std::vector<double> Bx, By, Bz;
+  std::vector<double> K, Kdot, Tau;
+  std::vector<unsigned char> valid;
+
+  unsigned size() const { return X.size(); }
+  void resize(unsigned n);
+  void get(unsigned i, bdifd_3rd_order_point_3d *P) const;
+};
+
+class bdifd_rig_batch {
+public:
+  bdifd_rig_batch(
+      const vpgl_perspective_camera<double> &P1,
+      const vpgl_perspective_camera<double> &P2);
+
+  explicit bdifd_rig_batch(const bdifd_rig &rig);
+
+  //: Reconstructs samples [begin,end) of corresponding views \p x1, \p x2 into
+  // \p X, which must already have (at least) x1.size() entries.
+  void reconstruct_3rd_order(
+      const bdifd_2d_soa &x1,
+      const bdifd_2d_soa &x2,
+      bdifd_3d_soa *X,
+      unsigned begin,
+      unsigned end) const;
+
+  //: Reconstructs all samples, resizing \p X, spreading blocks of points
+  // over \p nthreads threads (0 = one per core).
+  void reconstruct_3rd_order(
+      const bdifd_2d_soa &x1,
+      const bdifd_2d_soa &x2,
+      bdifd_3d_soa *X,
+      unsigned nthreads=1) const;
+
+private:
+  void set(
+      const vpgl_perspective_camera<double> &P1,
+      const vpgl_perspective_camera<double> &P2);
+
+  //: Per view: center, rows of R^T K^{-1} (pixel -> world direction at unit
+  // depth), optical axis F, and det of the 2x2 linear part of K^{-1}.
+  double c_[2][3];
+  double M_[2][3][3];
+  double F_[2][3];
+  double detA_[2];
+};
+
+#endif // bdifd_rig_batch_h
@@ -0,0 +1,189 @@
+#include "bdifd_run_report.h"
+#include "bdifd_json.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sys/resource.h>
+
+namespace {
+
+struct stage_entry {
+  std::string name;
+  double seconds;
+  unsigned calls;
+  double peak_rss;  // at the end of the last call
+};
+
+struct report_state {
+  std::mutex mutex;
+  std::vector<stage_entry> stages;
+  std::vector<std::pair<std::string, double> > counters;
+};
+
+report_state &state()
+{
+  static report_state s;
+  return s;
+}
+
+}
+
+double bdifd_run_report::
+now()
+{
+  typedef std::chrono::steady_clock clock;
+  static const clock::time_point start = clock::now();
+  return std::chrono::duration<double>(clock::now() - start).count();
+}
+
+double bdifd_run_report::
+peak_rss()
+{
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return 0;
+#ifdef __APPLE__
+  return double(ru.ru_maxrss);
+#else
+  return double(ru.ru_maxrss)*1024;
+#endif
+}
+
+void bdifd_run_report::
+count(const std::string &name, double n)
+{
+  report_state &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  for (unsigned i=0; i < s.counters.size(); ++i)
+    if (s.counters[i].first == name) {
+      s.counters[i].second += n;
+      return;
+    }
+  s.counters.push_back(std::make_pair(name, n));
+}
+
+double bdifd_run_report::
+counter(const std::string &name)
+{
+  report_state &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  for (unsigned i=0; i < s.counters.size(); ++i)
+    if (s.counters[i].first == name)
+      return s.counters[i].second;
+  return 0;
+}
+
+void bdifd_run_report::
+add_stage(const std::string &name, double seconds)
+{
+  double rss = peak_rss();
+  report_state &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  for (unsigned i=0; i < s.stages.size(); ++i)
+    if (s.stages[i].name == name) {
+      s.stages[i].seconds += seconds;
+      s.stages[i].calls++;
+      s.stages[i].peak_rss = rss;
+      return;
+    }
+  stage_entry e;
+  e.name = name;
+  e.seconds = seconds;
+  e.calls = 1;
+  e.peak_rss = rss;
+  s.stages.push_back(e);
+}
+
+void bdifd_run_report::
+clear()
+{
+  report_state &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.stages.clear();
+  s.counters.clear();
+}
+
+void bdifd_run_report::
+print(std::ostream &os)
+{
+  report_state &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  for (unsigned i=0; i < s.stages.size(); ++i)
+    os << "Stage " << s.stages[i].name << ": " << s.stages[i].seconds << " s, peak RSS "
+      << s.stages[i].peak_rss/(1024*1024) << " MB" << std::endl;
+  for (unsigned i=0; i < s.counters.size(); ++i)
+    os << "Count " << s.counters[i].first << ": " << s.counters[i].second << std::endl;
+}
+
+void bdifd_run_report::
+write_json(std::ostream &os, const context &ctx)
+{
+  double total = now();
+  double rss = peak_rss();
+
+  report_state &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+
+  std::ios::fmtflags f = os.flags();
+  std::streamsize prec = os.precision(17);
+
+  os << "{\n  \"context\": {";
+  for (unsigned i=0; i < ctx.size(); ++i) {
+    os << (i ? ",\n    " : "\n    ");
+    bdifd_json_string(os, ctx[i].first);
+    os << ": ";
+    bdifd_json_string(os, ctx[i].second);
+  }
+  os << "\n  },\n  \"wall_seconds\": " << total
+    << ",\n  \"peak_rss_bytes\": " << rss
+    << ",\n  \"stages\": [";
+  for (unsigned i=0; i < s.stages.size(); ++i) {
+    const stage_entry &e = s.stages[i];
+    os << (i ? ",\n    " : "\n    ") << "{\"name\": ";
+    bdifd_json_string(os, e.name);
+    os << ", \"seconds\": " << e.seconds << ", \"calls\": " << e.calls
+      << ", \"peak_rss_bytes\": " << e.peak_rss << "}";
+  }
+  os << "\n  ],\n  \"counters\": {";
+  for (unsigned i=0; i < s.counters.size(); ++i) {
+    os << (i ? ",\n    " : "\n    ");
+    bdifd_json_string(os, s.counters[i].first);
+    os << ": " << s.counters[i].second;
+  }
+  os << "\n  }\n}\n";
+
+  os.precision(prec);
+  os.flags(f);
+}
+
+bool bdifd_run_report::
+write_json(const std::string &fname, const context &ctx)
+{
+  std::ofstream fp(fname.c_str());
+  if (!fp)
+    return false;
+  write_json(fp, ctx);
+  return bool(fp);
+}
+
+//---------------------------------------------------------------------------
+
+bdifd_stage_timer::
+bdifd_stage_timer(const std::string &name)
+  : name_(name),
+    start_(bdifd_run_report::now()),
+    running_(true)
+{
+}
+
+double bdifd_stage_timer::
+stop()
+{
+  if (!running_)
+    return 0;
+  running_ = false;
+  double dt = bdifd_run_report::now() - start_;
+  bdifd_run_report::add_stage(name_, dt);
+  return dt;
+}
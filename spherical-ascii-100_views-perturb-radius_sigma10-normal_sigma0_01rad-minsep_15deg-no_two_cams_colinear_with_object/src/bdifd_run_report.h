@@ -0,0 +1,72 @@
+// This is bdifd_run_report.h
+#ifndef bdifd_run_report_h
+#define bdifd_run_report_h
+//:
+//\file
+//\brief Stage timings, counters and peak memory of a generator run
+//\date Sun Oct 18 2026
+//
+// Process-wide, so that library code (curve sampling, camera setup,
+// projection) can contribute counters without threading a context object
+// through every signature. Library functions accumulate locally and add once
+// per call; none of this is on a per-sample path.
+//
+// A stage is timed by a bdifd_stage_timer in scope; its wall time is added to
+// the stage of that name and the process peak RSS is sampled when it ends.
+// write_json() produces the run report written next to a dataset.
+//
+
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+class bdifd_run_report {
+public:
+  typedef std::vector<std::pair<std::string, std::string> > context;
+
+  //: Adds \p n to counter \p name, creating it at zero.
+  static void count(const std::string &name, double n=1);
+
+  //: Value of counter \p name, zero if never counted.
+  static double counter(const std::string &name);
+
+  //: Adds \p seconds to stage \p name and samples the peak RSS.
+  static void add_stage(const std::string &name, double seconds);
+
+  //: Peak resident set size of the process so far, in bytes (0 if unknown).
+  static double peak_rss();
+
+  //: Seconds on a monotonic clock since the run started (first call).
+  static double now();
+
+  static void clear();
+
+  //: One line per stage and counter.
+  static void print(std::ostream &os);
+
+  //: JSON report: \p ctx, total wall time since the first stage started,
+  // peak RSS, then the stages and counters in the order they first appeared.
+  static void write_json(std::ostream &os, const context &ctx);
+  static bool write_json(const std::string &fname, const context &ctx);
+};
+
+//: Times its own lifetime (or until stop()) as stage \p name.
+class bdifd_stage_timer {
+public:
+  explicit bdifd_stage_timer(const std::string &name);
+  ~bdifd_stage_timer() { stop(); }
+
+  //: Ends the stage early; returns its duration in seconds.
+  double stop();
+
+private:
+  bdifd_stage_timer(const bdifd_stage_timer &);
+  bdifd_stage_timer &operator=(const bdifd_stage_timer &);
+
+  std::string name_;
+  double start_;
+  bool running_;
+};
+
+#endif // bdifd_run_report_h
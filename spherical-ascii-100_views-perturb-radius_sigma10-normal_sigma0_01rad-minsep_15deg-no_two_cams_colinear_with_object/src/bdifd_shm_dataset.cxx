@@ -0,0 +1,386 @@
+#include "bdifd_shm_dataset.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct bdifd_shm_control {
+  uint32_t magic;
+  uint32_t format;
+  std::atomic<uint64_t> generation;
+};
+
+namespace {
+
+const std::size_t align_bytes = 64;
+
+std::size_t
+align(std::size_t off)
+{
+  return (off + align_bytes - 1)/align_bytes*align_bytes;
+}
+
+bool
+shm_error(const std::string &what, const std::string &seg)
+{
+  std::cerr << "bdifd_shm: error, unable to " << what << " segment " << seg
+    << ": " << std::strerror(errno) << std::endl;
+  return false;
+}
+
+//: Maps data segment \p seg read-only. Sets \p missing if it does not exist,
+// which is expected when a newer generation replaced it meanwhile.
+const void *
+map_segment(const std::string &seg, std::size_t *bytes, bool *missing)
+{
+  *missing = false;
+  int fd = shm_open(seg.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    if (errno == ENOENT)
+      *missing = true;
+    else
+      shm_error("open", seg);
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(bdifd_shm_header))) {
+    std::cerr << "bdifd_shm: error, segment " << seg << " is too small" << std::endl;
+    close(fd);
+    return 0;
+  }
+  void *p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    shm_error("map", seg);
+    return 0;
+  }
+  *bytes = st.st_size;
+  return p;
+}
+
+//: Checks that the header of a mapped segment is consistent with its size.
+bool
+valid_segment(const bdifd_shm_header *h, std::size_t bytes, uint64_t generation)
+{
+  if (h->magic != bdifd_shm_header::magic_number || h->format != bdifd_shm_header::format_version
+      || h->generation != generation || h->bytes != bytes)
+    return false;
+  std::size_t nv = h->nviews, n = h->npts;
+  if (h->off_K + 9*sizeof(double) > bytes || h->off_R + 9*sizeof(double)*nv > bytes
+      || h->off_C + 3*sizeof(double)*nv > bytes || h->off_space + 6*sizeof(double)*n > bytes
+      || h->off_crv_id + sizeof(uint32_t)*n > bytes || h->off_views + sizeof(uint64_t)*nv > bytes)
+    return false;
+  if (!h->has_2d)
+    return true;
+  const uint64_t *views = reinterpret_cast<const uint64_t *>(
+      reinterpret_cast<const unsigned char *>(h) + h->off_views);
+  for (unsigned v=0; v < nv; ++v)
+    if (views[v] + 4*sizeof(double)*n > bytes)
+      return false;
+  return true;
+}
+
+} // namespace
+
+//-----------------------------------------------------------------------------
+// bdifd_shm_dataset
+
+bdifd_shm_dataset::
+bdifd_shm_dataset(const void *base, std::size_t bytes)
+  : base_(static_cast<const unsigned char *>(base)), bytes_(bytes),
+  h_(static_cast<const bdifd_shm_header *>(base))
+{
+}
+
+bdifd_shm_dataset::
+~bdifd_shm_dataset()
+{
+  munmap(const_cast<unsigned char *>(base_), bytes_);
+}
+
+std::string bdifd_shm_dataset::
+segment_name(const std::string &name, uint64_t generation)
+{
+  std::ostringstream s;
+  s << name << "." << generation;
+  return s.str();
+}
+
+std::shared_ptr<const bdifd_shm_dataset> bdifd_shm_dataset::
+attach(const std::string &name, uint64_t generation)
+{
+  std::string seg = segment_name(name, generation);
+  std::size_t bytes;
+  bool missing;
+  const void *p = map_segment(seg, &bytes, &missing);
+  if (!p) {
+    if (missing)
+      std::cerr << "bdifd_shm: error, no segment " << seg << std::endl;
+    return std::shared_ptr<const bdifd_shm_dataset>();
+  }
+  // owned from here on, so an invalid segment is unmapped on return
+  std::shared_ptr<const bdifd_shm_dataset> ds(new bdifd_shm_dataset(p, bytes));
+  if (!valid_segment(ds->h_, bytes, generation)) {
+    std::cerr << "bdifd_shm: error, segment " << seg << " is not a dataset of this format" << std::endl;
+    return std::shared_ptr<const bdifd_shm_dataset>();
+  }
+  return ds;
+}
+
+//-----------------------------------------------------------------------------
+// bdifd_shm_publisher
+
+bdifd_shm_publisher::
+bdifd_shm_publisher(const std::string &name)
+  : name_(name), ctl_(0)
+{
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    shm_error("create", name);
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0
+      || (st.st_size < static_cast<off_t>(sizeof(bdifd_shm_control))
+        && ftruncate(fd, sizeof(bdifd_shm_control)) != 0)) {
+    shm_error("size", name);
+    close(fd);
+    return;
+  }
+  void *p = mmap(0, sizeof(bdifd_shm_control), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    shm_error("map", name);
+    return;
+  }
+
+  // a new segment is zero-filled
+  bdifd_shm_control *c = static_cast<bdifd_shm_control *>(p);
+  if (c->magic == 0) {
+    c->format = bdifd_shm_header::format_version;
+    c->generation.store(0);
+    c->magic = bdifd_shm_header::magic_number;
+  } else if (c->magic != bdifd_shm_header::magic_number || c->format != bdifd_shm_header::format_version) {
+    std::cerr << "bdifd_shm: error, segment " << name << " is not a control segment of this format" << std::endl;
+    munmap(p, sizeof(bdifd_shm_control));
+    return;
+  }
+  ctl_ = c;
+}
+
+bdifd_shm_publisher::
+~bdifd_shm_publisher()
+{
+  if (ctl_)
+    munmap(ctl_, sizeof(bdifd_shm_control));
+}
+
+uint64_t bdifd_shm_publisher::
+generation() const
+{
+  return ctl_ ? ctl_->generation.load(std::memory_order_acquire) : 0;
+}
+
+bool bdifd_shm_publisher::
+publish(const bdifd_ascii_dataset &ds)
+{
+  if (!ctl_)
+    return false;
+
+  std::size_t nv = ds.nviews(), n = ds.npts();
+  bool has_2d = ds.x.size() == nv;
+
+  bdifd_shm_header h;
+  std::memset(&h, 0, sizeof(h));
+  std::size_t off = align(sizeof(h));
+  h.off_K = off;      off = align(off + 9*sizeof(double));
+  h.off_R = off;      off = align(off + 9*sizeof(double)*nv);
+  h.off_C = off;      off = align(off + 3*sizeof(double)*nv);
+  h.off_space = off;  off = align(off + 6*sizeof(double)*n);
+  h.off_crv_id = off; off = align(off + sizeof(uint32_t)*n);
+  h.off_views = off;  off = align(off + sizeof(uint64_t)*nv);
+  std::vector<uint64_t> views(nv, 0);
+  if (has_2d)
+    for (unsigned v=0; v < nv; ++v) {
+      views[v] = off;
+      off = align(off + 4*sizeof(double)*n);
+    }
+
+  uint64_t old = ctl_->generation.load(std::memory_order_acquire);
+  h.magic = bdifd_shm_header::magic_number;
+  h.format = bdifd_shm_header::format_version;
+  h.generation = old + 1;
+  h.bytes = off;
+  h.nviews = nv;
+  h.npts = n;
+  h.has_2d = has_2d;
+  std::strncpy(h.dir, ds.dir.c_str(), sizeof(h.dir) - 1);
+
+  // a leftover of a publisher that died before switching over
+  std::string seg = bdifd_shm_dataset::segment_name(name_, h.generation);
+  shm_unlink(seg.c_str());
+  int fd = shm_open(seg.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+    return shm_error("create", seg);
+  if (ftruncate(fd, h.bytes) != 0) {
+    shm_error("size", seg);
+    close(fd);
+    shm_unlink(seg.c_str());
+    return false;
+  }
+  void *p = mmap(0, h.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    shm_error("map", seg);
+    shm_unlink(seg.c_str());
+    return false;
+  }
+
+  unsigned char *base = static_cast<unsigned char *>(p);
+  double *K = reinterpret_cast<double *>(base + h.off_K);
+  double *R = reinterpret_cast<double *>(base + h.off_R);
+  double *C = reinterpret_cast<double *>(base + h.off_C);
+  std::memcpy(K, ds.K.data_block(), 9*sizeof(double));
+  for (unsigned v=0; v < nv; ++v) {
+    std::memcpy(R + 9*v, ds.R[v].data_block(), 9*sizeof(double));
+    std::memcpy(C + 3*v, ds.C[v].data_block(), 3*sizeof(double));
+  }
+  const std::vector<double> *space[6] = {&ds.X, &ds.Y, &ds.Z, &ds.TX, &ds.TY, &ds.TZ};
+  for (unsigned k=0; k < 6; ++k)
+    if (n)
+      std::memcpy(base + h.off_space + k*n*sizeof(double), &(*space[k])[0], n*sizeof(double));
+  uint32_t *crv_id = reinterpret_cast<uint32_t *>(base + h.off_crv_id);
+  for (unsigned i=0; i < n; ++i)
+    crv_id[i] = ds.crv_id[i];
+  if (nv)
+    std::memcpy(base + h.off_views, &views[0], nv*sizeof(uint64_t));
+  for (unsigned v=0; has_2d && n && v < nv; ++v) {
+    const std::vector<double> *img[4] = {&ds.x[v], &ds.y[v], &ds.tx[v], &ds.ty[v]};
+    for (unsigned k=0; k < 4; ++k)
+      std::memcpy(base + views[v] + k*n*sizeof(double), &(*img[k])[0], n*sizeof(double));
+  }
+  std::memcpy(base, &h, sizeof(h));
+  munmap(p, h.bytes);
+
+  // readers that load the new generation find the segment complete
+  ctl_->generation.store(h.generation, std::memory_order_release);
+  if (old)
+    shm_unlink(bdifd_shm_dataset::segment_name(name_, old).c_str());
+  return true;
+}
+
+void bdifd_shm_publisher::
+unpublish()
+{
+  if (!ctl_)
+    return;
+  uint64_t old = ctl_->generation.exchange(0, std::memory_order_acq_rel);
+  if (old)
+    shm_unlink(bdifd_shm_dataset::segment_name(name_, old).c_str());
+  shm_unlink(name_.c_str());
+}
+
+//-----------------------------------------------------------------------------
+// bdifd_shm_client
+
+bdifd_shm_client::
+bdifd_shm_client(const std::string &name)
+  : name_(name), ctl_(0)
+{
+}
+
+bdifd_shm_client::
+~bdifd_shm_client()
+{
+  if (ctl_)
+    munmap(const_cast<bdifd_shm_control *>(ctl_), sizeof(bdifd_shm_control));
+}
+
+bool bdifd_shm_client::
+open_control()
+{
+  if (ctl_) {
+    munmap(const_cast<bdifd_shm_control *>(ctl_), sizeof(bdifd_shm_control));
+    ctl_ = 0;
+  }
+  int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(bdifd_shm_control))) {
+    close(fd);
+    return false;
+  }
+  void *p = mmap(0, sizeof(bdifd_shm_control), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return false;
+  const bdifd_shm_control *c = static_cast<const bdifd_shm_control *>(p);
+  if (c->magic != bdifd_shm_header::magic_number || c->format != bdifd_shm_header::format_version) {
+    munmap(p, sizeof(bdifd_shm_control));
+    return false;
+  }
+  ctl_ = c;
+  return true;
+}
+
+uint64_t bdifd_shm_client::
+published_generation()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!ctl_ && !open_control())
+    return 0;
+  return ctl_->generation.load(std::memory_order_acquire);
+}
+
+std::shared_ptr<const bdifd_shm_dataset> bdifd_shm_client::
+current()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool reopened = false;
+  if (!ctl_) {
+    if (!open_control())
+      return cur_;
+    reopened = true;
+  }
+
+  for (;;) {
+    uint64_t g = ctl_->generation.load(std::memory_order_acquire);
+    if (g == 0) {
+      // unpublished: the control segment is gone or about to be, so look it
+      // up again next time
+      munmap(const_cast<bdifd_shm_control *>(ctl_), sizeof(bdifd_shm_control));
+      ctl_ = 0;
+      return cur_;
+    }
+    if (cur_ && cur_->generation() == g)
+      return cur_;
+
+    std::string seg = bdifd_shm_dataset::segment_name(name_, g);
+    std::size_t bytes;
+    bool missing;
+    const void *p = map_segment(seg, &bytes, &missing);
+    if (p) {
+      std::shared_ptr<const bdifd_shm_dataset> ds(new bdifd_shm_dataset(p, bytes));
+      if (valid_segment(static_cast<const bdifd_shm_header *>(p), bytes, g))
+        cur_ = ds;
+      else
+        std::cerr << "bdifd_shm: error, segment " << seg << " is not a dataset of this format" << std::endl;
+      return cur_;
+    }
+    if (!missing)
+      return cur_;
+    if (ctl_->generation.load(std::memory_order_acquire) != g)
+      continue;   // replaced between the load and shm_open
+    // The generation is stale: the publisher restarted with a new control
+    // segment. Look it up once more.
+    if (reopened || !open_control())
+      return cur_;
+    reopened = true;
+  }
+}
@@ -0,0 +1,175 @@
+// This is bdifd_shm_dataset.h
+#ifndef bdifd_shm_dataset_h
+#define bdifd_shm_dataset_h
+//:
+//\file
+//\brief A dataset published once in POSIX shared memory, read by many processes
+//\date Sun Oct 18 2026
+//
+// bdifd_shm_publisher writes a bdifd_ascii_dataset into a named shared-memory
+// segment; any number of processes on the node then map it read-only with
+// bdifd_shm_client, with no parsing and no private copy.
+//
+// A name such as "/bdifd" stands for two kinds of segments:
+//
+//  - "/bdifd" itself, the control segment: a magic number and the current
+//    generation, an atomic 64-bit counter.
+//  - "/bdifd.<generation>", one data segment per published version: a
+//    bdifd_shm_header, then K, R and C of every view, the space samples (X, Y,
+//    Z, TX, TY, TZ arrays and curve ids) and, through a table of per-view
+//    offsets, the x, y, tx, ty arrays of each view. Arrays are 64-byte aligned.
+//
+// Publishing fills a fresh data segment, stores its generation in the control
+// segment, then unlinks the previous one. Clients that still map an older
+// generation keep it until they drop it; the next current() call maps the new
+// one, so a reader switches versions atomically between two calls and never
+// sees a half-written dataset. There is a single publisher per name.
+//
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include "bdifd_ascii_dataset.h"
+
+//: Layout of a data segment; offsets are in bytes from its start.
+struct bdifd_shm_header {
+  enum { magic_number = 0x62646673, format_version = 1 };
+
+  uint32_t magic;
+  uint32_t format;
+  uint64_t generation;
+  uint64_t bytes;       //:< whole segment
+  uint32_t nviews;
+  uint32_t npts;
+  uint32_t has_2d;
+  uint32_t reserved;
+  uint64_t off_K;       //:< 9 doubles, row-major
+  uint64_t off_R;       //:< 9 doubles per view
+  uint64_t off_C;       //:< 3 doubles per view
+  uint64_t off_space;   //:< X, Y, Z, TX, TY, TZ, npts doubles each
+  uint64_t off_crv_id;  //:< npts uint32
+  uint64_t off_views;   //:< nviews offsets to x, y, tx, ty (npts doubles each)
+  char dir[256];        //:< dataset directory, for diagnostics
+};
+
+//: One mapped generation. Everything points into the read-only mapping, which
+// lasts as long as the object.
+class bdifd_shm_dataset {
+public:
+  ~bdifd_shm_dataset();
+
+  //: Maps generation \p generation of \p name; null (with a message on
+  // std::cerr) if it does not exist or is not a valid data segment.
+  static std::shared_ptr<const bdifd_shm_dataset>
+  attach(const std::string &name, uint64_t generation);
+
+  //: Name of the data segment of \p generation.
+  static std::string segment_name(const std::string &name, uint64_t generation);
+
+  uint64_t generation() const { return h_->generation; }
+  unsigned nviews() const { return h_->nviews; }
+  unsigned npts() const { return h_->npts; }
+  bool has_2d() const { return h_->has_2d != 0; }
+  std::size_t bytes() const { return bytes_; }
+  std::string dir() const { return std::string(h_->dir); }
+
+  const double *K() const { return at<double>(h_->off_K); }
+  const double *R(unsigned v) const { return at<double>(h_->off_R) + 9*v; }
+  const double *C(unsigned v) const { return at<double>(h_->off_C) + 3*v; }
+
+  const double *X() const { return space(0); }
+  const double *Y() const { return space(1); }
+  const double *Z() const { return space(2); }
+  const double *TX() const { return space(3); }
+  const double *TY() const { return space(4); }
+  const double *TZ() const { return space(5); }
+  const uint32_t *crv_id() const { return at<uint32_t>(h_->off_crv_id); }
+
+  //: Image samples of view \p v; only if has_2d().
+  const double *x(unsigned v) const { return image(v, 0); }
+  const double *y(unsigned v) const { return image(v, 1); }
+  const double *tx(unsigned v) const { return image(v, 2); }
+  const double *ty(unsigned v) const { return image(v, 3); }
+
+private:
+  friend class bdifd_shm_client;
+
+  bdifd_shm_dataset(const void *base, std::size_t bytes);
+  bdifd_shm_dataset(const bdifd_shm_dataset &);
+  bdifd_shm_dataset &operator=(const bdifd_shm_dataset &);
+
+  template <class T> const T *
+  at(uint64_t off) const { return reinterpret_cast<const T *>(base_ + off); }
+
+  const double *space(unsigned k) const { return at<double>(h_->off_space) + std::size_t(k)*h_->npts; }
+
+  const double *
+  image(unsigned v, unsigned k) const
+  { return at<double>(at<uint64_t>(h_->off_views)[v]) + std::size_t(k)*h_->npts; }
+
+  const unsigned char *base_;
+  std::size_t bytes_;
+  const bdifd_shm_header *h_;
+};
+
+//: Shared state of the control segment.
+struct bdifd_shm_control;
+
+class bdifd_shm_publisher {
+public:
+  //: Creates the control segment of \p name if needed; generations continue
+  // from the one found there.
+  explicit bdifd_shm_publisher(const std::string &name);
+  ~bdifd_shm_publisher();
+
+  //: False if the control segment could not be set up.
+  bool ok() const { return ctl_ != 0; }
+
+  //: Writes \p ds as the next generation and makes it current. Returns false
+  // (with a message on std::cerr) and leaves the current one if it fails.
+  bool publish(const bdifd_ascii_dataset &ds);
+
+  //: Unlinks the current data segment and the control segment. Readers that
+  // map them keep their copy.
+  void unpublish();
+
+  //: Current generation, 0 if none.
+  uint64_t generation() const;
+
+private:
+  bdifd_shm_publisher(const bdifd_shm_publisher &);
+  bdifd_shm_publisher &operator=(const bdifd_shm_publisher &);
+
+  std::string name_;
+  bdifd_shm_control *ctl_;
+};
+
+class bdifd_shm_client {
+public:
+  explicit bdifd_shm_client(const std::string &name);
+  ~bdifd_shm_client();
+
+  //: The latest published generation, mapped on first use. If nothing is
+  // published (yet, or any more) this is the last one mapped, or null.
+  // Callers keep the returned pointer for as long as they read from it;
+  // current() may be called from several threads.
+  std::shared_ptr<const bdifd_shm_dataset> current();
+
+  //: Generation in the control segment, 0 if none is published.
+  uint64_t published_generation();
+
+private:
+  bdifd_shm_client(const bdifd_shm_client &);
+  bdifd_shm_client &operator=(const bdifd_shm_client &);
+
+  bool open_control();
+
+  std::string name_;
+  std::mutex mutex_;
+  const bdifd_shm_control *ctl_;
+  std::shared_ptr<const bdifd_shm_dataset> cur_;
+};
+
+#endif // bdifd_shm_dataset_h
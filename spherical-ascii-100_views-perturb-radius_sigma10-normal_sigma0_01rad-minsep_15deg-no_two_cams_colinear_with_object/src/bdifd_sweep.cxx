@@ -0,0 +1,458 @@
+#include "bdifd_sweep.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <vnl/vnl_math.h>
+#include <vnl/vnl_random.h>
+#include <vul/vul_file.h>
+#include <bdifd/bdifd_camera.h>
+#include <bmcsd/bmcsd_util.h>
+#include "bdifd_ascii_dataset.h"
+#include "bdifd_log.h"
+#include "bdifd_run_report.h"
+#include "bdifd_work_pool.h"
+
+namespace {
+
+//: Samples of one sampling density, shared by all variants at it.
+struct scene {
+  double density;
+  std::vector<bdifd_3rd_order_point_3d> pts;    //:< in sample order
+  std::string pts_txt, tgts_txt, ids_txt;       //:< crv-3D-pts, -tgts, crv-ids
+  std::vector<unsigned> groups;
+};
+
+//: Cameras and projected views shared by variants differing only in noise.
+struct group {
+  unsigned scene;
+  bdifd_sweep_variant params;
+  std::vector<vpgl_perspective_camera<double> > cams;
+  std::vector<std::vector<bdifd_3rd_order_point_2d> > views;
+  std::vector<unsigned> variants;
+  std::atomic<unsigned> to_project;
+  std::atomic<unsigned> to_write;     //:< views of all its variants
+};
+
+struct sweep {
+  const std::vector<bdifd_sweep_variant> *variants;
+  std::string outdir;
+  unsigned seed;
+  std::vector<std::unique_ptr<scene> > scenes;
+  std::vector<std::unique_ptr<group> > groups;
+  std::vector<unsigned> group_of;     //:< per variant
+  std::atomic<bool> ok;
+  bdifd_work_pool pool;
+
+  explicit sweep(unsigned nthreads) : seed(0), ok(true), pool(nthreads) {}
+};
+
+bool
+write_text(const std::string &fname, const std::string &s)
+{
+  std::ofstream fp(fname.c_str());
+  fp << s;
+  if (!fp) {
+    std::cerr << "bdifd_sweep: error, unable to write file name " << fname << std::endl;
+    return false;
+  }
+  bdifd_run_report::count("bytes_written", s.size());
+  return true;
+}
+
+std::string
+variant_dir(const sweep &sw, unsigned v)
+{
+  return sw.outdir + "/" + (*sw.variants)[v].name();
+}
+
+//: Adds the noise of variant \p v to view \p k and writes its 2D files.
+void
+write_view(sweep *sw, unsigned v, unsigned k)
+{
+  group &g = *sw->groups[sw->group_of[v]];
+  const bdifd_sweep_variant &p = (*sw->variants)[v];
+  const std::vector<bdifd_3rd_order_point_2d> &view = g.views[k];
+
+  // same draws for every variant, so noise levels are comparable sample by
+  // sample
+  vnl_random rng(2654435761ul*sw->seed + 40503ul*k + 1);
+  double dth = p.tgt_noise*vnl_math::pi/180;
+  std::ostringstream pts, tgts;
+  pts << std::setprecision(20);
+  tgts << std::setprecision(20);
+  for (unsigned i=0; i < view.size(); ++i) {
+    double ex = rng.drand64(-1, 1), ey = rng.drand64(-1, 1), eth = rng.drand64(-1, 1);
+    double tx = view[i].t[0], ty = view[i].t[1];
+    if (dth > 0) {
+      double c = std::cos(eth*dth), s = std::sin(eth*dth);
+      tx = c*view[i].t[0] - s*view[i].t[1];
+      ty = s*view[i].t[0] + c*view[i].t[1];
+    }
+    pts << view[i].gama[0] + p.pos_noise*ex << " " << view[i].gama[1] + p.pos_noise*ey << std::endl;
+    tgts << tx << " " << ty << std::endl;
+  }
+
+  std::string base = variant_dir(*sw, v) + "/" + bdifd_ascii_dataset::view_name(k);
+  if (!write_text(base + "-pts-2D.txt", pts.str()) || !write_text(base + "-tgts-2D.txt", tgts.str()))
+    sw->ok = false;
+
+  if (--g.to_write == 0)
+    std::vector<std::vector<bdifd_3rd_order_point_2d> >().swap(g.views);
+}
+
+//: Writes the cameras and 3D files of variant \p v, then its views.
+void
+write_variant(sweep *sw, unsigned v)
+{
+  group &g = *sw->groups[sw->group_of[v]];
+  const scene &sc = *sw->scenes[g.scene];
+  std::string dir = variant_dir(*sw, v);
+  vul_file::make_directory(dir);
+  bool ok = bmcsd_util::write_cams(dir, "frame_", bmcsd_util::BMCS_INTRINSIC_EXTRINSIC, g.cams);
+  if (!ok)
+    std::cerr << "bdifd_sweep: error, unable to write cameras in " << dir << std::endl;
+  ok = ok && write_text(dir + "/crv-3D-pts.txt", sc.pts_txt)
+    && write_text(dir + "/crv-3D-tgts.txt", sc.tgts_txt)
+    && write_text(dir + "/crv-ids.txt", sc.ids_txt);
+  if (!ok) {
+    // keep the counts right so that the views are still freed
+    sw->ok = false;
+    if ((g.to_write -= g.cams.size()) == 0)
+      std::vector<std::vector<bdifd_3rd_order_point_2d> >().swap(g.views);
+    return;
+  }
+  bdifd_run_report::count("variants_written");
+
+  for (unsigned k=0; k < g.cams.size(); ++k)
+    sw->pool.submit([sw, v, k]() { write_view(sw, v, k); });
+}
+
+//: Projects the scene into view \p k of group \p gi; the last view starts
+// the variants.
+void
+project_view(sweep *sw, unsigned gi, unsigned k)
+{
+  group &g = *sw->groups[gi];
+  const scene &sc = *sw->scenes[g.scene];
+  bdifd_camera cam;
+  cam.set_p(g.cams[k]);
+  std::vector<bdifd_3rd_order_point_2d> &view = g.views[k];
+  view.resize(sc.pts.size());
+  unsigned nculled = 0;
+  for (unsigned i=0; i < sc.pts.size(); ++i) {
+    bool not_degenerate;
+    view[i] = cam.project_to_image(sc.pts[i], &not_degenerate);
+    nculled += !not_degenerate;
+  }
+  bdifd_run_report::count("samples_projected", sc.pts.size());
+  bdifd_run_report::count("samples_culled", nculled);
+
+  if (--g.to_project == 0)
+    for (unsigned j=0; j < g.variants.size(); ++j) {
+      unsigned v = g.variants[j];
+      sw->pool.submit([sw, v]() { write_variant(sw, v); });
+    }
+}
+
+//: Cameras of group \p gi, then one projection per view.
+void
+make_cameras(sweep *sw, unsigned gi)
+{
+  group &g = *sw->groups[gi];
+  const bdifd_sweep_variant &p = g.params;
+  vnl_double_3x3 Kmatrix;
+  bdifd_turntable::internal_calib_olympus(Kmatrix, p.x_max_scaled, p.crop_x, p.crop_y);
+  vpgl_calibration_matrix<double> K(Kmatrix);
+  bdifd_turntable::cameras_olympus_spherical(&g.cams, K, p.cams, p.minsep, p.perturb, sw->seed);
+  bdifd_run_report::count("camera_sets");
+
+  unsigned nviews = g.cams.size();
+  g.views.resize(nviews);
+  g.to_project = nviews;
+  g.to_write = nviews*g.variants.size();
+  for (unsigned k=0; k < nviews; ++k)
+    sw->pool.submit([sw, gi, k]() { project_view(sw, gi, k); });
+}
+
+//: Samples and formats scene \p si, then sets up its camera groups.
+void
+sample_scene(sweep *sw, unsigned si)
+{
+  scene &sc = *sw->scenes[si];
+  std::vector<std::vector<bdifd_3rd_order_point_3d> > crv3d;
+  bdifd_data::space_curves_olympus_turntable(crv3d, sc.density);
+  bdifd_run_report::count("scenes_sampled");
+
+  std::ostringstream pts, tgts, ids;
+  pts << std::setprecision(20);
+  tgts << std::setprecision(20);
+  for (unsigned i=0; i < crv3d.size(); ++i)
+    for (unsigned j=0; j < crv3d[i].size(); ++j) {
+      const bdifd_3rd_order_point_3d &q = crv3d[i][j];
+      sc.pts.push_back(q);
+      pts << q.Gama[0] << " " << q.Gama[1] << " " << q.Gama[2] << std::endl;
+      tgts << q.T[0] << " " << q.T[1] << " " << q.T[2] << std::endl;
+      ids << i << std::endl;
+    }
+  sc.pts_txt = pts.str();
+  sc.tgts_txt = tgts.str();
+  sc.ids_txt = ids.str();
+
+  for (unsigned j=0; j < sc.groups.size(); ++j) {
+    unsigned gi = sc.groups[j];
+    sw->pool.submit([sw, gi]() { make_cameras(sw, gi); });
+  }
+}
+
+//: Checks \p v against [lo, hi] and, if \p integral, for being a whole number.
+bool
+in_range(const std::vector<double> &v, double lo, double hi, bool integral=false)
+{
+  for (unsigned i=0; i < v.size(); ++i)
+    if (!(v[i] >= lo && v[i] <= hi) || (integral && v[i] != std::floor(v[i])))
+      return false;
+  return !v.empty();
+}
+
+//: False if two different values of \p v have the same name, i.e. differ
+// only beyond the decimals kept in folder names.
+bool
+distinct_names(const std::vector<double> &v)
+{
+  std::map<std::string, double> names;
+  for (unsigned i=0; i < v.size(); ++i) {
+    std::pair<std::map<std::string, double>::iterator, bool> r
+      = names.insert(std::make_pair(bdifd_sweep::number_name(v[i]), v[i]));
+    if (!r.second && r.first->second != v[i])
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+std::string bdifd_sweep::
+number_name(double x)
+{
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(6) << x;
+  std::string s = os.str();
+  if (s.find('.') != std::string::npos) {
+    s.erase(s.find_last_not_of('0') + 1);
+    if (s[s.size()-1] == '.')
+      s.erase(s.size()-1);
+  }
+  for (unsigned i=0; i < s.size(); ++i)
+    if (s[i] == '.')
+      s[i] = '_';
+  return s;
+}
+
+bool bdifd_sweep::
+parse_list(const std::string &s, std::vector<double> *v)
+{
+  std::vector<double> r;
+  const char *p = s.c_str();
+  while (*p) {
+    char *q;
+    double x = std::strtod(p, &q);
+    if (q == p || !(x >= 0))
+      return false;
+    r.push_back(x);
+    p = q;
+    if (*p == ',' && p[1])
+      ++p;
+    else if (*p)
+      return false;
+  }
+  if (r.empty())
+    return false;
+  *v = r;
+  return true;
+}
+
+std::string bdifd_sweep_variant::
+name() const
+{
+  std::ostringstream os;
+  os << "spherical-ascii-" << cams.nviews << "_views";
+  if (perturb)
+    os << "-perturb-radius_sigma" << bdifd_sweep::number_name(cams.radius_sigma)
+      << "-normal_sigma" << bdifd_sweep::number_name(cams.normal_sigma) << "rad";
+  if (minsep)
+    os << "-minsep_" << bdifd_sweep::number_name(cams.minsep_deg)
+      << "deg-no_two_cams_colinear_with_object";
+  if (density != 1)
+    os << "-density" << bdifd_sweep::number_name(density);
+  if (pos_noise || tgt_noise)
+    os << "-pos_noise" << bdifd_sweep::number_name(pos_noise)
+      << "px-tgt_noise" << bdifd_sweep::number_name(tgt_noise) << "deg";
+  bdifd_sweep_variant d;
+  if (x_max_scaled != d.x_max_scaled || crop_x != d.crop_x || crop_y != d.crop_y)
+    os << "-scale" << bdifd_sweep::number_name(x_max_scaled) << "px-crop" << crop_x << "_" << crop_y;
+  return os.str();
+}
+
+std::string bdifd_sweep_variant::
+camera_key() const
+{
+  bdifd_sweep_variant v = *this;
+  v.pos_noise = v.tgt_noise = 0;
+  return v.name();
+}
+
+bdifd_sweep_grid::
+bdifd_sweep_grid()
+  : perturb(true), minsep(true)
+{
+  bdifd_sweep_variant d;
+  nviews.push_back(d.cams.nviews);
+  radius_sigma.push_back(d.cams.radius_sigma);
+  normal_sigma.push_back(d.cams.normal_sigma);
+  minsep_deg.push_back(d.cams.minsep_deg);
+  density.push_back(d.density);
+  pos_noise.push_back(d.pos_noise);
+  tgt_noise.push_back(d.tgt_noise);
+  x_max_scaled.push_back(d.x_max_scaled);
+  crop.push_back(std::make_pair(d.crop_x, d.crop_y));
+}
+
+bool bdifd_sweep_grid::
+set(const std::string &param, const std::string &list)
+{
+  if (param == "crop") {
+    // pairs XxY; the crop must leave the principal point inside the image
+    std::vector<std::pair<unsigned, unsigned> > r;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      unsigned x, y;
+      char sep, rest;
+      std::istringstream is(item);
+      if (!(is >> x >> sep >> y) || sep != 'x' || (is >> rest) || x >= 860 || y >= 1412)
+        return false;
+      r.push_back(std::make_pair(x, y));
+    }
+    if (r.empty())
+      return false;
+    crop = r;
+    return true;
+  }
+
+  std::vector<double> v;
+  if (!bdifd_sweep::parse_list(list, &v) || !distinct_names(v))
+    return false;
+  if (param == "nviews" && in_range(v, 1, 100000, true))
+    nviews = v;
+  else if (param == "radius_sigma" && in_range(v, 0, 1e3))
+    radius_sigma = v;
+  else if (param == "normal_sigma" && in_range(v, 0, 1))
+    normal_sigma = v;
+  // at 90 degrees or more every camera would be rejected
+  else if (param == "minsep" && in_range(v, 0, 89.999999))
+    minsep_deg = v;
+  else if (param == "density" && in_range(v, 1e-3, 1e3))
+    density = v;
+  else if (param == "pos_noise" && in_range(v, 0, 1e3))
+    pos_noise = v;
+  else if (param == "tgt_noise" && in_range(v, 0, 180))
+    tgt_noise = v;
+  else if (param == "scale" && in_range(v, 2, 1e5))
+    x_max_scaled = v;
+  else
+    return false;
+  return true;
+}
+
+void bdifd_sweep_grid::
+variants(std::vector<bdifd_sweep_variant> *out) const
+{
+  out->clear();
+  std::set<std::string> seen;
+  unsigned long ndup = 0;
+  bdifd_sweep_variant p;
+  p.perturb = perturb;
+  p.minsep = minsep;
+  for (unsigned a=0; a < density.size(); ++a)
+  for (unsigned b=0; b < nviews.size(); ++b)
+  for (unsigned c=0; c < radius_sigma.size(); ++c)
+  for (unsigned d=0; d < normal_sigma.size(); ++d)
+  for (unsigned e=0; e < minsep_deg.size(); ++e)
+  for (unsigned f=0; f < x_max_scaled.size(); ++f)
+  for (unsigned g=0; g < crop.size(); ++g)
+  for (unsigned h=0; h < pos_noise.size(); ++h)
+  for (unsigned i=0; i < tgt_noise.size(); ++i) {
+    p.density = density[a];
+    p.cams.nviews = static_cast<unsigned>(nviews[b]);
+    p.cams.radius_sigma = radius_sigma[c];
+    p.cams.normal_sigma = normal_sigma[d];
+    p.cams.minsep_deg = minsep_deg[e];
+    p.x_max_scaled = x_max_scaled[f];
+    p.crop_x = crop[g].first;
+    p.crop_y = crop[g].second;
+    p.pos_noise = pos_noise[h];
+    p.tgt_noise = tgt_noise[i];
+    if (seen.insert(p.name()).second)
+      out->push_back(p);
+    else
+      ++ndup;
+  }
+  // repeated values, or sigmas without -perturb and separations without
+  // -minsep, which do not change the data
+  if (ndup) {
+    bdifd_log_msg(warn) << "bdifd_sweep: " << ndup
+      << " combinations repeat the folder name of another and are generated once" << std::endl;
+  }
+}
+
+bool bdifd_sweep::
+run(const std::vector<bdifd_sweep_variant> &variants,
+    const std::string &outdir, unsigned seed, unsigned nthreads)
+{
+  sweep sw(nthreads);
+  sw.variants = &variants;
+  sw.outdir = outdir;
+  sw.seed = seed;
+  if (variants.empty())
+    return true;
+  vul_file::make_directory(outdir);
+
+  // one scene per density, one group per set of cameras
+  std::map<double, unsigned> scene_of;
+  std::map<std::string, unsigned> group_of;
+  sw.group_of.resize(variants.size());
+  for (unsigned v=0; v < variants.size(); ++v) {
+    std::string key = variants[v].camera_key();
+    std::map<std::string, unsigned>::const_iterator it = group_of.find(key);
+    if (it == group_of.end()) {
+      std::map<double, unsigned>::const_iterator s = scene_of.find(variants[v].density);
+      if (s == scene_of.end()) {
+        s = scene_of.insert(std::make_pair(variants[v].density, unsigned(sw.scenes.size()))).first;
+        sw.scenes.push_back(std::unique_ptr<scene>(new scene));
+        sw.scenes.back()->density = variants[v].density;
+      }
+      it = group_of.insert(std::make_pair(key, unsigned(sw.groups.size()))).first;
+      sw.groups.push_back(std::unique_ptr<group>(new group));
+      sw.groups.back()->scene = s->second;
+      sw.groups.back()->params = variants[v];
+      sw.scenes[s->second]->groups.push_back(it->second);
+    }
+    sw.group_of[v] = it->second;
+    sw.groups[it->second]->variants.push_back(v);
+  }
+
+  for (unsigned si=0; si < sw.scenes.size(); ++si) {
+    sweep *p = &sw;
+    sw.pool.submit([p, si]() { sample_scene(p, si); });
+  }
+  sw.pool.wait();
+  bdifd_run_report::count("tasks_stolen", sw.pool.steals());
+  return sw.ok;
+}
@@ -0,0 +1,109 @@
+// This is bdifd_sweep.h
+#ifndef bdifd_sweep_h
+#define bdifd_sweep_h
+//:
+//\file
+//\brief Parameter sweeps generating many variants of the spherical dataset
+//\date Sun Oct 18 2026
+//
+// A variant is the spherical dataset of generate_synth_sequence_3 with other
+// camera parameters (bdifd_spherical_params), image noise, sampling density
+// or crop and scale of internal_calib_olympus. Its folder is named the way
+// the published one is, e.g.
+//
+//   spherical-ascii-100_views-perturb-radius_sigma10-normal_sigma0_01rad-minsep_15deg-no_two_cams_colinear_with_object
+//
+// with '.' written as '_'. Parameters at their published values add nothing
+// to the name; otherwise -density2, -pos_noise0_5px-tgt_noise1deg and
+// -scale500px-crop400_900 follow, in that order.
+//
+// bdifd_sweep_grid holds a list of values per parameter; the sweep is their
+// cartesian product. bdifd_sweep::run() generates it on a bdifd_work_pool:
+//
+//  - each sampling density is sampled once and its 3D and crv-ids files
+//    formatted once, for all variants at that density;
+//  - variants that differ only in noise share their cameras and projected
+//    views, which are computed one task per view;
+//  - each variant writes its cameras and 3D files, then one task per view
+//    adds its noise and writes frame_NNNN-pts-2D.txt and -tgts-2D.txt.
+//
+// Since workers run their own newest task first, a worker finishes the
+// views of one set of cameras before starting another, so only about one
+// set of projected views per thread is held at a time; each is freed when
+// its last view is written.
+//
+// All camera sets use the same seed, so variants differ only by the
+// parameters changed: with equal sigmas the first n cameras of a sweep over
+// nviews are the same for every n. Noise is uniform in (-pos_noise,
+// pos_noise) pixels per coordinate and (-tgt_noise, tgt_noise) degrees of
+// tangent rotation, as in the README, and drawn from the seed and view alone,
+// so a sample gets the same draw, scaled, at every noise level. A variant
+// folder holds the cameras, crv-ids.txt and the 3D and 2D point and tangent
+// files, in the layout of generate_synth_sequence_3.
+//
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "bdifd_data.h"
+
+struct bdifd_sweep_variant {
+  bdifd_spherical_params cams;
+  bool perturb;             //:< perturb camera distance and direction
+  bool minsep;              //:< enforce cams.minsep_deg
+  double density;           //:< curve sampling density, 1 is published
+  double pos_noise;         //:< pixels
+  double tgt_noise;         //:< degrees
+  double x_max_scaled;      //:< as for internal_calib_olympus
+  unsigned crop_x, crop_y;
+
+  bdifd_sweep_variant()
+    : perturb(true), minsep(true), density(1), pos_noise(0), tgt_noise(0),
+    x_max_scaled(500), crop_x(400), crop_y(900) {}
+
+  //: Canonical folder name.
+  std::string name() const;
+
+  //: Variants with the same key share cameras and projected views.
+  std::string camera_key() const;
+};
+
+struct bdifd_sweep_grid {
+  std::vector<double> nviews, radius_sigma, normal_sigma, minsep_deg, density;
+  std::vector<double> pos_noise, tgt_noise, x_max_scaled;
+  std::vector<std::pair<unsigned, unsigned> > crop;
+  bool perturb, minsep;
+
+  //: The published dataset alone.
+  bdifd_sweep_grid();
+
+  //: Sets the values of parameter \p param (nviews, radius_sigma,
+  // normal_sigma, minsep, density, pos_noise, tgt_noise, scale or crop) from
+  // the comma separated \p list; crop takes pairs XxY. False, leaving the
+  // grid unchanged, on an unknown name, a malformed list, a value out of
+  // range, or two different values that differ only beyond the six decimals
+  // of folder names (they would land in one folder).
+  bool set(const std::string &param, const std::string &list);
+
+  //: Every combination, noise varying fastest, once per folder name; how
+  // many repeats were dropped is logged as a warning.
+  void variants(std::vector<bdifd_sweep_variant> *v) const;
+};
+
+class bdifd_sweep {
+public:
+  //: Comma separated non-negative numbers. False on anything else.
+  static bool parse_list(const std::string &s, std::vector<double> *v);
+
+  //: \p x as in folder names: up to six decimals, '.' as '_'.
+  static std::string number_name(double x);
+
+  //: Generates \p variants, each into \p outdir/name(), with camera seed
+  // \p seed (not 0) on \p nthreads threads (0 = one per core). Errors are
+  // printed to std::cerr; returns false if any file could not be written.
+  // Scenes, camera sets, views and bytes are added to bdifd_run_report.
+  static bool run(const std::vector<bdifd_sweep_variant> &variants,
+      const std::string &outdir, unsigned seed, unsigned nthreads=0);
+};
+
+#endif // bdifd_sweep_h
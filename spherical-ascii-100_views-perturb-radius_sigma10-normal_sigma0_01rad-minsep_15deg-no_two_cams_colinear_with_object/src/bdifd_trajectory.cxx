@@ -0,0 +1,265 @@
+#include "bdifd_trajectory.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+//: Unit quaternion (w, x, y, z) of rotation matrix \p R (Shepperd's method).
+void
+to_quaternion(const vnl_double_3x3 &R, double q[4])
+{
+  double tr = R[0][0] + R[1][1] + R[2][2];
+  if (tr > 0) {
+    double s = 2*std::sqrt(tr + 1);
+    q[0] = s/4;
+    q[1] = (R[2][1] - R[1][2])/s;
+    q[2] = (R[0][2] - R[2][0])/s;
+    q[3] = (R[1][0] - R[0][1])/s;
+  } else if (R[0][0] > R[1][1] && R[0][0] > R[2][2]) {
+    double s = 2*std::sqrt(1 + R[0][0] - R[1][1] - R[2][2]);
+    q[0] = (R[2][1] - R[1][2])/s;
+    q[1] = s/4;
+    q[2] = (R[0][1] + R[1][0])/s;
+    q[3] = (R[0][2] + R[2][0])/s;
+  } else if (R[1][1] > R[2][2]) {
+    double s = 2*std::sqrt(1 + R[1][1] - R[0][0] - R[2][2]);
+    q[0] = (R[0][2] - R[2][0])/s;
+    q[1] = (R[0][1] + R[1][0])/s;
+    q[2] = s/4;
+    q[3] = (R[1][2] + R[2][1])/s;
+  } else {
+    double s = 2*std::sqrt(1 + R[2][2] - R[0][0] - R[1][1]);
+    q[0] = (R[1][0] - R[0][1])/s;
+    q[1] = (R[0][2] + R[2][0])/s;
+    q[2] = (R[1][2] + R[2][1])/s;
+    q[3] = s/4;
+  }
+  double n = std::sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+  for (unsigned i=0; i < 4; ++i)
+    q[i] /= n;
+}
+
+void
+to_matrix(const double q[4], double R[3][3])
+{
+  double w = q[0], x = q[1], y = q[2], z = q[3];
+  R[0][0] = 1 - 2*(y*y + z*z);
+  R[0][1] = 2*(x*y - w*z);
+  R[0][2] = 2*(x*z + w*y);
+  R[1][0] = 2*(x*y + w*z);
+  R[1][1] = 1 - 2*(x*x + z*z);
+  R[1][2] = 2*(y*z - w*x);
+  R[2][0] = 2*(x*z - w*y);
+  R[2][1] = 2*(y*z + w*x);
+  R[2][2] = 1 - 2*(x*x + y*y);
+}
+
+//: Shortest-arc spherical interpolation from \p a (s = 0) to \p b (s = 1).
+void
+slerp(const double a[4], const double b[4], double s, double q[4])
+{
+  double c = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+  double sg = 1;
+  if (c < 0) {
+    c = -c;
+    sg = -1;
+  }
+  double wa, wb;
+  if (c > 1 - 1e-12) {
+    // nearly equal: linear, renormalized below
+    wa = 1 - s;
+    wb = s;
+  } else {
+    double th = std::acos(c), sn = std::sin(th);
+    wa = std::sin((1 - s)*th)/sn;
+    wb = std::sin(s*th)/sn;
+  }
+  double n = 0;
+  for (unsigned i=0; i < 4; ++i) {
+    q[i] = wa*a[i] + sg*wb*b[i];
+    n += q[i]*q[i];
+  }
+  n = std::sqrt(n);
+  for (unsigned i=0; i < 4; ++i)
+    q[i] /= n;
+}
+
+//: Image point and unit image tangent of camera-frame point and tangent,
+// through lens distortion \p d if not null.
+inline void
+project_one(const double K[3][3], const bdifd_lens_distortion *d,
+    double xc, double yc, double zc, double txc, double tyc, double tzc,
+    double *x, double *y, double *tx, double *ty)
+{
+  double u = xc/zc, v = yc/zc;
+  // derivative of (u, v) along the tangent, up to the positive factor 1/zc
+  double du = txc - u*tzc, dv = tyc - v*tzc;
+  if (d)
+    d->distort(u, v, du, dv, &u, &v, &du, &dv);
+  *x = K[0][0]*u + K[0][1]*v + K[0][2];
+  *y = K[1][1]*v + K[1][2];
+  double gx = K[0][0]*du + K[0][1]*dv, gy = K[1][1]*dv;
+  double n = std::sqrt(gx*gx + gy*gy);
+  *tx = gx/n;
+  *ty = gy/n;
+}
+
+}
+
+//---------------------------------------------------------------------------
+
+void bdifd_trajectory::
+add_key(const vnl_double_3x3 &R, const vnl_double_3 &C)
+{
+  double q[4];
+  to_quaternion(R, q);
+  C_.push_back(C);
+  q_.insert(q_.end(), q, q + 4);
+}
+
+void bdifd_trajectory::
+pose(double u, double R[3][3], double C[3]) const
+{
+  unsigned n = nkeys();
+  if (!n)
+    return;
+  u = std::max(0.0, std::min(u, double(n - 1)));
+  unsigned k = std::min(static_cast<unsigned>(u), n > 1 ? n - 2 : 0);
+  double s = u - k;
+
+  if (n == 1) {
+    to_matrix(&q_[0], R);
+    for (unsigned r=0; r < 3; ++r)
+      C[r] = C_[0][r];
+    return;
+  }
+
+  double q[4];
+  slerp(&q_[4*k], &q_[4*(k+1)], s, q);
+  to_matrix(q, R);
+
+  // Catmull-Rom through keys k-1..k+2, end keys repeated
+  const vnl_double_3 &p0 = C_[k ? k-1 : 0], &p1 = C_[k], &p2 = C_[k+1],
+    &p3 = C_[k+2 < n ? k+2 : n-1];
+  double s2 = s*s, s3 = s2*s;
+  for (unsigned r=0; r < 3; ++r)
+    C[r] = 0.5*(2*p1[r] + (p2[r] - p0[r])*s
+        + (2*p0[r] - 5*p1[r] + 4*p2[r] - p3[r])*s2
+        + (3*p1[r] - p0[r] - 3*p2[r] + p3[r])*s3);
+}
+
+void bdifd_trajectory::
+poses(unsigned n, double *R, double *C) const
+{
+  double len = nkeys() ? nkeys() - 1 : 0;
+  for (unsigned i=0; i < n; ++i) {
+    double u = n > 1 ? len*i/(n - 1) : 0;
+    double Ri[3][3];
+    pose(u, Ri, C + 3*i);
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned c=0; c < 3; ++c)
+        R[9*i + 3*r + c] = Ri[r][c];
+  }
+}
+
+//---------------------------------------------------------------------------
+
+bdifd_trajectory_projector::
+bdifd_trajectory_projector(const vnl_double_3x3 &K, const bdifd_3d_soa &X)
+  : X_(X),
+  xc_(X.size()), yc_(X.size()), zc_(X.size()),
+  txc_(X.size()), tyc_(X.size()), tzc_(X.size())
+{
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c)
+      K_[r][c] = K[r][c];
+}
+
+void bdifd_trajectory_projector::
+set_distortion(const bdifd_lens_distortion &d)
+{
+  d_ = d;
+}
+
+void bdifd_trajectory_projector::
+motion(const double R0[3][3], const double C0[3],
+    const double R[3][3], const double C[3], double L[3][3], double d[3])
+{
+  double dC[3] = { C[0] - C0[0], C[1] - C0[1], C[2] - C0[2] };
+  for (unsigned r=0; r < 3; ++r) {
+    d[r] = R[r][0]*dC[0] + R[r][1]*dC[1] + R[r][2]*dC[2];
+    for (unsigned c=0; c < 3; ++c)
+      L[r][c] = R[r][0]*R0[c][0] + R[r][1]*R0[c][1] + R[r][2]*R0[c][2];
+  }
+}
+
+void bdifd_trajectory_projector::
+project(const double R[3][3], const double C[3],
+    unsigned begin, unsigned end, bdifd_2d_soa *x) const
+{
+  const double *X = &X_.X[0], *Y = &X_.Y[0], *Z = &X_.Z[0];
+  const double *TX = &X_.Tx[0], *TY = &X_.Ty[0], *TZ = &X_.Tz[0];
+  double *ox = &x->x[0], *oy = &x->y[0], *otx = &x->tx[0], *oty = &x->ty[0];
+  // Xc = R X + t, t = -R C
+  double t[3];
+  for (unsigned r=0; r < 3; ++r)
+    t[r] = -(R[r][0]*C[0] + R[r][1]*C[1] + R[r][2]*C[2]);
+
+  for (unsigned i=begin; i < end; ++i) {
+    double xc = R[0][0]*X[i] + R[0][1]*Y[i] + R[0][2]*Z[i] + t[0];
+    double yc = R[1][0]*X[i] + R[1][1]*Y[i] + R[1][2]*Z[i] + t[1];
+    double zc = R[2][0]*X[i] + R[2][1]*Y[i] + R[2][2]*Z[i] + t[2];
+    double txc = R[0][0]*TX[i] + R[0][1]*TY[i] + R[0][2]*TZ[i];
+    double tyc = R[1][0]*TX[i] + R[1][1]*TY[i] + R[1][2]*TZ[i];
+    double tzc = R[2][0]*TX[i] + R[2][1]*TY[i] + R[2][2]*TZ[i];
+    project_one(K_, distortion(), xc, yc, zc, txc, tyc, tzc, ox + i, oy + i, otx + i, oty + i);
+  }
+}
+
+void bdifd_trajectory_projector::
+anchor(const double R[3][3], const double C[3], unsigned begin, unsigned end)
+{
+  const double *X = &X_.X[0], *Y = &X_.Y[0], *Z = &X_.Z[0];
+  const double *TX = &X_.Tx[0], *TY = &X_.Ty[0], *TZ = &X_.Tz[0];
+  double t[3];
+  for (unsigned r=0; r < 3; ++r)
+    t[r] = -(R[r][0]*C[0] + R[r][1]*C[1] + R[r][2]*C[2]);
+
+  for (unsigned i=begin; i < end; ++i) {
+    xc_[i] = R[0][0]*X[i] + R[0][1]*Y[i] + R[0][2]*Z[i] + t[0];
+    yc_[i] = R[1][0]*X[i] + R[1][1]*Y[i] + R[1][2]*Z[i] + t[1];
+    zc_[i] = R[2][0]*X[i] + R[2][1]*Y[i] + R[2][2]*Z[i] + t[2];
+    txc_[i] = R[0][0]*TX[i] + R[0][1]*TY[i] + R[0][2]*TZ[i];
+    tyc_[i] = R[1][0]*TX[i] + R[1][1]*TY[i] + R[1][2]*TZ[i];
+    tzc_[i] = R[2][0]*TX[i] + R[2][1]*TY[i] + R[2][2]*TZ[i];
+  }
+}
+
+void bdifd_trajectory_projector::
+advance(const double L[3][3], const double d[3],
+    unsigned begin, unsigned end, bdifd_2d_soa *x)
+{
+  double *xc = &xc_[0], *yc = &yc_[0], *zc = &zc_[0];
+  double *txc = &txc_[0], *tyc = &tyc_[0], *tzc = &tzc_[0];
+  double *ox = &x->x[0], *oy = &x->y[0], *otx = &x->tx[0], *oty = &x->ty[0];
+
+  for (unsigned i=begin; i < end; ++i) {
+    double a = xc[i], b = yc[i], c = zc[i];
+    xc[i] = L[0][0]*a + L[0][1]*b + L[0][2]*c - d[0];
+    yc[i] = L[1][0]*a + L[1][1]*b + L[1][2]*c - d[1];
+    zc[i] = L[2][0]*a + L[2][1]*b + L[2][2]*c - d[2];
+    a = txc[i]; b = tyc[i]; c = tzc[i];
+    txc[i] = L[0][0]*a + L[0][1]*b + L[0][2]*c;
+    tyc[i] = L[1][0]*a + L[1][1]*b + L[1][2]*c;
+    tzc[i] = L[2][0]*a + L[2][1]*b + L[2][2]*c;
+    project_one(K_, distortion(), xc[i], yc[i], zc[i], txc[i], tyc[i], tzc[i], ox + i, oy + i, otx + i, oty + i);
+  }
+}
+
+void bdifd_trajectory_projector::
+project_cached(unsigned begin, unsigned end, bdifd_2d_soa *x) const
+{
+  double *ox = &x->x[0], *oy = &x->y[0], *otx = &x->tx[0], *oty = &x->ty[0];
+  for (unsigned i=begin; i < end; ++i)
+    project_one(K_, distortion(), xc_[i], yc_[i], zc_[i], txc_[i], tyc_[i], tzc_[i], ox + i, oy + i, otx + i, oty + i);
+}
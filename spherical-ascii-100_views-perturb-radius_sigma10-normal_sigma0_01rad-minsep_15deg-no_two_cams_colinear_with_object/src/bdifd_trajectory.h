@@ -0,0 +1,98 @@
+// This is bdifd_trajectory.h
+#ifndef bdifd_trajectory_h
+#define bdifd_trajectory_h
+//:
+//\file
+//\brief Dense camera trajectories through key poses, projected incrementally
+//\date Sun Oct 18 2026
+//
+// bdifd_trajectory interpolates world-to-camera rotations R by SLERP and camera
+// centers C by a uniform Catmull-Rom spline between consecutive key poses, so
+// a handful of keys (e.g. the views of a dataset) yields a video-rate path of
+// any number of frames. The path parameter u runs over [0, nkeys-1], key k
+// being at u = k.
+//
+// bdifd_trajectory_projector projects a fixed set of space points and
+// tangents (a bdifd_3d_soa) along such a path. project() works from world
+// coordinates, x = K R (X - C). advance() instead keeps the camera-frame
+// coordinates Xc = R (X - C), Tc = R T of the previous frame and moves them by
+// the frame-to-frame motion
+//
+//   Xc' = L Xc - d,  Tc' = L Tc,   L = R' R^T,  d = R' (C' - C)
+//
+// Rounding accumulates in Xc, so callers re-anchor with anchor() every few
+// hundred frames. For rigid motion both forms cost one 3x3 product per point
+// and tangent; advance() also reads and writes the cache, so it only pays off
+// when the pose itself is expensive to evaluate per frame. bench_trajectory
+// times both. Both write image points and unit image tangents into a
+// bdifd_2d_soa (x, y, tx, ty only) and work on a range of points, so blocks of
+// points can go to different threads. With set_distortion() the points and
+// tangents go through the lens distortion of bdifd_distortion.h on the way.
+//
+
+#include <vector>
+#include <vnl/vnl_double_3.h>
+#include <vnl/vnl_double_3x3.h>
+#include "bdifd_distortion.h"
+#include "bdifd_rig_batch.h"
+
+class bdifd_trajectory {
+public:
+  //: Appends a key pose: world to camera rotation \p R, camera center \p C.
+  void add_key(const vnl_double_3x3 &R, const vnl_double_3 &C);
+
+  unsigned nkeys() const { return C_.size(); }
+
+  //: Pose at path parameter \p u, clamped to [0, nkeys-1].
+  void pose(double u, double R[3][3], double C[3]) const;
+
+  //: \p n poses evenly spaced over the whole path, both ends included:
+  // 9 doubles of R (row-major) and 3 of C per frame.
+  void poses(unsigned n, double *R, double *C) const;
+
+private:
+  std::vector<vnl_double_3> C_;
+  std::vector<double> q_;     //:< unit quaternions (w, x, y, z), 4 per key
+};
+
+class bdifd_trajectory_projector {
+public:
+  //: Projects the points and tangents of \p X (which must outlive this)
+  // with calibration \p K.
+  bdifd_trajectory_projector(const vnl_double_3x3 &K, const bdifd_3d_soa &X);
+
+  unsigned size() const { return X_.size(); }
+
+  //: Lens distortion applied to every projection; none by default.
+  void set_distortion(const bdifd_lens_distortion &d);
+
+  //: Projects points [begin,end) from world coordinates.
+  void project(const double R[3][3], const double C[3],
+      unsigned begin, unsigned end, bdifd_2d_soa *x) const;
+
+  //: Sets the camera-frame coordinates of points [begin,end) for pose R, C.
+  void anchor(const double R[3][3], const double C[3], unsigned begin, unsigned end);
+
+  //: Moves the camera-frame coordinates of [begin,end) by the motion \p L,
+  // \p d (see motion()) and projects them.
+  void advance(const double L[3][3], const double d[3],
+      unsigned begin, unsigned end, bdifd_2d_soa *x);
+
+  //: Projects the current camera-frame coordinates of [begin,end).
+  void project_cached(unsigned begin, unsigned end, bdifd_2d_soa *x) const;
+
+  //: L = R R0^T and d = R (C - C0), the motion used by advance().
+  static void motion(const double R0[3][3], const double C0[3],
+      const double R[3][3], const double C[3], double L[3][3], double d[3]);
+
+private:
+  const bdifd_lens_distortion *distortion() const { return d_.is_identity() ? 0 : &d_; }
+
+  double K_[3][3];
+  bdifd_lens_distortion d_;
+  const bdifd_3d_soa &X_;
+  std::vector<double> xc_, yc_, zc_;    //:< camera-frame points
+  std::vector<double> txc_, tyc_, tzc_; //:< camera-frame tangents
+};
+
+#endif // bdifd_trajectory_h
@@ -0,0 +1,329 @@
+#include "bdifd_trifocal_validator.h"
+#include "bdifd_ascii_dataset.h"
+#include "bdifd_parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <vnl/vnl_inverse.h>
+#include <vnl/vnl_random.h>
+
+namespace {
+
+const unsigned block_size = 256;
+
+//: Larger of \p a and \p b, NaN if either is (std::max drops a NaN in b).
+inline double
+max2(double a, double b)
+{
+  return a != a || b != b ? a + b : std::max(a, b);
+}
+
+inline double
+max3(double a, double b, double c)
+{
+  return max2(std::fabs(a), max2(std::fabs(b), std::fabs(c)));
+}
+
+//: Keeps residual \p r of sample \p i if it is the largest so far. A NaN
+// is kept, with the first sample giving one, so it fails any tolerance.
+inline void
+keep_max(double r, unsigned i, double *max, unsigned *argmax)
+{
+  if (!(r <= *max) && *max == *max) {
+    *max = r;
+    *argmax = i;
+  }
+}
+
+//: Keeps the largest of \p n residuals starting at sample \p base.
+inline void
+scan(const double *r, unsigned n, unsigned base, double *max, unsigned *argmax)
+{
+  for (unsigned i=0; i < n; ++i)
+    keep_max(r[i], base + i, max, argmax);
+}
+
+//: Rb = Ra Rc^T.
+inline void
+mul_transpose(const double Ra[3][3], const double Rc[3][3], double Rb[3][3])
+{
+  for (unsigned r=0; r < 3; ++r)
+    for (unsigned c=0; c < 3; ++c)
+      Rb[r][c] = Ra[r][0]*Rc[c][0] + Ra[r][1]*Rc[c][1] + Ra[r][2]*Rc[c][2];
+}
+
+//: Relative pose of \p Rw, \p tw with respect to \p R1w, \p t1w.
+inline void
+relative_pose(const double R1w[3][3], const double t1w[3],
+    const double Rw[3][3], const double tw[3], double R[3][3], double t[3])
+{
+  mul_transpose(Rw, R1w, R);
+  for (unsigned r=0; r < 3; ++r)
+    t[r] = tw[r] - (R[r][0]*t1w[0] + R[r][1]*t1w[1] + R[r][2]*t1w[2]);
+}
+
+}
+
+const char *bdifd_trifocal_residuals::
+name(unsigned k)
+{
+  static const char *names[nkinds] = {
+    "point", "essential", "rotation_free",
+    "tangent_projection", "tangent", "tangent_rotation_free"
+  };
+  return k < nkinds ? names[k] : "unknown";
+}
+
+bdifd_trifocal_validator::
+bdifd_trifocal_validator(const bdifd_ascii_dataset &ds)
+  : view_(ds.nviews()),
+    npts_(ds.npts())
+{
+  vnl_double_3x3 Kinv = vnl_inverse(ds.K);
+
+  for (unsigned v=0; v < view_.size(); ++v) {
+    view &w = view_[v];
+    for (unsigned r=0; r < 3; ++r) {
+      for (unsigned c=0; c < 3; ++c)
+        w.R[r][c] = ds.R[v][r][c];
+    }
+    for (unsigned r=0; r < 3; ++r)
+      w.t[r] = -(w.R[r][0]*ds.C[v][0] + w.R[r][1]*ds.C[v][1] + w.R[r][2]*ds.C[v][2]);
+
+    for (unsigned c=0; c < 3; ++c) {
+      w.x[c].resize(npts_);
+      w.d[c].resize(npts_);
+      w.n[c].resize(npts_);
+    }
+    w.a.resize(npts_);
+    w.e.resize(npts_);
+    w.m.resize(npts_);
+
+    std::vector<double> ux, uy, utx, uty;
+    ds.undistorted(v, &ux, &uy, &utx, &uty);
+    const double *px = &ux[0], *py = &uy[0];
+    const double *ptx = &utx[0], *pty = &uty[0];
+    w.tangent_projection = 0;
+    w.tangent_projection_argmax = 0;
+    for (unsigned i=0; i < npts_; ++i) {
+      double x[3], d[3], X[3], D[3];
+      for (unsigned r=0; r < 3; ++r) {
+        x[r] = Kinv[r][0]*px[i] + Kinv[r][1]*py[i] + Kinv[r][2];
+        d[r] = Kinv[r][0]*ptx[i] + Kinv[r][1]*pty[i];
+      }
+      double dn = std::sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+      for (unsigned r=0; r < 3; ++r)
+        d[r] /= dn;
+
+      // sample and tangent in camera coordinates
+      for (unsigned r=0; r < 3; ++r) {
+        X[r] = w.R[r][0]*ds.X[i] + w.R[r][1]*ds.Y[i] + w.R[r][2]*ds.Z[i] + w.t[r];
+        D[r] = w.R[r][0]*ds.TX[i] + w.R[r][1]*ds.TY[i] + w.R[r][2]*ds.TZ[i];
+      }
+      double a = X[2], e = D[2], b = a + e;
+      double g[3];
+      for (unsigned r=0; r < 3; ++r)
+        g[r] = (X[r] + D[r])/b - x[r];
+
+      // projected space tangent, (**) in the scripts
+      double p[3];
+      for (unsigned r=0; r < 3; ++r)
+        p[r] = D[r] - e*x[r];
+      double pn = std::sqrt(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+      double res = max3(d[0] - p[0]/pn, d[1] - p[1]/pn, d[2] - p[2]/pn);
+      keep_max(res, i, &w.tangent_projection, &w.tangent_projection_argmax);
+
+      for (unsigned r=0; r < 3; ++r) {
+        w.x[r][i] = x[r];
+        w.d[r][i] = d[r];
+      }
+      w.n[0][i] = x[1]*d[2] - x[2]*d[1];
+      w.n[1][i] = x[2]*d[0] - x[0]*d[2];
+      w.n[2][i] = x[0]*d[1] - x[1]*d[0];
+      w.a[i] = a;
+      w.e[i] = e;
+      w.m[i] = b*std::sqrt(g[0]*g[0] + g[1]*g[1] + g[2]*g[2]);
+    }
+  }
+}
+
+void bdifd_trifocal_validator::
+check(unsigned v1, unsigned v2, unsigned v3, bdifd_trifocal_residuals *res) const
+{
+  typedef bdifd_trifocal_residuals K;
+  res->v[0] = v1; res->v[1] = v2; res->v[2] = v3;
+  for (unsigned k=0; k < K::nkinds; ++k) {
+    res->max[k] = 0;
+    res->argmax[k] = 0;
+  }
+
+  const view &w1 = view_[v1], &w2 = view_[v2], &w3 = view_[v3];
+  double R2[3][3], t2[3], R3[3][3], t3[3], R32[3][3];
+  relative_pose(w1.R, w1.t, w2.R, w2.t, R2, t2);
+  relative_pose(w1.R, w1.t, w3.R, w3.t, R3, t3);
+  mul_transpose(R3, R2, R32);
+
+  const unsigned n = npts_;
+  if (!n)
+    return;
+
+  // c = x2 x R2 x1 for every sample, for the rotation-free determinants
+  std::vector<double> c[3];
+  for (unsigned r=0; r < 3; ++r)
+    c[r].resize(n);
+
+  double r_pt[block_size], r_ess[block_size], r_tgt[block_size], r_tdet[block_size];
+
+  const double *x10 = &w1.x[0][0], *x11 = &w1.x[1][0], *x12 = &w1.x[2][0];
+  const double *x20 = &w2.x[0][0], *x21 = &w2.x[1][0], *x22 = &w2.x[2][0];
+  const double *x30 = &w3.x[0][0], *x31 = &w3.x[1][0], *x32 = &w3.x[2][0];
+  const double *d10 = &w1.d[0][0], *d11 = &w1.d[1][0], *d12 = &w1.d[2][0];
+  const double *d20 = &w2.d[0][0], *d21 = &w2.d[1][0], *d22 = &w2.d[2][0];
+  const double *d30 = &w3.d[0][0], *d31 = &w3.d[1][0], *d32 = &w3.d[2][0];
+  const double *n10 = &w1.n[0][0], *n11 = &w1.n[1][0], *n12 = &w1.n[2][0];
+  const double *n20 = &w2.n[0][0], *n21 = &w2.n[1][0], *n22 = &w2.n[2][0];
+  const double *n30 = &w3.n[0][0], *n31 = &w3.n[1][0], *n32 = &w3.n[2][0];
+  const double *a1 = &w1.a[0], *a2 = &w2.a[0], *a3 = &w3.a[0];
+  const double *e1 = &w1.e[0], *e2 = &w2.e[0], *e3 = &w3.e[0];
+  const double *m1 = &w1.m[0], *m2 = &w2.m[0], *m3 = &w3.m[0];
+  double *c0 = &c[0][0], *c1 = &c[1][0], *c2 = &c[2][0];
+
+  for (unsigned base=0; base < n; base += block_size) {
+    unsigned nb = std::min(block_size, n - base);
+    for (unsigned j=0; j < nb; ++j) {
+      unsigned i = base + j;
+
+      // R2 x1, R3 x1
+      double y0 = R2[0][0]*x10[i] + R2[0][1]*x11[i] + R2[0][2]*x12[i];
+      double y1 = R2[1][0]*x10[i] + R2[1][1]*x11[i] + R2[1][2]*x12[i];
+      double y2 = R2[2][0]*x10[i] + R2[2][1]*x11[i] + R2[2][2]*x12[i];
+      double z0 = R3[0][0]*x10[i] + R3[0][1]*x11[i] + R3[0][2]*x12[i];
+      double z1 = R3[1][0]*x10[i] + R3[1][1]*x11[i] + R3[1][2]*x12[i];
+      double z2 = R3[2][0]*x10[i] + R3[2][1]*x11[i] + R3[2][2]*x12[i];
+
+      // (*)
+      double p12 = max3(a2[i]*x20[i] - a1[i]*y0 - t2[0],
+                        a2[i]*x21[i] - a1[i]*y1 - t2[1],
+                        a2[i]*x22[i] - a1[i]*y2 - t2[2]);
+      double p13 = max3(a3[i]*x30[i] - a1[i]*z0 - t3[0],
+                        a3[i]*x31[i] - a1[i]*z1 - t3[1],
+                        a3[i]*x32[i] - a1[i]*z2 - t3[2]);
+      r_pt[j] = max2(p12, p13);
+
+      // x2 . (t2 x R2 x1)
+      double e12 = x20[i]*(t2[1]*y2 - t2[2]*y1)
+                 + x21[i]*(t2[2]*y0 - t2[0]*y2)
+                 + x22[i]*(t2[0]*y1 - t2[1]*y0);
+      double e13 = x30[i]*(t3[1]*z2 - t3[2]*z1)
+                 + x31[i]*(t3[2]*z0 - t3[0]*z2)
+                 + x32[i]*(t3[0]*z1 - t3[1]*z0);
+      r_ess[j] = max2(std::fabs(e12), std::fabs(e13));
+
+      c0[i] = x21[i]*y2 - x22[i]*y1;
+      c1[i] = x22[i]*y0 - x20[i]*y2;
+      c2[i] = x20[i]*y1 - x21[i]*y0;
+
+      // (***): R2 (e1 x1 + m1 d1) is the space tangent in camera 2
+      double q0 = e1[i]*x10[i] + m1[i]*d10[i];
+      double q1 = e1[i]*x11[i] + m1[i]*d11[i];
+      double q2 = e1[i]*x12[i] + m1[i]*d12[i];
+      double t12 = max3(
+          e2[i]*x20[i] + m2[i]*d20[i] - (R2[0][0]*q0 + R2[0][1]*q1 + R2[0][2]*q2),
+          e2[i]*x21[i] + m2[i]*d21[i] - (R2[1][0]*q0 + R2[1][1]*q1 + R2[1][2]*q2),
+          e2[i]*x22[i] + m2[i]*d22[i] - (R2[2][0]*q0 + R2[2][1]*q1 + R2[2][2]*q2));
+      double t13 = max3(
+          e3[i]*x30[i] + m3[i]*d30[i] - (R3[0][0]*q0 + R3[0][1]*q1 + R3[0][2]*q2),
+          e3[i]*x31[i] + m3[i]*d31[i] - (R3[1][0]*q0 + R3[1][1]*q1 + R3[1][2]*q2),
+          e3[i]*x32[i] + m3[i]*d32[i] - (R3[2][0]*q0 + R3[2][1]*q1 + R3[2][2]*q2));
+      r_tgt[j] = max2(t12, t13);
+
+      // det[R3 n1, R3 R2^T n2, n3]
+      double u0 = R3[0][0]*n10[i] + R3[0][1]*n11[i] + R3[0][2]*n12[i];
+      double u1 = R3[1][0]*n10[i] + R3[1][1]*n11[i] + R3[1][2]*n12[i];
+      double u2 = R3[2][0]*n10[i] + R3[2][1]*n11[i] + R3[2][2]*n12[i];
+      double v0 = R32[0][0]*n20[i] + R32[0][1]*n21[i] + R32[0][2]*n22[i];
+      double v1 = R32[1][0]*n20[i] + R32[1][1]*n21[i] + R32[1][2]*n22[i];
+      double v2 = R32[2][0]*n20[i] + R32[2][1]*n21[i] + R32[2][2]*n22[i];
+      r_tdet[j] = std::fabs(u0*(v1*n32[i] - v2*n31[i])
+                          + u1*(v2*n30[i] - v0*n32[i])
+                          + u2*(v0*n31[i] - v1*n30[i]));
+    }
+    scan(r_pt, nb, base, &res->max[K::point], &res->argmax[K::point]);
+    scan(r_ess, nb, base, &res->max[K::essential], &res->argmax[K::essential]);
+    scan(r_tgt, nb, base, &res->max[K::tangent], &res->argmax[K::tangent]);
+    scan(r_tdet, nb, base, &res->max[K::tangent_rotation_free], &res->argmax[K::tangent_rotation_free]);
+  }
+
+  // Rotation-free constraint on samples i, i+n/3, i+2n/3, which are spread
+  // over different curves just like the three points picked in the script.
+  unsigned s1 = n/3, s2 = (2*n)/3;
+  double r_det[block_size];
+  for (unsigned base=0; base < n; base += block_size) {
+    unsigned nb = std::min(block_size, n - base);
+    for (unsigned j=0; j < nb; ++j) {
+      unsigned i = base + j;
+      unsigned k = i + s1; k -= (k >= n) ? n : 0;
+      unsigned l = i + s2; l -= (l >= n) ? n : 0;
+      r_det[j] = std::fabs(c0[i]*(c1[k]*c2[l] - c2[k]*c1[l])
+                         + c1[i]*(c2[k]*c0[l] - c0[k]*c2[l])
+                         + c2[i]*(c0[k]*c1[l] - c1[k]*c0[l]));
+    }
+    scan(r_det, nb, base, &res->max[K::rotation_free], &res->argmax[K::rotation_free]);
+  }
+
+  const view *w[3] = {&w1, &w2, &w3};
+  for (unsigned k=0; k < 3; ++k)
+    keep_max(w[k]->tangent_projection, w[k]->tangent_projection_argmax,
+        &res->max[K::tangent_projection], &res->argmax[K::tangent_projection]);
+}
+
+void bdifd_trifocal_validator::
+check(
+    const std::vector<vnl_vector_fixed<unsigned,3> > &triplets,
+    std::vector<bdifd_trifocal_residuals> *res,
+    unsigned nthreads) const
+{
+  res->resize(triplets.size());
+  bdifd_parallel::for_each(triplets.size(), [&](unsigned i) {
+    check(triplets[i][0], triplets[i][1], triplets[i][2], &(*res)[i]);
+  }, nthreads);
+}
+
+void bdifd_trifocal_validator::
+all_triplets(unsigned nviews, std::vector<vnl_vector_fixed<unsigned,3> > *t)
+{
+  t->clear();
+  for (unsigned i=0; i < nviews; ++i)
+    for (unsigned j=i+1; j < nviews; ++j)
+      for (unsigned k=j+1; k < nviews; ++k)
+        t->push_back(vnl_vector_fixed<unsigned,3>(i, j, k));
+}
+
+void bdifd_trifocal_validator::
+sample_triplets(unsigned nviews, unsigned n, unsigned seed,
+    std::vector<vnl_vector_fixed<unsigned,3> > *t)
+{
+  double total = nviews < 3 ? 0 : double(nviews)*(nviews-1)*(nviews-2)/6;
+  if (n >= total) {
+    all_triplets(nviews, t);
+    return;
+  }
+
+  vnl_random rng(seed);
+  std::set<unsigned long> seen;
+  t->clear();
+  t->reserve(n);
+  while (t->size() < n) {
+    unsigned v[3];
+    v[0] = rng.lrand32(nviews - 1);
+    v[1] = rng.lrand32(nviews - 1);
+    v[2] = rng.lrand32(nviews - 1);
+    if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+      continue;
+    std::sort(v, v+3);
+    unsigned long key = (static_cast<unsigned long>(v[0])*nviews + v[1])*nviews + v[2];
+    if (!seen.insert(key).second)
+      continue;
+    t->push_back(vnl_vector_fixed<unsigned,3>(v[0], v[1], v[2]));
+  }
+}
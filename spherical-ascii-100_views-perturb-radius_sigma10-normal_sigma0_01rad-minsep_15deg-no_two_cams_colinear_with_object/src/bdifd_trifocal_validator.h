@@ -0,0 +1,104 @@
+// This is bdifd_trifocal_validator.h
+#ifndef bdifd_trifocal_validator_h
+#define bdifd_trifocal_validator_h
+//:
+//\file
+//\brief Checks the trifocal point and tangent constraints on a dataset
+//\date Sun Oct 18 2026
+//
+// Native counterpart of synthdata_trifocal_simpler_notation.sce and
+// synthdata_trifocal_tangents_simpler_notation.sce, for every sample and any
+// set of view triplets instead of three hand-picked points and views.
+//
+// Notation as in the scripts: for a triplet (1,2,3), R2 = R2w R1w^T and
+// t2 = t2w - R2 t1w (same for view 3); x_v = K^{-1} [x;1] and d_v the unit
+// K^{-1} [t;0]; a_v the depth of the sample in view v and D_v the space
+// tangent in camera v. The residuals, all zero on exact data, are
+//
+//   point                  a2 x2 - a1 R2 x1 - t2                  (*)
+//   essential              x2 . (t2 x R2 x1)
+//   rotation_free          det[x2_i x R2 x1_i, ...] over samples i, i+n/3, i+2n/3
+//   tangent_projection     d_v - unit(D_v - D_v[3] x_v)
+//   tangent                e2 x2 + m2 d2 - R2 (e1 x1 + m1 d1)     (***)
+//   tangent_rotation_free  det[R3 (x1 x d1), R3 R2^T (x2 x d2), x3 x d3]
+//
+// with e_v = D_v[3] and m_v = (a_v + e_v) |(X_v + D_v)/(a_v + e_v) - x_v|,
+// i.e. eta = 1 in the scripts. Pairs (1,2) and (1,3) are both checked; vector
+// residuals are measured by their largest absolute component. Image samples
+// of a dataset with a calib.distortion are undistorted first.
+//
+// A NaN residual, e.g. from a space tangent pointing at a camera center or a
+// sample that could not be undistorted, is not dropped: it becomes the max of
+// its kind, with the first sample giving one as argmax, and so fails any
+// tolerance.
+//
+// Everything that depends on a single view is computed once, as one array
+// per coordinate; the per-triplet loops are branch-free and run over blocks
+// of samples. Triplets are spread over threads.
+//
+
+#include <vector>
+#include <vnl/vnl_vector_fixed.h>
+
+class bdifd_ascii_dataset;
+
+struct bdifd_trifocal_residuals {
+  enum kind {
+    point=0,
+    essential,
+    rotation_free,
+    tangent_projection,
+    tangent,
+    tangent_rotation_free,
+    nkinds
+  };
+
+  static const char *name(unsigned k);
+
+  unsigned v[3];
+  double max[nkinds];       //:< largest absolute residual, NaN if any is
+  unsigned argmax[nkinds];  //:< sample where it occurs
+};
+
+class bdifd_trifocal_validator {
+public:
+  //: Precomputes the per-view arrays; \p d must have its 2D samples read.
+  explicit bdifd_trifocal_validator(const bdifd_ascii_dataset &d);
+
+  unsigned nviews() const { return view_.size(); }
+  unsigned npts() const { return npts_; }
+
+  //: Checks each triplet, spreading them over \p nthreads threads (0 = one
+  // per core).
+  void check(
+      const std::vector<vnl_vector_fixed<unsigned,3> > &triplets,
+      std::vector<bdifd_trifocal_residuals> *res,
+      unsigned nthreads=0) const;
+
+  void check(unsigned v1, unsigned v2, unsigned v3, bdifd_trifocal_residuals *r) const;
+
+  //: All triplets i < j < k.
+  static void all_triplets(unsigned nviews, std::vector<vnl_vector_fixed<unsigned,3> > *t);
+
+  //: \p n distinct random triplets i < j < k (all of them if there are fewer).
+  static void sample_triplets(unsigned nviews, unsigned n, unsigned seed,
+      std::vector<vnl_vector_fixed<unsigned,3> > *t);
+
+private:
+  //: Per view, one array per coordinate.
+  struct view {
+    double R[3][3], t[3];
+    std::vector<double> x[3];   //:< K^{-1} [x;1]
+    std::vector<double> d[3];   //:< unit K^{-1} [t;0]
+    std::vector<double> n[3];   //:< x x d, normal of the tangent plane
+    std::vector<double> a;      //:< depth
+    std::vector<double> e, m;   //:< tangent scalars, eta = 1
+    double tangent_projection;  //:< max residual, view only
+    unsigned tangent_projection_argmax;
+  };
+
+  std::vector<view> view_;
+  unsigned npts_;
+};
+
+#endif // bdifd_trifocal_validator_h
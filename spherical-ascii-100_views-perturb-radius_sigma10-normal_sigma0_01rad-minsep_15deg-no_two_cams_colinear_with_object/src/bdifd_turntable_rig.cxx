@@ -0,0 +1,192 @@
+#include "bdifd_turntable_rig.h"
+#include <cmath>
+#include <vnl/vnl_math.h>
+#include <vgl/vgl_point_3d.h>
+#include <vgl/algo/vgl_rotation_3d.h>
+
+namespace {
+
+//: Calls f(i, cos, sin) for the angles theta0 + i step (degrees), i < n.
+template <class F> inline void
+walk(double theta0, double step, unsigned n, const F &f)
+{
+  double d = step*(vnl_math::pi/180.0);
+  double cd = std::cos(d), sd = std::sin(d);
+  double c = 1, s = 0;
+  for (unsigned i=0; i < n; ++i) {
+    if (i % bdifd_turntable_rig::reseed_period == 0) {
+      double phi = (theta0 + i*step)*(vnl_math::pi/180.0);
+      c = std::cos(phi);
+      s = std::sin(phi);
+    } else {
+      double cn = c*cd - s*sd;
+      s = s*cd + c*sd;
+      c = cn;
+    }
+    f(i, c, s);
+  }
+}
+
+//: Base pose of the Olympus turntable, from david-02-26-2006-crop2.
+struct olympus_base {
+  vnl_double_3x3 B;
+  vnl_double_3 t;
+
+  olympus_base()
+  {
+    double camera_to_object = 1.128036301860739e+03;
+    t = camera_to_object * vnl_double_3(0, 0.12722239600987, 0.99187421680045);
+
+    double roll = -3.961405930732378e-15;
+    double pitch = -3.02282467212289;
+    double yaw = -1.15081788134986;
+
+    vnl_double_3x3 Rx, Ry, Rz;
+
+    Rx[0][0] = 1;
+    Rx[0][1] = 0;
+    Rx[0][2] = 0;
+
+    Rx[1][0] = 0;
+    Rx[1][1] = std::cos(pitch);
+    Rx[1][2] = -std::sin(pitch);
+
+    Rx[2][0] = 0;
+    Rx[2][1] = std::sin(pitch);
+    Rx[2][2] = std::cos(pitch);
+
+    Ry[0][0] = std::cos(yaw);
+    Ry[0][1] = 0;
+    Ry[0][2] = std::sin(yaw);
+
+    Ry[1][0] = 0;
+    Ry[1][1] = 1;
+    Ry[1][2] = 0;
+
+    Ry[2][0] = -std::sin(yaw);
+    Ry[2][1] = 0;
+    Ry[2][2] = std::cos(yaw);
+
+    Rz[0][0] = std::cos(roll);
+    Rz[0][1] = -std::sin(roll);
+    Rz[0][2] = 0;
+
+    Rz[1][0] = std::sin(roll);
+    Rz[1][1] = std::cos(roll);
+    Rz[1][2] = 0;
+
+    Rz[2][0] = 0;
+    Rz[2][1] = 0;
+    Rz[2][2] = 1;
+
+    // Rckk normalized as in Mundy's notes; numerically
+    //   4.077407717391018371E-01   2.058618136737014769E-15  -9.130977291952939723E-01
+    //   1.081919985807717616E-01  -9.929553699976120251E-01   4.831277922046327278E-02
+    //  -9.066652935370919097E-01  -1.184889581054157787E-01  -4.048683888653117346E-01
+    B = Rx*Ry*Rz;
+  }
+};
+
+}
+
+//---------------------------------------------------------------------------
+
+bdifd_turntable_rig::
+bdifd_turntable_rig(const vpgl_calibration_matrix<double> &K,
+    const vnl_double_3x3 &B, const vnl_double_3 &t)
+  : K_(K)
+{
+  vnl_double_3x3 Km = K.get_matrix();
+  for (unsigned r=0; r < 3; ++r) {
+    Kt_[r] = Km[r][0]*t[0] + Km[r][1]*t[1] + Km[r][2]*t[2];
+    b_[r] = B[0][r]*t[0] + B[1][r]*t[1] + B[2][r]*t[2];
+    for (unsigned c=0; c < 3; ++c) {
+      B_[r][c] = B[r][c];
+      KB_[r][c] = Km[r][0]*B[0][c] + Km[r][1]*B[1][c] + Km[r][2]*B[2][c];
+    }
+  }
+}
+
+bdifd_turntable_rig bdifd_turntable_rig::
+olympus(const vpgl_calibration_matrix<double> &K)
+{
+  static const olympus_base base;
+  return bdifd_turntable_rig(K, base.B, base.t);
+}
+
+// To see how the system is modeled, check out my notes "Rewriting Geometry jan
+// 11". The camera center is at object_to_source from the center of rotation,
+// which is the world origin; for artifact 1 the step is 0.440 degrees.
+bdifd_turntable_rig bdifd_turntable_rig::
+ctspheres(const vpgl_calibration_matrix<double> &K)
+{
+  double const object_to_source = 121.00;
+  vnl_double_3x3 I;
+  I.set_identity();
+  return bdifd_turntable_rig(K, I, vnl_double_3(0, 0, object_to_source));
+}
+
+vpgl_perspective_camera<double> bdifd_turntable_rig::
+camera(double theta) const
+{
+  double R[9], C[3];
+  poses(theta, 0, 1, R, C);
+  vnl_double_3x3 Rm(R);
+  return vpgl_perspective_camera<double>(K_, vgl_point_3d<double>(C[0], C[1], C[2]),
+      vgl_rotation_3d<double>(Rm));
+}
+
+void bdifd_turntable_rig::
+cameras(double theta0, double step, unsigned n, vpgl_perspective_camera<double> *cams) const
+{
+  // in chunks of one reseed period so the poses stay on the stack
+  double R[reseed_period][9], C[reseed_period][3];
+  for (unsigned i0=0; i0 < n; i0 += reseed_period) {
+    unsigned m = n - i0 < reseed_period ? n - i0 : reseed_period;
+    poses(theta0 + i0*step, step, m, R[0], C[0]);
+    for (unsigned i=0; i < m; ++i)
+      cams[i0 + i] = vpgl_perspective_camera<double>(K_,
+          vgl_point_3d<double>(C[i][0], C[i][1], C[i][2]),
+          vgl_rotation_3d<double>(vnl_double_3x3(R[i])));
+  }
+}
+
+void bdifd_turntable_rig::
+cameras(const std::vector<double> &theta, std::vector<vpgl_perspective_camera<double> > *cams) const
+{
+  cams->resize(theta.size());
+  for (unsigned i=0; i < theta.size(); ++i)
+    (*cams)[i] = camera(theta[i]);
+}
+
+void bdifd_turntable_rig::
+projections(double theta0, double step, unsigned n, double *P) const
+{
+  // K B Y(phi): columns 0 and 2 turn, column 1 and K t are fixed
+  walk(theta0, step, n, [&](unsigned i, double c, double s) {
+    double *p = P + 12*i;
+    for (unsigned r=0; r < 3; ++r) {
+      p[4*r]   = KB_[r][0]*c + KB_[r][2]*s;
+      p[4*r+1] = KB_[r][1];
+      p[4*r+2] = KB_[r][2]*c - KB_[r][0]*s;
+      p[4*r+3] = Kt_[r];
+    }
+  });
+}
+
+void bdifd_turntable_rig::
+poses(double theta0, double step, unsigned n, double *R, double *C) const
+{
+  walk(theta0, step, n, [&](unsigned i, double c, double s) {
+    double *q = R + 9*i, *o = C + 3*i;
+    for (unsigned r=0; r < 3; ++r) {
+      q[3*r]   = B_[r][0]*c + B_[r][2]*s;
+      q[3*r+1] = B_[r][1];
+      q[3*r+2] = B_[r][2]*c - B_[r][0]*s;
+    }
+    // C = -R^T t = -Y(phi)^T b
+    o[0] = -(b_[0]*c + b_[2]*s);
+    o[1] = -b_[1];
+    o[2] = b_[0]*s - b_[2]*c;
+  });
+}
@@ -0,0 +1,74 @@
+// This is bdifd_turntable_rig.h
+#ifndef bdifd_turntable_rig_h
+#define bdifd_turntable_rig_h
+//:
+//\file
+//\brief Batched cameras of a fixed camera looking at a turntable
+//\date Sun Oct 18 2026
+//
+// Both turntables of bdifd_turntable have a fixed camera and an object turning
+// about the world y axis, so the camera at table angle phi is
+//
+//   R = B Y(phi),  t = const,   Y(phi) = [cos 0 -sin; 0 1 0; sin 0 cos]
+//
+// with the base pose B, t (for the Olympus rig B = Rx Ry Rz of the calibrated
+// roll, pitch and yaw) computed once per rig. A batch of n frames at angles
+// theta0 + i step then costs one sincos stream, generated by incremental
+// rotation and reseeded from std::sin/cos every reseed_period frames so the
+// drift stays at a few ulps over thousands of frames.
+//
+// Cameras are returned by value or written into caller-provided arrays; the
+// batch calls do not allocate.
+//
+
+#include <vector>
+#include <vnl/vnl_double_3.h>
+#include <vnl/vnl_double_3x3.h>
+#include <vpgl/vpgl_perspective_camera.h>
+
+class bdifd_turntable_rig {
+public:
+  //: Frames between exact sincos evaluations in the batch calls.
+  static const unsigned reseed_period = 64;
+
+  //: Rig with base rotation \p B and translation \p t.
+  bdifd_turntable_rig(const vpgl_calibration_matrix<double> &K,
+      const vnl_double_3x3 &B, const vnl_double_3 &t);
+
+  //: The rig of bdifd_turntable::camera_olympus.
+  static bdifd_turntable_rig olympus(const vpgl_calibration_matrix<double> &K);
+
+  //: The rig of bdifd_turntable::camera_ctspheres; frame i is at angle
+  // i*ctspheres_step() degrees.
+  static bdifd_turntable_rig ctspheres(const vpgl_calibration_matrix<double> &K);
+  static double ctspheres_step() { return 0.5; }
+
+  //: Camera at table angle \p theta, in degrees.
+  vpgl_perspective_camera<double> camera(double theta) const;
+
+  //: Cameras at theta0 + i step degrees, i < n, into \p cams[0..n).
+  void cameras(double theta0, double step, unsigned n,
+      vpgl_perspective_camera<double> *cams) const;
+
+  //: Cameras at the given angles, in degrees; \p cams is resized.
+  void cameras(const std::vector<double> &theta,
+      std::vector<vpgl_perspective_camera<double> > *cams) const;
+
+  //: 3x4 projection matrices K [R | t] at theta0 + i step degrees, row-major,
+  // 12 doubles per frame.
+  void projections(double theta0, double step, unsigned n, double *P) const;
+
+  //: Rotations (9 doubles per frame, row-major) and centers (3 per frame).
+  void poses(double theta0, double step, unsigned n, double *R, double *C) const;
+
+  const vpgl_calibration_matrix<double> &calibration() const { return K_; }
+
+private:
+  vpgl_calibration_matrix<double> K_;
+  double B_[3][3];   //:< base rotation
+  double KB_[3][3];  //:< K B
+  double Kt_[3];     //:< K t
+  double b_[3];      //:< B^T t; the center is -Y(phi)^T b
+};
+
+#endif // bdifd_turntable_rig_h
@@ -0,0 +1,146 @@
+#include "bdifd_view_cache.h"
+#include "bdifd_data.h"
+#include <condition_variable>
+
+//: A cache entry; view is null until ready.
+struct bdifd_view_cache::slot {
+  bdifd_view_cache::view_ptr view;
+  bool ready;
+  bool failed;
+  std::condition_variable cv;
+  lru_list::iterator pos;
+
+  slot() : ready(false), failed(false) {}
+};
+
+bdifd_view_cache::
+bdifd_view_cache(
+    const std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d,
+    const std::vector<vpgl_perspective_camera<double> > &cams,
+    unsigned capacity)
+  : cams_(cams), capacity_(capacity ? capacity : 1),
+  hits_(0), misses_(0), evictions_(0)
+{
+  for (unsigned i=0; i < crv3d.size(); ++i)
+    for (unsigned k=0; k < crv3d[i].size(); ++k) {
+      pts_.push_back(crv3d[i][k]);
+      crv_id_.push_back(i);
+    }
+}
+
+bdifd_view_cache *bdifd_view_cache::
+spherical(unsigned seed, unsigned capacity)
+{
+  // as in generate_synth_sequence_3
+  vnl_double_3x3 Kmatrix;
+  bdifd_turntable::internal_calib_olympus(Kmatrix, 500, 400, 900);
+  vpgl_calibration_matrix<double> K(Kmatrix);
+
+  std::vector<vpgl_perspective_camera<double> > cams;
+  bdifd_turntable::cameras_olympus_spherical(&cams, K, true, true, seed);
+
+  std::vector<std::vector<bdifd_3rd_order_point_3d> > crv3d;
+  bdifd_data::space_curves_olympus_turntable(crv3d);
+
+  return new bdifd_view_cache(crv3d, cams, capacity);
+}
+
+void bdifd_view_cache::
+project(unsigned v, bdifd_projected_view *out) const
+{
+  bdifd_camera cam;
+  cam.set_p(cams_[v]);
+  unsigned n = pts_.size();
+  out->v = v;
+  out->pts.resize(n);
+  out->valid.resize(n);
+  for (unsigned i=0; i < n; ++i) {
+    bool not_degenerate;
+    out->pts[i] = cam.project_to_image(pts_[i], &not_degenerate);
+    out->valid[i] = not_degenerate;
+  }
+}
+
+bdifd_view_cache::view_ptr bdifd_view_cache::
+view(unsigned v)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    std::map<unsigned, std::shared_ptr<slot> >::iterator it = slots_.find(v);
+    if (it != slots_.end()) {
+      std::shared_ptr<slot> s = it->second;
+      lru_.splice(lru_.begin(), lru_, s->pos);
+      ++hits_;
+      while (!s->ready)
+        s->cv.wait(lock);
+      if (!s->failed)
+        return s->view;
+      continue;   // the projecting thread failed and dropped the slot; retry
+    }
+
+    ++misses_;
+    std::shared_ptr<slot> s(new slot);
+    lru_.push_front(v);
+    s->pos = lru_.begin();
+    slots_[v] = s;
+
+    // evict from the cold end, skipping views still being projected
+    lru_list::iterator e = lru_.end();
+    while (slots_.size() > capacity_ && e != lru_.begin()) {
+      --e;
+      std::map<unsigned, std::shared_ptr<slot> >::iterator victim = slots_.find(*e);
+      if (!victim->second->ready)
+        continue;
+      slots_.erase(victim);
+      e = lru_.erase(e);
+      ++evictions_;
+    }
+
+    lock.unlock();
+    std::shared_ptr<bdifd_projected_view> p(new bdifd_projected_view);
+    try {
+      project(v, p.get());
+    } catch (...) {
+      lock.lock();
+      lru_.erase(s->pos);
+      slots_.erase(v);
+      s->failed = true;
+      s->ready = true;
+      s->cv.notify_all();
+      throw;
+    }
+    lock.lock();
+    s->view = p;
+    s->ready = true;
+    s->cv.notify_all();
+    return p;
+  }
+}
+
+unsigned long bdifd_view_cache::
+hits() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+unsigned long bdifd_view_cache::
+misses() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+unsigned long bdifd_view_cache::
+evictions() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return evictions_;
+}
+
+unsigned bdifd_view_cache::
+size() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return slots_.size();
+}
@@ -0,0 +1,91 @@
+// This is bdifd_view_cache.h
+#ifndef bdifd_view_cache_h
+#define bdifd_view_cache_h
+//:
+//\file
+//\brief Lazily projected views of a synthetic scene, with a bounded LRU cache
+//\date Sun Oct 18 2026
+//
+// Holds the sampled space curves and the cameras of a dataset and projects
+// view k (bdifd_camera::project_to_image, as the generator does) only when it
+// is asked for. At most capacity() projected views are kept; the least
+// recently used one is dropped when another is needed. Views are handed out
+// as shared pointers, so an evicted view stays valid for whoever still holds
+// it, and memory follows the views actually in use rather than the number of
+// cameras.
+//
+// view() may be called from any number of threads. Concurrent requests for a
+// view that is not cached yet wait for a single projection; requests for
+// other views proceed in parallel.
+//
+// spherical() sets up the published spherical scene (same calibration,
+// curves and cameras as generate_synth_sequence_3), so e.g. the three views
+// picked by synthetic_data_ascii_show.m cost three projections, not 100.
+//
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <bdifd/bdifd_camera.h>
+
+//: One projected view; pts[i] is sample i of the scene, valid[i] is zero if
+// its projection is degenerate.
+struct bdifd_projected_view {
+  unsigned v;
+  std::vector<bdifd_3rd_order_point_2d> pts;
+  std::vector<unsigned char> valid;
+};
+
+class bdifd_view_cache {
+public:
+  typedef std::shared_ptr<const bdifd_projected_view> view_ptr;
+
+  //: Scene of curves \p crv3d seen by cameras \p cams, keeping at most
+  // \p capacity projected views (at least one).
+  bdifd_view_cache(
+      const std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d,
+      const std::vector<vpgl_perspective_camera<double> > &cams,
+      unsigned capacity=8);
+
+  //: The spherical dataset scene; \p seed as for cameras_olympus_spherical.
+  static bdifd_view_cache *spherical(unsigned seed, unsigned capacity=8);
+
+  unsigned nviews() const { return cams_.size(); }
+  unsigned npts() const { return pts_.size(); }
+  unsigned capacity() const { return capacity_; }
+
+  //: Projected view \p v, computed on first use.
+  view_ptr view(unsigned v);
+
+  const vpgl_perspective_camera<double> &camera(unsigned v) const { return cams_[v]; }
+  const std::vector<bdifd_3rd_order_point_3d> &points() const { return pts_; }
+  //: Curve of each sample.
+  const std::vector<unsigned> &curve_ids() const { return crv_id_; }
+
+  //: Cache statistics since construction.
+  unsigned long hits() const;
+  unsigned long misses() const;
+  unsigned long evictions() const;
+  //: Views currently cached (including ones being projected).
+  unsigned size() const;
+
+private:
+  struct slot;
+  typedef std::list<unsigned> lru_list;
+
+  void project(unsigned v, bdifd_projected_view *out) const;
+
+  std::vector<bdifd_3rd_order_point_3d> pts_;
+  std::vector<unsigned> crv_id_;
+  std::vector<vpgl_perspective_camera<double> > cams_;
+  unsigned capacity_;
+
+  mutable std::mutex mutex_;
+  lru_list lru_;                                  //:< most recent first
+  std::map<unsigned, std::shared_ptr<slot> > slots_;
+  unsigned long hits_, misses_, evictions_;
+};
+
+#endif // bdifd_view_cache_h
@@ -0,0 +1,107 @@
+#include "bdifd_work_pool.h"
+#include "bdifd_parallel.h"
+
+namespace {
+
+//: The pool and worker index of the calling thread, if it is a worker.
+thread_local const bdifd_work_pool *current_pool = 0;
+thread_local unsigned current_worker = 0;
+
+} // namespace
+
+bdifd_work_pool::
+bdifd_work_pool(unsigned nthreads)
+  : queued_(0), pending_(0), steals_(0), next_(0), stop_(false)
+{
+  nthreads = bdifd_parallel::num_threads(nthreads);
+  for (unsigned w=0; w < nthreads; ++w)
+    queues_.push_back(std::unique_ptr<queue>(new queue));
+  workers_.reserve(nthreads);
+  for (unsigned w=0; w < nthreads; ++w)
+    workers_.push_back(std::thread(&bdifd_work_pool::run, this, w));
+}
+
+bdifd_work_pool::
+~bdifd_work_pool()
+{
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (unsigned w=0; w < workers_.size(); ++w)
+    workers_[w].join();
+}
+
+void bdifd_work_pool::
+submit(const task &t)
+{
+  unsigned w = current_pool == this ? current_worker : next_++ % queues_.size();
+  ++pending_;
+  ++queued_;
+  {
+    std::lock_guard<std::mutex> lock(queues_[w]->mutex);
+    queues_[w]->tasks.push_back(t);
+  }
+  // taking the lock orders this against a worker about to sleep
+  { std::lock_guard<std::mutex> lock(idle_mutex_); }
+  work_cv_.notify_one();
+}
+
+void bdifd_work_pool::
+wait()
+{
+  std::unique_lock<std::mutex> lock(idle_mutex_);
+  done_cv_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+bool bdifd_work_pool::
+pop(unsigned w, task *t)
+{
+  unsigned n = queues_.size();
+  {
+    queue &q = *queues_[w];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (!q.tasks.empty()) {
+      *t = q.tasks.back();
+      q.tasks.pop_back();
+      return true;
+    }
+  }
+  for (unsigned i=1; i < n; ++i) {
+    queue &q = *queues_[(w + i) % n];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (!q.tasks.empty()) {
+      *t = q.tasks.front();
+      q.tasks.pop_front();
+      ++steals_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void bdifd_work_pool::
+run(unsigned w)
+{
+  current_pool = this;
+  current_worker = w;
+  task t;
+  for (;;) {
+    if (pop(w, &t)) {
+      --queued_;
+      t();
+      t = task();
+      if (--pending_ == 0) {
+        { std::lock_guard<std::mutex> lock(idle_mutex_); }
+        done_cv_.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    work_cv_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+    if (stop_ && queued_ == 0)
+      return;
+  }
+}
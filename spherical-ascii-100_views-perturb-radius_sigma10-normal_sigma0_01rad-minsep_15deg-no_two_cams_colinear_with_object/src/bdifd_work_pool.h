@@ -0,0 +1,79 @@
+// This is bdifd_work_pool.h
+#ifndef bdifd_work_pool_h
+#define bdifd_work_pool_h
+//:
+//\file
+//\brief Work-stealing thread pool for tasks that spawn further tasks
+//\date Sun Oct 18 2026
+//
+// bdifd_parallel::for_each suits a fixed set of similar items. A parameter
+// sweep is a tree instead: a variant sets up its cameras, then spawns one
+// task per view, and views of different variants differ in cost. Here each
+// worker owns a deque. A task submitted from a worker goes to the back of
+// that worker's deque and is taken from the back (depth first, while its
+// data is warm); an idle worker steals from the front of another's deque,
+// which holds the oldest and usually largest pieces of work. Tasks submitted
+// from outside the pool are dealt round robin.
+//
+// Tasks must not throw. A task that has to wait for others does not block a
+// worker: the last of a group to finish (e.g. through an atomic counter)
+// runs or submits what follows.
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class bdifd_work_pool {
+public:
+  typedef std::function<void()> task;
+
+  //: Starts \p nthreads workers (0 = one per core).
+  explicit bdifd_work_pool(unsigned nthreads=0);
+
+  //: Waits for all tasks, then stops the workers.
+  ~bdifd_work_pool();
+
+  //: Queues \p t; may be called from tasks.
+  void submit(const task &t);
+
+  //: Blocks until every task submitted so far, and every task those
+  // submitted, has finished. Not to be called from a task.
+  void wait();
+
+  unsigned nthreads() const { return workers_.size(); }
+
+  //: Tasks taken from another worker's deque so far.
+  unsigned long steals() const { return steals_; }
+
+private:
+  bdifd_work_pool(const bdifd_work_pool &);
+  bdifd_work_pool &operator=(const bdifd_work_pool &);
+
+  struct queue {
+    std::mutex mutex;
+    std::deque<task> tasks;
+  };
+
+  void run(unsigned w);
+  bool pop(unsigned w, task *t);
+
+  std::vector<std::unique_ptr<queue> > queues_;
+  std::vector<std::thread> workers_;
+
+  std::mutex idle_mutex_;
+  std::condition_variable work_cv_;   //:< tasks queued, or stopping
+  std::condition_variable done_cv_;   //:< pending_ reached zero
+  std::atomic<unsigned long> queued_;   //:< in a deque
+  std::atomic<unsigned long> pending_;  //:< submitted and not finished
+  std::atomic<unsigned long> steals_;
+  std::atomic<unsigned> next_;          //:< round robin for outside submits
+  bool stop_;
+};
+
+#endif // bdifd_work_pool_h
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vnl/vnl_math.h>
+#include <vul/vul_arg.h>
+#include <bdifd/algo/bdifd_bench.h>
+#include <bdifd/algo/bdifd_data.h>
+#include <bdifd/algo/bdifd_distortion.h>
+#include <bdifd/algo/bdifd_parallel.h>
+
+// Undistortion throughput: -n edgels at random positions of an olympus
+// (500x800, as generated) or ctspheres (native detector) image are undistorted
+// by Newton iteration and by a bdifd_undistort_lut with a grid every -step
+// pixels, on one thread and on -j. Also times building the table and pushing
+// third-order points through the distortion, and prints the largest
+// difference between table and iteration.
+//
+// Usage: bench_distortion [-calib olympus|ctspheres] [-n 2000000] [-step 1]
+//          [-distortion k1,k2,k3,p1,p2] [-reps 5] [-min_time 0.05] [-filter s]
+//          [-json file] [-j threads] [-seed s]
+//
+// With -json - the JSON report goes to stdout and the table to stderr.
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_calib("-calib", "olympus or ctspheres", "olympus");
+  vul_arg<unsigned> a_n("-n", "number of edgels", 2000000);
+  vul_arg<double> a_step("-step", "table grid step in pixels", 1);
+  vul_arg<std::string> a_distortion("-distortion", "k1,k2,k3,p1,p2", "-0.2,0.05,0,0.001,0.001");
+  vul_arg<unsigned> a_reps("-reps", "repetitions per case", 5);
+  vul_arg<double> a_min_time("-min_time", "minimum seconds per repetition", 0.05);
+  vul_arg<std::string> a_filter("-filter", "only run cases whose name contains this", "");
+  vul_arg<std::string> a_json("-json", "write the JSON report to this file ('-' for stdout)", "");
+  vul_arg<unsigned> a_threads("-j", "threads for the parallel cases (0 = all cores)", 0);
+  vul_arg<unsigned> a_seed("-seed", "random seed", 1);
+  vul_arg_parse(argc, argv);
+
+  bdifd_lens_distortion d;
+  if (!d.parse(a_distortion())) {
+    std::cerr << "bench_distortion: error, -distortion takes k1,k2,k3,p1,p2" << std::endl;
+    return 1;
+  }
+
+  vnl_double_3x3 K;
+  double width, height;
+  if (a_calib() == "olympus") {
+    bdifd_turntable::internal_calib_olympus(K, 500, 400, 900);
+    width = 500;
+    height = 800;
+  } else if (a_calib() == "ctspheres") {
+    double source_to_detector;
+    bdifd_turntable::internal_calib_ctspheres(K);
+    bdifd_turntable::ctspheres_detector(4000, &source_to_detector, &width, &height);
+  } else {
+    std::cerr << "bench_distortion: error, unknown -calib " << a_calib() << std::endl;
+    return 1;
+  }
+
+  unsigned n = a_n(), nthreads = bdifd_parallel::num_threads(a_threads());
+  std::vector<double> xd(n), yd(n), x(n), y(n), xl(n), yl(n);
+  std::mt19937 rng(a_seed());
+  std::uniform_real_distribution<double> ux(0, width), uy(0, height), uth(0, 2*vnl_math::pi);
+  for (unsigned i=0; i < n; ++i) {
+    xd[i] = ux(rng);
+    yd[i] = uy(rng);
+  }
+
+  bdifd_bench bench(a_reps(), a_min_time(), a_filter());
+  typedef bdifd_bench::params params;
+  params p(1, std::make_pair(std::string("points"), double(n)));
+  params pj = p;
+  pj.push_back(std::make_pair(std::string("threads"), double(nthreads)));
+  params ps(1, std::make_pair(std::string("step"), a_step()));
+
+  bdifd_undistort_lut lut;
+  double nodes = (std::ceil(width/a_step()) + 1)*(std::ceil(height/a_step()) + 1);
+  bench.run("undistort_lut_build", ps, nodes, [&]() {
+    lut.build(K, d, width, height, a_step(), nthreads);
+  });
+  if (!lut.bytes())
+    lut.build(K, d, width, height, a_step(), nthreads);
+
+  bench.run("undistort_iterative", p, n, [&]() {
+    for (unsigned i=0; i < n; ++i)
+      d.undistort_pixel(K, xd[i], yd[i], &x[i], &y[i]);
+  });
+  bench.run("undistort_iterative_parallel", pj, n, [&]() {
+    bdifd_parallel::for_blocks(n, 1 << 14, [&](unsigned b, unsigned e) {
+      for (unsigned i=b; i < e; ++i)
+        d.undistort_pixel(K, xd[i], yd[i], &x[i], &y[i]);
+    }, nthreads);
+  });
+  bench.run("undistort_lut", p, n, [&]() {
+    lut.undistort(n, &xd[0], &yd[0], &xl[0], &yl[0]);
+  });
+  bench.run("undistort_lut_parallel", pj, n, [&]() {
+    bdifd_parallel::for_blocks(n, 1 << 14, [&](unsigned b, unsigned e) {
+      lut.undistort(e - b, &xd[b], &yd[b], &xl[b], &yl[b]);
+    }, nthreads);
+  });
+
+  std::vector<bdifd_3rd_order_point_2d> pts(n);
+  for (unsigned i=0; i < n; ++i) {
+    double th = uth(rng);
+    pts[i].gama[0] = xd[i];
+    pts[i].gama[1] = yd[i];
+    pts[i].gama[2] = 0;
+    pts[i].t[0] = std::cos(th);
+    pts[i].t[1] = std::sin(th);
+    pts[i].t[2] = 0;
+    pts[i].n[0] = -pts[i].t[1];
+    pts[i].n[1] = pts[i].t[0];
+    pts[i].n[2] = 0;
+    pts[i].k = 0.01;
+    pts[i].kdot = 0;
+    pts[i].valid = true;
+  }
+  std::vector<bdifd_3rd_order_point_2d> out(n);
+  bench.run("distort_3rd_order", p, n, [&]() {
+    for (unsigned i=0; i < n; ++i) {
+      out[i] = pts[i];
+      d.distort(K, &out[i]);
+    }
+  });
+
+  // accuracy of the table, against iteration
+  for (unsigned i=0; i < n; ++i)
+    d.undistort_pixel(K, xd[i], yd[i], &x[i], &y[i]);
+  lut.undistort(n, &xd[0], &yd[0], &xl[0], &yl[0]);
+  double max_err = 0;
+  for (unsigned i=0; i < n; ++i)
+    max_err = std::max(max_err, std::sqrt((xl[i] - x[i])*(xl[i] - x[i]) + (yl[i] - y[i])*(yl[i] - y[i])));
+
+  // with the JSON on stdout the text goes to stderr, so stdout parses
+  std::ostream &os = a_json() == "-" ? std::cerr : std::cout;
+  bench.print(os);
+  os << "Table: " << width << "x" << height << " every " << a_step() << " px, "
+    << lut.bytes()/1048576.0 << " MiB; largest difference from iteration " << max_err << " px"
+    << std::endl;
+
+  if (!a_json().empty()) {
+    std::vector<std::pair<std::string, std::string> > context;
+    context.push_back(std::make_pair(std::string("executable"), std::string(argv[0])));
+    context.push_back(std::make_pair(std::string("calib"), a_calib()));
+    context.push_back(std::make_pair(std::string("distortion"), a_distortion()));
+
+    if (a_json() == "-")
+      bench.write_json(std::cout, context);
+    else {
+      std::ofstream fp(a_json().c_str());
+      if (!fp) {
+        std::cerr << "bench_distortion: error, unable to open file name " << a_json() << std::endl;
+        return 1;
+      }
+      bench.write_json(fp, context);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vul/vul_arg.h>
+#include <vul/vul_file.h>
+#include <bdifd/bdifd_camera.h>
+#include <bdifd/bdifd_rig.h>
+#include <bdifd/algo/bdifd_data.h>
+#include <bdifd/algo/bdifd_edgel_sampler.h>
+#include <bdifd/algo/bdifd_err_stats.h>
+#include <bdifd/algo/bdifd_bench.h>
+#include <bdifd/algo/bdifd_turntable_rig.h>
+#include <bmcsd/bmcsd_util.h>
+
+// Microbenchmarks for each stage of the dataset generator, plus end-to-end
+// runs reproducing the turntable (20 views) and spherical (100 views)
+// datasets. Per-stage cases are parameterized by the number of views and of
+// curve samples; samples are the synthetic curves repeated or truncated to
+// the requested count, views are the spherical cameras, repeated as needed
+// (at least 3, as err_reproj_perturb reprojects into a third view).
+//
+// The spherical cameras are drawn from -seed, so every run times the same
+// cameras (0 seeds from the clock, as generate_synth_sequence_3 does by
+// default).
+//
+// Usage: bench_generator [-views 3,20,100] [-points 1000,5117,50000]
+//          [-reps 5] [-min_time 0.05] [-filter stage] [-json out.json] [-dir /tmp/...]
+//          [-seed 1]
+//
+// With -json - the JSON report goes to stdout and the table to stderr.
+//
+
+static std::vector<unsigned>
+parse_list(const std::string &s)
+{
+  std::vector<unsigned> v;
+  std::istringstream is(s);
+  std::string tok;
+  while (std::getline(is, tok, ','))
+    if (!tok.empty())
+      v.push_back(std::atoi(tok.c_str()));
+  return v;
+}
+
+//: One curve holding \p n samples taken cyclically from all of \p crv3d.
+static void
+resample(const std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d, unsigned n,
+    std::vector<std::vector<bdifd_3rd_order_point_3d> > &out)
+{
+  std::vector<bdifd_3rd_order_point_3d> all;
+  for (unsigned c=0; c < crv3d.size(); ++c)
+    all.insert(all.end(), crv3d[c].begin(), crv3d[c].end());
+  out.assign(1, std::vector<bdifd_3rd_order_point_3d>(n));
+  for (unsigned i=0; i < n; ++i)
+    out[0][i] = all[i % all.size()];
+}
+
+static void
+turntable_cameras(unsigned nviews, const vpgl_calibration_matrix<double> &K,
+    std::vector<vpgl_perspective_camera<double> > &cam_vpgl)
+{
+  cam_vpgl.resize(nviews);
+  bdifd_turntable_rig::olympus(K).cameras(0, 6, nviews, &cam_vpgl[0]);
+}
+
+//: Writes the ASCII files of the generator (minus cameras) into \p dir.
+static bool
+write_ascii(const std::string &dir,
+    const std::vector<std::vector<bdifd_3rd_order_point_3d> > &crv3d,
+    const std::vector<std::vector<bdifd_3rd_order_point_2d> > &crv2d)
+{
+  for (unsigned k=0; k < crv2d.size(); ++k) {
+    std::ostringstream v_str;
+    v_str << std::setw(4) << std::setfill('0') << k;
+    std::string fname_base = dir + std::string("/frame_") + v_str.str();
+
+    std::ofstream fp_pts2d((fname_base + "-pts-2D.txt").c_str());
+    std::ofstream fp_tgts2d((fname_base + "-tgts-2D.txt").c_str());
+    if (!fp_pts2d || !fp_tgts2d)
+      return false;
+    fp_pts2d << std::setprecision(20);
+    fp_tgts2d << std::setprecision(20);
+    for (unsigned j=0; j < crv2d[k].size(); ++j) {
+      fp_pts2d << crv2d[k][j].gama[0] << " " << crv2d[k][j].gama[1] << std::endl;
+      fp_tgts2d << crv2d[k][j].t[0] << " " << crv2d[k][j].t[1] << std::endl;
+    }
+  }
+
+  std::ofstream fp_crv_id((dir + "/crv-ids.txt").c_str());
+  std::ofstream fp_crv_3d_pts((dir + "/crv-3D-pts.txt").c_str());
+  std::ofstream fp_crv_3d_tgts((dir + "/crv-3D-tgts.txt").c_str());
+  if (!fp_crv_id || !fp_crv_3d_pts || !fp_crv_3d_tgts)
+    return false;
+  fp_crv_3d_pts << std::setprecision(20);
+  fp_crv_3d_tgts << std::setprecision(20);
+  for (unsigned i=0; i < crv3d.size(); ++i)
+    for (unsigned k=0; k < crv3d[i].size(); ++k) {
+      fp_crv_id << i << std::endl;
+      fp_crv_3d_pts << crv3d[i][k].Gama[0] << " " << crv3d[i][k].Gama[1]  << " " << crv3d[i][k].Gama[2] << std::endl;
+      fp_crv_3d_tgts << crv3d[i][k].T[0] << " " << crv3d[i][k].T[1]  << " " << crv3d[i][k].T[2] << std::endl;
+    }
+  return true;
+}
+
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_views("-views", "comma-separated numbers of views", "3,20,100");
+  vul_arg<std::string> a_points("-points", "comma-separated numbers of curve samples", "1000,5117,50000");
+  vul_arg<unsigned> a_reps("-reps", "repetitions per case", 5);
+  vul_arg<double> a_min_time("-min_time", "minimum seconds per repetition", 0.05);
+  vul_arg<std::string> a_filter("-filter", "only run cases whose name contains this", "");
+  vul_arg<std::string> a_json("-json", "write the JSON report to this file ('-' for stdout)", "");
+  vul_arg<std::string> a_dir("-dir", "scratch directory for the writing stages", "./out-bench");
+  vul_arg<unsigned> a_seed("-seed", "camera seed (0 = clock)", 1);
+  vul_arg_parse(argc, argv);
+
+  std::vector<unsigned> views = parse_list(a_views());
+  std::vector<unsigned> points = parse_list(a_points());
+  const std::string &dir = a_dir();
+  vul_file::make_directory(dir);
+
+  bdifd_bench bench(a_reps(), a_min_time(), a_filter());
+  typedef bdifd_bench::params params;
+
+  vnl_double_3x3 Kmatrix;
+  bdifd_turntable::internal_calib_olympus(Kmatrix, 500, 400, 900);
+  vpgl_calibration_matrix<double> K(Kmatrix);
+
+  // Curve sampling
+  std::vector<std::vector<bdifd_3rd_order_point_3d> > crv3d;
+  bench.run("space_curves_olympus_turntable", params(), 0, [&]() {
+    crv3d.clear();
+    bdifd_data::space_curves_olympus_turntable(crv3d);
+  });
+  bench.run("space_curves_digicam_turntable_sandbox", params(), 0, [&]() {
+    std::vector<std::vector<bdifd_3rd_order_point_3d> > c;
+    bdifd_data::space_curves_digicam_turntable_sandbox(c);
+  });
+  bench.run("space_curves_ctspheres", params(), 0, [&]() {
+    std::vector<std::vector<bdifd_3rd_order_point_3d> > c;
+    bdifd_data::space_curves_ctspheres(c);
+  });
+  if (crv3d.empty())
+    bdifd_data::space_curves_olympus_turntable(crv3d);
+
+  // Cameras
+  std::vector<vpgl_perspective_camera<double> > cam_sph;
+  bench.run("cameras_olympus_spherical", params(), 100, [&]() {
+    cam_sph.clear();
+    bdifd_turntable::cameras_olympus_spherical(&cam_sph, K, true, true, a_seed());
+  });
+  if (cam_sph.empty())
+    bdifd_turntable::cameras_olympus_spherical(&cam_sph, K, true, true, a_seed());
+
+  // one frame at a time, as the turntable drivers used to ask for them
+  bench.run("camera_olympus", params(1, std::make_pair(std::string("views"), 20.0)), 20, [&]() {
+    for (unsigned v=0; v < 20; ++v)
+      delete bdifd_turntable::camera_olympus(v*6, K);
+  });
+  bench.run("turntable_cameras", params(1, std::make_pair(std::string("views"), 20.0)), 20, [&]() {
+    std::vector<vpgl_perspective_camera<double> > c;
+    turntable_cameras(20, K, c);
+  });
+
+  // CT-style sequence: 0.5 degree steps over a full turn
+  {
+  bdifd_turntable_rig rig = bdifd_turntable_rig::olympus(K);
+  std::vector<double> P(720*12);
+  std::vector<vpgl_perspective_camera<double> > c(720);
+  params p(1, std::make_pair(std::string("views"), 720.0));
+  bench.run("turntable_rig_projections", p, 720, [&]() {
+    rig.projections(0, 0.5, 720, &P[0]);
+  });
+  bench.run("turntable_rig_cameras", p, 720, [&]() {
+    rig.cameras(0, 0.5, 720, &c[0]);
+  });
+  }
+
+  // Image edgels: oversampling then limit_distance (spacing 0) against
+  // sampling at the target spacing
+  {
+  const double radii[] = {20, 100, 400};
+  for (unsigned ir=0; ir < 3; ++ir) {
+    double r = radii[ir];
+    for (unsigned adaptive=0; adaptive < 2; ++adaptive) {
+      params p(1, std::make_pair(std::string("radius"), r));
+      std::string suffix = adaptive ? "_adaptive" : "_prune";
+      std::vector<vsol_line_2d_sptr> lines;
+      std::vector<bdifd_3rd_order_point_2d> C;
+      bench.run("get_circle_edgels" + suffix, p, 0, [&]() {
+        bdifd_data::get_circle_edgels(r, lines, C, false, 0.1, 10, 0, adaptive ? 1 : 0);
+      });
+      bench.run("get_ellipse_edgels" + suffix, p, 0, [&]() {
+        bdifd_data::get_ellipse_edgels(r, r/4, lines, C, false, 0.1, 10, 0, adaptive ? 1 : 0);
+      });
+    }
+  }
+
+  std::vector<bdifd_conic_arc> arcs;
+  for (unsigned i=0; i < 2000; ++i)
+    arcs.push_back(bdifd_conic_arc(20 + (i*37) % 300, 5 + (i*53) % 200, 500, 400));
+  std::vector<std::vector<bdifd_3rd_order_point_2d> > C;
+  bdifd_edgel_sampler sampler;
+  bench.run("edgel_sampler_arcs", params(1, std::make_pair(std::string("arcs"), 2000.0)), 2000, [&]() {
+    sampler.sample(arcs, &C);
+  });
+  }
+
+  for (unsigned iv=0; iv < views.size(); ++iv) {
+    unsigned nv = std::max(views[iv], 3u);
+    std::vector<bdifd_camera> cam(nv);
+    for (unsigned v=0; v < nv; ++v)
+      cam[v].set_p(cam_sph[v % cam_sph.size()]);
+
+    for (unsigned ip=0; ip < points.size(); ++ip) {
+      unsigned np = points[ip];
+      params p;
+      p.push_back(std::make_pair(std::string("views"), double(nv)));
+      p.push_back(std::make_pair(std::string("points"), double(np)));
+
+      std::vector<std::vector<bdifd_3rd_order_point_3d> > c3d;
+      resample(crv3d, np, c3d);
+
+      // Projection and filtering
+      std::vector<std::vector<bdifd_3rd_order_point_2d> > crv2d;
+      bench.run("project_into_cams", p, double(nv)*np, [&]() {
+        bdifd_data::project_into_cams(c3d, cam, crv2d);
+      });
+      if (crv2d.empty())
+        bdifd_data::project_into_cams(c3d, cam, crv2d);
+
+      bench.run("project_into_cams_without_epitangency", p, double(nv)*np, [&]() {
+        std::vector<std::vector<bdifd_3rd_order_point_2d> > f;
+        bdifd_data::project_into_cams_without_epitangency(c3d, cam, f, vnl_math::pi/6);
+      });
+
+      // Error evaluation: views 0,1 reconstruct, view 2 reprojects; does
+      // not depend on the number of views.
+      if (iv == 0) {
+        bdifd_rig rig(cam[0].Pr_, cam[1].Pr_);
+        params pe(1, p[1]);
+        bench.run("err_reproj_perturb", pe, np, [&]() {
+          std::vector<double> e_pos, e_t, e_k, e_kdot;
+          std::vector<unsigned> idx;
+          bdifd_data::err_reproj_perturb(crv2d, cam, rig, e_pos, e_t, e_k, e_kdot, idx);
+        });
+        bench.run("err_reproj_perturb_streaming", pe, np, [&]() {
+          bdifd_err_stats e_pos, e_t, e_k, e_kdot;
+          bdifd_data::err_reproj_perturb(crv2d, cam, rig, e_pos, e_t, e_k, e_kdot);
+        });
+      }
+
+      // Writing
+      bench.run("write_ascii", p, double(nv)*np, [&]() {
+        if (!write_ascii(dir, c3d, crv2d))
+          std::cerr << "bench_generator: error writing to " << dir << std::endl;
+      });
+    }
+  }
+
+  // End to end: cameras, curves, projection and all files, as the
+  // generate_synth_sequence drivers do.
+  bench.run("e2e_turntable", params(1, std::make_pair(std::string("views"), 20.0)), 0, [&]() {
+    std::vector<vpgl_perspective_camera<double> > cam_vpgl;
+    turntable_cameras(20, K, cam_vpgl);
+    std::vector<bdifd_camera> cam(cam_vpgl.size());
+    for (unsigned i=0; i < cam.size(); ++i)
+      cam[i].set_p(cam_vpgl[i]);
+    bmcsd_util::write_cams(dir, "frame_", bmcsd_util::BMCS_INTRINSIC_EXTRINSIC, cam_vpgl);
+
+    std::vector<std::vector<bdifd_3rd_order_point_3d> > c3d;
+    std::vector<std::vector<bdifd_3rd_order_point_2d> > c2d;
+    bdifd_data::space_curves_olympus_turntable(c3d);
+    bdifd_data::project_into_cams(c3d, cam, c2d);
+    write_ascii(dir, c3d, c2d);
+  });
+
+  bench.run("e2e_spherical", params(1, std::make_pair(std::string("views"), 100.0)), 0, [&]() {
+    std::vector<vpgl_perspective_camera<double> > cam_vpgl;
+    bdifd_turntable::cameras_olympus_spherical(&cam_vpgl, K, true, true, a_seed());
+    std::vector<bdifd_camera> cam(cam_vpgl.size());
+    for (unsigned i=0; i < cam.size(); ++i)
+      cam[i].set_p(cam_vpgl[i]);
+    bmcsd_util::write_cams(dir, "frame_", bmcsd_util::BMCS_INTRINSIC_EXTRINSIC, cam_vpgl);
+
+    std::vector<std::vector<bdifd_3rd_order_point_3d> > c3d;
+    std::vector<std::vector<bdifd_3rd_order_point_2d> > c2d;
+    bdifd_data::space_curves_olympus_turntable(c3d);
+    bdifd_data::project_into_cams(c3d, cam, c2d);
+    write_ascii(dir, c3d, c2d);
+  });
+
+  // with the JSON on stdout the table goes to stderr, so stdout parses
+  bench.print(a_json() == "-" ? std::cerr : std::cout);
+
+  if (!a_json().empty()) {
+    std::vector<std::pair<std::string, std::string> > context;
+    context.push_back(std::make_pair(std::string("executable"), std::string(argv[0])));
+    context.push_back(std::make_pair(std::string("views"), a_views()));
+    context.push_back(std::make_pair(std::string("points"), a_points()));
+#ifdef NDEBUG
+    context.push_back(std::make_pair(std::string("library_build_type"), std::string("release")));
+#else
+    context.push_back(std::make_pair(std::string("library_build_type"), std::string("debug")));
+#endif
+
+    if (a_json() == "-")
+      bench.write_json(std::cout, context);
+    else {
+      std::ofstream fp(a_json().c_str());
+      if (!fp) {
+        std::cerr << "bench_generator: error, unable to open file name " << a_json() << std::endl;
+        return 1;
+      }
+      bench.write_json(fp, context);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_minimal_bench.h>
+
+// Benchmark for minimal relative pose solvers, e.g. one generated from
+// bifocal-5pt-R_sincos-T_eliminated-expanded.m: runs -trials random minimal
+// sets through the solver at each level of the noise ladder and reports
+// solves/s, success rate and the rotation and translation errors against the
+// .extrinsic files.
+//
+// -pos and -theta give the ladder, uniform noise of up to that many pixels
+// and degrees as in the dataset README; -theta is only swept for solvers that
+// use tangents. View pairs or triplets are given as "-views 0,5;3,11" (first
+// two or three numbers of each group) or drawn at random.
+//
+// Usage: bench_minimal -dir dataset [-solver 8pt] [-trials n] [-pos 0,0.5,1,2]
+//          [-theta 0,0.5,1,5,10] [-views i,j[,k];...] [-tol_deg d] [-batch n]
+//          [-seed s] [-j threads]
+//
+static bool
+parse_list(const std::string &str, std::vector<double> *v)
+{
+  std::string s = str;
+  for (unsigned i=0; i < s.size(); ++i)
+    if (s[i] == ',')
+      s[i] = ' ';
+  std::istringstream is(s);
+  double d;
+  v->clear();
+  while (is >> d)
+    v->push_back(d);
+  return is.eof() && !v->empty();
+}
+
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "dataset directory", ".");
+  vul_arg<std::string> a_solver("-solver", "minimal solver", "8pt");
+  vul_arg<unsigned long> a_trials("-trials", "trials per noise level", 100000);
+  vul_arg<std::string> a_pos("-pos", "position noise ladder, pixels", "0,0.5,1,2");
+  vul_arg<std::string> a_theta("-theta", "tangent noise ladder, degrees", "0,0.5,1,5,10");
+  vul_arg<std::string> a_views("-views", "view pairs or triplets, e.g. 0,5;3,11", "");
+  vul_arg<double> a_tol("-tol_deg", "success tolerance on rotation and translation, degrees", 1);
+  vul_arg<unsigned> a_batch("-batch", "trials per batch", 4096);
+  vul_arg<unsigned> a_seed("-seed", "seed for sampling and noise", 5117);
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg_parse(argc, argv);
+
+  std::unique_ptr<bdifd_minimal_solver> solver(bdifd_minimal_solver::create(a_solver()));
+  if (!solver) {
+    std::cerr << "bench_minimal: error, unknown solver " << a_solver() << "; available:";
+    std::vector<std::string> n = bdifd_minimal_solver::names();
+    for (unsigned i=0; i < n.size(); ++i)
+      std::cerr << " " << n[i];
+    std::cerr << std::endl;
+    return 1;
+  }
+  unsigned nv = solver->nviews();
+
+  std::vector<double> pos, theta;
+  if (!parse_list(a_pos(), &pos) || !parse_list(a_theta(), &theta)) {
+    std::cerr << "bench_minimal: error, bad noise ladder" << std::endl;
+    return 1;
+  }
+  if (!solver->uses_tangents())
+    theta.assign(1, 0.0);
+
+  bdifd_ascii_dataset ds;
+  if (!ds.read(a_dir()))
+    return 1;
+  if (ds.nviews() < nv) {
+    std::cerr << "bench_minimal: error, need at least " << nv << " views, got " << ds.nviews() << std::endl;
+    return 1;
+  }
+
+  std::vector<vnl_vector_fixed<unsigned,3> > views;
+  if (!a_views().empty()) {
+    std::string s = a_views();
+    std::istringstream groups(s);
+    std::string g;
+    while (std::getline(groups, g, ';')) {
+      std::vector<double> v;
+      if (!parse_list(g, &v) || v.size() < nv) {
+        std::cerr << "bench_minimal: error, need " << nv << " views in group '" << g << "'" << std::endl;
+        return 1;
+      }
+      vnl_vector_fixed<unsigned,3> w(0u, 0u, 0u);
+      for (unsigned j=0; j < nv; ++j) {
+        if (v[j] < 0 || v[j] >= ds.nviews()) {
+          std::cerr << "bench_minimal: error, view out of range in group '" << g << "'" << std::endl;
+          return 1;
+        }
+        w[j] = static_cast<unsigned>(v[j]);
+      }
+      views.push_back(w);
+    }
+  }
+
+  bdifd_minimal_bench bench(ds);
+  bench.set_views(views);
+  bench.set_tolerance(a_tol());
+  bench.set_batch(a_batch());
+
+  std::cout << "Solver " << solver->name() << ": " << nv << " views, " << solver->npoints()
+    << (solver->uses_tangents() ? " points with tangents" : " points") << ", "
+    << a_trials() << " trials per level" << std::endl;
+
+  vul_timer t;
+  unsigned long total = 0, total_success = 0;
+  for (unsigned p=0; p < pos.size(); ++p)
+    for (unsigned q=0; q < theta.size(); ++q) {
+      bdifd_minimal_result r;
+      bench.run(*solver, pos[p], theta[q], a_trials(), a_seed() + 7919*(p*theta.size() + q), &r, a_threads());
+      total += r.trials;
+      total_success += r.success;
+
+      // none with -trials 0, or when the dataset has too few samples
+      std::cout << "Noise " << r.dpos << " px, " << r.dtheta << " deg: ";
+      if (!r.trials) {
+        std::cout << "n/a, no trials run" << std::endl;
+        std::cout << "---" << std::endl;
+        continue;
+      }
+      std::cout << 100.0*r.solved/r.trials << "% solved, "
+        << 100.0*r.success/r.trials << "% within " << a_tol() << " deg, "
+        << double(r.solutions)/r.trials << " solutions/trial" << std::endl;
+      std::cout << "Throughput: " << r.trials/r.solve_seconds << " solves/s per thread, "
+        << r.trials/r.wall_seconds << " trials/s overall" << std::endl;
+      r.rot_err.print_summary(std::cout, "Rotation error (deg)");
+      r.t_err.print_summary(std::cout, "Translation direction error (deg)");
+      std::cout << "---" << std::endl;
+    }
+
+  std::cout << "Ran " << total << " trials in " << t.real()/1000.0 << " s, ";
+  if (total)
+    std::cout << 100.0*total_success/total << "% within tolerance" << std::endl;
+  else
+    std::cout << "n/a within tolerance" << std::endl;
+  return 0;
+}
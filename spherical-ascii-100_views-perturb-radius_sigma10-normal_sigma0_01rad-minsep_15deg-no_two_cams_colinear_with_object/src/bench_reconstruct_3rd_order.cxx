@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <bdifd/bdifd_camera.h>
+#include <bdifd/bdifd_rig.h>
+#include <bdifd/algo/bdifd_data.h>
+#include <bdifd/algo/bdifd_parallel.h>
+#include <bdifd/algo/bdifd_rig_batch.h>
+
+// Compares bdifd_rig::reconstruct_3rd_order against the batched SoA kernel on
+// the synthetic curves seen from two of the spherical cameras. Reports the
+// throughput of each path in points/second and the largest deviation between
+// them over the samples the evaluation code keeps (epipolar angle > 30deg).
+//
+// Exits with 1 if the point, the curvature, its derivative or the torsion
+// (relative to max(1, |value|)) or the tangent angle (radians, signed
+// tangents, so a flipped tangent counts as pi) deviates by more than -tol.
+// Both paths are closed form, and the batched kernel agrees with analytic
+// curves to about 1e-12, so the default leaves room only for ill-conditioned
+// samples. The cameras are drawn from -seed, so that a run can be repeated
+// (0 seeds from the clock, as generate_synth_sequence_3 does by default).
+//
+// Usage: bench_reconstruct_3rd_order [-n points] [-v1 view] [-v2 view] [-j threads]
+//          [-tol 1e-6] [-seed 1]
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<unsigned> a_n("-n", "number of correspondences (samples are repeated)", 2000000);
+  vul_arg<unsigned> a_v1("-v1", "first view", 0);
+  vul_arg<unsigned> a_v2("-v2", "second view", 1);
+  vul_arg<unsigned> a_threads("-j", "threads for the batched path (0 = all cores)", 1);
+  vul_arg<double> a_tol("-tol", "largest deviation of Gama, T, K, Kdot and Tau allowed", 1e-6);
+  vul_arg<unsigned> a_seed("-seed", "camera seed (0 = clock)", 1);
+  vul_arg_parse(argc, argv);
+
+  unsigned  crop_origin_x_ = 400;
+  unsigned  crop_origin_y_ = 900;
+  double x_max_scaled = 500;
+
+  vnl_double_3x3 Kmatrix;
+  bdifd_turntable::internal_calib_olympus(Kmatrix, x_max_scaled, crop_origin_x_, crop_origin_y_);
+
+  vpgl_calibration_matrix<double> K(Kmatrix);
+  std::vector<vpgl_perspective_camera<double> > cam_vpgl;
+  bdifd_turntable::cameras_olympus_spherical(&cam_vpgl, K, true, true, a_seed());
+
+  if (a_v1() >= cam_vpgl.size() || a_v2() >= cam_vpgl.size() || a_v1() == a_v2()) {
+    std::cerr << "Invalid views; there are " << cam_vpgl.size() << " cameras.\n";
+    return 1;
+  }
+
+  std::vector<bdifd_camera> cam(2);
+  cam[0].set_p(cam_vpgl[a_v1()]);
+  cam[1].set_p(cam_vpgl[a_v2()]);
+
+  std::vector<std::vector<bdifd_3rd_order_point_3d> > crv3d;
+  bdifd_data::space_curves_olympus_turntable( crv3d );
+
+  std::vector<bdifd_3rd_order_point_2d> x1, x2;
+  for (unsigned c=0; c < crv3d.size(); ++c) {
+    std::vector<std::vector<bdifd_3rd_order_point_2d> > xc;
+    bdifd_data::project_into_cams(crv3d[c], cam, xc);
+    x1.insert(x1.end(), xc[0].begin(), xc[0].end());
+    x2.insert(x2.end(), xc[1].begin(), xc[1].end());
+  }
+
+  bdifd_rig rig(cam[0].Pr_, cam[1].Pr_);
+  const double epipolar_angle_thresh = vnl_math::pi/6;
+  std::vector<bool> keep(x1.size());
+  for (unsigned i=0; i < x1.size(); ++i)
+    keep[i] = x1[i].valid && x2[i].valid &&
+      bdifd_rig::angle_with_epipolar_line(x1[i].t,x1[i].gama,rig.f12) > epipolar_angle_thresh;
+
+  unsigned npts = std::max(a_n(), (unsigned)x1.size());
+  std::cout << "Samples: " << x1.size() << ", correspondences: " << npts << std::endl;
+
+  // Scalar path, as called from err_reproj_perturb.
+  std::vector<bdifd_3rd_order_point_3d> Xs(x1.size());
+  vul_timer t;
+  for (unsigned i=0; i < npts; ++i) {
+    unsigned j = i % x1.size();
+    bdifd_3rd_order_point_2d p1_w, p2_w;
+    rig.cam[0].img_to_world(&x1[j],&p1_w);
+    rig.cam[1].img_to_world(&x2[j],&p2_w);
+    rig.reconstruct_3rd_order(p1_w, p2_w, &Xs[j]);
+  }
+  double t_scalar = t.real()/1000.0;
+
+  bdifd_2d_soa s1, s2;
+  s1.resize(npts);
+  s2.resize(npts);
+  for (unsigned i=0; i < npts; ++i) {
+    s1.set(i, x1[i % x1.size()]);
+    s2.set(i, x2[i % x1.size()]);
+  }
+
+  bdifd_rig_batch batch(rig);
+  bdifd_3d_soa Xb;
+  Xb.resize(npts);
+  t.mark();
+  batch.reconstruct_3rd_order(s1, s2, &Xb, a_threads());
+  double t_batch = t.real()/1000.0;
+
+  double d_gama = 0, d_t = 0, d_k = 0, d_kdot = 0, d_tau = 0;
+  unsigned ncmp = 0;
+  // largest so far, a NaN sticking
+  auto worst = [](double d, double x) { return x > d || x != x ? x : d; };
+  for (unsigned i=0; i < x1.size(); ++i) {
+    if (!keep[i] || !Xb.valid[i])
+      continue;
+    bdifd_3rd_order_point_3d P;
+    Xb.get(i, &P);
+    const bdifd_3rd_order_point_3d &S = Xs[i];
+    d_gama = worst(d_gama, (P.Gama - S.Gama).magnitude()/std::max(1.0, S.Gama.magnitude()));
+    d_t = worst(d_t, std::acos(std::max(-1.0, std::min(1.0, dot_product(P.T, S.T)))));
+    d_k = worst(d_k, std::fabs(P.K - S.K)/std::max(1.0, std::fabs(S.K)));
+    d_kdot = worst(d_kdot, std::fabs(P.Kdot - S.Kdot)/std::max(1.0, std::fabs(S.Kdot)));
+    d_tau = worst(d_tau, std::fabs(P.Tau - S.Tau)/std::max(1.0, std::fabs(S.Tau)));
+    ++ncmp;
+  }
+
+  std::cout << "Scalar:  " << t_scalar << " s, " << npts/t_scalar << " points/s" << std::endl;
+  std::cout << "Batched: " << t_batch << " s, " << npts/t_batch << " points/s ("
+    << (a_threads() ? a_threads() : bdifd_parallel::num_threads()) << " threads)" << std::endl;
+  std::cout << "Speedup: " << t_scalar/t_batch << std::endl;
+  std::cout << "Max deviation over " << ncmp << " samples: Gama " << d_gama
+    << ", T angle " << d_t << ", K " << d_k << ", Kdot " << d_kdot << ", Tau " << d_tau << std::endl;
+
+  double tol = a_tol();
+  if (!(d_gama <= tol && d_t <= tol && d_k <= tol && d_kdot <= tol && d_tau <= tol)) {
+    std::cerr << "bench_reconstruct_3rd_order: error, batched path deviates by more than "
+      << tol << std::endl;
+    return 1;
+  }
+  return 0;
+}
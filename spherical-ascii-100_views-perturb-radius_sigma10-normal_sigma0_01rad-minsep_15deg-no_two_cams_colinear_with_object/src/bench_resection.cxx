@@ -0,0 +1,166 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <vnl/vnl_math.h>
+#include <vnl/vnl_random.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_err_stats.h>
+#include <bdifd/algo/bdifd_parallel.h>
+#include <bdifd/algo/bdifd_resection.h>
+
+// Camera resection benchmark, the counterpart of the onecamattime runs in
+// misc/old/synth-data-38curves-perturb2: estimates the pose of every view of
+// an ASCII dataset from its 2D-3D point and tangent correspondences, then
+// refines it. Per view it prints the same "Initial/Final average, max, med
+// error" lines (reprojection, pixels), followed by the pose error against the
+// .extrinsic file; the summary gives solves and refinements per second.
+//
+// -subset n uses n random samples per view; -sigma and -tangent_sigma perturb
+// the image points (pixels) and tangents (degrees).
+//
+// Usage: bench_resection -dir dataset [-solver dlt] [-subset n] [-sigma px]
+//          [-tangent_sigma deg] [-tangent_weight w] [-norefine] [-seed s]
+//          [-j threads]
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "dataset directory", ".");
+  vul_arg<std::string> a_solver("-solver", "pose solver", "dlt");
+  vul_arg<unsigned> a_subset("-subset", "samples per view (0 = all)", 0);
+  vul_arg<double> a_sigma("-sigma", "std. deviation of the image point noise, pixels", 0);
+  vul_arg<double> a_tsigma("-tangent_sigma", "std. deviation of the image tangent noise, degrees", 0);
+  vul_arg<double> a_tweight("-tangent_weight", "weight of tangents in the refinement (0 = points only)", 1);
+  vul_arg<bool> a_norefine("-norefine", "skip the refinement", false);
+  vul_arg<unsigned> a_seed("-seed", "seed for subsets and noise", 5117);
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg_parse(argc, argv);
+
+  std::unique_ptr<bdifd_resection_solver> solver(bdifd_resection_solver::create(a_solver()));
+  if (!solver) {
+    std::cerr << "bench_resection: error, unknown solver " << a_solver() << "; available:";
+    std::vector<std::string> n = bdifd_resection_solver::names();
+    for (unsigned i=0; i < n.size(); ++i)
+      std::cerr << " " << n[i];
+    std::cerr << std::endl;
+    return 1;
+  }
+
+  bdifd_ascii_dataset ds;
+  if (!ds.read(a_dir()))
+    return 1;
+  unsigned nviews = ds.nviews();
+
+  // problems are built up front so only solving is timed
+  std::vector<bdifd_resection_problem> prob(nviews);
+  for (unsigned v=0; v < nviews; ++v) {
+    vnl_random rng(a_seed() + v);
+    bdifd_resection_problem &p = prob[v];
+    p.K = ds.K;
+    std::vector<unsigned> ids;
+    unsigned npts = ds.npts();
+    if (a_subset() && a_subset() < npts) {
+      // partial Fisher-Yates
+      std::vector<unsigned> all(npts);
+      for (unsigned i=0; i < npts; ++i)
+        all[i] = i;
+      for (unsigned i=0; i < a_subset(); ++i)
+        std::swap(all[i], all[i + rng.lrand32(npts - i - 1)]);
+      ids.assign(all.begin(), all.begin() + a_subset());
+    } else {
+      ids.resize(npts);
+      for (unsigned i=0; i < npts; ++i)
+        ids[i] = i;
+    }
+    for (unsigned k=0; k < ids.size(); ++k) {
+      unsigned i = ids[k];
+      double th = std::atan2(ds.ty[v][i], ds.tx[v][i]);
+      if (a_tsigma() > 0)
+        th += a_tsigma()*rng.normal64()*vnl_math::pi/180;
+      p.x.push_back(ds.x[v][i] + a_sigma()*rng.normal64());
+      p.y.push_back(ds.y[v][i] + a_sigma()*rng.normal64());
+      p.tx.push_back(std::cos(th));
+      p.ty.push_back(std::sin(th));
+      p.X.push_back(ds.X[i]);
+      p.Y.push_back(ds.Y[i]);
+      p.Z.push_back(ds.Z[i]);
+      p.TX.push_back(ds.TX[i]);
+      p.TY.push_back(ds.TY[i]);
+      p.TZ.push_back(ds.TZ[i]);
+    }
+  }
+
+  std::vector<vnl_double_3x3> R0(nviews), R(nviews);
+  std::vector<vnl_double_3> t0(nviews), t(nviews);
+  std::vector<char> ok(nviews);
+  std::vector<unsigned> iters(nviews, 0);
+
+  vul_timer timer;
+  bdifd_parallel::for_each(nviews, [&](unsigned v) {
+    ok[v] = solver->solve(prob[v], &R0[v], &t0[v]);
+  }, a_threads());
+  double t_solve = timer.real()/1000.0;
+
+  timer.mark();
+  bdifd_parallel::for_each(nviews, [&](unsigned v) {
+    R[v] = R0[v];
+    t[v] = t0[v];
+    if (ok[v] && !a_norefine())
+      iters[v] = bdifd_resection::refine(prob[v], &R[v], &t[v], a_tweight());
+  }, a_threads());
+  double t_refine = timer.real()/1000.0;
+
+  bdifd_err_stats init_avg, final_avg, final_med, rot_err, center_err, nit;
+  unsigned nfailed = 0;
+  for (unsigned v=0; v < nviews; ++v) {
+    std::cout << "View " << v << " (" << prob[v].size() << " samples, solver "
+      << solver->name() << ")" << std::endl;
+    if (!ok[v]) {
+      std::cout << "Solver failed" << std::endl << "---" << std::endl;
+      ++nfailed;
+      continue;
+    }
+    std::vector<double> err;
+    double avg, max, med;
+    bdifd_resection::reprojection_errors(prob[v], R0[v], t0[v], &err);
+    bdifd_resection::summary(err, &avg, &max, &med);
+    std::cout << "Initial average, max, med error: " << avg << ", " << max << ", " << med << std::endl;
+    init_avg.add(avg, v);
+
+    bdifd_resection::reprojection_errors(prob[v], R[v], t[v], &err);
+    bdifd_resection::summary(err, &avg, &max, &med);
+    std::cout << "Final average, max, med error: " << avg << ", " << max << ", " << med << std::endl;
+    std::cout << "Very final average error: " << avg << std::endl;
+    final_avg.add(avg, v);
+    final_med.add(med, v);
+    nit.add(iters[v], v);
+
+    // center = -R^T t
+    double dr = bdifd_resection::rotation_error(R[v], ds.R[v]);
+    double dc2 = 0;
+    for (unsigned r=0; r < 3; ++r) {
+      double c = -(R[v][0][r]*t[v][0] + R[v][1][r]*t[v][1] + R[v][2][r]*t[v][2]);
+      dc2 += (c - ds.C[v][r])*(c - ds.C[v][r]);
+    }
+    std::cout << "Rotation error (deg): " << dr*180/vnl_math::pi
+      << ", center error: " << std::sqrt(dc2) << std::endl;
+    std::cout << "---" << std::endl;
+    rot_err.add(dr*180/vnl_math::pi, v);
+    center_err.add(std::sqrt(dc2), v);
+  }
+
+  init_avg.print_summary(std::cout, "Initial average error (pixels)");
+  final_avg.print_summary(std::cout, "Final average error (pixels)");
+  final_med.print_summary(std::cout, "Final median error (pixels)");
+  rot_err.print_summary(std::cout, "Rotation error (deg)");
+  center_err.print_summary(std::cout, "Center error");
+  nit.print_summary(std::cout, "Refinement iterations");
+  std::cout << "Solver " << solver->name() << ": " << nviews - nfailed << "/" << nviews
+    << " views solved in " << t_solve << " s (" << nviews/t_solve << " solves/s)" << std::endl;
+  if (!a_norefine())
+    std::cout << "Refinement: " << t_refine << " s (" << nviews/t_refine << " refinements/s)" << std::endl;
+
+  return nfailed ? 1 : 0;
+}
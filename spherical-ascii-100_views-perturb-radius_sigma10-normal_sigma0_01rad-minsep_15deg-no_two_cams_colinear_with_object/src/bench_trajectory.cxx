@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vul/vul_arg.h>
+#include <vul/vul_file.h>
+#include <vul/vul_timer.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_parallel.h>
+#include <bdifd/algo/bdifd_trajectory.h>
+
+// Dense video-rate trajectory through the views of an ASCII dataset, taken
+// as key poses in order (SLERP on rotations, Catmull-Rom on centers). The
+// curve samples of the dataset are projected into -frames frames both from
+// world coordinates in every frame and incrementally, moving the camera-frame
+// coordinates by the frame-to-frame motion and re-anchoring every -reanchor
+// frames. Prints frames/s for both and the largest difference between them.
+//
+// With -outdir the incremental frames are also written, as frame_NNNN-pts-2D
+// .txt, -tgts-2D.txt and .extrinsic plus calib.intrinsic; the 3D files are
+// those of the key dataset.
+//
+// Usage: bench_trajectory -dir dataset [-frames 2000] [-reanchor 256]
+//          [-outdir dir] [-j threads]
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "dataset directory with the key views", ".");
+  vul_arg<unsigned> a_frames("-frames", "number of frames", 2000);
+  vul_arg<unsigned> a_reanchor("-reanchor", "frames between exact reprojections (incremental mode)", 256);
+  vul_arg<std::string> a_outdir("-outdir", "write the frames to this directory", "");
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg_parse(argc, argv);
+
+  bdifd_ascii_dataset ds;
+  if (!ds.read(a_dir(), false))
+    return 1;
+  if (ds.nviews() < 2) {
+    std::cerr << "bench_trajectory: error, need at least 2 key views, got " << ds.nviews() << std::endl;
+    return 1;
+  }
+
+  bdifd_trajectory traj;
+  for (unsigned v=0; v < ds.nviews(); ++v)
+    traj.add_key(ds.R[v], ds.C[v]);
+
+  unsigned npts = ds.npts(), nframes = std::max(a_frames(), 2u);
+  unsigned reanchor = a_reanchor() ? a_reanchor() : 1;
+  bdifd_3d_soa X;
+  X.resize(npts);
+  for (unsigned i=0; i < npts; ++i) {
+    X.X[i] = ds.X[i];   X.Y[i] = ds.Y[i];   X.Z[i] = ds.Z[i];
+    X.Tx[i] = ds.TX[i]; X.Ty[i] = ds.TY[i]; X.Tz[i] = ds.TZ[i];
+  }
+
+  // poses and frame-to-frame motions up front, shared by all point blocks
+  std::vector<double> R(9*nframes), C(3*nframes), L(9*nframes), d(3*nframes);
+  traj.poses(nframes, &R[0], &C[0]);
+  typedef const double (*mat)[3];
+  typedef double (*mat_out)[3];
+  for (unsigned f=1; f < nframes; ++f)
+    bdifd_trajectory_projector::motion(mat(&R[9*(f-1)]), &C[3*(f-1)], mat(&R[9*f]), &C[3*f],
+        mat_out(&L[9*f]), &d[3*f]);
+
+  bdifd_trajectory_projector proj(ds.K, X);
+  bdifd_2d_soa out;
+  out.resize(npts);
+  unsigned nthreads = bdifd_parallel::num_threads(a_threads());
+  unsigned block = (npts + nthreads - 1)/nthreads;
+
+  // Each thread takes a block of points through every frame
+  vul_timer t;
+  bdifd_parallel::for_blocks(npts, block, [&](unsigned begin, unsigned end) {
+    for (unsigned f=0; f < nframes; ++f)
+      proj.project(mat(&R[9*f]), &C[3*f], begin, end, &out);
+  }, nthreads);
+  double t_direct = t.real()/1000.0;
+
+  t.mark();
+  bdifd_parallel::for_blocks(npts, block, [&](unsigned begin, unsigned end) {
+    for (unsigned f=0; f < nframes; ++f)
+      if (f % reanchor == 0) {
+        proj.anchor(mat(&R[9*f]), &C[3*f], begin, end);
+        proj.project_cached(begin, end, &out);
+      } else
+        proj.advance(mat(&L[9*f]), &d[3*f], begin, end, &out);
+  }, nthreads);
+  double t_incr = t.real()/1000.0;
+
+  // Difference between the two, frame by frame, outside the timings
+  bdifd_2d_soa ref;
+  ref.resize(npts);
+  double max_pos = 0, max_tgt = 0;
+  unsigned argmax_frame = 0;
+  std::string outdir = a_outdir();
+  if (!outdir.empty()) {
+    vul_file::make_directory(outdir);
+    std::string fname = outdir + std::string("/") + "calib.intrinsic";
+    std::ofstream fp(fname.c_str());
+    if (!fp) {
+      std::cerr << "bench_trajectory: error, unable to open file name " << fname << std::endl;
+      return 1;
+    }
+    fp << std::setprecision(20);
+    for (unsigned r=0; r < 3; ++r)
+      fp << ds.K[r][0] << " " << ds.K[r][1] << " " << ds.K[r][2] << std::endl;
+  }
+
+  for (unsigned f=0; f < nframes; ++f) {
+    if (f % reanchor == 0) {
+      proj.anchor(mat(&R[9*f]), &C[3*f], 0, npts);
+      proj.project_cached(0, npts, &out);
+    } else
+      proj.advance(mat(&L[9*f]), &d[3*f], 0, npts, &out);
+    proj.project(mat(&R[9*f]), &C[3*f], 0, npts, &ref);
+    for (unsigned i=0; i < npts; ++i) {
+      double dp = std::sqrt((out.x[i] - ref.x[i])*(out.x[i] - ref.x[i])
+          + (out.y[i] - ref.y[i])*(out.y[i] - ref.y[i]));
+      double dt = std::fabs(out.tx[i]*ref.ty[i] - out.ty[i]*ref.tx[i]);
+      if (dp > max_pos) {
+        max_pos = dp;
+        argmax_frame = f;
+      }
+      max_tgt = std::max(max_tgt, dt);
+    }
+
+    if (outdir.empty())
+      continue;
+    std::ostringstream v_str;
+    v_str << std::setw(4) << std::setfill('0') << f;
+    std::string fname_base = outdir + std::string("/frame_") + v_str.str();
+    std::ofstream fp_pts((fname_base + "-pts-2D.txt").c_str());
+    std::ofstream fp_tgts((fname_base + "-tgts-2D.txt").c_str());
+    std::ofstream fp_ext((fname_base + ".extrinsic").c_str());
+    if (!fp_pts || !fp_tgts || !fp_ext) {
+      std::cerr << "bench_trajectory: error, unable to open file name " << fname_base << "*" << std::endl;
+      return 1;
+    }
+    fp_pts << std::setprecision(20);
+    fp_tgts << std::setprecision(20);
+    fp_ext << std::setprecision(20);
+    for (unsigned i=0; i < npts; ++i) {
+      fp_pts << out.x[i] << " " << out.y[i] << std::endl;
+      fp_tgts << out.tx[i] << " " << out.ty[i] << std::endl;
+    }
+    for (unsigned r=0; r < 3; ++r)
+      fp_ext << R[9*f+3*r] << " " << R[9*f+3*r+1] << " " << R[9*f+3*r+2] << std::endl;
+    fp_ext << std::endl << C[3*f] << " " << C[3*f+1] << " " << C[3*f+2] << std::endl;
+  }
+
+  std::cout << "Trajectory through " << traj.nkeys() << " key views, " << nframes << " frames of "
+    << npts << " samples, " << nthreads << " threads" << std::endl;
+  std::cout << "Direct reprojection: " << t_direct << " s (" << nframes/t_direct << " frames/s)" << std::endl;
+  std::cout << "Incremental (re-anchor every " << reanchor << "): " << t_incr << " s ("
+    << nframes/t_incr << " frames/s), speedup " << t_direct/t_incr << std::endl;
+  std::cout << "Max difference: " << max_pos << " px (frame " << argmax_frame
+    << "), tangent sine " << max_tgt << std::endl;
+  if (!outdir.empty())
+    std::cout << "Frames written to " << outdir << std::endl;
+  return 0;
+}
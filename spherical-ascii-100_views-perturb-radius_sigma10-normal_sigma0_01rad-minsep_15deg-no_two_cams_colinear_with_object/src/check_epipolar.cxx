@@ -0,0 +1,121 @@
+#include <fstream>
+#include <iostream>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_epipolar_checker.h>
+
+// Checks the epipolar constraint x_j^T F_ij x_i and the consistency of image
+// tangents with the space tangents for every sample over every view pair of
+// an ASCII dataset, replacing synthdata_bifocal.sce. Prints the histogram of
+// each residual over all pairs and the worst pair; -out writes one histogram
+// per pair and residual. Returns nonzero if a residual is above tolerance or
+// not finite (NaN or infinite, counted apart from the histogram).
+//
+// Usage: check_epipolar -dir dataset [-tol pixels] [-tol_tangent sine]
+//          [-degenerate sine] [-j threads] [-out histograms.txt]
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "dataset directory", ".");
+  vul_arg<double> a_tol("-tol", "largest acceptable epipolar distance, pixels", 1e-6);
+  vul_arg<double> a_tol_tangent("-tol_tangent", "largest acceptable tangent residual, sine of angle", 1e-6);
+  vul_arg<double> a_degenerate("-degenerate", "skip tangents whose back-projected planes are closer than this, sine of angle", 1e-3);
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg<std::string> a_out("-out", "per-pair histograms", "");
+  vul_arg_parse(argc, argv);
+
+  vul_timer t;
+  bdifd_ascii_dataset ds;
+  if (!ds.read(a_dir()))
+    return 1;
+  double t_read = t.real()/1000.0;
+
+  if (ds.nviews() < 2) {
+    std::cerr << "check_epipolar: error, need at least 2 views, got " << ds.nviews() << std::endl;
+    return 1;
+  }
+
+  t.mark();
+  bdifd_epipolar_checker chk(ds, a_degenerate());
+  std::vector<bdifd_epipolar_residuals> res;
+  chk.check_all(&res, a_threads());
+  double t_check = t.real()/1000.0;
+
+  typedef bdifd_epipolar_residuals K;
+  if (!a_out().empty()) {
+    std::ofstream fp(a_out().c_str());
+    if (!fp) {
+      std::cerr << "check_epipolar: error, unable to open file name " << a_out() << std::endl;
+      return 1;
+    }
+    fp.precision(6);
+    fp << "# vi vj residual count nonfinite max mean";
+    for (unsigned b=0; b < K::nbins; ++b)
+      fp << " " << K::bin_lower(b);
+    fp << std::endl;
+    for (unsigned p=0; p < res.size(); ++p)
+      for (unsigned k=0; k < K::nkinds; ++k) {
+        fp << res[p].v[0] << " " << res[p].v[1] << " " << K::name(k) << " "
+          << res[p].count[k] << " " << res[p].nonfinite[k] << " " << res[p].max[k] << " "
+          << res[p].mean[k];
+        for (unsigned b=0; b < K::nbins; ++b)
+          fp << " " << res[p].hist[k][b];
+        fp << std::endl;
+      }
+  }
+
+  double nres = double(res.size())*ds.npts();
+  std::cout << "Read " << ds.nviews() << " views, " << ds.npts() << " samples in "
+    << t_read << " s" << std::endl;
+  std::cout << "Checked " << res.size() << " pairs, " << nres << " samples in " << t_check
+    << " s (" << nres/t_check << " samples/s)" << std::endl;
+
+  bool ok = true;
+  double tol[K::nkinds] = { a_tol(), a_tol_tangent() };
+  unsigned degenerate = 0;
+  for (unsigned p=0; p < res.size(); ++p)
+    degenerate += res[p].degenerate;
+
+  for (unsigned k=0; k < K::nkinds; ++k) {
+    double hist[K::nbins] = {0};
+    double sum = 0, count = 0, nonfinite = 0;
+    unsigned worst = 0, worst_nonfinite = 0;
+    for (unsigned p=0; p < res.size(); ++p) {
+      for (unsigned b=0; b < K::nbins; ++b)
+        hist[b] += res[p].hist[k][b];
+      sum += res[p].mean[k]*res[p].count[k];
+      count += res[p].count[k];
+      nonfinite += res[p].nonfinite[k];
+      if (res[p].max[k] > res[worst].max[k])
+        worst = p;
+      if (res[p].nonfinite[k] > res[worst_nonfinite].nonfinite[k])
+        worst_nonfinite = p;
+    }
+    const bdifd_epipolar_residuals &r = res[worst];
+    bool pass = r.max[k] <= tol[k] && !nonfinite;
+    ok = ok && pass;
+
+    std::cout << K::name(k) << ": max " << r.max[k] << " at views " << r.v[0] << "," << r.v[1]
+      << " sample " << r.argmax[k] << ", mean " << (count ? sum/count : 0)
+      << (r.max[k] <= tol[k] ? "" : "  ** above tolerance") << std::endl;
+    for (unsigned b=0; b < K::nbins; ++b)
+      if (hist[b]) {
+        std::cout << "  [" << K::bin_lower(b) << ", ";
+        if (b+1 < K::nbins)
+          std::cout << K::bin_lower(b+1);
+        else
+          std::cout << "inf";
+        std::cout << "): " << hist[b] << std::endl;
+      }
+    if (nonfinite) {
+      const bdifd_epipolar_residuals &n = res[worst_nonfinite];
+      std::cout << "  ** not finite: " << nonfinite << ", most (" << n.nonfinite[k]
+        << ") at views " << n.v[0] << "," << n.v[1] << std::endl;
+    }
+  }
+  std::cout << "Tangents skipped near epipolar tangency: " << degenerate << std::endl;
+
+  return ok ? 0 : 1;
+}
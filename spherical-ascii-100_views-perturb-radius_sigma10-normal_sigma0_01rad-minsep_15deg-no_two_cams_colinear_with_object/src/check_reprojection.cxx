@@ -0,0 +1,53 @@
+#include <iostream>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_reprojection_checker.h>
+
+// Verifies that the 2D samples and tangents of every view of an ASCII dataset
+// are the reprojection of crv-3D-pts.txt and crv-3D-tgts.txt through
+// calib.intrinsic and the .extrinsic files. Prints max and mean deviation per
+// view and stops at the first view out of tolerance, returning nonzero. Meant
+// to be run on every generated dataset before publishing it.
+//
+// Usage: check_reprojection -dir dataset [-tol pixels] [-tol_tangent radians]
+//          [-j threads]
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "dataset directory", ".");
+  vul_arg<double> a_tol("-tol", "largest acceptable point deviation, pixels", 1e-6);
+  vul_arg<double> a_tol_tangent("-tol_tangent", "largest acceptable tangent deviation, radians", 1e-6);
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg_parse(argc, argv);
+
+  vul_timer t;
+  bdifd_ascii_dataset ds;
+  if (!ds.read(a_dir()))
+    return 1;
+  double t_read = t.real()/1000.0;
+
+  t.mark();
+  bdifd_reprojection_checker chk(ds, a_tol(), a_tol_tangent());
+  std::vector<bdifd_view_reprojection> res;
+  unsigned bad = chk.check_all(&res, a_threads());
+  double t_check = t.real()/1000.0;
+
+  std::cout << "Read " << ds.nviews() << " views, " << ds.npts() << " samples in "
+    << t_read << " s, checked in " << t_check << " s" << std::endl;
+
+  std::cout << "# view max_pt mean_pt argmax_pt max_tgt mean_tgt argmax_tgt" << std::endl;
+  for (unsigned v=0; v < res.size() && v <= bad; ++v) {
+    const bdifd_view_reprojection &r = res[v];
+    std::cout << v << " " << r.max_pt << " " << r.mean_pt << " " << r.argmax_pt << " "
+      << r.max_tgt << " " << r.mean_tgt << " " << r.argmax_tgt << std::endl;
+  }
+
+  if (bad < res.size()) {
+    std::cerr << "check_reprojection: error, view " << bad << " (" << bdifd_ascii_dataset::view_name(bad)
+      << ") is out of tolerance" << std::endl;
+    return 1;
+  }
+  return 0;
+}
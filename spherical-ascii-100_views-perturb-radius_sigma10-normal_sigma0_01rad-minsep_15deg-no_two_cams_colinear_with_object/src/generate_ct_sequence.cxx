@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vul/vul_arg.h>
+#include <vul/vul_file.h>
+#include <vul/vul_timer.h>
+#include <bdifd/bdifd_camera.h>
+#include <bdifd/algo/bdifd_channels.h>
+#include <bdifd/algo/bdifd_data.h>
+#include <bdifd/algo/bdifd_log.h>
+#include <bdifd/algo/bdifd_parallel.h>
+#include <bdifd/algo/bdifd_run_report.h>
+#include <bdifd/algo/bdifd_turntable_rig.h>
+
+// Generate a micro-CT sequence: the ctspheres curves seen by the ctspheres
+// turntable rig, one frame every -step degrees (0.5 as in the CT Spheres
+// scans), at -x_max_scaled detector columns (4000 is the native 4000x2096).
+//
+// Frames are streamed: each batch of -batch frames gets its cameras from the
+// rig, is projected and written out (frames in parallel), and its buffers are
+// reused for the next, so memory does not grow with the number of frames.
+// Files are named and laid out as for generate_synth_sequence_3, plus a
+// per-frame .extrinsic and one calib.intrinsic.
+//
+// In the CT geometry the object lies between the source, which is the optical
+// center, and the detector, which is the image plane. Samples at a depth
+// outside (0, source_to_detector) or projecting off the detector are written
+// anyway but counted (samples_outside_beam, samples_off_detector in
+// run-report.json) and reported, one warning per batch that has any; the
+// per-frame counts are logged at debug level (BDIFD_LOG=debug).
+//
+// -curvature also writes the curvature channels, as for
+// generate_synth_sequence_3.
+//
+// Usage: generate_ct_sequence [-outdir dir] [-frames 720] [-step 0.5]
+//          [-x_max_scaled 4000] [-batch 32] [-j threads] [-curvature txt,bin]
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-outdir", "output directory", "./out-ct");
+  vul_arg<unsigned> a_frames("-frames", "number of frames", 720);
+  vul_arg<double> a_step("-step", "rotation per frame, degrees", bdifd_turntable_rig::ctspheres_step());
+  vul_arg<double> a_x_max_scaled("-x_max_scaled", "detector columns (4000 = native)", 4000);
+  vul_arg<unsigned> a_batch("-batch", "frames per batch", 32);
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg<std::string> a_curvature("-curvature", "curvature channel formats: txt, bin or txt,bin", "");
+  vul_arg_parse(argc, argv);
+
+  unsigned curvature_formats;
+  if (!bdifd_channels::parse_formats(a_curvature(), &curvature_formats)) {
+    std::cerr << "generate_ct_sequence: error, -curvature takes txt, bin or txt,bin" << std::endl;
+    return 1;
+  }
+
+  std::string dir(a_dir());
+  std::string prefix("frame_");
+  unsigned nframes = a_frames();
+  unsigned batch = a_batch() ? a_batch() : 1;
+
+  bdifd_stage_timer t_cameras("camera_setup");
+  vnl_double_3x3 Kmatrix;
+  bdifd_turntable::internal_calib_ctspheres(Kmatrix, a_x_max_scaled());
+  vpgl_calibration_matrix<double> K(Kmatrix);
+  bdifd_turntable_rig rig = bdifd_turntable_rig::ctspheres(K);
+
+  double source_to_detector, width, height;
+  bdifd_turntable::ctspheres_detector(a_x_max_scaled(), &source_to_detector, &width, &height);
+  t_cameras.stop();
+
+  bdifd_stage_timer t_sampling("sampling");
+  std::vector<std::vector<bdifd_3rd_order_point_3d> > crv3d;
+  bdifd_data::space_curves_ctspheres(crv3d);
+  std::vector<bdifd_3rd_order_point_3d> pts;
+  std::vector<unsigned> crv_id;
+  for (unsigned i=0; i < crv3d.size(); ++i)
+    for (unsigned k=0; k < crv3d[i].size(); ++k) {
+      pts.push_back(crv3d[i][k]);
+      crv_id.push_back(i);
+    }
+  unsigned npts = pts.size();
+  t_sampling.stop();
+
+  // Frame-independent files
+
+  bdifd_stage_timer t_static("output_static");
+  vul_file::make_directory(dir);
+  {
+  std::string fname = dir + std::string("/") + "calib.intrinsic";
+  std::ofstream fp(fname.c_str());
+  if (!fp) {
+    std::cerr << "generate_ct_sequence: error, unable to open file name " << fname << std::endl;
+    return 1;
+  }
+  fp << std::setprecision(20);
+  for (unsigned r=0; r < 3; ++r)
+    fp << Kmatrix[r][0] << " " << Kmatrix[r][1] << " " << Kmatrix[r][2] << std::endl;
+  }
+
+  const char *static_files[3] = { "crv-ids.txt", "crv-3D-pts.txt", "crv-3D-tgts.txt" };
+  for (unsigned f=0; f < 3; ++f) {
+    std::string fname = dir + std::string("/") + static_files[f];
+    std::ofstream fp(fname.c_str());
+    if (!fp) {
+      std::cerr << "generate_ct_sequence: error, unable to open file name " << fname << std::endl;
+      return 1;
+    }
+    fp << std::setprecision(20);
+    for (unsigned j=0; j < npts; ++j)
+      if (f == 0)
+        fp << crv_id[j] << std::endl;
+      else if (f == 1)
+        fp << pts[j].Gama[0] << " " << pts[j].Gama[1] << " " << pts[j].Gama[2] << std::endl;
+      else
+        fp << pts[j].T[0] << " " << pts[j].T[1] << " " << pts[j].T[2] << std::endl;
+    bdifd_run_report::count("bytes_written", double(fp.tellp()));
+  }
+  if (curvature_formats) {
+    std::vector<std::vector<double> > cols;
+    bdifd_channels::curvature_3d(crv3d, &cols);
+    double bytes = 0;
+    if (!bdifd_channels::write(bdifd_channels::space_base(dir), curvature_formats, cols, &bytes))
+      return 1;
+    bdifd_run_report::count("bytes_written", bytes);
+  }
+  t_static.stop();
+
+  // Frames, one batch at a time
+
+  std::vector<vpgl_perspective_camera<double> > cams(batch);
+  std::vector<std::vector<bdifd_3rd_order_point_2d> > crv2d(batch);
+  std::vector<unsigned> outside(batch), off_detector(batch), culled(batch);
+  std::vector<char> ok(batch);
+  unsigned long total_outside = 0, total_off_detector = 0;
+  bool failed = false;
+
+  bdifd_stage_timer t_frames("frames");
+  vul_timer timer;
+  for (unsigned b0=0; b0 < nframes && !failed; b0 += batch) {
+    unsigned m = std::min(batch, nframes - b0);
+    rig.cameras(b0*a_step(), a_step(), m, &cams[0]);
+
+    bdifd_parallel::for_each(m, [&](unsigned s) {
+      unsigned k = b0 + s;
+      bdifd_camera cam;
+      cam.set_p(cams[s]);
+      const vnl_matrix_fixed<double,3,4> &P = cams[s].get_matrix();
+
+      std::vector<bdifd_3rd_order_point_2d> &x = crv2d[s];
+      x.resize(npts);
+      outside[s] = off_detector[s] = culled[s] = 0;
+      for (unsigned j=0; j < npts; ++j) {
+        bool not_degenerate;
+        x[j] = cam.project_to_image(pts[j], &not_degenerate);
+        culled[s] += !not_degenerate;
+
+        // K has third row (0 0 1), so the third row of P gives the depth
+        double depth = P[2][0]*pts[j].Gama[0] + P[2][1]*pts[j].Gama[1] + P[2][2]*pts[j].Gama[2] + P[2][3];
+        outside[s] += !(depth > 0 && depth < source_to_detector);
+        off_detector[s] += !(x[j].gama[0] >= 0 && x[j].gama[0] < width
+            && x[j].gama[1] >= 0 && x[j].gama[1] < height);
+      }
+
+      std::ostringstream v_str;
+      v_str << std::setw(4) << std::setfill('0') << k;
+      std::string fname_base = dir + std::string("/") + prefix + v_str.str();
+
+      std::ofstream fp_pts2d((fname_base + "-pts-2D.txt").c_str());
+      std::ofstream fp_tgts2d((fname_base + "-tgts-2D.txt").c_str());
+      std::ofstream fp_ext((fname_base + ".extrinsic").c_str());
+      ok[s] = fp_pts2d && fp_tgts2d && fp_ext;
+      if (!ok[s])
+        return;
+      fp_pts2d << std::setprecision(20);
+      fp_tgts2d << std::setprecision(20);
+      fp_ext << std::setprecision(20);
+      for (unsigned j=0; j < npts; ++j) {
+        fp_pts2d << x[j].gama[0] << " " << x[j].gama[1] << std::endl;
+        fp_tgts2d << x[j].t[0] << " " << x[j].t[1] << std::endl;
+      }
+
+      vnl_matrix_fixed<double,3,3> R = cams[s].get_rotation().as_matrix();
+      vgl_point_3d<double> C = cams[s].get_camera_center();
+      for (unsigned r=0; r < 3; ++r)
+        fp_ext << R[r][0] << " " << R[r][1] << " " << R[r][2] << std::endl;
+      fp_ext << std::endl << C.x() << " " << C.y() << " " << C.z() << std::endl;
+
+      bdifd_run_report::count("bytes_written",
+          double(fp_pts2d.tellp()) + double(fp_tgts2d.tellp()) + double(fp_ext.tellp()));
+      ok[s] = fp_pts2d && fp_tgts2d && fp_ext;
+
+      if (ok[s] && curvature_formats) {
+        std::vector<std::vector<double> > cols;
+        bdifd_channels::curvature_2d(x, &cols);
+        double bytes = 0;
+        ok[s] = bdifd_channels::write(bdifd_channels::view_base(dir, k), curvature_formats, cols, &bytes);
+        bdifd_run_report::count("bytes_written", bytes);
+      }
+    }, a_threads());
+
+    unsigned long batch_outside = 0, batch_off_detector = 0;
+    unsigned batch_frames = 0;
+    for (unsigned s=0; s < m; ++s) {
+      if (!ok[s]) {
+        std::cerr << "generate_ct_sequence: error, unable to write frame " << b0 + s
+          << " in " << dir << std::endl;
+        failed = true;
+        break;
+      }
+      if (outside[s] || off_detector[s]) {
+        bdifd_log_msg(debug) << "frame " << b0 + s << ": " << outside[s]
+          << " samples outside the beam, " << off_detector[s] << " off the detector" << std::endl;
+        ++batch_frames;
+      }
+      batch_outside += outside[s];
+      batch_off_detector += off_detector[s];
+      bdifd_run_report::count("samples_culled", culled[s]);
+    }
+    if (batch_frames) {
+      bdifd_log_msg(warn) << "frames " << b0 << "-" << b0 + m - 1 << ": " << batch_frames
+        << " with " << batch_outside << " samples outside the beam, " << batch_off_detector
+        << " off the detector" << std::endl;
+    }
+    total_outside += batch_outside;
+    total_off_detector += batch_off_detector;
+    bdifd_run_report::count("frames", m);
+    bdifd_run_report::count("samples_projected", double(m)*npts);
+  }
+  double secs = timer.real()/1000.0;
+  t_frames.stop();
+  if (failed)
+    return 1;
+
+  bdifd_run_report::count("samples_outside_beam", total_outside);
+  bdifd_run_report::count("samples_off_detector", total_off_detector);
+
+  std::cout << "Generated " << nframes << " frames of " << npts << " samples in " << secs
+    << " s (" << nframes/secs << " frames/s); " << total_outside << " samples outside the beam, "
+    << total_off_detector << " off the " << width << "x" << height << " detector" << std::endl;
+
+  bdifd_run_report::context ctx;
+  ctx.push_back(std::make_pair(std::string("generator"), std::string("generate_ct_sequence")));
+  ctx.push_back(std::make_pair(std::string("dataset"), std::string("ctspheres")));
+  std::ostringstream frames_str, step_str;
+  frames_str << nframes;
+  step_str << a_step();
+  ctx.push_back(std::make_pair(std::string("views"), frames_str.str()));
+  ctx.push_back(std::make_pair(std::string("step_deg"), step_str.str()));
+  if (curvature_formats)
+    ctx.push_back(std::make_pair(std::string("curvature"), a_curvature()));
+
+  std::string fname_report = dir + std::string("/") + "run-report.json";
+  if (!bdifd_run_report::write_json(fname_report, ctx)) {
+    std::cerr << "generate_ct_sequence: error, unable to open file name " << fname_report << std::endl;
+    return 1;
+  }
+  if (bdifd_log::enabled(bdifd_log::info))
+    bdifd_run_report::print(std::clog);
+
+  return 0;
+}
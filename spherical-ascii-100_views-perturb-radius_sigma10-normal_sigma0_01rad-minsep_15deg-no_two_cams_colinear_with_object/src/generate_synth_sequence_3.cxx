@@ -1,15 +1,24 @@
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <vul/vul_arg.h>
 #include <vul/vul_file.h>
 #include <vnl/vnl_random.h>
 #include <bdifd/bdifd_camera.h>
 #include <bdifd/algo/bdifd_data.h>
+#include <bdifd/algo/bdifd_arena.h>
+#include <bdifd/algo/bdifd_channels.h>
+#include <bdifd/algo/bdifd_distortion.h>
+#include <bdifd/algo/bdifd_lod.h>
+#include <bdifd/algo/bdifd_morton.h>
 #include <bsold/bsold_file_io.h>
 #include <sdet/sdet_edgemap.h>
 #include <sdetd/io/sdetd_load_edg.h>
 #include <bmcsd/bmcsd_util.h>
 #include <bmcsd/algo/bmcsd_algo_util.h>
 #include <bmcsd/bmcsd_curve_3d_sketch.h>
+#include <bdifd/algo/bdifd_log.h>
+#include <bdifd/algo/bdifd_run_report.h>
 
 // Generate a more complete synthetic sequence of curves
 // for the Public // https://github.com/rfabbri/synthcurves-multiview-3d-dataset/#curves
@@ -17,18 +26,69 @@
 // See also
 // https://github.com/rfabbri/synthcurves-multiview-3d-dataset
 // 
+// Diagnostics are leveled (BDIFD_LOG=error|warn|info|debug|trace); stage
+// timings, counters and peak memory are written to run-report.json in the
+// output directory.
+//
+// Usage: generate_synth_sequence_3 [-outdir dir] [-seed s] [-lod_levels n]
+//          [-lod_base b] [-curvature txt,bin] [-distortion k1,k2,k3,p1,p2]
+//          [-zorder]
+//
+// With -seed 0 (the default) cameras are seeded from the clock, as for the
+// published dataset; golden_regression uses a fixed seed.
+//
+// With -lod_levels n > 1 the curves are sampled 2^(n-1-b) times more densely
+// and crv-lod.txt gives the level of detail of each sample (see bdifd_lod.h);
+// level b has the published density.
+//
+// -curvature also writes the curvature channels, frame_NNNN-curv-2D and
+// crv-3D-curv, as text, binary or both (see bdifd_channels.h). They are
+// not written by default.
+//
+// -distortion passes every projection through that lens distortion (see
+// bdifd_distortion.h), tangents and curvatures included, and writes the
+// coefficients to calib.distortion. Without it the cameras are pinhole.
+// Samples that land outside the 500x800 image are written all the same and
+// counted as samples_outside_image in the run report.
+//
+// -zorder writes the samples of each view in Z-order of pixel position
+// instead of sample order, with frame_NNNN-ids.bin giving the sample of each
+// line (see bdifd_morton.h); the 3D files stay in sample order.
+//
 int
 main(int argc, char **argv)
 {
+  vul_arg<std::string> a_dir("-outdir", "output directory", "./out-tmp");
+  vul_arg<unsigned> a_seed("-seed", "camera seed (0 = clock)", 0);
+  vul_arg<unsigned> a_lod_levels("-lod_levels", "nested levels of detail", 1);
+  vul_arg<unsigned> a_lod_base("-lod_base", "level with the published sample density", 0);
+  vul_arg<std::string> a_curvature("-curvature", "curvature channel formats: txt, bin or txt,bin", "");
+  vul_arg<std::string> a_distortion("-distortion", "lens distortion k1,k2,k3,p1,p2", "");
+  vul_arg<bool> a_zorder("-zorder", "write the samples of each view in Z-order", false);
+  vul_arg_parse(argc, argv);
+
+  bdifd_lens_distortion distortion;
+  if (!distortion.parse(a_distortion())) {
+    std::cerr << "generate_synth_sequence: error, -distortion takes k1,k2,k3,p1,p2" << std::endl;
+    return 1;
+  }
+
+  unsigned curvature_formats;
+  if (!bdifd_channels::parse_formats(a_curvature(), &curvature_formats)) {
+    std::cerr << "generate_synth_sequence: error, -curvature takes txt, bin or txt,bin" << std::endl;
+    return 1;
+  }
+
   unsigned  crop_origin_x_ = 400;
   //unsigned  crop_origin_y_ = 1750;
   unsigned  crop_origin_y_ = 900;
   double x_max_scaled = 500; // final image can be considered 500x800 after crop and scale, 
   // but can consider 500x600 if care is taken with bounding boxes of the data
 
-  std::string dir("./out-tmp");
+  std::string dir(a_dir());
   std::string prefix("frame_");
 
+  bdifd_stage_timer t_cameras("camera_setup");
   vnl_double_3x3 Kmatrix;
   bdifd_turntable::internal_calib_olympus(Kmatrix, x_max_scaled, crop_origin_x_, crop_origin_y_);
 
@@ -36,40 +96,78 @@ main(int argc, char **argv)
   std::vector<vpgl_perspective_camera<double> > cam_vpgl;
   std::vector<bdifd_camera> cam_gt;
   
-  bdifd_turntable::cameras_olympus_spherical(&cam_vpgl, K, true, true);
+  bdifd_turntable::cameras_olympus_spherical(&cam_vpgl, K, true, true, a_seed());
   unsigned nviews = cam_vpgl.size();
   cam_gt.resize(nviews);
 
   for (unsigned i=0; i < nviews; ++i) {
     cam_gt[i].set_p(cam_vpgl[i]);
   }
+  t_cameras.stop();
 
   // write the cameras out
 
+  bdifd_stage_timer t_write_cams("write_cameras");
   vul_file::make_directory(dir);
 
   bool retval =  
     bmcsd_util::write_cams(dir, prefix, bmcsd_util::BMCS_INTRINSIC_EXTRINSIC, cam_vpgl);
 
-  std::cout << "VPGL CAM 003: " << cam_vpgl[3].get_matrix() << std::endl;
+  bdifd_log_msg(debug) << "VPGL CAM 003: " << cam_vpgl[3].get_matrix() << std::endl;
   if (!retval)
     abort();
+  t_write_cams.stop();
   
 
   // crv2d[i][j]  curve i view j
   std::vector<std::vector<std::vector<bdifd_3rd_order_point_2d> > > crv2d;
   std::vector<std::vector<bdifd_3rd_order_point_3d> > crv3d;
+  bdifd_stage_timer t_sampling("sampling");
 //  bdifd_data::space_curves_digicam_turntable_sandbox( crv3d );
-  bdifd_data::space_curves_olympus_turntable( crv3d );
+  unsigned lod_levels = std::max(a_lod_levels(), 1u);
+  bdifd_data::space_curves_olympus_turntable( crv3d, bdifd_lod::density(lod_levels, a_lod_base()) );
+  t_sampling.stop();
 
   vgl_point_3d<double> pt_analyze(crv3d[0][2].Gama[0], crv3d[0][2].Gama[1], crv3d[0][2].Gama[2]);
-  std::cout << "VPGL PROJ 003 pt 3: " << "pt " << std::endl << pt_analyze << std::endl <<
+  bdifd_log_msg(debug) << "VPGL PROJ 003 pt 3: " << "pt " << std::endl << pt_analyze << std::endl <<
     "project: " << std::endl <<  cam_vpgl[3].project(pt_analyze) << std::endl;
 
+  bdifd_stage_timer t_projection("projection");
   crv2d.resize(crv3d.size());
 
   for (unsigned  i=0; i < crv3d.size(); ++i)
     bdifd_data::project_into_cams(crv3d[i], cam_gt, crv2d[i]);
+  if (!distortion.is_identity()) {
+    for (unsigned  i=0; i < crv2d.size(); ++i)
+      for (unsigned  k=0; k < crv2d[i].size(); ++k)
+        for (unsigned  j=0; j < crv2d[i][k].size(); ++j)
+          distortion.distort(Kmatrix, &crv2d[i][k][j]);
+    if (!distortion.write(dir + std::string("/") + "calib.distortion"))
+      return 1;
+  }
+
+  // Pincushion distortion (k1 > 0) can push samples off the image. They are
+  // still written, so that line l is sample l in every view, but counted
+  // and reported once here.
+  const double width = x_max_scaled, height = 800;
+  unsigned long noutside = 0;
+  unsigned nviews_outside = 0;
+  for (unsigned  k=0; k < nviews; ++k) {
+    unsigned long n = 0;
+    for (unsigned  i=0; i < crv2d.size(); ++i)
+      for (unsigned  j=0; j < crv2d[i][k].size(); ++j) {
+        const bdifd_3rd_order_point_2d &p = crv2d[i][k][j];
+        n += !(p.gama[0] > 0 && p.gama[1] > 0 && p.gama[0] < width && p.gama[1] < height);
+      }
+    noutside += n;
+    nviews_outside += n > 0;
+  }
+  bdifd_run_report::count("samples_outside_image", noutside);
+  if (noutside) {
+    bdifd_log_msg(warn) << noutside << " samples in " << nviews_outside << " views fall outside the "
+      << width << "x" << height << " image" << std::endl;
+  }
+  t_projection.stop();
 
 
   //: image coordinates
@@ -78,6 +176,22 @@ main(int argc, char **argv)
   unsigned  number_of_curves = crv2d.size();
   assert(crv3d.size() == crv2d.size());
 
+  bdifd_stage_timer t_output("output");
+
+  // with -zorder, line_ids[k][l] is the sample on line l of the files of
+  // view k; sample id -> curve and index in it
+  bool zorder = a_zorder();
+  std::vector<std::vector<unsigned> > line_ids(nviews);
+  std::vector<unsigned> sample_crv, sample_idx;
+  for (unsigned i=0; zorder && i < crv3d.size(); ++i)
+    for (unsigned j=0; j < crv3d[i].size(); ++j) {
+      sample_crv.push_back(i);
+      sample_idx.push_back(j);
+    }
+  auto sample = [&](unsigned k, unsigned id) -> const bdifd_3rd_order_point_2d & {
+    return crv2d[sample_crv[id]][k][sample_idx[id]];
+  };
+
   std::ofstream fp_crv_id;
   
   std::string fname_crv_id = dir + std::string("/") + "crv-ids.txt";
@@ -103,6 +217,29 @@ main(int argc, char **argv)
     
     fp_pts2d << std::setprecision(20);
 
+    // all vsol objects of this view live in one arena, released at the end
+    // of the iteration, after polys
+    bdifd_vsol_arena pool;
+    unsigned npts_view = 0;
+    for (unsigned i=0; i<number_of_curves; ++i)
+      npts_view += crv2d[i][k].size();
+    pool.points.reserve(npts_view);
+    pool.polylines.reserve(number_of_curves);
+
+    if (zorder) {
+      std::vector<double> px, py;
+      px.reserve(npts_view);
+      py.reserve(npts_view);
+      for (unsigned i=0; i<number_of_curves; ++i)
+        for (unsigned  j=0; j < crv2d[i][k].size(); ++j) {
+          px.push_back(crv2d[i][k][j].gama[0]);
+          py.push_back(crv2d[i][k][j].gama[1]);
+        }
+      bdifd_morton::order(px, py, &line_ids[k]);
+      if (!bdifd_morton::write_ids(bdifd_morton::ids_name(dir, k), line_ids[k]))
+        return 1;
+      bdifd_run_report::count("bytes_written", 12 + 4.0*npts_view);
+    }
     
     std::vector< vsol_spatial_object_2d_sptr > polys(number_of_curves);
     for (unsigned i=0; i<number_of_curves; ++i) {
@@ -111,15 +248,39 @@ main(int argc, char **argv)
       for (unsigned  j=0; j < crv2d[i][k].size(); ++j)  {
         if (k == 0)
           fp_crv_id << i << std::endl;
-        xi[j] = new vsol_point_2d(crv2d[i][k][j].gama[0], crv2d[i][k][j].gama[1]);
-        assert(crv2d[i][k][j].gama[0] > 0);
-        assert(crv2d[i][k][j].gama[1] > 0);
-        fp_pts2d << crv2d[i][k][j].gama[0] << " " << crv2d[i][k][j].gama[1] << std::endl;
+        xi[j] = pool.points.make(crv2d[i][k][j].gama[0], crv2d[i][k][j].gama[1]);
+        if (!zorder)
+          fp_pts2d << crv2d[i][k][j].gama[0] << " " << crv2d[i][k][j].gama[1] << std::endl;
       }
-      polys[i] = new vsol_polyline_2d(xi);
+      polys[i] = pool.polylines.make(xi);
+    }
+    for (unsigned l=0; l < line_ids[k].size(); ++l) {
+      const bdifd_3rd_order_point_2d &p = sample(k, line_ids[k][l]);
+      fp_pts2d << p.gama[0] << " " << p.gama[1] << std::endl;
     }
+    bdifd_run_report::count("bytes_written", double(fp_pts2d.tellp()));
+    if (k == 0)
+      bdifd_run_report::count("bytes_written", double(fp_crv_id.tellp()));
     fp_crv_id.close();
 
+    if (curvature_formats) {
+      std::vector<bdifd_3rd_order_point_2d> view_pts;
+      view_pts.reserve(npts_view);
+      if (zorder) {
+        for (unsigned l=0; l < line_ids[k].size(); ++l)
+          view_pts.push_back(sample(k, line_ids[k][l]));
+      } else {
+        for (unsigned i=0; i<number_of_curves; ++i)
+          view_pts.insert(view_pts.end(), crv2d[i][k].begin(), crv2d[i][k].end());
+      }
+      std::vector<std::vector<double> > cols;
+      bdifd_channels::curvature_2d(view_pts, &cols);
+      double bytes = 0;
+      if (!bdifd_channels::write(bdifd_channels::view_base(dir, k), curvature_formats, cols, &bytes))
+        return 1;
+      bdifd_run_report::count("bytes_written", bytes);
+    }
+
     // bsold_save_cem(polys, fname_base + std::string(".cemv.gz"));
   }
 
@@ -142,15 +303,30 @@ main(int argc, char **argv)
     fp_tgts2d << std::setprecision(20);
 
     
+    // edgels of this view, contiguous and freed together at the end of the
+    // iteration; an edgemap built from them must not outlive edgel_pool
+    bdifd_arena<sdet_edgel> edgel_pool;
+    unsigned npts_view = 0;
+    for (unsigned i=0; i<number_of_curves; ++i)
+      npts_view += crv2d[i][k].size();
+    edgel_pool.reserve(npts_view);
+
     std::vector< sdet_edgel *> edgels;
+    edgels.reserve(npts_view);
     for (unsigned i=0; i<number_of_curves; ++i) {
       for (unsigned  j=0; j < crv2d[i][k].size(); ++j) {
-        edgels.push_back(new sdet_edgel);
+        edgels.push_back(edgel_pool.make());
         bmcsd_algo_util::bdifd_to_sdet(crv2d[i][k][j], edgels.back());
-        fp_tgts2d << crv2d[i][k][j].t[0] << " " << crv2d[i][k][j].t[1] << std::endl;
+        if (!zorder)
+          fp_tgts2d << crv2d[i][k][j].t[0] << " " << crv2d[i][k][j].t[1] << std::endl;
         assert(fabs(crv2d[i][k][j].t[2]) < 1e-4);
       }
     }
+    for (unsigned l=0; l < line_ids[k].size(); ++l) {
+      const bdifd_3rd_order_point_2d &p = sample(k, line_ids[k][l]);
+      fp_tgts2d << p.t[0] << " " << p.t[1] << std::endl;
+    }
+    bdifd_run_report::count("bytes_written", double(fp_tgts2d.tellp()));
     fp_tgts2d.close();
 //    sdet_edgemap_sptr em = new sdet_edgemap(520, 380, edgels);
 
@@ -202,9 +378,57 @@ main(int argc, char **argv)
       fp_crv_3d_tgts << crv3d[i][k].T[0] << " " << crv3d[i][k].T[1]  << " " << crv3d[i][k].T[2] << std::endl;
     }
   }
+  bdifd_run_report::count("bytes_written", double(fp_crv_3d_pts.tellp()));
+  bdifd_run_report::count("bytes_written", double(fp_crv_3d_tgts.tellp()));
+  if (curvature_formats) {
+    std::vector<std::vector<double> > cols;
+    bdifd_channels::curvature_3d(crv3d, &cols);
+    double bytes = 0;
+    if (!bdifd_channels::write(bdifd_channels::space_base(dir), curvature_formats, cols, &bytes))
+      return 1;
+    bdifd_run_report::count("bytes_written", bytes);
+  }
+  if (lod_levels > 1) {
+    bdifd_lod lod(crv3d, lod_levels);
+    std::string fname_lod = dir + std::string("/") + "crv-lod.txt";
+    if (!lod.write(fname_lod))
+      return 1;
+    for (unsigned l=0; l < lod.nlevels(); ++l)
+      bdifd_log_msg(info) << "LOD level " << l << ": " << lod.level(l).size() << " samples" << std::endl;
+  }
   // bmcsd_curve_3d_sketch csk(crv3d_1st, attr);
 
   //csk.write_dir_format(dir+std::string("/csk"));
+  t_output.stop();
+
+  bdifd_run_report::context ctx;
+  ctx.push_back(std::make_pair(std::string("generator"), std::string("generate_synth_sequence_3")));
+  ctx.push_back(std::make_pair(std::string("dataset"), std::string("spherical")));
+  std::ostringstream nviews_str;
+  nviews_str << nviews;
+  ctx.push_back(std::make_pair(std::string("views"), nviews_str.str()));
+  std::ostringstream seed_str;
+  seed_str << a_seed();
+  ctx.push_back(std::make_pair(std::string("seed"), seed_str.str()));
+  if (curvature_formats)
+    ctx.push_back(std::make_pair(std::string("curvature"), a_curvature()));
+  if (!distortion.is_identity())
+    ctx.push_back(std::make_pair(std::string("distortion"), a_distortion()));
+  if (zorder)
+    ctx.push_back(std::make_pair(std::string("layout"), std::string("zorder")));
+  if (lod_levels > 1) {
+    std::ostringstream lod_str;
+    lod_str << lod_levels << " levels, base " << a_lod_base();
+    ctx.push_back(std::make_pair(std::string("lod"), lod_str.str()));
+  }
+
+  std::string fname_report = dir + std::string("/") + "run-report.json";
+  if (!bdifd_run_report::write_json(fname_report, ctx)) {
+    std::cerr << "generate_synth_sequence: error, unable to open file name " << fname_report << std::endl;
+    return 1;
+  }
+  if (bdifd_log::enabled(bdifd_log::info))
+    bdifd_run_report::print(std::clog);
 
   return 0;
 }
@@ -0,0 +1,97 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vul/vul_arg.h>
+#include <vul/vul_file.h>
+#include <vul/vul_timer.h>
+#include <bdifd/algo/bdifd_parallel.h>
+#include <bdifd/algo/bdifd_view_cache.h>
+
+// Write only selected views of the spherical dataset, projecting them on
+// demand through bdifd_view_cache instead of generating all 100. The views of
+// synthetic_data_ascii_show.m (selected_ids 55 43 63, one-based) are
+// "-views 54,42,62". Output files are named as by generate_synth_sequence_3.
+// Prints the setup time and the time to the first projected view.
+//
+// Usage: generate_views -views 54,42,62 [-seed s] [-outdir dir] [-capacity n]
+//          [-j threads]
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_views("-views", "zero-based view indices, e.g. 54,42,62", "54,42,62");
+  vul_arg<unsigned> a_seed("-seed", "camera seed (0 = clock)", 0);
+  vul_arg<std::string> a_dir("-outdir", "output directory", "./out-views");
+  vul_arg<unsigned> a_capacity("-capacity", "views kept in memory", 8);
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg_parse(argc, argv);
+
+  std::vector<unsigned> views;
+  {
+  std::string s = a_views();
+  for (unsigned i=0; i < s.size(); ++i)
+    if (s[i] == ',')
+      s[i] = ' ';
+  std::istringstream is(s);
+  unsigned v;
+  while (is >> v)
+    views.push_back(v);
+  }
+
+  vul_timer t;
+  std::unique_ptr<bdifd_view_cache> cache(bdifd_view_cache::spherical(a_seed(), a_capacity()));
+  double t_setup = t.real()/1000.0;
+  for (unsigned i=0; i < views.size(); ++i)
+    if (views[i] >= cache->nviews()) {
+      std::cerr << "generate_views: error, view " << views[i] << " out of range, have "
+        << cache->nviews() << std::endl;
+      return 1;
+    }
+  if (views.empty()) {
+    std::cerr << "generate_views: error, no views given" << std::endl;
+    return 1;
+  }
+
+  t.mark();
+  cache->view(views[0]);
+  double t_first = t.real()/1000.0;
+
+  std::string dir(a_dir());
+  vul_file::make_directory(dir);
+  std::vector<char> ok(views.size(), 0);
+  t.mark();
+  bdifd_parallel::for_each(views.size(), [&](unsigned i) {
+    bdifd_view_cache::view_ptr p = cache->view(views[i]);
+
+    std::ostringstream v_str;
+    v_str << std::setw(4) << std::setfill('0') << views[i];
+    std::string fname_base = dir + std::string("/frame_") + v_str.str();
+    std::ofstream fp_pts((fname_base + "-pts-2D.txt").c_str());
+    std::ofstream fp_tgts((fname_base + "-tgts-2D.txt").c_str());
+    if (!fp_pts || !fp_tgts)
+      return;
+    fp_pts << std::setprecision(20);
+    fp_tgts << std::setprecision(20);
+    for (unsigned j=0; j < p->pts.size(); ++j) {
+      fp_pts << p->pts[j].gama[0] << " " << p->pts[j].gama[1] << std::endl;
+      fp_tgts << p->pts[j].t[0] << " " << p->pts[j].t[1] << std::endl;
+    }
+    ok[i] = fp_pts && fp_tgts;
+  }, a_threads());
+  double t_views = t.real()/1000.0;
+
+  for (unsigned i=0; i < views.size(); ++i)
+    if (!ok[i]) {
+      std::cerr << "generate_views: error, unable to write view " << views[i] << " in " << dir << std::endl;
+      return 1;
+    }
+
+  std::cout << "Scene of " << cache->npts() << " samples, " << cache->nviews() << " cameras set up in "
+    << t_setup << " s; first view in " << t_first << " s" << std::endl;
+  std::cout << "Wrote " << views.size() << " views in " << t_views << " s; cache: "
+    << cache->hits() << " hits, " << cache->misses() << " misses, "
+    << cache->evictions() << " evictions, " << cache->size() << " views held" << std::endl;
+  return 0;
+}
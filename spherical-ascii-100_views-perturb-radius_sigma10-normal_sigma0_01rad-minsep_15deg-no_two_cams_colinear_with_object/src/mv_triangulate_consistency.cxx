@@ -0,0 +1,100 @@
+#include <cmath>
+#include <iostream>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <vnl/vnl_random.h>
+#include <bdifd/bdifd_camera.h>
+#include <bdifd/bdifd_util.h>
+#include <bdifd/algo/bdifd_data.h>
+#include <bdifd/algo/bdifd_err_stats.h>
+#include <bdifd/algo/bdifd_mv_triangulation.h>
+
+// Ground-truth consistency check for the spherical dataset: projects the
+// synthetic curves into all cameras, triangulates every sample from all views
+// in which it is visible and compares with the 3D curves. With -sigma, image
+// positions are perturbed by Gaussian noise (pixels) before triangulating.
+//
+// Usage: mv_triangulate_consistency [-sigma pixels] [-j threads]
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<double> a_sigma("-sigma", "std. deviation of the image noise, pixels", 0);
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg_parse(argc, argv);
+
+  unsigned  crop_origin_x_ = 400;
+  unsigned  crop_origin_y_ = 900;
+  double x_max_scaled = 500;
+
+  vnl_double_3x3 Kmatrix;
+  bdifd_turntable::internal_calib_olympus(Kmatrix, x_max_scaled, crop_origin_x_, crop_origin_y_);
+
+  vpgl_calibration_matrix<double> K(Kmatrix);
+  std::vector<vpgl_perspective_camera<double> > cam_vpgl;
+  bdifd_turntable::cameras_olympus_spherical(&cam_vpgl, K, true, true);
+  unsigned nviews = cam_vpgl.size();
+
+  std::vector<bdifd_camera> cam(nviews);
+  for (unsigned v=0; v < nviews; ++v)
+    cam[v].set_p(cam_vpgl[v]);
+
+  std::vector<std::vector<bdifd_3rd_order_point_3d> > crv3d;
+  bdifd_data::space_curves_olympus_turntable( crv3d );
+
+  // x[v][i]: sample i of all curves, view v
+  std::vector<std::vector<bdifd_3rd_order_point_2d> > x(nviews);
+  std::vector<bdifd_3rd_order_point_3d> gt;
+  for (unsigned c=0; c < crv3d.size(); ++c) {
+    std::vector<std::vector<bdifd_3rd_order_point_2d> > xc;
+    bdifd_data::project_into_cams(crv3d[c], cam, xc);
+    for (unsigned v=0; v < nviews; ++v)
+      x[v].insert(x[v].end(), xc[v].begin(), xc[v].end());
+    gt.insert(gt.end(), crv3d[c].begin(), crv3d[c].end());
+  }
+
+  if (a_sigma() > 0) {
+    vnl_random rng(5117);
+    for (unsigned v=0; v < nviews; ++v)
+      for (unsigned i=0; i < x[v].size(); ++i) {
+        x[v][i].gama[0] += a_sigma()*rng.normal64();
+        x[v][i].gama[1] += a_sigma()*rng.normal64();
+      }
+  }
+
+  bdifd_mv_triangulation tri(cam);
+  std::vector<bdifd_mv_point> X;
+  vul_timer t;
+  tri.triangulate(x, &X, a_threads());
+  double secs = t.real()/1000.0;
+
+  bdifd_err_stats err_pos, err_t, reproj, t_res, pos_cond, t_cond, nv;
+  for (unsigned i=0; i < X.size(); ++i) {
+    nv.add(X[i].nviews, i);
+    if (X[i].valid) {
+      err_pos.add((X[i].Gama - gt[i].Gama).magnitude(), i);
+      reproj.add(X[i].reproj_rms, i);
+      pos_cond.add(X[i].pos_cond, i);
+    }
+    if (X[i].valid_t) {
+      err_t.add(std::acos(bdifd_util::clump_to_acos(std::fabs(dot_product(X[i].T, gt[i].T)))), i);
+      t_res.add(X[i].t_residual, i);
+      t_cond.add(X[i].t_cond, i);
+    }
+  }
+
+  std::cout << "Triangulated " << X.size() << " samples from " << nviews << " views in "
+    << secs << " s (" << X.size()/secs << " points/s)" << std::endl;
+  std::cout << "Valid position: " << err_pos.count() << ", valid tangent: " << err_t.count() << std::endl;
+  nv.print_summary(std::cout, "Views per sample");
+  err_pos.print_summary(std::cout, "Position (3D)");
+  err_t.print_summary(std::cout, "Tangent angle (rad)");
+  reproj.print_summary(std::cout, "RMS reprojection (pixels)");
+  t_res.print_summary(std::cout, "Tangent residual");
+  pos_cond.print_summary(std::cout, "Position conditioning");
+  t_cond.print_summary(std::cout, "Tangent conditioning");
+  std::cout << "Worst position at sample " << err_pos.argmax()
+    << ", worst tangent at sample " << err_t.argmax() << std::endl;
+
+  return 0;
+}
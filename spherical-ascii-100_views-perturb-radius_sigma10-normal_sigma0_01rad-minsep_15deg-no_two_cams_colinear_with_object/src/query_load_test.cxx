@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vul/vul_arg.h>
+#include <bdifd/algo/bdifd_err_stats.h>
+#include <bdifd/algo/bdifd_query_server.h>
+
+// Load test for query_server. Each of -clients threads opens its own
+// connection and sends -requests random queries, -batch at a time (pipelined,
+// of any size), waiting for all responses of a batch before the next. A
+// query is a -box x -box pixel box around a random position in a random view
+// or, with probability -point_frac, the track of a random sample.
+//
+// Prints the throughput and the p50, p99 and largest round-trip time of a
+// batch, over all clients.
+//
+// Usage: query_load_test [-address unix:/tmp/bdifd.sock] [-clients 4]
+//          [-requests 100000] [-batch 1] [-box 64] [-point_frac 0.5] [-seed 1]
+//
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+struct client_result {
+  bool ok;
+  unsigned long requests, records;
+  double max_us;
+  bdifd_quantile_sketch latency_us;
+
+  client_result() : ok(false), requests(0), records(0), max_us(0) {}
+};
+
+} // namespace
+
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_address("-address", "unix:/path or tcp:port", "unix:/tmp/bdifd.sock");
+  vul_arg<unsigned> a_clients("-clients", "concurrent connections, one thread each", 4);
+  vul_arg<unsigned> a_requests("-requests", "requests per client", 100000);
+  vul_arg<unsigned> a_batch("-batch", "requests sent together", 1);
+  vul_arg<double> a_box("-box", "side of the query box in pixels", 64);
+  vul_arg<double> a_point_frac("-point_frac", "fraction of point-track queries", 0.5);
+  vul_arg<unsigned> a_seed("-seed", "random seed", 1);
+  vul_arg_parse(argc, argv);
+
+  bdifd_query_client probe;
+  if (!probe.connect(a_address()))
+    return 1;
+  bdifd_query_request info;
+  std::memset(&info, 0, sizeof(info));
+  info.op = bdifd_query_request::op_info;
+  bdifd_query_response r;
+  std::vector<bdifd_query_record> recs;
+  if (!probe.query(info, &r, &recs) || r.status != bdifd_query_response::ok || recs.size() != 1) {
+    std::cerr << "query_load_test: error, no info from " << a_address() << std::endl;
+    return 1;
+  }
+  const bdifd_query_record bounds = recs[0];
+  if (!bounds.view || !bounds.point) {
+    std::cerr << "query_load_test: error, empty dataset behind " << a_address() << std::endl;
+    return 1;
+  }
+
+  unsigned nclients = std::max(a_clients(), 1u), batch = std::max(a_batch(), 1u);
+  unsigned nbatches = (a_requests() + batch - 1)/batch;
+  double half = a_box()/2;
+  std::vector<client_result> res(nclients);
+  std::vector<std::thread> pool;
+
+  clock_type::time_point t0 = clock_type::now();
+  for (unsigned c=0; c < nclients; ++c)
+    pool.push_back(std::thread([&, c]() {
+      client_result &out = res[c];
+      bdifd_query_client cl;
+      if (!cl.connect(a_address()))
+        return;
+      std::mt19937 rng(a_seed() + 7919*c);
+      std::uniform_real_distribution<double> u01(0, 1);
+      std::uniform_real_distribution<double> ux(bounds.x, bounds.tx), uy(bounds.y, bounds.ty);
+      std::uniform_int_distribution<unsigned> uview(0, bounds.view - 1), upoint(0, bounds.point - 1);
+      std::vector<bdifd_query_request> q(batch);
+      std::vector<bdifd_query_record> records;
+      bdifd_query_response resp;
+
+      for (unsigned b=0; b < nbatches; ++b) {
+        for (unsigned k=0; k < batch; ++k) {
+          std::memset(&q[k], 0, sizeof(q[k]));
+          q[k].id = b*batch + k;
+          if (u01(rng) < a_point_frac()) {
+            q[k].op = bdifd_query_request::op_point;
+            q[k].point = upoint(rng);
+          } else {
+            double x = ux(rng), y = uy(rng);
+            q[k].op = bdifd_query_request::op_box;
+            q[k].view = uview(rng);
+            q[k].xmin = x - half;
+            q[k].xmax = x + half;
+            q[k].ymin = y - half;
+            q[k].ymax = y + half;
+          }
+        }
+        clock_type::time_point s = clock_type::now();
+        if (!cl.send(&q[0], batch))
+          return;
+        for (unsigned k=0; k < batch; ++k) {
+          if (!cl.receive(&resp, &records) || resp.id != q[k].id
+              || resp.status != bdifd_query_response::ok)
+            return;
+          out.records += records.size();
+        }
+        double us = std::chrono::duration<double, std::micro>(clock_type::now() - s).count();
+        out.latency_us.add(us);
+        out.max_us = std::max(out.max_us, us);
+        out.requests += batch;
+      }
+      out.ok = true;
+    }));
+  for (unsigned c=0; c < nclients; ++c)
+    pool[c].join();
+  double secs = std::chrono::duration<double>(clock_type::now() - t0).count();
+
+  bdifd_quantile_sketch latency;
+  unsigned long nreq = 0, nrec = 0;
+  double max_us = 0;
+  for (unsigned c=0; c < nclients; ++c) {
+    if (!res[c].ok) {
+      std::cerr << "query_load_test: error, client " << c << " lost its connection or got a bad response"
+        << std::endl;
+      return 1;
+    }
+    latency.merge(res[c].latency_us);
+    nreq += res[c].requests;
+    nrec += res[c].records;
+    max_us = std::max(max_us, res[c].max_us);
+  }
+
+  std::cout << nclients << " clients, " << nreq << " requests in batches of " << batch << ": "
+    << secs << " s, " << nreq/secs << " requests/s, " << double(nrec)/nreq << " records/request"
+    << std::endl;
+  std::cout << "Batch round trip: p50 " << latency.quantile(0.5) << " us, p99 "
+    << latency.quantile(0.99) << " us, max " << max_us << " us" << std::endl;
+  return 0;
+}
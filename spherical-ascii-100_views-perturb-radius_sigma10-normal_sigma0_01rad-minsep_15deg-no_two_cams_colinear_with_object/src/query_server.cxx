@@ -0,0 +1,67 @@
+#include <csignal>
+#include <iostream>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_parallel.h>
+#include <bdifd/algo/bdifd_query_server.h>
+
+// Serves view-box and point-track queries on an ASCII dataset over a local
+// socket (protocol in bdifd_query_server.h), so interactive tools and workers
+// on the node look samples up instead of loading the files. Runs until SIGINT
+// or SIGTERM, then prints the number of connections and requests served.
+// query_load_test measures it.
+//
+// Usage: query_server -dir dataset [-address unix:/tmp/bdifd.sock | tcp:port]
+//          [-cell 32] [-j threads]
+//
+
+namespace {
+
+bdifd_query_server *server = 0;
+
+void
+on_signal(int)
+{
+  if (server)
+    server->stop();
+}
+
+} // namespace
+
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "dataset directory", ".");
+  vul_arg<std::string> a_address("-address", "unix:/path or tcp:port (loopback)", "unix:/tmp/bdifd.sock");
+  vul_arg<double> a_cell("-cell", "index grid cell size in pixels", 32);
+  vul_arg<unsigned> a_threads("-j", "event loop threads (0 = all cores)", 0);
+  vul_arg_parse(argc, argv);
+
+  vul_timer t;
+  bdifd_ascii_dataset ds;
+  if (!ds.read(a_dir()))
+    return 1;
+  double t_read = t.real()/1000.0;
+  t.mark();
+  bdifd_query_index index(ds, a_cell());
+  double t_index = t.real()/1000.0;
+
+  bdifd_query_server srv(index);
+  if (!srv.listen(a_address()))
+    return 1;
+  server = &srv;
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+
+  unsigned nthreads = bdifd_parallel::num_threads(a_threads());
+  std::cout << "Serving " << index.nviews() << " views of " << index.npts() << " samples on "
+    << a_address() << " with " << nthreads << " threads (read " << t_read << " s, index "
+    << t_index << " s)" << std::endl;
+  srv.run(nthreads);
+  server = 0;
+
+  std::cout << "Served " << srv.requests() << " requests on " << srv.connections()
+    << " connections" << std::endl;
+  return 0;
+}
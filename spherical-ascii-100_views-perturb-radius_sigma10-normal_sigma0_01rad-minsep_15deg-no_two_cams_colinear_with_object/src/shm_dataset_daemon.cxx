@@ -0,0 +1,148 @@
+#include <csignal>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <sys/stat.h>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_log.h>
+#include <bdifd/algo/bdifd_shm_dataset.h>
+
+// Loads an ASCII dataset once into POSIX shared memory (see
+// bdifd_shm_dataset.h) and keeps it current for the evaluation processes of
+// the node, which attach with bdifd_shm_client instead of reading the folder.
+//
+// Every -poll seconds the dataset files are checked for a change of size or
+// modification time (to the second), or for a change in the number of views. A changed dataset
+// is re-read once it has been stable for one more poll and published as the
+// next generation; readers pick it up on their next current() call. If it
+// cannot be read (e.g. half copied) the previous generation stays.
+//
+// SIGINT or SIGTERM unpublish and exit. With -once the dataset is published
+// and the daemon exits, leaving the segments for readers until a later
+// "-unpublish" run.
+//
+// Usage: shm_dataset_daemon -dir dataset [-name /bdifd] [-poll 2] [-no_2d]
+//          [-once] [-unpublish]
+//
+
+namespace {
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void
+on_signal(int)
+{
+  stop_requested = 1;
+}
+
+//: Sizes and modification times of the files of the dataset in \p dir, and
+// its view count; changes whenever any of them does.
+std::string
+signature(const std::string &dir)
+{
+  std::string sig;
+  const char *files[] = {"calib.intrinsic", "crv-3D-pts.txt", "crv-3D-tgts.txt", "crv-ids.txt"};
+  std::vector<std::string> names(files, files + 4);
+  for (unsigned v=0; ; ++v) {
+    std::string base = bdifd_ascii_dataset::view_name(v);
+    struct stat st;
+    if (stat((dir + "/" + base + ".extrinsic").c_str(), &st) != 0)
+      break;
+    names.push_back(base + ".extrinsic");
+    names.push_back(base + "-pts-2D.txt");
+    names.push_back(base + "-tgts-2D.txt");
+  }
+  for (unsigned i=0; i < names.size(); ++i) {
+    struct stat st;
+    std::ostringstream s;
+    if (stat((dir + "/" + names[i]).c_str(), &st) == 0)
+      s << names[i] << ":" << st.st_size << ":" << st.st_mtime << ";";
+    else
+      s << names[i] << ":-;";
+    sig += s.str();
+  }
+  return sig;
+}
+
+bool
+load_and_publish(const std::string &dir, bool read_2d, bdifd_shm_publisher *pub)
+{
+  vul_timer t;
+  bdifd_ascii_dataset ds;
+  if (!ds.read(dir, read_2d))
+    return false;
+  double t_read = t.real()/1000.0;
+  t.mark();
+  if (!pub->publish(ds))
+    return false;
+  std::cout << "Published generation " << pub->generation() << ": " << ds.nviews() << " views, "
+    << ds.npts() << " samples (read " << t_read << " s, publish " << t.real()/1000.0 << " s)" << std::endl;
+  return true;
+}
+
+} // namespace
+
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "dataset directory", ".");
+  vul_arg<std::string> a_name("-name", "shared-memory name, starting with /", "/bdifd");
+  vul_arg<double> a_poll("-poll", "seconds between checks for a new dataset version", 2);
+  vul_arg<bool> a_no_2d("-no_2d", "publish cameras and 3D curves only", false);
+  vul_arg<bool> a_once("-once", "publish and exit, leaving the segments", false);
+  vul_arg<bool> a_unpublish("-unpublish", "remove the segments of -name and exit", false);
+  vul_arg_parse(argc, argv);
+
+  bdifd_shm_publisher pub(a_name());
+  if (!pub.ok())
+    return 1;
+  if (a_unpublish()) {
+    pub.unpublish();
+    return 0;
+  }
+
+  std::string dir = a_dir();
+  bool read_2d = !a_no_2d();
+  std::string sig = signature(dir);
+  if (!load_and_publish(dir, read_2d, &pub))
+    return 1;
+  if (a_once())
+    return 0;
+
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+  // nanosleep, unlike usleep, takes any -poll; a signal ends it early
+  double poll = a_poll() > 0 ? a_poll() : 1;
+  struct timespec poll_ts;
+  poll_ts.tv_sec = static_cast<std::time_t>(poll);
+  poll_ts.tv_nsec = static_cast<long>((poll - poll_ts.tv_sec)*1e9);
+  std::string pending;
+  while (!stop_requested) {
+    nanosleep(&poll_ts, 0);
+    std::string s = signature(dir);
+    if (s == sig) {
+      pending.clear();
+      continue;
+    }
+    // wait for the files to settle before reading them
+    if (s != pending) {
+      bdifd_log_msg(info) << "Dataset in " << dir << " changed, waiting for it to settle" << std::endl;
+      pending = s;
+      continue;
+    }
+    if (load_and_publish(dir, read_2d, &pub))
+      sig = s;
+    else {
+      bdifd_log_msg(warn) << "Keeping generation " << pub.generation() << std::endl;
+    }
+    pending.clear();
+  }
+
+  pub.unpublish();
+  std::cout << "Unpublished " << a_name() << std::endl;
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <cmath>
+#include <iostream>
+#include <unistd.h>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <bdifd/algo/bdifd_shm_dataset.h>
+
+// Attaches to a dataset published by shm_dataset_daemon and prints what it
+// holds, with the time taken to map it, as a minimal bdifd_shm_client user.
+// To check the data it reprojects the space samples into every view and
+// prints the largest distance to the stored image samples.
+//
+// With -follow the program keeps polling for -follow seconds and reports
+// each new generation it switches to.
+//
+// Usage: shm_dataset_info [-name /bdifd] [-follow seconds]
+//
+
+namespace {
+
+//: Largest distance between the projected space samples and the image
+// samples over all views of \p ds.
+double
+max_reprojection_error(const bdifd_shm_dataset &ds)
+{
+  double emax = 0;
+  const double *K = ds.K();
+  for (unsigned v=0; v < ds.nviews(); ++v) {
+    const double *R = ds.R(v), *C = ds.C(v);
+    const double *x = ds.x(v), *y = ds.y(v);
+    for (unsigned i=0; i < ds.npts(); ++i) {
+      double d[3] = {ds.X()[i] - C[0], ds.Y()[i] - C[1], ds.Z()[i] - C[2]};
+      double c[3];
+      for (unsigned r=0; r < 3; ++r)
+        c[r] = R[3*r]*d[0] + R[3*r+1]*d[1] + R[3*r+2]*d[2];
+      double u = (K[0]*c[0] + K[1]*c[1] + K[2]*c[2])/c[2];
+      double w = (K[4]*c[1] + K[5]*c[2])/c[2];
+      double e = std::sqrt((u - x[i])*(u - x[i]) + (w - y[i])*(w - y[i]));
+      if (e > emax)
+        emax = e;
+    }
+  }
+  return emax;
+}
+
+void
+print(const bdifd_shm_dataset &ds, double t_map)
+{
+  std::cout << "Generation " << ds.generation() << " from " << ds.dir() << ": " << ds.nviews()
+    << " views, " << ds.npts() << " samples, " << ds.bytes()/1048576.0 << " MB, mapped in "
+    << t_map*1000 << " ms" << std::endl;
+  if (ds.has_2d())
+    std::cout << "  max reprojection error " << max_reprojection_error(ds) << " px" << std::endl;
+}
+
+} // namespace
+
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_name("-name", "shared-memory name, starting with /", "/bdifd");
+  vul_arg<double> a_follow("-follow", "seconds to keep watching for new generations", 0);
+  vul_arg_parse(argc, argv);
+
+  bdifd_shm_client client(a_name());
+  vul_timer t;
+  std::shared_ptr<const bdifd_shm_dataset> ds = client.current();
+  if (!ds) {
+    std::cerr << "shm_dataset_info: error, nothing published as " << a_name() << std::endl;
+    return 1;
+  }
+  print(*ds, t.real()/1000.0);
+
+  vul_timer total;
+  while (total.real()/1000.0 < a_follow()) {
+    usleep(100000);
+    t.mark();
+    std::shared_ptr<const bdifd_shm_dataset> next = client.current();
+    if (next != ds) {
+      print(*next, t.real()/1000.0);
+      ds = next;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <vul/vul_arg.h>
+#include <vul/vul_file.h>
+#include <bdifd/algo/bdifd_log.h>
+#include <bdifd/algo/bdifd_parallel.h>
+#include <bdifd/algo/bdifd_run_report.h>
+#include <bdifd/algo/bdifd_sweep.h>
+
+// Generates variants of the spherical dataset over a grid of parameters,
+// one folder per variant under -outdir, named as the published one (see
+// bdifd_sweep.h). Every parameter takes a comma separated list; the sweep is
+// the cartesian product, and parameters left out keep their published value.
+// E.g.
+//
+//   sweep_datasets -outdir sweep -seed 7 -nviews 20,100 -pos_noise 0,0.5,1,2 -tgt_noise 0,1,5
+//
+// gives 24 folders from one sampled scene and two sets of cameras.
+//
+// Sampling, cameras, projection and writing run as tasks on a work-stealing
+// pool of -j threads (see bdifd_work_pool.h). The run report, with the
+// number of variants, camera sets and bytes written, goes to
+// -outdir/run-report.json.
+//
+// Unless -no_minsep, no variant may ask for more views than can all be
+// -minsep apart (bdifd_spherical_params::max_separated_views, 116 at 15
+// degrees); the sweep stops before generating anything.
+//
+// Usage: sweep_datasets [-outdir dir] [-seed s] [-j threads]
+//          [-nviews n,...] [-radius_sigma mm,...] [-normal_sigma rad,...]
+//          [-minsep deg,...] [-density d,...] [-pos_noise px,...]
+//          [-tgt_noise deg,...] [-scale x_max,...] [-crop XxY,...]
+//          [-no_perturb] [-no_minsep] [-list]
+//
+// With -seed 0 (the default) the seed is drawn from the clock once, for the
+// whole sweep, and recorded in the run report.
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-outdir", "output directory, one folder per variant", "./sweep");
+  vul_arg<unsigned> a_seed("-seed", "camera and noise seed (0 = clock)", 0);
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg<std::string> a_nviews("-nviews", "numbers of views", "");
+  vul_arg<std::string> a_radius_sigma("-radius_sigma", "camera distance sigmas, mm", "");
+  vul_arg<std::string> a_normal_sigma("-normal_sigma", "viewing direction sigmas, rad", "");
+  vul_arg<std::string> a_minsep("-minsep", "minimum camera separations, degrees", "");
+  vul_arg<std::string> a_density("-density", "curve sampling densities (1 = published)", "");
+  vul_arg<std::string> a_pos_noise("-pos_noise", "position noise, pixels", "");
+  vul_arg<std::string> a_tgt_noise("-tgt_noise", "tangent noise, degrees", "");
+  vul_arg<std::string> a_scale("-scale", "scaled image widths, as x_max_scaled of internal_calib_olympus", "");
+  vul_arg<std::string> a_crop("-crop", "crop origins XxY", "");
+  vul_arg<bool> a_no_perturb("-no_perturb", "do not perturb camera distance and direction", false);
+  vul_arg<bool> a_no_minsep("-no_minsep", "do not enforce a minimum camera separation", false);
+  vul_arg<bool> a_list("-list", "only print the variant names", false);
+  vul_arg_parse(argc, argv);
+
+  bdifd_sweep_grid grid;
+  grid.perturb = !a_no_perturb();
+  grid.minsep = !a_no_minsep();
+  const std::pair<const char *, std::string> lists[] = {
+    std::make_pair("nviews", a_nviews()),
+    std::make_pair("radius_sigma", a_radius_sigma()),
+    std::make_pair("normal_sigma", a_normal_sigma()),
+    std::make_pair("minsep", a_minsep()),
+    std::make_pair("density", a_density()),
+    std::make_pair("pos_noise", a_pos_noise()),
+    std::make_pair("tgt_noise", a_tgt_noise()),
+    std::make_pair("scale", a_scale()),
+    std::make_pair("crop", a_crop())
+  };
+  for (unsigned i=0; i < sizeof(lists)/sizeof(lists[0]); ++i)
+    if (!lists[i].second.empty() && !grid.set(lists[i].first, lists[i].second)) {
+      std::cerr << "sweep_datasets: error, bad list for -" << lists[i].first
+        << ": " << lists[i].second << std::endl;
+      return 1;
+    }
+
+  std::vector<bdifd_sweep_variant> variants;
+  grid.variants(&variants);
+  for (unsigned v=0; v < variants.size(); ++v) {
+    const bdifd_spherical_params &c = variants[v].cams;
+    if (variants[v].minsep && c.nviews > c.max_separated_views()) {
+      std::cerr << "sweep_datasets: error, " << c.nviews << " views cannot all be " << c.minsep_deg
+        << " degrees apart, at most " << c.max_separated_views() << " (or -no_minsep)" << std::endl;
+      return 1;
+    }
+  }
+  if (a_list()) {
+    for (unsigned v=0; v < variants.size(); ++v)
+      std::cout << variants[v].name() << std::endl;
+    return 0;
+  }
+
+  unsigned seed = a_seed() ? a_seed() : static_cast<unsigned>(std::time(0));
+  unsigned nthreads = bdifd_parallel::num_threads(a_threads());
+  bdifd_log_msg(info) << variants.size() << " variants on " << nthreads << " threads, seed "
+    << seed << std::endl;
+
+  bdifd_stage_timer t_sweep("sweep");
+  bool ok = bdifd_sweep::run(variants, a_dir(), seed, nthreads);
+  t_sweep.stop();
+
+  bdifd_run_report::context ctx;
+  ctx.push_back(std::make_pair(std::string("generator"), std::string("sweep_datasets")));
+  ctx.push_back(std::make_pair(std::string("dataset"), std::string("spherical")));
+  std::ostringstream nvariants_str, seed_str, threads_str;
+  nvariants_str << variants.size();
+  seed_str << seed;
+  threads_str << nthreads;
+  ctx.push_back(std::make_pair(std::string("variants"), nvariants_str.str()));
+  ctx.push_back(std::make_pair(std::string("seed"), seed_str.str()));
+  ctx.push_back(std::make_pair(std::string("threads"), threads_str.str()));
+
+  vul_file::make_directory(a_dir());
+  std::string fname_report = a_dir() + std::string("/") + "run-report.json";
+  if (!bdifd_run_report::write_json(fname_report, ctx)) {
+    std::cerr << "sweep_datasets: error, unable to open file name " << fname_report << std::endl;
+    return 1;
+  }
+  if (bdifd_log::enabled(bdifd_log::info))
+    bdifd_run_report::print(std::clog);
+
+  if (!ok) {
+    std::cerr << "sweep_datasets: error, some variants were not written" << std::endl;
+    return 1;
+  }
+  return 0;
+}
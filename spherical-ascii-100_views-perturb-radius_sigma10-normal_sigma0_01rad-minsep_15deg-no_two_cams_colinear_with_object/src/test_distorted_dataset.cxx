@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <vul/vul_arg.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_epipolar_checker.h>
+#include <bdifd/algo/bdifd_reprojection_checker.h>
+#include <bdifd/algo/bdifd_trifocal_validator.h>
+
+// Round trip of a distorted dataset through the loader and the checkers: the
+// first -views views of a pinhole dataset are written to a temporary
+// directory with their image samples and tangents passed through -distortion
+// and a calib.distortion, as generate_synth_sequence_3 -distortion does, then
+// read back. The reprojection, epipolar and trifocal checks must all pass
+// within -tol, and the reprojection check must fail once calib.distortion is
+// removed. Returns nonzero on any failure.
+//
+// Usage: test_distorted_dataset -dir dataset [-views 6] [-tol 1e-6]
+//          [-distortion k1,k2,k3,p1,p2]
+//
+
+namespace {
+
+//: Removes the files written to a temporary directory, and the directory,
+// on every way out of main().
+struct tmp_dir {
+  std::string dir;
+  std::vector<std::string> files;
+  ~tmp_dir()
+  {
+    if (dir.empty())
+      return;
+    for (unsigned i=0; i < files.size(); ++i)
+      std::remove((dir + "/" + files[i]).c_str());
+    if (rmdir(dir.c_str()) != 0)
+      std::cerr << "test_distorted_dataset: warning, left " << dir << " behind" << std::endl;
+  }
+};
+
+bool
+write_columns(tmp_dir *tmp, const std::string &name, const std::vector<double> *cols[], unsigned ncols)
+{
+  tmp->files.push_back(name);
+  std::ofstream fp((tmp->dir + "/" + name).c_str());
+  fp.precision(20);
+  for (unsigned i=0; fp && i < cols[0]->size(); ++i) {
+    for (unsigned c=0; c < ncols; ++c)
+      fp << (c ? " " : "") << (*cols[c])[i];
+    fp << std::endl;
+  }
+  if (!fp) {
+    std::cerr << "test_distorted_dataset: error, unable to write file name " << name << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//: Writes views [0, nv) of \p ds to \p tmp with \p d applied to its image
+// samples.
+bool
+write_distorted(const bdifd_ascii_dataset &ds, unsigned nv, const bdifd_lens_distortion &d,
+    tmp_dir *tmp)
+{
+  std::vector<double> K(ds.K.data_block(), ds.K.data_block() + 9);
+  const std::vector<double> *kcols[1] = {&K};
+  std::vector<double> ids(ds.crv_id.begin(), ds.crv_id.end());
+  const std::vector<double> *idcols[1] = {&ids};
+  const std::vector<double> *pts[3] = {&ds.X, &ds.Y, &ds.Z};
+  const std::vector<double> *tgts[3] = {&ds.TX, &ds.TY, &ds.TZ};
+  if (!write_columns(tmp, "calib.intrinsic", kcols, 1)
+      || !write_columns(tmp, "crv-ids.txt", idcols, 1)
+      || !write_columns(tmp, "crv-3D-pts.txt", pts, 3)
+      || !write_columns(tmp, "crv-3D-tgts.txt", tgts, 3))
+    return false;
+  tmp->files.push_back("calib.distortion");
+  if (!d.write(tmp->dir + "/calib.distortion"))
+    return false;
+
+  for (unsigned v=0; v < nv; ++v) {
+    std::string base = bdifd_ascii_dataset::view_name(v);
+    std::vector<double> ext;
+    for (unsigned r=0; r < 3; ++r)
+      for (unsigned c=0; c < 3; ++c)
+        ext.push_back(ds.R[v][r][c]);
+    for (unsigned c=0; c < 3; ++c)
+      ext.push_back(ds.C[v][c]);
+    const std::vector<double> *ecols[1] = {&ext};
+    if (!write_columns(tmp, base + ".extrinsic", ecols, 1))
+      return false;
+
+    unsigned n = ds.npts();
+    std::vector<double> x(n), y(n), tx(n), ty(n);
+    const vnl_double_3x3 &Km = ds.K;
+    for (unsigned i=0; i < n; ++i) {
+      double vv = (ds.y[v][i] - Km[1][2])/Km[1][1];
+      double u = (ds.x[v][i] - Km[0][2] - Km[0][1]*vv)/Km[0][0];
+      double dv = ds.ty[v][i]/Km[1][1];
+      double du = (ds.tx[v][i] - Km[0][1]*dv)/Km[0][0];
+      double ud, vd, dud, dvd;
+      d.distort(u, vv, du, dv, &ud, &vd, &dud, &dvd);
+      x[i] = Km[0][0]*ud + Km[0][1]*vd + Km[0][2];
+      y[i] = Km[1][1]*vd + Km[1][2];
+      double qx = Km[0][0]*dud + Km[0][1]*dvd, qy = Km[1][1]*dvd;
+      double g = std::sqrt(qx*qx + qy*qy);
+      tx[i] = qx/g;
+      ty[i] = qy/g;
+    }
+    const std::vector<double> *p2d[2] = {&x, &y}, *t2d[2] = {&tx, &ty};
+    if (!write_columns(tmp, base + "-pts-2D.txt", p2d, 2)
+        || !write_columns(tmp, base + "-tgts-2D.txt", t2d, 2))
+      return false;
+  }
+  return true;
+}
+
+bool
+check(bool pass, const char *what, double value)
+{
+  std::cout << what << ": " << value << (pass ? "" : "  ** FAIL") << std::endl;
+  return pass;
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "pinhole dataset directory", ".");
+  vul_arg<unsigned> a_views("-views", "views to copy", 6);
+  vul_arg<double> a_tol("-tol", "tolerance of every check", 1e-6);
+  vul_arg<std::string> a_distortion("-distortion", "k1,k2,k3,p1,p2", "-0.2,0.05,0,0.001,0.001");
+  vul_arg_parse(argc, argv);
+
+  bdifd_lens_distortion d;
+  if (!d.parse(a_distortion()) || d.is_identity()) {
+    std::cerr << "test_distorted_dataset: error, -distortion takes non-zero k1,k2,k3,p1,p2" << std::endl;
+    return 1;
+  }
+  bdifd_ascii_dataset src;
+  if (!src.read(a_dir()))
+    return 1;
+  if (!src.distortion.is_identity()) {
+    std::cerr << "test_distorted_dataset: error, " << a_dir() << " is already distorted" << std::endl;
+    return 1;
+  }
+  unsigned nv = std::min(a_views(), src.nviews());
+  if (nv < 3) {
+    std::cerr << "test_distorted_dataset: error, need at least 3 views" << std::endl;
+    return 1;
+  }
+
+  tmp_dir tmp;
+  char tmpl[] = "/tmp/bdifd-distorted-XXXXXX";
+  if (!mkdtemp(tmpl)) {
+    std::cerr << "test_distorted_dataset: error, unable to create a temporary directory" << std::endl;
+    return 1;
+  }
+  tmp.dir = tmpl;
+  if (!write_distorted(src, nv, d, &tmp))
+    return 1;
+
+  bdifd_ascii_dataset ds;
+  if (!ds.read(tmp.dir))
+    return 1;
+  bool ok = check(ds.nviews() == nv && !ds.distortion.is_identity(), "views read", ds.nviews());
+
+  const double tol = a_tol();
+  bdifd_reprojection_checker rchk(ds, tol, tol);
+  std::vector<bdifd_view_reprojection> rres;
+  unsigned bad = rchk.check_all(&rres);
+  double rmax = 0;
+  for (unsigned v=0; v < rres.size(); ++v)
+    rmax = std::max(rmax, std::max(rres[v].max_pt, rres[v].max_tgt));
+  ok = check(bad == nv, "reprojection, max", rmax) && ok;
+
+  bdifd_epipolar_checker echk(ds);
+  std::vector<bdifd_epipolar_residuals> eres;
+  echk.check_all(&eres);
+  double emax = 0;
+  bool efinite = true;
+  for (unsigned p=0; p < eres.size(); ++p)
+    for (unsigned k=0; k < bdifd_epipolar_residuals::nkinds; ++k) {
+      emax = std::max(emax, eres[p].max[k]);
+      efinite = efinite && !eres[p].nonfinite[k];
+    }
+  ok = check(efinite && emax <= tol, "epipolar, max", emax) && ok;
+
+  bdifd_trifocal_validator tval(ds);
+  std::vector<vnl_vector_fixed<unsigned,3> > triplets;
+  bdifd_trifocal_validator::all_triplets(nv, &triplets);
+  std::vector<bdifd_trifocal_residuals> tres;
+  tval.check(triplets, &tres);
+  double tmax = 0;
+  bool tfinite = true;
+  for (unsigned i=0; i < tres.size(); ++i)
+    for (unsigned k=0; k < bdifd_trifocal_residuals::nkinds; ++k) {
+      tmax = std::max(tmax, tres[i].max[k]);
+      tfinite = tfinite && tres[i].max[k] == tres[i].max[k];
+    }
+  ok = check(tfinite && tmax <= tol, "trifocal, max", tmax) && ok;
+
+  // without calib.distortion the same samples must not reproject
+  std::remove((tmp.dir + "/calib.distortion").c_str());
+  bdifd_ascii_dataset pinhole;
+  if (!pinhole.read(tmp.dir))
+    return 1;
+  bdifd_reprojection_checker pchk(pinhole, tol, tol);
+  std::vector<bdifd_view_reprojection> pres;
+  bad = pchk.check_all(&pres);
+  ok = check(bad < nv, "reprojection without calib.distortion, first bad view", bad) && ok;
+
+  std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <vul/vul_arg.h>
+#include <vnl/vnl_math.h>
+#include <bdifd/algo/bdifd_edgel_sampler.h>
+
+// Spacing of bdifd_edgel_sampler on circles, mild and high aspect ratio
+// ellipses, each started at a few angles, and open arcs. For each curve, of
+// length L sampled with N chords (the closing one included on a closed
+// curve):
+//
+//  - N is the nearest whole number to L/spacing (at least 3 on a closed
+//    curve and 1 on an arc);
+//  - no chord is longer than L/N;
+//  - where the curve is not folded within a step (curvature k at most pi
+//    N/L everywhere), no chord is shorter than 2 sin(k L/2N)/k;
+//  - open arcs start and end on theta0 and theta1.
+//
+// L is integrated here independently of the sampler, by the midpoint rule.
+// Returns nonzero on any failure.
+//
+// Usage: test_edgel_sampler [-spacing 1]
+//
+
+namespace {
+
+//: Length of \p a by the midpoint rule on \p n intervals.
+double
+length(const bdifd_conic_arc &a, unsigned n)
+{
+  const double deg = vnl_math::pi/180.0;
+  double t0 = a.theta0*deg, dt = (std::min(a.theta1 - a.theta0, 360.0)*deg)/n, L = 0;
+  for (unsigned i=0; i < n; ++i) {
+    double t = t0 + (i + 0.5)*dt;
+    L += std::sqrt(a.ra*a.ra*std::sin(t)*std::sin(t) + a.rb*a.rb*std::cos(t)*std::cos(t))*dt;
+  }
+  return L;
+}
+
+bool
+check(const bdifd_edgel_sampler &smp, const bdifd_conic_arc &a)
+{
+  std::vector<bdifd_3rd_order_point_2d> C;
+  smp.sample(a, &C);
+  bool closed = a.theta1 - a.theta0 >= 360;
+  unsigned n = C.size(), N = closed ? n : n - 1;
+  double h = smp.spacing(), L = length(a, 2000000), step = L/N;
+
+  double lo = 1e300, hi = 0;
+  for (unsigned i=0; i < N; ++i) {
+    const bdifd_3rd_order_point_2d &p = C[i], &q = C[(i + 1) % n];
+    double d = std::sqrt((q.gama[0] - p.gama[0])*(q.gama[0] - p.gama[0])
+        + (q.gama[1] - p.gama[1])*(q.gama[1] - p.gama[1]));
+    lo = std::min(lo, d);
+    hi = std::max(hi, d);
+  }
+  double kmax = std::max(a.ra/(a.rb*a.rb), a.rb/(a.ra*a.ra));
+  bool folded = kmax*step > vnl_math::pi;
+  double lo_bound = folded ? 0 : 2*std::sin(kmax*step/2)/kmax;
+
+  unsigned Nmin = closed ? 3 : 1;
+  bool count_ok = std::fabs(N - L/h) <= 0.5 + 1e-6 || (N == Nmin && L/h < Nmin);
+  bool hi_ok = hi <= step*(1 + 1e-6);
+  bool lo_ok = lo >= lo_bound*(1 - 1e-6);
+  bool ends_ok = true;
+  if (!closed) {
+    bdifd_3rd_order_point_2d p0 = bdifd_edgel_sampler::point(a, a.theta0*vnl_math::pi/180);
+    bdifd_3rd_order_point_2d p1 = bdifd_edgel_sampler::point(a, a.theta1*vnl_math::pi/180);
+    ends_ok = std::fabs(C[0].gama[0] - p0.gama[0]) + std::fabs(C[0].gama[1] - p0.gama[1]) < 1e-9*a.ra
+      && std::fabs(C[n-1].gama[0] - p1.gama[0]) + std::fabs(C[n-1].gama[1] - p1.gama[1]) < 1e-9*a.ra;
+  }
+  bool pass = count_ok && hi_ok && lo_ok && ends_ok;
+
+  std::cout << a.ra << "x" << a.rb << " [" << a.theta0 << "," << a.theta1 << "]: L/h " << L/h
+    << " chords " << N << " (" << lo << " to " << hi << ", L/N " << step
+    << (folded ? ", folded" : "") << ")";
+  if (!count_ok)
+    std::cout << "  ** FAIL count";
+  if (!hi_ok)
+    std::cout << "  ** FAIL max chord";
+  if (!lo_ok)
+    std::cout << "  ** FAIL min chord, below " << lo_bound;
+  if (!ends_ok)
+    std::cout << "  ** FAIL ends";
+  std::cout << std::endl;
+  return pass;
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+  vul_arg<double> a_spacing("-spacing", "pixels between samples", 1);
+  vul_arg_parse(argc, argv);
+
+  const double h = a_spacing();
+  bdifd_edgel_sampler smp(h);
+  bool ok = true;
+
+  // closed curves, as get_circle_edgels and get_ellipse_edgels ask for them,
+  // then the same started elsewhere
+  const double radii[][2] = {
+    {2, 2}, {5, 5}, {50, 50}, {1e5, 1e5},
+    {80, 20}, {40, 10}, {200, 30}, {20, 80},
+    {200, 5}, {20, 1.5}, {1000, 1}, {10, 0.1}, {100, 0.05}, {3, 0.5}
+  };
+  const double starts[] = {0, 37, 90, 211.5};
+  for (unsigned i=0; i < sizeof(radii)/sizeof(radii[0]); ++i)
+    for (unsigned j=0; j < sizeof(starts)/sizeof(starts[0]); ++j)
+      ok = check(smp, bdifd_conic_arc(radii[i][0]*h, radii[i][1]*h, 10, -3,
+            starts[j], starts[j] + 360)) && ok;
+
+  // open arcs, over an end of the ellipse or not
+  const double arcs[][4] = {
+    {3, 0.5, 0, 280}, {20, 80, 30, 180}, {200, 5, 170, 190}, {100, 0.05, -30, 10},
+    {1000, 1, 5, 355}, {50, 50, 0, 0.5}, {20, 1.5, 90, 400}
+  };
+  for (unsigned i=0; i < sizeof(arcs)/sizeof(arcs[0]); ++i)
+    ok = check(smp, bdifd_conic_arc(arcs[i][0]*h, arcs[i][1]*h, 0, 0, arcs[i][2], arcs[i][3])) && ok;
+
+  std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}
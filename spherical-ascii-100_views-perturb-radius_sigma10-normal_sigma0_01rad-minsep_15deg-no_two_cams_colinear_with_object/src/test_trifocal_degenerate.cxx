@@ -0,0 +1,104 @@
+#include <iostream>
+#include <limits>
+#include <vul/vul_arg.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_trifocal_validator.h>
+
+// Degenerate triplets must fail bdifd_trifocal_validator instead of passing
+// -tol with their NaN residuals dropped. On views 0, 1, 2 of a dataset:
+//
+//  - as read, every residual is finite and within -tol;
+//  - with the space tangent of one sample pointing at the center of camera
+//    2, the tangent transfer into view 2 is close to 0/0, and the tangent
+//    residual must fail -tol;
+//  - with a zero space tangent at one sample (a cusp), its projection is
+//    0/0, and the tangent_projection residual must be NaN at that sample;
+//  - with one image sample of view 1 set to NaN, as left by a failed
+//    undistortion, the point residual must be NaN at that sample.
+//
+// Returns nonzero on any failure.
+//
+// Usage: test_trifocal_degenerate -dir dataset [-tol 1e-6]
+//
+
+namespace {
+
+typedef bdifd_trifocal_residuals K;
+
+//: Residuals of views 0, 1, 2 of \p ds.
+K
+check_012(const bdifd_ascii_dataset &ds)
+{
+  bdifd_trifocal_validator val(ds);
+  K r;
+  val.check(0, 1, 2, &r);
+  return r;
+}
+
+bool
+expect_fail(const K &r, unsigned kind, double tol)
+{
+  bool pass = !(r.max[kind] <= tol);
+  std::cout << K::name(kind) << ": max " << r.max[kind] << " at sample " << r.argmax[kind]
+    << ", expected above " << tol << (pass ? "" : "  ** FAIL") << std::endl;
+  return pass;
+}
+
+bool
+expect_nan(const K &r, unsigned kind, unsigned sample, double tol)
+{
+  bool pass = r.max[kind] != r.max[kind] && r.argmax[kind] == sample && !(r.max[kind] <= tol);
+  std::cout << K::name(kind) << ": max " << r.max[kind] << " at sample " << r.argmax[kind]
+    << ", expected NaN at " << sample << (pass ? "" : "  ** FAIL") << std::endl;
+  return pass;
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "dataset directory", ".");
+  vul_arg<double> a_tol("-tol", "largest acceptable residual", 1e-6);
+  vul_arg_parse(argc, argv);
+
+  bdifd_ascii_dataset ds;
+  if (!ds.read(a_dir()))
+    return 1;
+  if (ds.nviews() < 3 || ds.npts() < 3) {
+    std::cerr << "test_trifocal_degenerate: error, need 3 views and 3 samples" << std::endl;
+    return 1;
+  }
+  const double tol = a_tol();
+  bool ok = true;
+
+  K r = check_012(ds);
+  for (unsigned k=0; k < K::nkinds; ++k) {
+    bool pass = r.max[k] <= tol;
+    std::cout << "as read, " << K::name(k) << ": max " << r.max[k]
+      << (pass ? "" : "  ** FAIL") << std::endl;
+    ok = ok && pass;
+  }
+
+  // tangent through the center of camera 2
+  unsigned s = ds.npts()/2;
+  bdifd_ascii_dataset bad = ds;
+  bad.TX[s] = ds.C[2][0] - ds.X[s];
+  bad.TY[s] = ds.C[2][1] - ds.Y[s];
+  bad.TZ[s] = ds.C[2][2] - ds.Z[s];
+  ok = expect_fail(check_012(bad), K::tangent, tol) && ok;
+
+  // cusp
+  bad = ds;
+  bad.TX[s] = bad.TY[s] = bad.TZ[s] = 0;
+  ok = expect_nan(check_012(bad), K::tangent_projection, s, tol) && ok;
+
+  // image sample lost in view 1
+  unsigned s2 = ds.npts()/3;
+  bad = ds;
+  bad.x[1][s2] = bad.y[1][s2] = std::numeric_limits<double>::quiet_NaN();
+  ok = expect_nan(check_012(bad), K::point, s2, tol) && ok;
+
+  std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+  return ok ? 0 : 1;
+}
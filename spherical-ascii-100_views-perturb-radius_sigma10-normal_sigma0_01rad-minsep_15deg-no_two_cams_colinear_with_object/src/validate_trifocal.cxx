@@ -0,0 +1,117 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vul/vul_arg.h>
+#include <vul/vul_timer.h>
+#include <bdifd/algo/bdifd_ascii_dataset.h>
+#include <bdifd/algo/bdifd_trifocal_validator.h>
+
+// Checks the trifocal point and tangent constraints of an ASCII dataset on
+// every sample, replacing the Scilab scripts synthdata_trifocal*.sce. Views
+// are given as "-triplets 3,11,17;0,5,9", or drawn at random with -sample;
+// by default all triplets are checked. Returns nonzero if any residual is
+// above -tol or NaN.
+//
+// Usage: validate_trifocal -dir dataset [-triplets i,j,k;...] [-sample n]
+//          [-seed s] [-tol t] [-j threads] [-out table.txt]
+//
+int
+main(int argc, char **argv)
+{
+  vul_arg<std::string> a_dir("-dir", "dataset directory", ".");
+  vul_arg<std::string> a_triplets("-triplets", "view triplets, e.g. 3,11,17;0,5,9", "");
+  vul_arg<unsigned> a_sample("-sample", "number of random triplets (0 = all)", 0);
+  vul_arg<unsigned> a_seed("-seed", "seed for -sample", 1);
+  vul_arg<double> a_tol("-tol", "largest acceptable residual", 1e-6);
+  vul_arg<unsigned> a_threads("-j", "threads (0 = all cores)", 0);
+  vul_arg<std::string> a_out("-out", "per-triplet residuals, one line per triplet", "");
+  vul_arg_parse(argc, argv);
+
+  vul_timer t;
+  bdifd_ascii_dataset ds;
+  if (!ds.read(a_dir()))
+    return 1;
+  double t_read = t.real()/1000.0;
+
+  if (ds.nviews() < 3) {
+    std::cerr << "validate_trifocal: error, need at least 3 views, got " << ds.nviews() << std::endl;
+    return 1;
+  }
+
+  std::vector<vnl_vector_fixed<unsigned,3> > triplets;
+  if (!a_triplets().empty()) {
+    std::istringstream groups(a_triplets());
+    std::string g;
+    while (std::getline(groups, g, ';')) {
+      std::string w = g;
+      for (unsigned i=0; i < w.size(); ++i)
+        if (w[i] == ',')
+          w[i] = ' ';
+      std::istringstream is(w);
+      unsigned v[3];
+      if (!(is >> v[0] >> v[1] >> v[2]) || !(is >> std::ws).eof()) {
+        std::cerr << "validate_trifocal: error, need 3 views in triplet '" << g << "'" << std::endl;
+        return 1;
+      }
+      if (v[0] >= ds.nviews() || v[1] >= ds.nviews() || v[2] >= ds.nviews()) {
+        std::cerr << "validate_trifocal: error, view out of range in triplet "
+          << v[0] << "," << v[1] << "," << v[2] << std::endl;
+        return 1;
+      }
+      triplets.push_back(vnl_vector_fixed<unsigned,3>(v[0], v[1], v[2]));
+    }
+  } else if (a_sample())
+    bdifd_trifocal_validator::sample_triplets(ds.nviews(), a_sample(), a_seed(), &triplets);
+  else
+    bdifd_trifocal_validator::all_triplets(ds.nviews(), &triplets);
+
+  t.mark();
+  bdifd_trifocal_validator val(ds);
+  std::vector<bdifd_trifocal_residuals> res;
+  val.check(triplets, &res, a_threads());
+  double t_check = t.real()/1000.0;
+
+  typedef bdifd_trifocal_residuals K;
+  if (!a_out().empty()) {
+    std::ofstream fp(a_out().c_str());
+    if (!fp) {
+      std::cerr << "validate_trifocal: error, unable to open file name " << a_out() << std::endl;
+      return 1;
+    }
+    fp.precision(6);
+    fp << "# v1 v2 v3";
+    for (unsigned k=0; k < K::nkinds; ++k)
+      fp << " " << K::name(k);
+    fp << std::endl;
+    for (unsigned i=0; i < res.size(); ++i) {
+      fp << res[i].v[0] << " " << res[i].v[1] << " " << res[i].v[2];
+      for (unsigned k=0; k < K::nkinds; ++k)
+        fp << " " << res[i].max[k];
+      fp << std::endl;
+    }
+  }
+
+  std::cout << "Read " << ds.nviews() << " views, " << ds.npts() << " samples in "
+    << t_read << " s" << std::endl;
+  std::cout << "Checked " << res.size() << " triplets in " << t_check << " s" << std::endl;
+
+  bool ok = true;
+  for (unsigned k=0; k < K::nkinds; ++k) {
+    unsigned worst = 0;
+    for (unsigned i=1; i < res.size(); ++i)
+      if (!(res[i].max[k] <= res[worst].max[k]) && res[worst].max[k] == res[worst].max[k])
+        worst = i;
+    if (res.empty())
+      break;
+    const bdifd_trifocal_residuals &r = res[worst];
+    // false for NaN too
+    bool pass = r.max[k] <= a_tol();
+    ok = ok && pass;
+    std::cout << K::name(k) << ": max " << r.max[k]
+      << " at views " << r.v[0] << "," << r.v[1] << "," << r.v[2]
+      << " sample " << r.argmax[k]
+      << (pass ? "" : r.max[k] == r.max[k] ? "  ** above tolerance" : "  ** not finite") << std::endl;
+  }
+
+  return ok ? 0 : 1;
+}